@@ -0,0 +1,877 @@
+/**
+ *  @brief Benchmark entry point
+ *
+ *  This file contains the benchmark harness: each stage of the pixel
+ *  adjustment (read, detect, adjust, downscale and write) is timed over
+ *  synthetic frames, for every engine and thread count requested, and
+ *  reported as one JSON object per line.
+ *
+ */
+
+#include "frame.h"
+#include "kernels.h"
+#include "parallel.h"
+#include "selection.h"
+#include "synth.h"
+
+/* System includes */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS
+ ****************************************************************************/
+/* Default frame dimensions. */
+#define BENCH_WIDTH 4096U
+#define BENCH_HEIGHT 4096U
+
+/* Default number of pixels to adjust. */
+#define BENCH_PIXEL_COUNT 1000U
+
+/* Default number of runs for each measurement, the fastest one counts. */
+#define BENCH_REPEATS 3U
+
+/* Maximum number of entries in a list option. */
+#define BENCH_MAX_LIST 16U
+
+/* Adjustment factor used by the adjust stage. */
+#define BENCH_FACTOR 0.5f
+
+/****************************************************************************
+ * TYPE DEFINITIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Benchmark parameters given through the CLI.
+ */
+struct Bench_Options {
+    uint32_t width;             /* Frame width */
+    uint32_t height;            /* Frame height */
+    size_t pixel_count;         /* Number of pixels to select */
+    size_t repeats;             /* Runs for each measurement */
+    uint64_t seed;              /* Generator seed */
+    const char *directory;      /* Directory for the temporary frame */
+    enum Synth_Distribution distributions[BENCH_MAX_LIST];
+    size_t distribution_count;  /* Number of distributions */
+    enum Selection_Engine engines[BENCH_MAX_LIST];
+    size_t engine_count;        /* Number of engines */
+    size_t threads[BENCH_MAX_LIST];     /* Thread counts */
+    size_t thread_count;        /* Number of thread counts */
+};
+
+/**
+ *  @brief Stage work over one frame partition.
+ */
+struct Bench_Task {
+    uint16_t *data;             /* Partition pixel data */
+    size_t size;                /* Partition size */
+    size_t offset;              /* Index of the first partition pixel */
+    size_t pixel_count;         /* Number of pixels to select */
+    enum Selection_Engine engine;       /* Heap or histogram */
+    size_t *histogram;          /* Partition histogram */
+    struct Selection_Heap heap; /* Partition heap */
+    uint16_t value;             /* Adjustment threshold value */
+    uint8_t *out;               /* Partition preview pixels */
+    int status;                 /* Task result */
+};
+
+/**
+ *  @brief Frame and buffers shared by all the measurements.
+ */
+struct Bench_Frame {
+    uint16_t *data;             /* Generated frame */
+    uint16_t *work;             /* Copy adjusted by the adjust stage */
+    uint8_t *preview;           /* 8-bit preview pixels */
+    size_t size;                /* Number of pixels */
+    const char *path;           /* Temporary frame file */
+    int fd;                     /* Temporary frame file descriptor */
+    enum Synth_Distribution distribution;   /* Frame distribution */
+    uint16_t threshold;         /* Threshold of the adjust stage */
+};
+
+/****************************************************************************
+ * LOCAL DECLARATIONS
+ ****************************************************************************/
+/**
+ *  @brief Print help message
+ *
+ *  @param none
+ *
+ *  @return none
+ */
+static void PrintUsage(void);
+
+/**
+ *  @brief Parse a comma-separated list of names or numbers.
+ *
+ *  @param list     List to parse (modified)
+ *  @param parse    Entry parser, returning false for invalid entries
+ *  @param entries  Output entries
+ *  @param size     Size of one entry
+ *  @param count    Number of entries parsed
+ *
+ *  @return true, if all the entries are valid.
+ *          false, otherwise.
+ */
+static bool ParseList(char *list,
+                      bool (*parse)(const char *, void *),
+                      void *entries,
+                      size_t size,
+                      size_t *count);
+
+/**
+ *  @brief Parse a distribution list entry.
+ *
+ *  @param name   Distribution name
+ *  @param entry  Parsed enum Synth_Distribution
+ *
+ *  @return true, if the name is valid.
+ *          false, otherwise.
+ */
+static bool ParseDistribution(const char *name, void *entry);
+
+/**
+ *  @brief Parse an engine list entry.
+ *
+ *  @param name   Engine name (heap, select or histogram)
+ *  @param entry  Parsed enum Selection_Engine
+ *
+ *  @return true, if the name is valid.
+ *          false, otherwise.
+ */
+static bool ParseEngine(const char *name, void *entry);
+
+/**
+ *  @brief Parse a thread count list entry.
+ *
+ *  @param name   Thread count (0 for one per CPU)
+ *  @param entry  Parsed size_t
+ *
+ *  @return true, if the count is valid.
+ *          false, otherwise.
+ */
+static bool ParseThreads(const char *name, void *entry);
+
+/**
+ *  @brief Get a monotonic timestamp.
+ *
+ *  @param none
+ *
+ *  @return The time in seconds.
+ */
+static double GetTime(void);
+
+/**
+ *  @brief Print one measurement as a JSON object.
+ *
+ *  @param options  Benchmark parameters
+ *  @param frame    Measured frame
+ *  @param stage    Stage name
+ *  @param engine   Engine name
+ *  @param threads  Number of threads
+ *  @param seconds  Fastest run time
+ *
+ *  @return none
+ */
+static void PrintResult(const struct Bench_Options *options,
+                        const struct Bench_Frame *frame,
+                        const char *stage,
+                        const char *engine,
+                        size_t threads,
+                        double seconds);
+
+/**
+ *  @brief Split a frame into partitions for a stage.
+ *
+ *  @param frame    Frame to split
+ *  @param data     Pixel data to split (the frame or its copy)
+ *  @param count    Number of partitions
+ *  @param tasks    Output partitions
+ *
+ *  @return none
+ */
+static void InitTasks(const struct Bench_Frame *frame,
+                      uint16_t *data,
+                      size_t count,
+                      struct Bench_Task *tasks);
+
+/**
+ *  @brief Build the histogram or the heap of a partition.
+ *
+ *  @param task  Partition to process (struct Bench_Task)
+ *
+ *  @return none
+ */
+static void DetectTask(void *task);
+
+/**
+ *  @brief Scale the pixels above the threshold in a partition.
+ *
+ *  @param task  Partition to process (struct Bench_Task)
+ *
+ *  @return none
+ */
+static void AdjustTask(void *task);
+
+/**
+ *  @brief Convert a partition to 8-bit preview pixels.
+ *
+ *  @param task  Partition to process (struct Bench_Task)
+ *
+ *  @return none
+ */
+static void DownscaleTask(void *task);
+
+/**
+ *  @brief Run the detection once, the way delite does.
+ *
+ *  @param frame    Frame to process
+ *  @param engine   Selection engine
+ *  @param count    Number of pixels to select
+ *  @param threads  Number of threads (only 1 for the select engine)
+ *  @param arena    Arena for the histograms and indices
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int RunDetect(const struct Bench_Frame *frame,
+                     enum Selection_Engine engine,
+                     size_t count,
+                     size_t threads,
+                     struct Bitmap_Arena *arena);
+
+/**
+ *  @brief Run all the stages over one frame distribution.
+ *
+ *  @param options  Benchmark parameters
+ *  @param frame    Frame to generate and measure
+ *  @param arena    Arena for the stage buffers
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int RunStages(const struct Bench_Options *options,
+                     struct Bench_Frame *frame,
+                     struct Bitmap_Arena *arena);
+
+/**
+ *  @brief Write a generated frame to a file.
+ *
+ *  @param options  Frame parameters (the first distribution is used)
+ *  @param path     Output file path
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int GenerateFile(const struct Bench_Options *options,
+                        const char *path);
+
+/****************************************************************************/
+
+/**
+ *  @brief Main function
+ *
+ *  Parse the CLI arguments and run the benchmark over each requested
+ *  distribution, or only generate a frame file with -g.
+ *  @param argc  Number of arguments
+ *  @param argv  Reference to the argument array
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+int main(int argc, char **argv) {
+    char **arg_iterator = NULL;
+    char path[256] = { '\0' };
+    const char *generate_path = NULL;
+    unsigned long long value = 0;
+    struct Bench_Options options = {
+        .width = BENCH_WIDTH,
+        .height = BENCH_HEIGHT,
+        .pixel_count = BENCH_PIXEL_COUNT,
+        .repeats = BENCH_REPEATS,
+        .seed = 1U,
+        .directory = "/tmp",
+        .distributions = { SYNTH_UNIFORM, SYNTH_GAUSSIAN, SYNTH_HOT_PIXELS,
+                           SYNTH_SATURATED },
+        .distribution_count = SYNTH_DISTRIBUTION_COUNT,
+        .engines = { SELECTION_ENGINE_HEAP, SELECTION_ENGINE_INTROSELECT,
+                     SELECTION_ENGINE_HISTOGRAM },
+        .engine_count = 3U,
+        .thread_count = 0
+    };
+    struct Bench_Frame frame;
+    struct Bitmap_Arena arena;
+    size_t i = 0;
+    int status = EXIT_SUCCESS;
+
+    KernelsInit();
+    memset(&frame, 0, sizeof(frame));
+    frame.fd = -1;
+    BitmapArenaInit(&arena);
+
+    for (arg_iterator = argv + 1; (EXIT_SUCCESS == status) &&
+                                  (arg_iterator < argv + argc);
+         arg_iterator++) {
+        if ((2 != strlen(*arg_iterator)) || ('-' != (*arg_iterator)[0]) ||
+            (NULL == arg_iterator[1])) {
+            PrintUsage();
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        arg_iterator++;
+        value = strtoull(*arg_iterator, NULL, 0);
+        switch (arg_iterator[-1][1]) {
+            /* Frame dimensions */
+            case 'w':
+            case 'h':
+                if ((0 == value) || (value > UINT32_MAX)) {
+                    printf("Invalid frame dimension.\n");
+                    status = EXIT_FAILURE;
+                }
+                else if ('w' == arg_iterator[-1][1]) {
+                    options.width = value;
+                }
+                else {
+                    options.height = value;
+                }
+
+                break;
+            /* Pixel count */
+            case 'p':
+                options.pixel_count = value;
+                if (0 == value) {
+                    printf("Invalid pixel count.\n");
+                    status = EXIT_FAILURE;
+                }
+
+                break;
+            /* Number of runs */
+            case 'r':
+                options.repeats = value;
+                if (0 == value) {
+                    printf("Invalid number of runs.\n");
+                    status = EXIT_FAILURE;
+                }
+
+                break;
+            /* Generator seed */
+            case 's':
+                options.seed = value;
+
+                break;
+            /* Temporary directory */
+            case 't':
+                options.directory = *arg_iterator;
+
+                break;
+            /* Generator only */
+            case 'g':
+                generate_path = *arg_iterator;
+
+                break;
+            case 'd':
+                if (!ParseList(*arg_iterator, ParseDistribution,
+                               options.distributions,
+                               sizeof(options.distributions[0]),
+                               &options.distribution_count)) {
+                    printf("Invalid distribution list.\n");
+                    status = EXIT_FAILURE;
+                }
+
+                break;
+            case 'e':
+                if (!ParseList(*arg_iterator, ParseEngine, options.engines,
+                               sizeof(options.engines[0]),
+                               &options.engine_count)) {
+                    printf("Invalid engine list.\n");
+                    status = EXIT_FAILURE;
+                }
+
+                break;
+            case 'j':
+                if (!ParseList(*arg_iterator, ParseThreads, options.threads,
+                               sizeof(options.threads[0]),
+                               &options.thread_count)) {
+                    printf("Invalid thread count list.\n");
+                    status = EXIT_FAILURE;
+                }
+
+                break;
+            /* Invalid input */
+            default:
+                PrintUsage();
+                status = EXIT_FAILURE;
+
+                break;
+        }
+    }
+
+    /* One thread, and one per CPU if that's more. */
+    if (0 == options.thread_count) {
+        options.threads[options.thread_count++] = 1U;
+        if (ParallelGetCpuCount() > 1U) {
+            options.threads[options.thread_count++] = ParallelGetCpuCount();
+        }
+    }
+
+    if ((EXIT_SUCCESS == status) && (NULL != generate_path)) {
+        status = GenerateFile(&options, generate_path);
+    }
+    else if (EXIT_SUCCESS == status) {
+        frame.size = (size_t) options.width * options.height;
+        frame.data = malloc(frame.size * sizeof(frame.data[0]));
+        frame.work = malloc(frame.size * sizeof(frame.work[0]));
+        frame.preview = malloc(frame.size);
+        snprintf(path, sizeof(path), "%s/delite-bench-XXXXXX",
+                 options.directory);
+        frame.fd = mkstemp(path);
+        frame.path = path;
+        if ((NULL == frame.data) || (NULL == frame.work) ||
+            (NULL == frame.preview) || (frame.fd < 0)) {
+            printf("Unexpected error when allocating the frame.\n");
+            status = EXIT_FAILURE;
+        }
+        for (i = 0; (EXIT_SUCCESS == status) &&
+                    (i < options.distribution_count); i++) {
+            frame.distribution = options.distributions[i];
+            status = RunStages(&options, &frame, &arena);
+        }
+    }
+
+    if (frame.fd >= 0) {
+        close(frame.fd);
+        unlink(path);
+    }
+    free(frame.data);
+    free(frame.work);
+    free(frame.preview);
+    BitmapArenaFree(&arena);
+
+    return status;
+}
+
+static void PrintUsage(void) {
+    char help_message[] = "Usage: bench [-w width] [-h height] "
+                          "[-d distributions] [-e engines] [-j threads] "
+                          "[-p pixel_count] [-r runs] [-s seed] "
+                          "[-t directory] [-g output_file]\n"
+                          "\n"
+                          "-w, -h  Frame dimensions (default is 4096x4096)\n"
+                          "-d  Comma-separated distributions: uniform, "
+                          "gaussian, hot, saturated (default is all)\n"
+                          "-e  Comma-separated engines: heap, select, "
+                          "histogram (default is all)\n"
+                          "-j  Comma-separated thread counts, 0 for one "
+                          "per CPU (default is 1,0)\n"
+                          "-p  Number of pixels to adjust (default is "
+                          "1000)\n"
+                          "-r  Runs for each measurement, the fastest one "
+                          "is reported (default is 3)\n"
+                          "-s  Generator seed (default is 1)\n"
+                          "-t  Directory for the temporary frame file "
+                          "(default is /tmp)\n"
+                          "-g  Only write a generated frame (first "
+                          "distribution) to a file\n"
+                          "\n"
+                          "Each measurement is printed as one JSON object "
+                          "per line.\n";
+
+    printf("%s", help_message);
+}
+
+static bool ParseList(char *list,
+                      bool (*parse)(const char *, void *),
+                      void *entries,
+                      size_t size,
+                      size_t *count) {
+    char *entry = NULL;
+    bool result = true;
+
+    *count = 0;
+    for (entry = strtok(list, ","); result && (NULL != entry);
+         entry = strtok(NULL, ",")) {
+        if (*count >= BENCH_MAX_LIST) {
+            result = false;
+        }
+        else {
+            result = parse(entry, (uint8_t *) entries + *count * size);
+            (*count)++;
+        }
+    }
+
+    return result && (*count > 0);
+}
+
+static bool ParseDistribution(const char *name, void *entry) {
+    return SynthParseDistribution(name, entry);
+}
+
+static bool ParseEngine(const char *name, void *entry) {
+    enum Selection_Engine *engine = entry;
+    bool result = true;
+
+    if (0 == strcmp(name, "heap")) {
+        *engine = SELECTION_ENGINE_HEAP;
+    }
+    else if (0 == strcmp(name, "select")) {
+        *engine = SELECTION_ENGINE_INTROSELECT;
+    }
+    else if (0 == strcmp(name, "histogram")) {
+        *engine = SELECTION_ENGINE_HISTOGRAM;
+    }
+    else {
+        result = false;
+    }
+
+    return result;
+}
+
+static bool ParseThreads(const char *name, void *entry) {
+    size_t *threads = entry;
+
+    *threads = strtoull(name, NULL, 0);
+    if (0 == *threads) {
+        *threads = ParallelGetCpuCount();
+    }
+
+    return (*threads <= PARALLEL_MAX_THREADS);
+}
+
+static double GetTime(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void PrintResult(const struct Bench_Options *options,
+                        const struct Bench_Frame *frame,
+                        const char *stage,
+                        const char *engine,
+                        size_t threads,
+                        double seconds) {
+    double bytes = (double) frame->size * sizeof(frame->data[0]);
+
+    if (seconds <= 0.0) {
+        seconds = 1e-9;
+    }
+
+    printf("{\"stage\":\"%s\",\"engine\":\"%s\",\"distribution\":\"%s\","
+           "\"width\":%u,\"height\":%u,\"pixel_count\":%zu,"
+           "\"threads\":%zu,\"kernels\":\"%s\",\"seconds\":%.6f,"
+           "\"mpix_per_s\":%.1f,\"gb_per_s\":%.3f}\n",
+           stage, engine, SynthGetDistributionName(frame->distribution),
+           options->width, options->height, options->pixel_count, threads,
+           KernelsGetName(), seconds, frame->size / seconds / 1e6,
+           bytes / seconds / 1e9);
+    fflush(stdout);
+}
+
+static void InitTasks(const struct Bench_Frame *frame,
+                      uint16_t *data,
+                      size_t count,
+                      struct Bench_Task *tasks) {
+    size_t part_size = (frame->size + count - 1U) / count;
+    size_t start = 0;
+    size_t i = 0;
+
+    memset(tasks, 0, count * sizeof(tasks[0]));
+    for (i = 0; i < count; i++) {
+        start = (i * part_size < frame->size) ? i * part_size : frame->size;
+        tasks[i].data = &data[start];
+        tasks[i].offset = start;
+        tasks[i].size = (frame->size - start < part_size) ?
+                        frame->size - start : part_size;
+        tasks[i].value = frame->threshold;
+        tasks[i].out = &frame->preview[start];
+    }
+}
+
+static void DetectTask(void *task) {
+    struct Bench_Task *bench = task;
+
+    if (SELECTION_ENGINE_HISTOGRAM == bench->engine) {
+        bench->status = SelectionBuildHistogram(bench->data, bench->size,
+                                                bench->histogram);
+    }
+    else {
+        bench->status = SelectionHeapInit(&(bench->heap),
+                                          (bench->pixel_count < bench->size) ?
+                                          bench->pixel_count : bench->size,
+                                          SELECTION_TIE_BREAK_FIRST);
+        if (EXIT_SUCCESS == bench->status) {
+            SelectionHeapUpdate(&(bench->heap), bench->data, bench->size,
+                                bench->offset);
+        }
+    }
+}
+
+static void AdjustTask(void *task) {
+    struct Bench_Task *bench = task;
+
+    KernelScaleAbove(bench->data, bench->size, bench->value, BENCH_FACTOR);
+}
+
+static void DownscaleTask(void *task) {
+    struct Bench_Task *bench = task;
+
+    KernelDownscale(bench->data, bench->size, bench->out);
+}
+
+static int RunDetect(const struct Bench_Frame *frame,
+                     enum Selection_Engine engine,
+                     size_t count,
+                     size_t threads,
+                     struct Bitmap_Arena *arena) {
+    struct Bench_Task tasks[PARALLEL_MAX_THREADS];
+    struct Selection_Heap heap;
+    struct Selection_Threshold threshold;
+    size_t *histogram = NULL;
+    size_t *indices = NULL;
+    size_t selected = 0;
+    size_t value = 0;
+    size_t i = 0;
+    int status = EXIT_SUCCESS;
+
+    memset(&heap, 0, sizeof(heap));
+    BitmapArenaReset(arena);
+    InitTasks(frame, frame->data, threads, tasks);
+
+    if (SELECTION_ENGINE_INTROSELECT == engine) {
+        indices = BitmapArenaAlloc(arena, count * sizeof(size_t));
+        status = (NULL == indices) ? EXIT_FAILURE :
+                 SelectionTopK(frame->data, frame->size, count, engine,
+                               SELECTION_TIE_BREAK_FIRST, indices, &selected);
+    }
+    else {
+        for (i = 0; (EXIT_SUCCESS == status) && (i < threads); i++) {
+            tasks[i].engine = engine;
+            tasks[i].pixel_count = count;
+            if (SELECTION_ENGINE_HISTOGRAM == engine) {
+                tasks[i].histogram = BitmapArenaAlloc(arena,
+                                                      SELECTION_HISTOGRAM_SIZE
+                                                      * sizeof(size_t));
+                if (NULL == tasks[i].histogram) {
+                    status = EXIT_FAILURE;
+                }
+            }
+        }
+        if (EXIT_SUCCESS == status) {
+            status = ParallelRun(DetectTask, tasks, sizeof(tasks[0]),
+                                 threads);
+        }
+        for (i = 0; (EXIT_SUCCESS == status) && (i < threads); i++) {
+            status = tasks[i].status;
+        }
+    }
+
+    /* Merge the partition results, as delite does. */
+    if ((EXIT_SUCCESS == status) && (SELECTION_ENGINE_HISTOGRAM == engine)) {
+        histogram = tasks[0].histogram;
+        for (i = 1; i < threads; i++) {
+            for (value = 0; value < SELECTION_HISTOGRAM_SIZE; value++) {
+                histogram[value] += tasks[i].histogram[value];
+            }
+        }
+        status = SelectionFindThreshold(histogram, count,
+                                        SELECTION_TIE_BREAK_FIRST,
+                                        &threshold);
+    }
+    else if ((EXIT_SUCCESS == status) && (SELECTION_ENGINE_HEAP == engine)) {
+        status = SelectionHeapInit(&heap, (count < frame->size) ? count :
+                                          frame->size,
+                                   SELECTION_TIE_BREAK_FIRST);
+        for (i = 0; (EXIT_SUCCESS == status) && (i < threads); i++) {
+            SelectionHeapMerge(&heap, &tasks[i].heap);
+        }
+        indices = BitmapArenaAlloc(arena, (heap.size + 1U) * sizeof(size_t));
+        if ((EXIT_SUCCESS == status) && (NULL != indices)) {
+            selected = SelectionHeapExtract(&heap, indices);
+        }
+        else {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    for (i = 0; i < threads; i++) {
+        SelectionHeapFree(&tasks[i].heap);
+    }
+    SelectionHeapFree(&heap);
+
+    return status;
+}
+
+static int RunStages(const struct Bench_Options *options,
+                     struct Bench_Frame *frame,
+                     struct Bitmap_Arena *arena) {
+    struct Bench_Task tasks[PARALLEL_MAX_THREADS];
+    struct Selection_Threshold threshold;
+    struct Frame input;
+    size_t *histogram = NULL;
+    size_t bytes = frame->size * sizeof(frame->data[0]);
+    size_t threads = 0;
+    size_t i = 0;
+    size_t j = 0;
+    size_t run = 0;
+    ssize_t written = 0;
+    double start = 0.0;
+    double best = 0.0;
+    int status = EXIT_SUCCESS;
+
+    SynthGenerateFrame(frame->data, options->width, options->height,
+                       frame->distribution, options->seed);
+
+    /* The adjust stage uses the threshold of the requested pixel count. */
+    BitmapArenaReset(arena);
+    histogram = BitmapArenaAlloc(arena, SELECTION_HISTOGRAM_SIZE *
+                                        sizeof(size_t));
+    status = (NULL == histogram) ? EXIT_FAILURE :
+             SelectionBuildHistogram(frame->data, frame->size, histogram);
+    if (EXIT_SUCCESS == status) {
+        status = SelectionFindThreshold(histogram, options->pixel_count,
+                                        SELECTION_TIE_BREAK_FIRST,
+                                        &threshold);
+        frame->threshold = threshold.value;
+    }
+
+    /* Write, then read back from the page cache. */
+    for (run = 0, best = 0.0; (EXIT_SUCCESS == status) &&
+                              (run < options->repeats); run++) {
+        start = GetTime();
+        if (ftruncate(frame->fd, 0) < 0) {
+            status = EXIT_FAILURE;
+        }
+        for (i = 0; (EXIT_SUCCESS == status) && (i < bytes); i += written) {
+            written = pwrite(frame->fd, (uint8_t *) frame->data + i,
+                             bytes - i, i);
+            if ((written < 0) && (EINTR == errno)) {
+                written = 0;
+            }
+            else if (written <= 0) {
+                status = EXIT_FAILURE;
+            }
+        }
+        start = GetTime() - start;
+        best = ((0 == run) || (start < best)) ? start : best;
+    }
+    if (EXIT_SUCCESS == status) {
+        PrintResult(options, frame, "write", "none", 1U, best);
+    }
+
+    for (run = 0; (EXIT_SUCCESS == status) && (run < options->repeats);
+         run++) {
+        start = GetTime();
+        status = FrameOpen(frame->path, FRAME_INPUT_READ, NULL, &input);
+        if (EXIT_SUCCESS == status) {
+            FrameClose(&input);
+        }
+        start = GetTime() - start;
+        best = ((0 == run) || (start < best)) ? start : best;
+    }
+    if (EXIT_SUCCESS == status) {
+        PrintResult(options, frame, "read", "none", 1U, best);
+    }
+
+    for (i = 0; (EXIT_SUCCESS == status) && (i < options->engine_count);
+         i++) {
+        for (j = 0; (EXIT_SUCCESS == status) && (j < options->thread_count);
+             j++) {
+            /* The partial select only runs on a single thread. */
+            threads = options->threads[j];
+            if ((SELECTION_ENGINE_INTROSELECT == options->engines[i]) &&
+                (1U != threads)) {
+                continue;
+            }
+            for (run = 0; (EXIT_SUCCESS == status) &&
+                          (run < options->repeats); run++) {
+                start = GetTime();
+                status = RunDetect(frame, options->engines[i],
+                                   options->pixel_count, threads, arena);
+                start = GetTime() - start;
+                best = ((0 == run) || (start < best)) ? start : best;
+            }
+            if (EXIT_SUCCESS == status) {
+                PrintResult(options, frame, "detect",
+                            SelectionGetEngineName(options->engines[i]),
+                            threads, best);
+            }
+        }
+    }
+
+    for (j = 0; (EXIT_SUCCESS == status) && (j < options->thread_count);
+         j++) {
+        threads = options->threads[j];
+        for (run = 0; (EXIT_SUCCESS == status) && (run < options->repeats);
+             run++) {
+            memcpy(frame->work, frame->data, bytes);
+            InitTasks(frame, frame->work, threads, tasks);
+            start = GetTime();
+            status = ParallelRun(AdjustTask, tasks, sizeof(tasks[0]),
+                                 threads);
+            start = GetTime() - start;
+            best = ((0 == run) || (start < best)) ? start : best;
+        }
+        if (EXIT_SUCCESS == status) {
+            PrintResult(options, frame, "adjust", "none", threads, best);
+        }
+
+        for (run = 0; (EXIT_SUCCESS == status) && (run < options->repeats);
+             run++) {
+            InitTasks(frame, frame->data, threads, tasks);
+            start = GetTime();
+            status = ParallelRun(DownscaleTask, tasks, sizeof(tasks[0]),
+                                 threads);
+            start = GetTime() - start;
+            best = ((0 == run) || (start < best)) ? start : best;
+        }
+        if (EXIT_SUCCESS == status) {
+            PrintResult(options, frame, "downscale", "none", threads, best);
+        }
+    }
+
+    if (EXIT_FAILURE == status) {
+        printf("Unexpected error when running the %s benchmark.\n",
+               SynthGetDistributionName(frame->distribution));
+    }
+
+    return status;
+}
+
+static int GenerateFile(const struct Bench_Options *options,
+                        const char *path) {
+    size_t size = (size_t) options->width * options->height;
+    uint16_t *data = malloc(size * sizeof(data[0]));
+    FILE *out = NULL;
+    int status = EXIT_SUCCESS;
+
+    if (NULL == data) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        SynthGenerateFrame(data, options->width, options->height,
+                           options->distributions[0], options->seed);
+        out = fopen(path, "wb");
+        if ((NULL == out) ||
+            (fwrite(data, sizeof(data[0]), size, out) != size)) {
+            status = EXIT_FAILURE;
+        }
+        if ((NULL != out) && (0 != fclose(out))) {
+            status = EXIT_FAILURE;
+        }
+    }
+    if (EXIT_FAILURE == status) {
+        printf("Unexpected error when writing the generated frame.\n");
+    }
+
+    free(data);
+
+    return status;
+}
@@ -0,0 +1,179 @@
+/**
+ *  @brief Synthetic frame generator implementation file.
+ *
+ */
+
+#include "synth.h"
+
+#include <math.h>
+#include <string.h>
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS AND MACROS
+ ****************************************************************************/
+/* One hot pixel cluster for this many pixels. */
+#define SYNTH_HOT_SPACING 0x4000U
+
+/* Largest hot pixel cluster radius. */
+#define SYNTH_HOT_RADIUS 2U
+
+/* Number of saturated regions, each one 1/8 of the frame wide and high. */
+#define SYNTH_SATURATED_REGIONS 4U
+
+/* M_PI isn't part of C99. */
+#define SYNTH_TWO_PI 6.283185307179586
+
+/****************************************************************************
+ * LOCAL DECLARATIONS
+ ****************************************************************************/
+/**
+ *  @brief Get the next value of a splitmix64 generator.
+ *
+ *  @param state  Generator state
+ *
+ *  @return A 64-bit pseudo-random value.
+ */
+static uint64_t NextRandom(uint64_t *state);
+
+/**
+ *  @brief Get a normally distributed pixel value.
+ *
+ *  @param state  Generator state
+ *  @param mean   Distribution mean
+ *  @param sigma  Standard deviation
+ *
+ *  @return The value, clamped to the 16-bit range.
+ */
+static uint16_t NextGaussian(uint64_t *state, double mean, double sigma);
+
+/****************************************************************************/
+
+bool SynthParseDistribution(const char *name,
+                            enum Synth_Distribution *distribution) {
+    bool result = false;
+    size_t i = 0;
+
+    for (i = 0; (!result) && (i < SYNTH_DISTRIBUTION_COUNT); i++) {
+        if (0 == strcmp(name, SynthGetDistributionName(i))) {
+            *distribution = i;
+            result = true;
+        }
+    }
+
+    return result;
+}
+
+const char *SynthGetDistributionName(enum Synth_Distribution distribution) {
+    const char *name = "uniform";
+
+    switch (distribution) {
+        case SYNTH_GAUSSIAN:
+            name = "gaussian";
+
+            break;
+        case SYNTH_HOT_PIXELS:
+            name = "hot";
+
+            break;
+        case SYNTH_SATURATED:
+            name = "saturated";
+
+            break;
+        default:
+
+            break;
+    }
+
+    return name;
+}
+
+void SynthGenerateFrame(uint16_t *data,
+                        uint32_t width,
+                        uint32_t height,
+                        enum Synth_Distribution distribution,
+                        uint64_t seed) {
+    uint64_t state = seed;
+    size_t size = (size_t) width * height;
+    size_t clusters = size / SYNTH_HOT_SPACING + 1U;
+    size_t i = 0;
+    uint32_t radius = 0;
+    uint32_t cx = 0;
+    uint32_t cy = 0;
+    uint32_t x = 0;
+    uint32_t y = 0;
+
+    for (i = 0; i < size; i++) {
+        switch (distribution) {
+            case SYNTH_GAUSSIAN:
+                data[i] = NextGaussian(&state, 32768.0, 8192.0);
+
+                break;
+            case SYNTH_HOT_PIXELS:
+                data[i] = NextGaussian(&state, 2048.0, 512.0);
+
+                break;
+            case SYNTH_SATURATED:
+                data[i] = NextGaussian(&state, 24576.0, 6144.0);
+
+                break;
+            default:
+                data[i] = NextRandom(&state) >> 48;
+
+                break;
+        }
+    }
+
+    /* Small bright clusters, brightest in their center. */
+    for (i = 0; (SYNTH_HOT_PIXELS == distribution) && (i < clusters); i++) {
+        cx = NextRandom(&state) % width;
+        cy = NextRandom(&state) % height;
+        radius = NextRandom(&state) % (SYNTH_HOT_RADIUS + 1U);
+        for (y = (cy > radius) ? cy - radius : 0;
+             (y <= cy + radius) && (y < height); y++) {
+            for (x = (cx > radius) ? cx - radius : 0;
+                 (x <= cx + radius) && (x < width); x++) {
+                data[(size_t) y * width + x] =
+                    ((x == cx) && (y == cy)) ? 0xFFFFU :
+                    (0xF000U | (NextRandom(&state) >> 52));
+            }
+        }
+    }
+
+    /* Clipped regions, all at the highest value. */
+    for (i = 0; (SYNTH_SATURATED == distribution) &&
+                (i < SYNTH_SATURATED_REGIONS); i++) {
+        cx = NextRandom(&state) % (width - width / 8U);
+        cy = NextRandom(&state) % (height - height / 8U);
+        for (y = cy; y < cy + height / 8U; y++) {
+            for (x = cx; x < cx + width / 8U; x++) {
+                data[(size_t) y * width + x] = 0xFFFFU;
+            }
+        }
+    }
+}
+
+static uint64_t NextRandom(uint64_t *state) {
+    uint64_t value = (*state += 0x9E3779B97F4A7C15ULL);
+
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+
+    return value ^ (value >> 31);
+}
+
+static uint16_t NextGaussian(uint64_t *state, double mean, double sigma) {
+    /* Box-Muller, from two uniform values in (0, 1]. */
+    double u = ((NextRandom(state) >> 11) + 1.0) / 9007199254740992.0;
+    double v = ((NextRandom(state) >> 11) + 1.0) / 9007199254740992.0;
+    double value = mean + sigma * sqrt(-2.0 * log(u)) *
+                   cos(SYNTH_TWO_PI * v);
+
+    if (value < 0.0) {
+        value = 0.0;
+    }
+    else if (value > 65535.0) {
+        value = 65535.0;
+    }
+
+    return (uint16_t) value;
+}
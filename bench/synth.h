@@ -0,0 +1,76 @@
+/**
+ *  @brief Synthetic frame generator header.
+ *
+ *  This header contains the API for filling 16-bit frames with synthetic
+ *  sensor data, so the benchmarks can be reproduced without real frames.
+ *  The frames only depend on their geometry, distribution and seed.
+ */
+
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/****************************************************************************
+ * TYPE DEFINITIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Available pixel value distributions.
+ */
+enum Synth_Distribution {
+    SYNTH_UNIFORM = 0,          /* Uniform over the whole 16-bit range */
+    SYNTH_GAUSSIAN,             /* Mid-gray noise */
+    SYNTH_HOT_PIXELS,           /* Dark noise with small bright clusters */
+    SYNTH_SATURATED,            /* Gray noise with clipped regions */
+    SYNTH_DISTRIBUTION_COUNT    /* Number of distributions */
+};
+
+/****************************************************************************
+ * FUNCTION DECLARATIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Parse a distribution name.
+ *
+ *  @param name          Distribution name (uniform, gaussian, hot or
+ *                       saturated)
+ *  @param distribution  Parsed distribution
+ *
+ *  @return true, if the name is valid.
+ *          false, otherwise.
+ */
+bool SynthParseDistribution(const char *name,
+                            enum Synth_Distribution *distribution);
+
+/**
+ *  @brief Get the name of a distribution.
+ *
+ *  @param distribution  Distribution
+ *
+ *  @return The name accepted by SynthParseDistribution.
+ */
+const char *SynthGetDistributionName(enum Synth_Distribution distribution);
+
+/**
+ *  @brief Fill a frame with synthetic pixels.
+ *
+ *  @param data          Frame to fill (width * height pixels)
+ *  @param width         Frame width
+ *  @param height        Frame height
+ *  @param distribution  Pixel value distribution
+ *  @param seed          Random generator seed
+ *
+ *  @return none
+ */
+void SynthGenerateFrame(uint16_t *data,
+                        uint32_t width,
+                        uint32_t height,
+                        enum Synth_Distribution distribution,
+                        uint64_t seed);
+
+/****************************************************************************/
+
+#endif /* SYNTH_H */
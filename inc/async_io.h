@@ -0,0 +1,182 @@
+/**
+ *  @brief Asynchronous file I/O header.
+ *
+ *  This header contains the API for queueing positioned reads and writes
+ *  which run in the background while the caller keeps computing. On Linux,
+ *  the requests go through io_uring. Where it isn't available, a small pool
+ *  of worker threads runs them with pread() and pwrite() instead. A queue
+ *  must only be used from the thread which initialized it.
+ */
+
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS AND MACROS
+ ****************************************************************************/
+/* Maximum number of requests in flight at the same time. */
+#define ASYNC_IO_QUEUE_DEPTH 16U
+
+/* Worker threads of the fallback backend (one read and two writes). */
+#define ASYNC_IO_THREAD_COUNT 3U
+
+/****************************************************************************
+ * TYPE DEFINITIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Available I/O backends.
+ */
+enum Async_Io_Backend {
+    ASYNC_IO_BACKEND_AUTO = 0,      /* io_uring, falling back to threads */
+    ASYNC_IO_BACKEND_URING,         /* io_uring only */
+    ASYNC_IO_BACKEND_THREADS        /* Worker threads only */
+};
+
+/**
+ *  @brief Available I/O operations.
+ */
+enum Async_Io_Operation {
+    ASYNC_IO_READ = 0,              /* Positioned read */
+    ASYNC_IO_WRITE                  /* Positioned write */
+};
+
+/**
+ *  @brief Read or write request.
+ *
+ *  The request and its data must stay valid until it's completed. Short
+ *  transfers are resumed in the background, so a request completes with
+ *  all of its data transferred, unless a read reaches the end of the file.
+ */
+struct Async_Io_Request {
+    enum Async_Io_Operation operation;  /* Read or write */
+    int fd;                     /* File descriptor */
+    uint8_t *data;              /* Data to read into or to write */
+    size_t count;               /* Number of bytes requested */
+    off_t offset;               /* File offset */
+    size_t done;                /* Number of bytes transferred */
+    bool busy;                  /* Whether the request is in flight */
+    int status;                 /* Request result */
+    struct Async_Io_Request *next;      /* Next request waiting for a worker */
+};
+
+/**
+ *  @brief io_uring submission and completion rings.
+ */
+struct Async_Io_Ring {
+    int fd;                     /* Ring file descriptor */
+    void *sq_ring;              /* Submission ring mapping */
+    size_t sq_ring_size;        /* Submission ring mapping size */
+    void *cq_ring;              /* Completion ring mapping (may be sq_ring) */
+    size_t cq_ring_size;        /* Completion ring mapping size */
+    void *sqes;                 /* Submission entries */
+    size_t sqes_size;           /* Submission entries mapping size */
+    uint32_t *sq_head;          /* First entry consumed by the kernel */
+    uint32_t *sq_tail;          /* Next entry to submit */
+    uint32_t *sq_array;         /* Submitted entry indices */
+    uint32_t sq_mask;           /* Submission ring index mask */
+    uint32_t sq_entries;        /* Number of submission entries */
+    uint32_t *cq_head;          /* Next completion to consume */
+    uint32_t *cq_tail;          /* Next completion posted by the kernel */
+    uint32_t cq_mask;           /* Completion ring index mask */
+    void *cqes;                 /* Completion entries */
+};
+
+/**
+ *  @brief Queue of requests running in the background.
+ */
+struct Async_Io_Queue {
+    enum Async_Io_Backend backend;      /* Backend in use (never auto) */
+    size_t in_flight;           /* Number of requests in flight */
+    struct Async_Io_Ring ring;  /* io_uring rings */
+    pthread_t threads[ASYNC_IO_THREAD_COUNT];   /* Worker threads */
+    size_t thread_count;        /* Number of started worker threads */
+    pthread_mutex_t lock;       /* Protects the fields below */
+    pthread_cond_t queued;      /* Signaled when a request is queued */
+    pthread_cond_t completed;   /* Signaled when a request is completed */
+    struct Async_Io_Request *first;     /* First request waiting */
+    struct Async_Io_Request *last;      /* Last request waiting */
+    bool stopping;              /* Whether the workers must stop */
+};
+
+/****************************************************************************
+ * FUNCTION DECLARATIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Initialize a request queue.
+ *
+ *  If no worker thread can be started, the requests of the thread backend
+ *  run right away on the calling thread.
+ *  @param queue    Queue to be initialized
+ *  @param backend  Requested backend
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if not successful (e.g. no io_uring support
+ *          while it was explicitly requested).
+ */
+int AsyncIoInit(struct Async_Io_Queue *queue, enum Async_Io_Backend backend);
+
+/**
+ *  @brief Get the name of the backend used by a queue.
+ *
+ *  @param queue  Queue to check
+ *
+ *  @return "uring" or "threads".
+ */
+const char *AsyncIoGetBackendName(const struct Async_Io_Queue *queue);
+
+/**
+ *  @brief Submit a read or write request.
+ *
+ *  No more than ASYNC_IO_QUEUE_DEPTH requests can be in flight at once.
+ *  @param queue      Queue to submit to
+ *  @param request    Request to submit (must not be in flight)
+ *  @param operation  Read or write
+ *  @param fd         File descriptor
+ *  @param data       Data to read into or to write
+ *  @param count      Number of bytes to transfer
+ *  @param offset     File offset
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if not successful.
+ */
+int AsyncIoSubmit(struct Async_Io_Queue *queue,
+                  struct Async_Io_Request *request,
+                  enum Async_Io_Operation operation,
+                  int fd,
+                  void *data,
+                  size_t count,
+                  off_t offset);
+
+/**
+ *  @brief Wait for a request to complete.
+ *
+ *  Requests which were never submitted are already complete.
+ *  @param queue    Queue the request was submitted to
+ *  @param request  Request to wait for
+ *
+ *  @return EXIT_SUCCESS, if the request succeeded.
+ *          EXIT_FAILURE, if not.
+ */
+int AsyncIoWait(struct Async_Io_Queue *queue,
+                struct Async_Io_Request *request);
+
+/**
+ *  @brief Wait for all the requests in flight and release the queue.
+ *
+ *  @param queue  Queue to release
+ *
+ *  @return none
+ */
+void AsyncIoFree(struct Async_Io_Queue *queue);
+
+/****************************************************************************/
+
+#endif /* ASYNC_IO_H */
@@ -4,12 +4,16 @@
  *  This header contains bitmap-related types definitions,
  *  including the bitmap manipulation API declaration.
  *  The functions can be used for initializing bitmaps and performing
- *  read/write operations on the pixel data.
+ *  read/write operations on the pixel data, as well as the full-depth
+ *  16-bit PGM and 12-bit packed output layouts. The arena allocator serves
+ *  the per-frame buffers of the bitmap pipeline, which are all released
+ *  at once between frames.
  */
 
 #ifndef BITMAP_H
 #define BITMAP_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -26,6 +30,22 @@
                              sizeof(struct Bitmap_ColorEntry) + \
                              (bmp)->info_header.image_size)
 
+/* Pixel data compression types (uncompressed or 8-bit run-length). */
+#define BITMAP_COMPRESSION_RGB 0U
+#define BITMAP_COMPRESSION_RLE8 1U
+
+/* Longest RLE8 row: 2 bytes per pixel at worst, then the end of line. */
+#define BITMAP_RLE8_ROW_BOUND(width) (2U * (size_t) (width) + 2U)
+
+/* Longest binary PGM header ("P5\n<width> <height>\n65535\n"). */
+#define BITMAP_PGM_HEADER_SIZE 32U
+
+/* Alignment of the arena allocations (one cache line). */
+#define BITMAP_ARENA_ALIGNMENT 64U
+
+/* Minimum size of an arena block. */
+#define BITMAP_ARENA_BLOCK_SIZE 0x100000U
+
 #ifndef USE_COLOR_TABLE
     #warning "Support for monochromatic, 4-bit and 8-bit bitmaps is disabled!"
 #endif
@@ -34,6 +54,15 @@
  * TYPE DEFINITIONS
  ****************************************************************************/
 
+/**
+ *  @brief Available output image layouts.
+ */
+enum Bitmap_Format {
+    BITMAP_FORMAT_BMP = 0,      /* 8-bit grayscale BMP (high pixel byte) */
+    BITMAP_FORMAT_PGM,          /* 16-bit binary PGM (P5, big-endian) */
+    BITMAP_FORMAT_RAW12         /* Headerless MIPI RAW12 (top 12 bits) */
+};
+
 /* Set the structure members alignment to 1,
    so the file layout matches exactly. */
 #pragma pack(push)
@@ -56,14 +85,15 @@ struct Bitmap_Header {
  */ 
 struct Bitmap_Info_Header {
     const uint32_t header_size;       /* The info header size */
-    uint32_t width;                   /* Bitmap width 
-                                        (must be a multiple of 4 bytes) */
+    uint32_t width;                   /* Bitmap width (in pixels, the rows
+                                         are padded to 4 bytes) */
     uint32_t height;                  /* Bitmap height */
     const uint16_t planes_count;      /* Number of planes (=1) */
     const uint16_t bit_depth;         /* Bit depth level (up to 24-bit) */
-    const uint32_t compression;       /* Compression type */
+    uint32_t compression;             /* Compression type */
     uint32_t image_size;              /* Image size after compression
-                                         (if uncompressed, == width * height) */
+                                         (if uncompressed, == stride * height)
+                                         */
     uint32_t x_resolution;            /* Horizontal resolution (pixels/meter) */
     uint32_t y_resolution;            /* Vertical resolution (pixels/meter) */
     const uint32_t colors_used;       /* Number of colors 
@@ -112,6 +142,29 @@ struct Bitmap {
 /* Restore the initial memory alignment. */
 #pragma pack(pop)
 
+/**
+ *  @brief Memory block owned by an arena.
+ *
+ *  The usable memory follows the block header.
+ */
+struct Bitmap_Arena_Block {
+    struct Bitmap_Arena_Block *next;    /* Previously allocated block */
+    size_t size;                        /* Usable size */
+    size_t used;                        /* Bytes handed out */
+};
+
+/**
+ *  @brief Arena allocator for per-frame buffers.
+ *
+ *  Allocations are never released one by one, only all at once when
+ *  the arena is reset. If a frame needed more than one block, the blocks
+ *  are merged into a single one on reset, so a sequence of similar frames
+ *  is served without any further malloc.
+ */
+struct Bitmap_Arena {
+    struct Bitmap_Arena_Block *blocks;  /* Most recent block first */
+};
+
 /****************************************************************************
  * FUNCTION DECLARATIONS
  ****************************************************************************/
@@ -122,20 +175,63 @@ struct Bitmap {
  *
  *  Initialize the main bitmap fields, having the default 
  *  grayscale color table alongside (256 shades).
- *  @param bitmap  Bitmap to be initialized
+ *  @param bitmap       Bitmap to be initialized
+ *  @param compression  Pixel data compression (BITMAP_COMPRESSION_RGB or
+ *                      BITMAP_COMPRESSION_RLE8)
  * 
  *  @return EXIT_SUCCESSFUL, if successful.
  *          EXIT_FAILURE, if not successful.
  */
-int BitmapInit8BitGrayscale(struct Bitmap **bitmap);
+int BitmapInit8BitGrayscale(struct Bitmap **bitmap, uint32_t compression);
 #endif /* USE_COLOR_TABLE */
 
+/**
+ *  @brief Initialize an empty arena.
+ *
+ *  @param arena  Arena to be initialized
+ * 
+ *  @return none
+ */
+void BitmapArenaInit(struct Bitmap_Arena *arena);
+
+/**
+ *  @brief Allocate memory from an arena.
+ *
+ *  The memory is aligned on BITMAP_ARENA_ALIGNMENT bytes and remains
+ *  valid until the arena is reset or released.
+ *  @param arena  Arena to allocate from
+ *  @param size   Number of bytes
+ * 
+ *  @return The allocated memory, if successful.
+ *          NULL, if not successful.
+ */
+void *BitmapArenaAlloc(struct Bitmap_Arena *arena, size_t size);
+
+/**
+ *  @brief Release all the allocations of an arena at once.
+ *
+ *  The memory itself is kept for the next frame.
+ *  @param arena  Arena to reset
+ * 
+ *  @return none
+ */
+void BitmapArenaReset(struct Bitmap_Arena *arena);
+
+/**
+ *  @brief Release the arena memory.
+ *
+ *  @param arena  Arena to release
+ * 
+ *  @return none
+ */
+void BitmapArenaFree(struct Bitmap_Arena *arena);
+
 /**
  *  @brief Set the width and height of the bitmap.
  *
- *  Update the width and height and, implicitly, the image_size.
- *  The function will fail if the width is not a multiple of 4 bytes.
- *  (see DIB format specs)
+ *  Update the width and height and, implicitly, the image_size, which
+ *  accounts for the padding of each row to 4 bytes (see DIB format specs).
+ *  The function will fail if the file size doesn't fit on 32 bits.
  *  @param bitmap  Bitmap to be modified
  *  @param width   Image width
  *  @param heigth  Image height
@@ -144,8 +240,31 @@ int BitmapInit8BitGrayscale(struct Bitmap **bitmap);
  *          EXIT_FAILURE, if not successful.
  */
 int BitmapSetWidthHeight(struct Bitmap *bitmap, 
-                         uint16_t width,
-                         uint16_t height);
+                         uint32_t width,
+                         uint32_t height);
+
+/**
+ *  @brief Set the size of the compressed pixel data.
+ *
+ *  Update the image_size and, implicitly, the file size, once the pixel
+ *  data has been compressed. The function will fail if the file size
+ *  doesn't fit on 32 bits.
+ *  @param bitmap  Bitmap to be modified
+ *  @param size    Compressed pixel data size
+ * 
+ *  @return EXIT_SUCCESSFUL, if successful.
+ *          EXIT_FAILURE, if not successful.
+ */
+int BitmapSetImageSize(struct Bitmap *bitmap, size_t size);
+
+/**
+ *  @brief Get the size of a bitmap row, including its padding.
+ *
+ *  @param bitmap  Bitmap to read from
+ * 
+ *  @return The row size in bytes (a multiple of 4).
+ */
+uint32_t BitmapGetStride(const struct Bitmap *bitmap);
 
 /**
  *  @brief Get the pixel data from a bitmap.
@@ -165,16 +284,93 @@ uint32_t BitmapGetPixelData(const struct Bitmap *bitmap,
 /**
  *  @brief Copy the input data to the bitmap pixel data array.
  *
- *  Copy each byte from the input data array to the given bitmap.
- *  The input data array is assumed to have at least image_size bytes,
- *  otherwise the behavior is undefined.
+ *  The input data array holds the pixels in the bitmap bit depth (8 or
+ *  16 bits, in host order) and is copied as it is, so it is assumed to
+ *  have at least image_size bytes, otherwise the behavior is undefined.
+ *  The pixel data array is allocated from the given arena.
  *  @param bitmap  Bitmap to be modified
  *  @param data    Array containing the pixel values
+ *  @param arena   Arena to allocate the pixel data from
  * 
  *  @return EXIT_SUCCESSFUL, if successful.
  *          EXIT_FAILURE, if not successful.
  */
-int BitmapFillPixelData(struct Bitmap *bitmap, union Raw_Pixel_Data *data);
+int BitmapFillPixelData(struct Bitmap *bitmap,
+                        const void *data,
+                        struct Bitmap_Arena *arena);
+
+/**
+ *  @brief Get the number of bytes taken by pixels in a given layout.
+ *
+ *  @param format  Output image layout
+ *  @param size    Number of pixels
+ * 
+ *  @return The pixel data size (without any header).
+ */
+size_t BitmapGetFormatSize(enum Bitmap_Format format, size_t size);
+
+/**
+ *  @brief Get the file extension of an image layout.
+ *
+ *  @param format  Image layout
+ * 
+ *  @return The extension, without the leading dot.
+ */
+const char *BitmapGetFormatExtension(enum Bitmap_Format format);
+
+/**
+ *  @brief Build the header of a 16-bit binary PGM image.
+ *
+ *  @param width   Image width
+ *  @param height  Image height
+ *  @param header  Output header (BITMAP_PGM_HEADER_SIZE bytes)
+ * 
+ *  @return The header length.
+ */
+size_t BitmapFormatPgmHeader(uint32_t width, uint32_t height, char *header);
+
+/**
+ *  @brief Convert 16-bit pixels to the big-endian PGM sample order.
+ *
+ *  On big-endian hosts, this is a plain copy.
+ *  @param data  Input pixel data
+ *  @param size  Number of pixels
+ *  @param out   Output samples (2 * size bytes)
+ * 
+ *  @return none
+ */
+void BitmapSwap16Bit(const uint16_t *data, size_t size, uint8_t *out);
+
+/**
+ *  @brief Pack the top 12 bits of 16-bit pixels, two pixels in 3 bytes.
+ *
+ *  The layout is MIPI RAW12: the high 8 bits of both pixels, then their
+ *  low 4 bits (the first pixel in the low nibble). An odd trailing pixel
+ *  is paired with a zero one.
+ *  @param data  Input pixel data
+ *  @param size  Number of pixels
+ *  @param out   Output bytes (see BitmapGetFormatSize)
+ * 
+ *  @return none
+ */
+void BitmapPack12Bit(const uint16_t *data, size_t size, uint8_t *out);
+
+/**
+ *  @brief Encode a row of 8-bit pixels as RLE8 (BI_RLE8).
+ *
+ *  Runs of 3 equal pixels or more are encoded as such, the pixels in
+ *  between as absolute runs (or as single pixel runs, when fewer than 3).
+ *  The row closes with an end of line, or an end of bitmap for the last
+ *  one, and isn't padded.
+ *  @param row    Pixels to encode
+ *  @param width  Number of pixels
+ *  @param last   Whether it is the last row of the bitmap
+ *  @param out    Output bytes (BITMAP_RLE8_ROW_BOUND(width))
+ * 
+ *  @return The encoded row size.
+ */
+size_t BitmapEncodeRle8Row(const uint8_t *row, uint32_t width, bool last,
+                           uint8_t *out);
 
 /****************************************************************************/
 
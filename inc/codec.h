@@ -0,0 +1,108 @@
+/**
+ *  @brief Fast compression codecs header.
+ *
+ *  This header contains the API for packing the adjusted pixel data into
+ *  an LZ4 frame (see the LZ4 frame format specification), which the lz4
+ *  tool and library decode as they are. The frame is made of independent
+ *  blocks of up to CODEC_LZ4_BLOCK_SIZE bytes, so the blocks are
+ *  compressed in parallel and a frame can be written out in pieces, one
+ *  after the other, with the header first and the end mark last. A block
+ *  which doesn't get smaller is stored as it is.
+ */
+
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS AND MACROS
+ ****************************************************************************/
+/* Largest LZ4 block (the 4 MiB maximum block size of the frame format). */
+#define CODEC_LZ4_BLOCK_SIZE 0x400000U
+
+/* LZ4 frame header size: magic number, descriptor and its checksum. */
+#define CODEC_LZ4_HEADER_SIZE 7U
+
+/* LZ4 end mark size (an empty block). */
+#define CODEC_LZ4_END_SIZE 4U
+
+/* Entries of the match finder hash table, as a power of 2 (16 KiB). */
+#define CODEC_LZ4_HASH_BITS 12U
+
+/* Size of the hash tables needed by a given number of threads. */
+#define CODEC_LZ4_TABLES_SIZE(thread_count) \
+        ((thread_count) * (sizeof(uint32_t) << CODEC_LZ4_HASH_BITS))
+
+/****************************************************************************
+ * TYPE DEFINITIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Available adjusted data containers.
+ */
+enum Codec_Format {
+    CODEC_FORMAT_NONE = 0,      /* Raw pixel data */
+    CODEC_FORMAT_LZ4,           /* LZ4 frame of independent blocks */
+    CODEC_FORMAT_DELTA          /* Records of the adjusted pixels only
+                                   (see FrameWriteChanges, files only) */
+};
+
+/****************************************************************************
+ * FUNCTION DECLARATIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Get the largest size of compressed LZ4 blocks.
+ *
+ *  @param size  Number of input bytes
+ *
+ *  @return The size of the blocks holding the input, at worst (neither
+ *          the frame header nor the end mark included).
+ */
+size_t CodecLz4GetBound(size_t size);
+
+/**
+ *  @brief Write the header of an LZ4 frame.
+ *
+ *  @param out  Output bytes (CODEC_LZ4_HEADER_SIZE)
+ *
+ *  @return The header size.
+ */
+size_t CodecLz4WriteHeader(uint8_t *out);
+
+/**
+ *  @brief Write the end mark of an LZ4 frame.
+ *
+ *  @param out  Output bytes (CODEC_LZ4_END_SIZE)
+ *
+ *  @return The end mark size.
+ */
+size_t CodecLz4WriteEnd(uint8_t *out);
+
+/**
+ *  @brief Compress data into consecutive LZ4 blocks.
+ *
+ *  Each thread compresses every thread_count-th block, the blocks being
+ *  packed together once all of them are done.
+ *  @param data          Input bytes
+ *  @param size          Number of input bytes
+ *  @param thread_count  Number of threads
+ *  @param tables        Hash tables (CODEC_LZ4_TABLES_SIZE(thread_count))
+ *  @param out           Output blocks (see CodecLz4GetBound)
+ *  @param out_size      Size of the output blocks
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if the worker threads failed.
+ */
+int CodecLz4Compress(const void *data,
+                     size_t size,
+                     size_t thread_count,
+                     uint32_t *tables,
+                     uint8_t *out,
+                     size_t *out_size);
+
+/****************************************************************************/
+
+#endif /* CODEC_H */
@@ -0,0 +1,358 @@
+/**
+ *  @brief Delite library header.
+ *
+ *  This header contains the API for adjusting the overexposed pixels of
+ *  16-bit grayscale frames and generating their previews, either in place
+ *  on memory owned by the caller or from and to files. A context keeps the
+ *  adjustment parameters, the preview bitmap template and the per-frame
+ *  buffers from one frame to the next, so the frames can be processed
+ *  in-process without setting anything up again. A context must only be
+ *  used by one thread at a time, its calls starting their own worker
+ *  threads as requested by the parameters.
+ */
+
+#ifndef DELITE_H
+#define DELITE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "async_io.h"
+#include "bitmap.h"
+#include "codec.h"
+#include "frame.h"
+#include "selection.h"
+#include "stats.h"
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS AND MACROS
+ ****************************************************************************/
+/* Largest preview downsampling factor. */
+#define DELITE_PREVIEW_MAX_SCALE 256U
+
+/* Side of the square tiles of the preview pyramid, in pixels. */
+#define DELITE_PYRAMID_TILE_SIZE 256U
+
+/* Tags of the records multiplexing both pipe mode outputs. */
+#define DELITE_RECORD_ALTERED 'R'
+#define DELITE_RECORD_PREVIEW 'P'
+
+/* Record header size: the tag, then the 64-bit little-endian payload size. */
+#define DELITE_RECORD_HEADER_SIZE 9U
+
+/****************************************************************************
+ * TYPE DEFINITIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Ways of choosing the pixels to adjust.
+ */
+enum Delite_Mode {
+    DELITE_MODE_COUNT = 0,              /* The pixel_count highest pixels */
+    DELITE_MODE_THRESHOLD,              /* All the pixels above a value */
+    DELITE_MODE_PERCENTILE,             /* The highest share of the pixels */
+    DELITE_MODE_NEIGHBORHOOD            /* The pixels far above the median
+                                           of their neighborhood */
+};
+
+/**
+ *  @brief Adjustment parameters.
+ */
+struct Delite_Options {
+    enum Delite_Mode mode;              /* How the pixels are chosen */
+    size_t pixel_count;                 /* Number of pixels to adjust */
+    uint16_t threshold;                 /* Value to exceed (threshold mode) */
+    double percentile;                  /* Share of the pixels to adjust,
+                                           as a percentage (percentile
+                                           mode) */
+    uint16_t median_margin;             /* Distance to the neighborhood
+                                           median to exceed (neighborhood
+                                           mode) */
+    size_t median_window;               /* Neighborhood side, 3 or 5
+                                           (neighborhood mode) */
+    unsigned adjustment_level;          /* Adjustment level (percentage) */
+    enum Selection_Engine engine;       /* Selection engine */
+    enum Selection_Tie_Break tie_break; /* Tie-break policy */
+    enum Frame_Input_Mode input_mode;   /* Input file access mode */
+    enum Frame_Pixel_Format pixel_format;   /* Input pixel format (files
+                                               and pipes) */
+    size_t thread_count;                /* Threads per frame */
+    bool streaming;                     /* Whether to use the chunked mode */
+    size_t chunk_size;                  /* Streaming chunk size in bytes */
+    bool sequence;                      /* Whether the frames are a sequence,
+                                           updated from one to the next */
+    enum Bitmap_Format preview_format;  /* Preview image layout */
+    bool preview_rle;                   /* Whether the BMP preview is
+                                           run-length encoded (RLE8) */
+    enum Codec_Format altered_format;   /* Adjusted data container */
+    bool patch_input;                   /* Whether the adjusted pixels are
+                                           written back into the input
+                                           file (files only) */
+    const char *pyramid_path;           /* Preview pyramid directory
+                                           (NULL for none) */
+    uint32_t width;                     /* Frame width (0 to derive it) */
+    uint32_t height;                    /* Frame height (0 to derive it) */
+    uint32_t depth;                     /* Number of volume slices, the
+                                           geometry being the one of a
+                                           slice (0 for a single frame) */
+    uint32_t preview_scale;             /* Preview downsampling factor */
+    enum Async_Io_Backend io_backend;   /* Streaming mode I/O backend */
+};
+
+/* State of the sequence mode, private to the library. */
+struct Delite_Sequence;
+
+/**
+ *  @brief Processing context, reused from one frame to the next.
+ */
+struct Delite_Context {
+    struct Delite_Options options;      /* Adjustment parameters */
+    struct Bitmap *preview;     /* Preview bitmap and its color table */
+    struct Bitmap_Arena arena;  /* Per-frame buffers, reset between frames */
+    struct Delite_Sequence *sequence;   /* Previous frame of the sequence
+                                           (NULL until the first one) */
+    struct Stats *stats;        /* Run statistics (NULL if disabled) */
+};
+
+/****************************************************************************
+ * FUNCTION DECLARATIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Initialize a processing context.
+ *
+ *  The statistics are disabled until the caller sets them.
+ *  @param context  Context to be initialized
+ *  @param options  Adjustment parameters, copied into the context
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if the parameters are invalid or the context
+ *          can't be allocated.
+ */
+int DeliteInit(struct Delite_Context *context,
+               const struct Delite_Options *options);
+
+/**
+ *  @brief Release a processing context.
+ *
+ *  @param context  Context to release
+ *
+ *  @return none
+ */
+void DeliteFree(struct Delite_Context *context);
+
+/**
+ *  @brief Adjust the overexposed pixels of a frame in place.
+ *
+ *  The frame stays owned by the caller and isn't copied. The buffers of
+ *  the previous frame are released first. In the sequence mode, the frame
+ *  is compared with the previous one, so the selection is only updated
+ *  where it changed.
+ *  @param context  Processing context
+ *  @param data     Frame pixels
+ *  @param size     Number of frame pixels
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+int DeliteAdjust(struct Delite_Context *context, uint16_t *data, size_t size);
+
+/**
+ *  @brief Get the size of the preview of a frame.
+ *
+ *  A run-length encoded preview gets the size it would take at worst.
+ *  @param context       Processing context
+ *  @param size          Number of frame pixels
+ *  @param preview_size  Preview size in bytes, including its header
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if the frame doesn't hold the requested geometry.
+ */
+int DeliteGetPreviewSize(struct Delite_Context *context,
+                         size_t size,
+                         size_t *preview_size);
+
+/**
+ *  @brief Generate the preview of a frame into memory.
+ *
+ *  The preview is laid out exactly as its file would be, header first.
+ *  The buffers of the previous frame are released first.
+ *  @param context       Processing context
+ *  @param data          Frame pixels
+ *  @param size          Number of frame pixels
+ *  @param preview       Preview memory, owned by the caller
+ *  @param preview_size  Preview memory size (see DeliteGetPreviewSize)
+ *  @param rendered      Size of the rendered preview (may be NULL)
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+int DeliteRenderPreview(struct Delite_Context *context,
+                        const uint16_t *data,
+                        size_t size,
+                        void *preview,
+                        size_t preview_size,
+                        size_t *rendered);
+
+/**
+ *  @brief Write the tiled preview pyramid of a frame.
+ *
+ *  Level 0 holds the frame at full resolution and each next level halves
+ *  the previous one, averaging its 2x2 pixel blocks, down to the first
+ *  level fitting in a single tile. Each tile is averaged and written out
+ *  while it is still in the cache, in the preview format, as
+ *  <directory>/<level>/<column>_<row>.<extension>, the rows being counted
+ *  from the first frame row. The buffers of the previous frame are
+ *  released first.
+ *  @param context    Processing context
+ *  @param data       Frame pixels
+ *  @param size       Number of frame pixels
+ *  @param directory  Pyramid directory (created if missing)
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+int DeliteWritePyramid(struct Delite_Context *context,
+                       const uint16_t *data,
+                       size_t size,
+                       const char *directory);
+
+/**
+ *  @brief Adjust a frame file.
+ *
+ *  Read the input raw byte stream, detect overexposed pixels and
+ *  output the altered binary file + the preview bitmap. When the
+ *  threshold is known before the adjustment, the three steps are fused
+ *  into a single pass over the frame. The preview pyramid, if
+ *  requested, is written last (see DeliteWritePyramid). Input pixels in
+ *  another format are decoded by the first pass over the frame, and the
+ *  adjusted data is then written as 16-bit pixels in the host byte order.
+ *  The delta container and the input patching both write the adjusted
+ *  pixels only (see FrameWriteChanges), the altered file then holding the
+ *  delta records, if any. With a depth, the file is a volume of equal
+ *  slices: the pixels are selected and adjusted over the whole volume, so
+ *  the slices share one threshold, and each slice gets its own preview,
+ *  the threads taking the slices in turns. A file that doesn't split
+ *  exactly into the slices is rejected before anything is written.
+ *  @param context            Processing context
+ *  @param input_file_path    Path to the input file
+ *  @param preview_file_path  Path to the final preview bitmap (with a
+ *                            depth, a pattern where %i is the slice index
+ *                            and %n the input file name)
+ *  @param altered_file_path  Path to the adjusted pixel data
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+int DeliteProcessFile(struct Delite_Context *context,
+                      const char *input_file_path,
+                      const char *preview_file_path,
+                      const char *altered_file_path);
+
+/**
+ *  @brief Adjust a frame file over fixed-size chunks.
+ *
+ *  The input is read twice, one chunk at a time: the first pass feeds
+ *  a running selection (heap or histogram) and the second one adjusts
+ *  each chunk and writes it out to the altered binary file and to
+ *  the preview bitmap. The reads and writes run in the background, so
+ *  the next chunk is read and both outputs are written while the current
+ *  chunk is processed. The memory usage is bounded by the chunk size.
+ *  The select engine is replaced by the histogram in this mode, and a
+ *  fixed threshold only needs the second pass.
+ *  @param context            Processing context
+ *  @param input_file_path    Path to the input file
+ *  @param preview_file_path  Path to the final preview bitmap
+ *  @param altered_file_path  Path to the adjusted pixel data
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+int DeliteProcessStream(struct Delite_Context *context,
+                        const char *input_file_path,
+                        const char *preview_file_path,
+                        const char *altered_file_path);
+
+/**
+ *  @brief Adjust a frame read from a descriptor, such as a pipe.
+ *
+ *  The input is read until it ends, so its size doesn't need to be known
+ *  in advance. A fixed threshold is applied one chunk at a time, as the
+ *  input comes in, if no preview is requested or the frame width and
+ *  height are both given (and the preview isn't run-length encoded, its
+ *  header holding the encoded size) and the pixels need no decoding; the
+ *  frame is buffered whole otherwise. A compressed output is written as
+ *  one LZ4 frame. When both outputs go to the same descriptor, they're
+ *  multiplexed as records: a tag byte, the payload size as a 64-bit
+ *  little-endian integer and the payload. The preview may then be split
+ *  over several records, which are concatenated in order. The descriptors
+ *  are left open. The delta output and the input patching need an input
+ *  file, so they fail here.
+ *  @param context  Processing context
+ *  @param in       Input descriptor
+ *  @param altered  Adjusted pixel data output descriptor (-1 for none)
+ *  @param preview  Preview output descriptor (-1 for none)
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+int DeliteProcessPipe(struct Delite_Context *context,
+                      int in,
+                      int altered,
+                      int preview);
+
+/**
+ *  @brief Adjust a batch of frame files.
+ *
+ *  The inputs are taken from a directory (all its regular files), from
+ *  a glob pattern or from a list file holding one path per line. The
+ *  output paths are built from patterns, where %n stands for the input
+ *  file name without its extension, %i for the input position in the
+ *  batch and %% for a literal %. Each worker thread has its own context,
+ *  reused for all the files it processes.
+ *  @param source           Directory, glob pattern or list file
+ *  @param preview_pattern  Preview path pattern
+ *  @param altered_pattern  Adjusted data path pattern
+ *  @param options          Adjustment parameters
+ *  @param job_count        Number of files processed at the same time
+ *  @param stats            Run statistics, summed over the workers
+ *                          (may be NULL)
+ *
+ *  @return EXIT_SUCCESS, if all the files were processed.
+ *          EXIT_FAILURE, otherwise.
+ */
+int DeliteProcessBatch(const char *source,
+                       const char *preview_pattern,
+                       const char *altered_pattern,
+                       const struct Delite_Options *options,
+                       size_t job_count,
+                       struct Stats *stats);
+
+/**
+ *  @brief Print the most overexposed pixels of a frame file.
+ *
+ *  Read the input raw byte stream and print the count highest ranked
+ *  pixel values and their position, from the highest to the lowest.
+ *  The frame is scanned once, with one bounded heap per thread, and
+ *  is left unmodified.
+ *  The x and y positions use the frame width of the preview (see
+ *  DeliteProcessFile), the requested one if any.
+ *  @param input_file_path    Path to the input file
+ *  @param count              Number of pixels to report
+ *  @param options            Adjustment parameters (tie-break policy,
+ *                            input mode and pixel format, threads and
+ *                            geometry)
+ *  @param stats              Run statistics (may be NULL)
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+int DeliteQuickSearch(const char *input_file_path,
+                      size_t count,
+                      const struct Delite_Options *options,
+                      struct Stats *stats);
+
+/****************************************************************************/
+
+#endif /* DELITE_H */
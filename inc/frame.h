@@ -0,0 +1,255 @@
+/**
+ *  @brief Raw frame I/O header.
+ *
+ *  This header contains the raw frame type definition, alongside
+ *  the API for loading a frame from a file and writing it back
+ *  after adjustment. By default, the input file is memory-mapped
+ *  privately, so the pixels can be adjusted in place (copy-on-write)
+ *  without reading the whole file into a separate buffer. The input
+ *  pixels may also come in other formats, which are decoded into 16-bit
+ *  pixels by the first pass over the frame.
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "bitmap.h"
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS AND MACROS
+ ****************************************************************************/
+/* Granularity of the adjusted data tracking (in bytes). */
+#define FRAME_BLOCK_SIZE 4096U
+
+/* Mark the block holding a given 16-bit pixel as adjusted. */
+#define FRAME_MARK_PIXEL(dirty_map, index) \
+        ((dirty_map)[((index) * 2U / FRAME_BLOCK_SIZE) / 8U] |= \
+         (uint8_t) (1U << (((index) * 2U / FRAME_BLOCK_SIZE) % 8U)))
+
+/* Delta file magic number, followed by the frame size in pixels (64-bit
+   little-endian). */
+#define FRAME_DELTA_MAGIC "DLTA"
+#define FRAME_DELTA_HEADER_SIZE 12U
+
+/* Delta record size: the pixel index (64-bit), then its original and
+   adjusted values (16-bit), all little-endian. */
+#define FRAME_DELTA_RECORD_SIZE 12U
+
+/****************************************************************************
+ * TYPE DEFINITIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Available input modes.
+ */
+enum Frame_Input_Mode {
+    FRAME_INPUT_MMAP = 0,       /* Private mapping, fall back to read */
+    FRAME_INPUT_READ            /* Read the whole file into memory */
+};
+
+/**
+ *  @brief Available input pixel formats.
+ */
+enum Frame_Pixel_Format {
+    FRAME_PIXEL_U16LE = 0,      /* 16-bit little-endian */
+    FRAME_PIXEL_U16BE,          /* 16-bit big-endian */
+    FRAME_PIXEL_U8,             /* 8-bit */
+    FRAME_PIXEL_RAW12,          /* 12-bit packed (MIPI RAW12) */
+    FRAME_PIXEL_F32             /* 32-bit little-endian float, 0 to 1 */
+};
+
+/**
+ *  @brief Raw frame loaded from a file.
+ *
+ *  When the frame is mapped, the dirty map holds one bit for each
+ *  FRAME_BLOCK_SIZE bytes and must be updated for every adjusted pixel,
+ *  so only the adjusted blocks have to be written on top of the input.
+ *  When the input pixels need decoding, they are kept apart from the
+ *  16-bit pixels, which are filled in by FrameDecode.
+ */
+struct Frame {
+    void *data;                 /* Frame contents (16-bit pixels) */
+    size_t size;                /* Frame size in bytes */
+    int fd;                     /* Input file descriptor */
+    bool mapped;                /* Whether the input is a private mapping */
+    uint8_t *dirty_map;         /* Adjusted blocks (NULL if not mapped) */
+    bool pooled;                /* Whether the buffers belong to an arena */
+    enum Frame_Pixel_Format format;     /* Input pixel format */
+    uint8_t *encoded;           /* Input pixels left to decode (NULL if
+                                   data holds them as they are) */
+    size_t encoded_size;        /* Input size in bytes */
+};
+
+/**
+ *  @brief Output file the adjusted frame is written to one range at a time.
+ *
+ *  When the frame is mapped, the input file is copied in-kernel when
+ *  opening the output (unless it's the input file itself), so the
+ *  unadjusted data is already in place and only the adjusted blocks
+ *  have to be written.
+ */
+struct Frame_Output {
+    int fd;                     /* Output file descriptor */
+    bool in_place;              /* Whether the input data is already there */
+};
+
+/****************************************************************************
+ * FUNCTION DECLARATIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Load a raw frame from a file.
+ *
+ *  The file is mapped privately with a sequential access hint. If the
+ *  mapping isn't possible or the read mode is requested, the whole file
+ *  is read into a newly allocated array instead. If an arena is given,
+ *  the read buffer and the dirty map are allocated from it and remain
+ *  valid until the arena is reset, even after the frame is closed.
+ *  @param path   File to load
+ *  @param mode   Input mode
+ *  @param arena  Arena to allocate the buffers from (NULL for malloc)
+ *  @param frame  Frame to be initialized
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if not successful.
+ */
+int FrameOpen(const char *path, enum Frame_Input_Mode mode,
+              struct Bitmap_Arena *arena, struct Frame *frame);
+
+/**
+ *  @brief Set the pixel format of a loaded frame.
+ *
+ *  Unless the format is the 16-bit one of the host, the frame contents
+ *  become the encoded input and data a new array for the 16-bit pixels,
+ *  left for FrameDecode to fill in. The frame then has no dirty map and
+ *  is written out as a whole, in the host byte order, and the input file
+ *  itself can't be the output. Any trailing bytes not making up a whole
+ *  pixel are left out.
+ *  @param frame   Frame loaded as it is
+ *  @param format  Input pixel format
+ *  @param arena   Arena to allocate the pixels from (NULL for malloc)
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if the frame holds no whole pixel to decode or
+ *          the pixels can't be allocated.
+ */
+int FrameSetPixelFormat(struct Frame *frame,
+                        enum Frame_Pixel_Format format,
+                        struct Bitmap_Arena *arena);
+
+/**
+ *  @brief Decode a range of the input pixels of a frame.
+ *
+ *  Ranges can be decoded in any order and from several threads at once.
+ *  Nothing is done for a frame without encoded input.
+ *  @param frame   Frame to decode (may be NULL)
+ *  @param offset  Index of the first pixel
+ *  @param count   Number of pixels
+ *  @param out     Decoded pixels (usually the same pixels of data)
+ *
+ *  @return none
+ */
+void FrameDecode(const struct Frame *frame,
+                 size_t offset,
+                 size_t count,
+                 uint16_t *out);
+
+/**
+ *  @brief Write a frame to a file.
+ *
+ *  For mapped frames, the input file is copied in-kernel and only the
+ *  adjusted blocks are written on top of it, otherwise the whole frame
+ *  is written. Writing back to the input file itself is supported.
+ *  @param frame  Frame to write
+ *  @param path   Output file path
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if not successful.
+ */
+int FrameWriteToFile(const struct Frame *frame, const char *path);
+
+/**
+ *  @brief Write only the adjusted pixels of a frame.
+ *
+ *  The adjusted blocks (all of them without a dirty map) are compared
+ *  with the input file, which still holds the original pixels. Each
+ *  changed pixel is written to the delta file as a record, in order,
+ *  and each run of changed pixels is written over the input file itself
+ *  if requested, so the rest of the frame is never written anywhere.
+ *  The delta file can't be the input file.
+ *  @param frame       Frame to write (without encoded input)
+ *  @param delta_path  Delta file path (NULL for none)
+ *  @param patch_path  Input file path, to patch it (NULL to leave it)
+ *  @param written     Number of bytes written, incremented
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if not successful.
+ */
+int FrameWriteChanges(const struct Frame *frame,
+                      const char *delta_path,
+                      const char *patch_path,
+                      size_t *written);
+
+/**
+ *  @brief Open the output file of a frame for writing it by ranges.
+ *
+ *  Unless it's the input file itself, the output file is truncated and,
+ *  for mapped frames, filled with a copy of the input file. The input
+ *  file can only be the output of a frame without encoded input.
+ *  @param frame   Frame to write
+ *  @param path    Output file path
+ *  @param output  Output to be initialized
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if not successful.
+ */
+int FrameOutputOpen(const struct Frame *frame, const char *path,
+                    struct Frame_Output *output);
+
+/**
+ *  @brief Write a range of a frame to its output file.
+ *
+ *  Ranges can be written in any order and from several threads at once.
+ *  When the output is in place, only the blocks marked in the dirty map
+ *  are written.
+ *  @param frame      Frame to write
+ *  @param output     Output file
+ *  @param offset     Range offset in bytes
+ *  @param count      Range size in bytes
+ *  @param dirty_map  Adjusted blocks, counted from offset (NULL for all)
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if not successful.
+ */
+int FrameOutputWrite(const struct Frame *frame,
+                     const struct Frame_Output *output,
+                     size_t offset,
+                     size_t count,
+                     const uint8_t *dirty_map);
+
+/**
+ *  @brief Close the output file of a frame.
+ *
+ *  @param output  Output to close
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if not successful.
+ */
+int FrameOutputClose(struct Frame_Output *output);
+
+/**
+ *  @brief Release the frame resources.
+ *
+ *  @param frame  Frame to release
+ *
+ *  @return none
+ */
+void FrameClose(struct Frame *frame);
+
+/****************************************************************************/
+
+#endif /* FRAME_H */
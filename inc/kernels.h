@@ -0,0 +1,218 @@
+/**
+ *  @brief Pixel processing kernels header.
+ *
+ *  This header contains the API of the innermost pixel loops: the 16-bit
+ *  to 8-bit conversion and the row sums used for the preview, the
+ *  threshold scans used by the detection, the adjustment multiply, the
+ *  neighborhood median filter and the decoders of the other input pixel
+ *  formats. Each kernel has a scalar implementation
+ *  and, where available, SSE2, AVX2 or NEON ones, picked once at startup
+ *  based on the CPU features. All the implementations give exactly the
+ *  same results.
+ */
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS
+ ****************************************************************************/
+/* Largest neighborhood side of the median filter. */
+#define KERNELS_MAX_WINDOW 5U
+
+/****************************************************************************
+ * FUNCTION DECLARATIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Select the kernel implementations for the running CPU.
+ *
+ *  Must be called once, before any other kernel is used. Until then,
+ *  the scalar implementations are used.
+ *  @param none
+ *
+ *  @return none
+ */
+void KernelsInit(void);
+
+/**
+ *  @brief Get the name of the selected kernel implementations.
+ *
+ *  @param none
+ *
+ *  @return "scalar", "sse2", "avx2" or "neon".
+ */
+const char *KernelsGetName(void);
+
+/**
+ *  @brief Get the scaling factor of an adjustment level.
+ *
+ *  The factor is 1 - level / 100, with each operation rounded to single
+ *  precision, so it's the same for any compiler and architecture.
+ *  @param adjustment_level  Adjustment level (percentage)
+ *
+ *  @return The scaling factor.
+ */
+float KernelsGetScaleFactor(unsigned adjustment_level);
+
+/**
+ *  @brief Scale a single pixel.
+ *
+ *  The pixel is multiplied by the factor in single precision, rounded to
+ *  nearest even, and the product is truncated towards zero, even where
+ *  the float math runs in a wider format. This defines the result of all
+ *  the scaling kernels.
+ *  @param pixel   Pixel value
+ *  @param factor  Scaling factor (between 0 and 1)
+ *
+ *  @return The scaled pixel value.
+ */
+uint16_t KernelScalePixel(uint16_t pixel, float factor);
+
+/**
+ *  @brief Convert 16-bit pixels to 8-bit by keeping their high byte.
+ *
+ *  @param data  Input pixel data
+ *  @param size  Number of pixels
+ *  @param out   Output pixel data (must hold at least size bytes)
+ *
+ *  @return none
+ */
+void KernelDownscale(const uint16_t *data, size_t size, uint8_t *out);
+
+/**
+ *  @brief Find the first pixel which is at least a given value.
+ *
+ *  @param data   Pixel data
+ *  @param size   Number of pixels
+ *  @param value  Value to compare against
+ *
+ *  @return The index of the pixel, or size if there's none.
+ */
+size_t KernelFindAtLeast(const uint16_t *data, size_t size, uint16_t value);
+
+/**
+ *  @brief Find the first pixel equal to a given value.
+ *
+ *  @param data   Pixel data
+ *  @param size   Number of pixels
+ *  @param value  Value to compare against
+ *
+ *  @return The index of the pixel, or size if there's none.
+ */
+size_t KernelFindEqual(const uint16_t *data, size_t size, uint16_t value);
+
+/**
+ *  @brief Scale all the pixels above a given value.
+ *
+ *  Each pixel above the value is scaled as by KernelScalePixel, the
+ *  vector implementations giving exactly the same results.
+ *  @param data    Pixel data to adjust
+ *  @param size    Number of pixels
+ *  @param value   Value the pixels must exceed
+ *  @param factor  Scaling factor (between 0 and 1)
+ *
+ *  @return The number of scaled pixels.
+ */
+size_t KernelScaleAbove(uint16_t *data,
+                        size_t size,
+                        uint16_t value,
+                        float factor);
+
+/**
+ *  @brief Add a row of pixels to a row of sums.
+ *
+ *  The sums don't saturate, the caller must keep them below 2^32.
+ *  @param data  Pixel data
+ *  @param size  Number of pixels
+ *  @param sums  Sums to update (one for each pixel)
+ *
+ *  @return none
+ */
+void KernelAccumulate(const uint16_t *data, size_t size, uint32_t *sums);
+
+/**
+ *  @brief Scale the pixels far above the median of their neighborhood.
+ *
+ *  The neighborhood of a pixel is the window x window square centered on
+ *  it, read from copies of the original rows holding window / 2 more
+ *  pixels on both sides. A pixel exceeding its median by more than the
+ *  margin is scaled as by KernelScalePixel, from its original value. The
+ *  medians come out of the same selection network for all the
+ *  implementations.
+ *  @param data    Pixel row to adjust
+ *  @param rows    Original rows around it, the middle one matching data
+ *                 (window of them)
+ *  @param window  Neighborhood side (3 or 5)
+ *  @param size    Number of pixels
+ *  @param margin  Largest distance to the median left untouched
+ *  @param factor  Scaling factor (between 0 and 1)
+ *
+ *  @return The number of scaled pixels.
+ */
+size_t KernelScaleAboveMedian(uint16_t *data,
+                              const uint16_t *const *rows,
+                              size_t window,
+                              size_t size,
+                              uint16_t margin,
+                              float factor);
+
+/**
+ *  @brief Swap the bytes of 16-bit pixels.
+ *
+ *  @param in    Input pixel data
+ *  @param size  Number of pixels
+ *  @param out   Output pixel data
+ *
+ *  @return none
+ */
+void KernelSwap16Bit(const uint16_t *in, size_t size, uint16_t *out);
+
+/**
+ *  @brief Decode 8-bit pixels.
+ *
+ *  Each pixel is widened to v * 257, so 0xFF becomes 0xFFFF.
+ *  @param in    Input bytes (one for each pixel)
+ *  @param size  Number of pixels
+ *  @param out   Output pixel data
+ *
+ *  @return none
+ */
+void KernelDecode8Bit(const uint8_t *in, size_t size, uint16_t *out);
+
+/**
+ *  @brief Decode 12-bit packed pixels (MIPI RAW12).
+ *
+ *  Each pair of pixels takes 3 bytes: the high 8 bits of the first and
+ *  of the second pixel, then their low 4 bits (the first pixel's in the
+ *  low nibble). Each pixel is widened to (v << 4) | (v >> 8), so 0xFFF
+ *  becomes 0xFFFF.
+ *  @param in    Input bytes, starting on a pair of pixels (3 for each
+ *               pair, including the last one if size is odd)
+ *  @param size  Number of pixels
+ *  @param out   Output pixel data
+ *
+ *  @return none
+ */
+void KernelDecode12Bit(const uint8_t *in, size_t size, uint16_t *out);
+
+/**
+ *  @brief Decode little-endian 32-bit float pixels.
+ *
+ *  The values from 0 to 1 are multiplied by 65536 and truncated, the
+ *  ones above saturating to 0xFFFF, while the negative ones and NaN give
+ *  0. The scaling is exact, so all the implementations agree.
+ *  @param in    Input bytes (4 for each pixel)
+ *  @param size  Number of pixels
+ *  @param out   Output pixel data
+ *
+ *  @return none
+ */
+void KernelDecodeFloat(const uint8_t *in, size_t size, uint16_t *out);
+
+/****************************************************************************/
+
+#endif /* KERNELS_H */
@@ -0,0 +1,87 @@
+/**
+ *  @brief Buffered logger header.
+ *
+ *  This header contains the API for formatting messages into a fixed
+ *  buffer which is only written out once full or when the log is closed,
+ *  so logging stays out of the way of the pixel processing. A log must
+ *  only be used by one thread at a time.
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS AND MACROS
+ ****************************************************************************/
+/* Log buffer size, which is also the longest message. */
+#define LOG_BUFFER_SIZE 4096U
+
+/****************************************************************************
+ * TYPE DEFINITIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Buffered log.
+ */
+struct Log {
+    int fd;                     /* Log file descriptor */
+    bool owned;                 /* Whether the descriptor is closed with it */
+    size_t length;              /* Number of buffered bytes */
+    int status;                 /* EXIT_FAILURE once anything went wrong */
+    char buffer[LOG_BUFFER_SIZE];   /* Messages not written out yet */
+};
+
+/****************************************************************************
+ * FUNCTION DECLARATIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Open a log.
+ *
+ *  @param log   Log to be initialized
+ *  @param path  Log file path, truncated if it exists (NULL for stderr)
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if not successful.
+ */
+int LogOpen(struct Log *log, const char *path);
+
+/**
+ *  @brief Append a formatted message to a log.
+ *
+ *  Errors, including messages longer than LOG_BUFFER_SIZE, are reported
+ *  when the log is flushed or closed.
+ *  @param log     Log to append to
+ *  @param format  printf() format
+ *  @param ...     Format arguments
+ *
+ *  @return none
+ */
+void LogPrintf(struct Log *log, const char *format, ...);
+
+/**
+ *  @brief Write out the buffered messages.
+ *
+ *  @param log  Log to flush
+ *
+ *  @return EXIT_SUCCESS, if everything logged so far was written.
+ *          EXIT_FAILURE, otherwise.
+ */
+int LogFlush(struct Log *log);
+
+/**
+ *  @brief Flush and close a log.
+ *
+ *  @param log  Log to close
+ *
+ *  @return EXIT_SUCCESS, if everything logged was written.
+ *          EXIT_FAILURE, otherwise.
+ */
+int LogClose(struct Log *log);
+
+/****************************************************************************/
+
+#endif /* LOG_H */
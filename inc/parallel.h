@@ -0,0 +1,82 @@
+/**
+ *  @brief Worker threads header.
+ *
+ *  This header contains the API for running the same task over several
+ *  partitions at once, one worker thread per partition. The calling
+ *  thread always processes the first partition itself. The worker threads
+ *  are started for each run, unless a pool of them has been started
+ *  beforehand to be reused from one run to the next.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdlib.h>
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS AND MACROS
+ ****************************************************************************/
+/* Maximum number of worker threads for a single run. */
+#define PARALLEL_MAX_THREADS 256U
+
+/****************************************************************************
+ * FUNCTION DECLARATIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Get the number of online CPUs.
+ *
+ *  @param none
+ *
+ *  @return The number of CPUs, between 1 and PARALLEL_MAX_THREADS.
+ */
+size_t ParallelGetCpuCount(void);
+
+/**
+ *  @brief Start a pool of worker threads, shared by the following runs.
+ *
+ *  The workers wait for the runs instead of being started and joined for
+ *  each of them, which removes that latency from short runs. A run finding
+ *  the pool busy with another one starts its own threads, as it does
+ *  without a pool. The pool must not be started or stopped during a run.
+ *  @param count  Number of worker threads (below PARALLEL_MAX_THREADS)
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if the pool is already started or its threads
+ *          can't be started.
+ */
+int ParallelPoolStart(size_t count);
+
+/**
+ *  @brief Stop the pool of worker threads, once they are idle.
+ *
+ *  @param none
+ *
+ *  @return none
+ */
+void ParallelPoolStop(void);
+
+/**
+ *  @brief Run a task over an array of arguments, one thread each.
+ *
+ *  The function returns once all the arguments have been processed.
+ *  If a worker thread can't be started, its argument is processed by
+ *  the calling thread instead, so the results never depend on how many
+ *  threads actually ran. The pool workers, if any, claim the arguments
+ *  one at a time along with the calling thread.
+ *  @param task      Task to run
+ *  @param args      Array of task arguments
+ *  @param arg_size  Size of one argument
+ *  @param count     Number of arguments (up to PARALLEL_MAX_THREADS)
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if not successful.
+ */
+int ParallelRun(void (*task)(void *),
+                void *args,
+                size_t arg_size,
+                size_t count);
+
+/****************************************************************************/
+
+#endif /* PARALLEL_H */
@@ -0,0 +1,265 @@
+/**
+ *  @brief Pixel selection engine header.
+ *
+ *  This header contains the top-k selection API used for detecting
+ *  the overexposed pixels of a raw frame. The pixels are ranked by
+ *  their value and, for equal values, by their position according to
+ *  the tie-break policy (by default, the pixel closer to the beginning
+ *  of the frame ranks higher). Pixels having the value 0 are never selected.
+ *  Arrays of up to 2^48 pixels are supported.
+ */
+
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS AND MACROS
+ ****************************************************************************/
+/* The automatic engine picks the bounded heap as long as the number of
+   pixels to select is below size / SELECTION_HEAP_RATIO. */
+#define SELECTION_HEAP_RATIO 64U
+
+/* Number of histogram bins needed for 16-bit pixel data. */
+#define SELECTION_HISTOGRAM_SIZE 0x10000U
+
+/****************************************************************************
+ * TYPE DEFINITIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Available top-k selection engines.
+ */
+enum Selection_Engine {
+    SELECTION_ENGINE_AUTO = 0,      /* Pick the engine based on k and size */
+    SELECTION_ENGINE_HEAP,          /* Bounded min-heap, O(n log k) */
+    SELECTION_ENGINE_INTROSELECT,   /* Partial select, O(n) */
+    SELECTION_ENGINE_HISTOGRAM      /* Value histogram + threshold, O(n) */
+};
+
+/**
+ *  @brief Policies for choosing between pixels having the same value.
+ */
+enum Selection_Tie_Break {
+    SELECTION_TIE_BREAK_FIRST = 0,  /* The pixel closer to the beginning */
+    SELECTION_TIE_BREAK_LAST,       /* The pixel closer to the end */
+    SELECTION_TIE_BREAK_ALL         /* All pixels at the threshold value */
+};
+
+/**
+ *  @brief Threshold which separates the selected pixels from the others.
+ *
+ *  All the pixels above the threshold value are selected, while only
+ *  quota pixels out of the ones equal to the threshold value are.
+ */
+struct Selection_Threshold {
+    uint16_t value;                 /* Threshold value */
+    size_t above;                   /* Number of pixels above the value */
+    size_t equal;                   /* Number of pixels equal to the value */
+    size_t quota;                   /* Number of equal pixels to select */
+};
+
+/**
+ *  @brief Bounded min-heap of ranking keys.
+ *
+ *  The heap can be updated with consecutive chunks of the same frame,
+ *  so the selection doesn't need the whole frame at once. The root
+ *  always holds the lowest ranked pixel kept so far.
+ */
+struct Selection_Heap {
+    uint64_t *keys;                 /* Heap array */
+    size_t size;                    /* Number of keys in the heap */
+    size_t capacity;                /* Maximum number of keys */
+    uint64_t mask;                  /* Tie-break index mask */
+};
+
+/****************************************************************************
+ * FUNCTION DECLARATIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Resolve the engine to use for a given selection.
+ *
+ *  SELECTION_ENGINE_AUTO picks the bounded heap for small selections
+ *  and the histogram otherwise. Any other engine is returned as it is.
+ *  @param engine  Requested selection engine
+ *  @param size    Array size
+ *  @param count   Number of pixels to select
+ *
+ *  @return The engine to use.
+ */
+enum Selection_Engine SelectionPickEngine(enum Selection_Engine engine,
+                                          size_t size,
+                                          size_t count);
+
+/**
+ *  @brief Get the name of a selection engine.
+ *
+ *  @param engine  Selection engine
+ *
+ *  @return "auto", "heap", "select" or "histogram".
+ */
+const char *SelectionGetEngineName(enum Selection_Engine engine);
+
+/**
+ *  @brief Select the highest ranked pixels of a 16-bit pixel array.
+ *
+ *  Find the count highest ranked non-zero pixels and store their indices.
+ *  The order of the selected indices is unspecified, except for the last
+ *  one, which always refers to the lowest ranked selected pixel.
+ *  If the array contains less than count non-zero pixels, all of them
+ *  are selected. Since no more than count pixels can be returned,
+ *  SELECTION_TIE_BREAK_ALL is handled as SELECTION_TIE_BREAK_FIRST.
+ *  @param data       Pixel data to select from
+ *  @param size       Array size
+ *  @param count      Number of pixels to select
+ *  @param engine     Selection engine to use
+ *  @param tie_break  Tie-break policy for pixels having the same value
+ *  @param indices    Output array (must hold at least count entries)
+ *  @param selected   Number of pixels actually selected
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if not successful.
+ */
+int SelectionTopK(const uint16_t *data,
+                  size_t size,
+                  size_t count,
+                  enum Selection_Engine engine,
+                  enum Selection_Tie_Break tie_break,
+                  size_t *indices,
+                  size_t *selected);
+
+/**
+ *  @brief Initialize an empty selection heap.
+ *
+ *  @param heap       Heap to be initialized
+ *  @param capacity   Number of pixels to select
+ *  @param tie_break  Tie-break policy (all is handled as first)
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if not successful.
+ */
+int SelectionHeapInit(struct Selection_Heap *heap,
+                      size_t capacity,
+                      enum Selection_Tie_Break tie_break);
+
+/**
+ *  @brief Update a selection heap with a chunk of pixels.
+ *
+ *  The chunks must be passed in ascending order of their offsets.
+ *  @param heap    Heap to update
+ *  @param data    Pixel data chunk
+ *  @param size    Chunk size
+ *  @param offset  Index of the first chunk pixel within the frame
+ *
+ *  @return none
+ */
+void SelectionHeapUpdate(struct Selection_Heap *heap,
+                         const uint16_t *data,
+                         size_t size,
+                         size_t offset);
+
+/**
+ *  @brief Merge the keys kept by another selection heap into a heap.
+ *
+ *  Both heaps must use the same tie-break policy. Since no two pixels
+ *  rank the same, the merged heap keeps the same pixels no matter in
+ *  which order the heaps are merged.
+ *  @param heap   Heap to update
+ *  @param other  Heap to merge (e.g. built over another frame partition)
+ *
+ *  @return none
+ */
+void SelectionHeapMerge(struct Selection_Heap *heap,
+                        const struct Selection_Heap *other);
+
+/**
+ *  @brief Get the indices of the pixels kept by a selection heap.
+ *
+ *  The last index always refers to the lowest ranked pixel.
+ *  @param heap     Heap to read from
+ *  @param indices  Output array (must hold at least heap->size entries)
+ *
+ *  @return The number of indices stored.
+ */
+size_t SelectionHeapExtract(const struct Selection_Heap *heap,
+                            size_t *indices);
+
+/**
+ *  @brief Release the selection heap resources.
+ *
+ *  @param heap  Heap to release
+ *
+ *  @return none
+ */
+void SelectionHeapFree(struct Selection_Heap *heap);
+
+/**
+ *  @brief Sort pixel indices from the highest ranked to the lowest.
+ *
+ *  @param data       Pixel data the indices refer to
+ *  @param indices    Indices to sort
+ *  @param count      Number of indices
+ *  @param tie_break  Tie-break policy for pixels having the same value
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if not successful.
+ */
+int SelectionSortByRank(const uint16_t *data,
+                        size_t *indices,
+                        size_t count,
+                        enum Selection_Tie_Break tie_break);
+
+/**
+ *  @brief Build the value histogram of a 16-bit pixel array.
+ *
+ *  @param data       Pixel data
+ *  @param size       Array size
+ *  @param histogram  Output histogram (SELECTION_HISTOGRAM_SIZE bins)
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if not successful.
+ */
+int SelectionBuildHistogram(const uint16_t *data,
+                            size_t size,
+                            size_t *histogram);
+
+/**
+ *  @brief Add a chunk of pixels to an existing value histogram.
+ *
+ *  @param data       Pixel data chunk
+ *  @param size       Chunk size
+ *  @param histogram  Histogram to update (SELECTION_HISTOGRAM_SIZE bins)
+ *
+ *  @return none
+ */
+void SelectionUpdateHistogram(const uint16_t *data,
+                              size_t size,
+                              size_t *histogram);
+
+/**
+ *  @brief Find the threshold for selecting the highest count pixels.
+ *
+ *  The histogram is walked down from the highest value until count
+ *  non-zero pixels are reached. The pixels equal to the threshold value
+ *  are all selected with SELECTION_TIE_BREAK_ALL, otherwise only as many
+ *  as needed to reach count. If the histogram contains no non-zero pixels,
+ *  the threshold value is 0 and nothing is selected.
+ *  @param histogram  Value histogram (SELECTION_HISTOGRAM_SIZE bins)
+ *  @param count      Number of pixels to select
+ *  @param tie_break  Tie-break policy for pixels at the threshold value
+ *  @param threshold  Output threshold
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if not successful.
+ */
+int SelectionFindThreshold(const size_t *histogram,
+                           size_t count,
+                           enum Selection_Tie_Break tie_break,
+                           struct Selection_Threshold *threshold);
+
+/****************************************************************************/
+
+#endif /* SELECTION_H */
@@ -0,0 +1,105 @@
+/**
+ *  @brief Frame server header.
+ *
+ *  This header contains the API and the wire protocol of the server mode,
+ *  which keeps a processing context and a pool of worker threads ready and
+ *  adjusts the frames requested over a Unix socket. The frames and their
+ *  previews stay in shared memory (memfd_create()), whose descriptors are
+ *  passed along with the requests (SCM_RIGHTS), so they're never copied
+ *  through the socket: the frame is adjusted in place and the preview is
+ *  rendered into the memory given by the client. Since the server keeps
+ *  the memory mapped, both must be sealed against shrinking
+ *  (MFD_ALLOW_SEALING, then F_ADD_SEALS with F_SEAL_SHRINK) before being
+ *  passed, and unsealed memory is rejected like a malformed request
+ *  (growing the memory is fine).
+ *
+ *  Each request is a struct Server_Request, carrying either no descriptor,
+ *  the frame memory descriptor or the frame and then the preview memory
+ *  descriptors. The memory given last on the connection is used when none
+ *  is passed, and stays mapped until it is replaced, so a client passing
+ *  the same memory once can send the following frames without remapping
+ *  it. The server replies with a struct Server_Response for each request,
+ *  in order. A request may be sent in pieces, the descriptors coming with
+ *  any of them, and a connection waiting for the rest of its request
+ *  doesn't hold up the others. All the fields are in the host byte order.
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "delite.h"
+#include "stats.h"
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS AND MACROS
+ ****************************************************************************/
+/* First field of every request and response ("DLT1"). */
+#define SERVER_MAGIC 0x31544C44U
+
+/* Request flags: adjust the frame in place, render its preview. */
+#define SERVER_FLAG_ADJUST 0x1U
+#define SERVER_FLAG_PREVIEW 0x2U
+
+/* Maximum number of connections served at the same time. */
+#define SERVER_MAX_CLIENTS 64U
+
+/****************************************************************************
+ * TYPE DEFINITIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Frame request.
+ */
+struct Server_Request {
+    uint32_t magic;             /* SERVER_MAGIC */
+    uint32_t flags;             /* SERVER_FLAG_ADJUST and/or _PREVIEW */
+    uint64_t frame_offset;      /* Frame position in its memory (bytes,
+                                   even) */
+    uint64_t frame_size;        /* Number of frame pixels */
+    uint64_t preview_offset;    /* Preview position in its memory (bytes) */
+};
+
+/**
+ *  @brief Reply to a frame request.
+ */
+struct Server_Response {
+    uint32_t magic;             /* SERVER_MAGIC */
+    int32_t status;             /* EXIT_SUCCESS or EXIT_FAILURE */
+    uint64_t adjusted;          /* Number of pixels adjusted */
+    uint64_t preview_size;      /* Preview size in bytes, header included */
+};
+
+/****************************************************************************
+ * FUNCTION DECLARATIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Serve frame requests until asked to stop.
+ *
+ *  The connections are served one request at a time, in the order the
+ *  requests are completed. A failed request is reported to its client
+ *  only, while a malformed one closes its connection, as does a client
+ *  not reading its replies. A stale socket at the
+ *  given path is replaced, and the socket is removed once stopped.
+ *  @param socket_path  Path of the Unix socket to listen on
+ *  @param options      Adjustment parameters
+ *  @param stop         Set to stop (e.g. by a signal handler, which should
+ *                      interrupt the system calls)
+ *  @param stats        Run statistics, summed over the requests (may be
+ *                      NULL)
+ *
+ *  @return EXIT_SUCCESS, if the server stopped as requested.
+ *          EXIT_FAILURE, if it couldn't be started or its socket failed.
+ */
+int ServerRun(const char *socket_path,
+              const struct Delite_Options *options,
+              volatile sig_atomic_t *stop,
+              struct Stats *stats);
+
+/****************************************************************************/
+
+#endif /* SERVER_H */
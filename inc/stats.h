@@ -0,0 +1,160 @@
+/**
+ *  @brief Run statistics header.
+ *
+ *  This header contains the API for timing the processing stages and
+ *  counting the work done, so a slow run can be broken down without a
+ *  profiler. Every function accepts NULL statistics and does nothing then,
+ *  so the instrumented code doesn't need to check whether they're enabled.
+ *  The statistics must only be updated by one thread at a time.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "log.h"
+
+/****************************************************************************
+ * TYPE DEFINITIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Timed processing stages.
+ */
+enum Stats_Stage {
+    STATS_STAGE_READ = 0,       /* Opening or reading the input */
+    STATS_STAGE_DETECT,         /* Selecting the pixels to adjust */
+    STATS_STAGE_ADJUST,         /* Adjusting them */
+    STATS_STAGE_PREVIEW,        /* Converting the preview pixels */
+    STATS_STAGE_FUSED,          /* All of the above, one tile at a time */
+    STATS_STAGE_WRITE,          /* Writing the outputs */
+    STATS_STAGE_COUNT           /* Number of stages */
+};
+
+/**
+ *  @brief Work counters.
+ */
+enum Stats_Counter {
+    STATS_FRAMES = 0,           /* Frames processed */
+    STATS_BYTES_READ,           /* Input bytes read (or mapped) */
+    STATS_BYTES_WRITTEN,        /* Output bytes written */
+    STATS_PIXELS_SCANNED,       /* Pixels examined by the selection */
+    STATS_PIXELS_ADJUSTED,      /* Pixels adjusted */
+    STATS_COUNTER_COUNT         /* Number of counters */
+};
+
+/**
+ *  @brief Statistics of a run.
+ */
+struct Stats {
+    double started;             /* Time the run started */
+    double starts[STATS_STAGE_COUNT];   /* Time each stage last started */
+    double seconds[STATS_STAGE_COUNT];  /* Time spent in each stage */
+    uint64_t counters[STATS_COUNTER_COUNT];     /* Work counters */
+    const char *engine;         /* Selection engine (NULL if none ran) */
+    const char *io_backend;     /* Streaming I/O backend (NULL if none) */
+    size_t thread_count;        /* Threads per frame */
+};
+
+/****************************************************************************
+ * FUNCTION DECLARATIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Initialize empty statistics, starting the total run time.
+ *
+ *  @param stats  Statistics to be initialized
+ *
+ *  @return none
+ */
+void StatsInit(struct Stats *stats);
+
+/**
+ *  @brief Get a monotonic timestamp.
+ *
+ *  @param none
+ *
+ *  @return The time in seconds.
+ */
+double StatsGetTime(void);
+
+/**
+ *  @brief Start timing a stage.
+ *
+ *  @param stats  Statistics to update (may be NULL)
+ *  @param stage  Stage starting
+ *
+ *  @return none
+ */
+void StatsBegin(struct Stats *stats, enum Stats_Stage stage);
+
+/**
+ *  @brief Stop timing a stage, adding its time since StatsBegin.
+ *
+ *  @param stats  Statistics to update (may be NULL)
+ *  @param stage  Stage ending
+ *
+ *  @return none
+ */
+void StatsEnd(struct Stats *stats, enum Stats_Stage stage);
+
+/**
+ *  @brief Add to a work counter.
+ *
+ *  @param stats    Statistics to update (may be NULL)
+ *  @param counter  Counter to update
+ *  @param value    Value to add
+ *
+ *  @return none
+ */
+void StatsAdd(struct Stats *stats, enum Stats_Counter counter,
+              uint64_t value);
+
+/**
+ *  @brief Record the selection engine used.
+ *
+ *  @param stats   Statistics to update (may be NULL)
+ *  @param engine  Engine name
+ *
+ *  @return none
+ */
+void StatsSetEngine(struct Stats *stats, const char *engine);
+
+/**
+ *  @brief Record the streaming I/O backend used.
+ *
+ *  @param stats       Statistics to update (may be NULL)
+ *  @param io_backend  Backend name
+ *
+ *  @return none
+ */
+void StatsSetIoBackend(struct Stats *stats, const char *io_backend);
+
+/**
+ *  @brief Add the stage times and counters of other statistics.
+ *
+ *  The engine and backend names are taken over if they were set.
+ *  @param stats  Statistics to update
+ *  @param other  Statistics to add (e.g. from another batch worker)
+ *
+ *  @return none
+ */
+void StatsMerge(struct Stats *stats, const struct Stats *other);
+
+/**
+ *  @brief Log the statistics as a single-line JSON object.
+ *
+ *  The SIMD kernels in use and the peak resident set size of the process
+ *  are logged along with them.
+ *  @param stats  Statistics to log
+ *  @param log    Log to write to
+ *
+ *  @return none
+ */
+void StatsWrite(const struct Stats *stats, struct Log *log);
+
+/****************************************************************************/
+
+#endif /* STATS_H */
@@ -0,0 +1,533 @@
+/**
+ *  @brief Asynchronous file I/O implementation file.
+ *
+ */
+
+#include "async_io.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif /* __linux__ */
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && \
+    defined(__NR_io_uring_enter)
+#define ASYNC_IO_HAS_URING
+#endif
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS AND MACROS
+ ****************************************************************************/
+/* Largest transfer submitted at once, the rest is resumed afterwards. */
+#define ASYNC_IO_MAX_TRANSFER 0x40000000U
+
+/****************************************************************************
+ * LOCAL DECLARATIONS
+ ****************************************************************************/
+/**
+ *  @brief Run the rest of a request on the calling thread.
+ *
+ *  @param request  Request to run
+ *
+ *  @return none
+ */
+static void TransferNow(struct Async_Io_Request *request);
+
+/**
+ *  @brief Account for a partial transfer of a request.
+ *
+ *  @param request  Request which made progress
+ *  @param result   Number of bytes transferred, or a negated errno value
+ *
+ *  @return true, if the request is complete.
+ *          false, if the rest must be transferred.
+ */
+static bool UpdateTransfer(struct Async_Io_Request *request, ssize_t result);
+
+/**
+ *  @brief Worker thread entry point of the thread backend.
+ *
+ *  @param queue  Queue to serve (struct Async_Io_Queue)
+ *
+ *  @return NULL
+ */
+static void *RunWorker(void *queue);
+
+/**
+ *  @brief Start the worker threads of the thread backend.
+ *
+ *  @param queue  Queue to initialize
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int InitThreads(struct Async_Io_Queue *queue);
+
+#ifdef ASYNC_IO_HAS_URING
+/**
+ *  @brief Set up and map the io_uring rings.
+ *
+ *  @param ring  Rings to be initialized
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if io_uring isn't available.
+ */
+static int InitRing(struct Async_Io_Ring *ring);
+
+/**
+ *  @brief Unmap and close the io_uring rings.
+ *
+ *  @param ring  Rings to release
+ *
+ *  @return none
+ */
+static void FreeRing(struct Async_Io_Ring *ring);
+
+/**
+ *  @brief Queue the rest of a request on the submission ring.
+ *
+ *  @param ring     Rings to submit to
+ *  @param request  Request to submit
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int SubmitToRing(struct Async_Io_Ring *ring,
+                        struct Async_Io_Request *request);
+
+/**
+ *  @brief Wait for completions and process all the available ones.
+ *
+ *  Partial transfers are submitted again for the rest of their data.
+ *  @param queue  Queue to process
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int ReapFromRing(struct Async_Io_Queue *queue);
+#endif /* ASYNC_IO_HAS_URING */
+
+/****************************************************************************/
+
+int AsyncIoInit(struct Async_Io_Queue *queue, enum Async_Io_Backend backend) {
+    int status = EXIT_FAILURE;
+
+    if (NULL != queue) {
+        memset(queue, 0, sizeof(*queue));
+        queue->ring.fd = -1;
+#ifdef ASYNC_IO_HAS_URING
+        if (ASYNC_IO_BACKEND_THREADS != backend) {
+            status = InitRing(&(queue->ring));
+            queue->backend = ASYNC_IO_BACKEND_URING;
+        }
+#endif /* ASYNC_IO_HAS_URING */
+        if ((EXIT_FAILURE == status) &&
+            (ASYNC_IO_BACKEND_URING != backend)) {
+            status = InitThreads(queue);
+            queue->backend = ASYNC_IO_BACKEND_THREADS;
+        }
+    }
+
+    return status;
+}
+
+const char *AsyncIoGetBackendName(const struct Async_Io_Queue *queue) {
+    return (ASYNC_IO_BACKEND_URING == queue->backend) ? "uring" : "threads";
+}
+
+int AsyncIoSubmit(struct Async_Io_Queue *queue,
+                  struct Async_Io_Request *request,
+                  enum Async_Io_Operation operation,
+                  int fd,
+                  void *data,
+                  size_t count,
+                  off_t offset) {
+    int status = EXIT_SUCCESS;
+
+    if ((NULL == queue) || (NULL == request) || request->busy) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        memset(request, 0, sizeof(*request));
+        request->operation = operation;
+        request->fd = fd;
+        request->data = data;
+        request->count = count;
+        request->offset = offset;
+        request->status = EXIT_SUCCESS;
+    }
+
+    if ((EXIT_FAILURE == status) || (0 == count)) {
+        /* Nothing to transfer. */
+    }
+#ifdef ASYNC_IO_HAS_URING
+    else if (ASYNC_IO_BACKEND_URING == queue->backend) {
+        if (queue->in_flight >= ASYNC_IO_QUEUE_DEPTH) {
+            status = EXIT_FAILURE;
+        }
+        else {
+            status = SubmitToRing(&(queue->ring), request);
+        }
+        if (EXIT_SUCCESS == status) {
+            request->busy = true;
+            queue->in_flight++;
+        }
+    }
+#endif /* ASYNC_IO_HAS_URING */
+    else if (0 == queue->thread_count) {
+        TransferNow(request);
+    }
+    else {
+        pthread_mutex_lock(&(queue->lock));
+        if (queue->in_flight >= ASYNC_IO_QUEUE_DEPTH) {
+            status = EXIT_FAILURE;
+        }
+        else {
+            request->busy = true;
+            queue->in_flight++;
+            if (NULL == queue->last) {
+                queue->first = request;
+            }
+            else {
+                queue->last->next = request;
+            }
+            queue->last = request;
+            pthread_cond_signal(&(queue->queued));
+        }
+        pthread_mutex_unlock(&(queue->lock));
+    }
+
+    return status;
+}
+
+int AsyncIoWait(struct Async_Io_Queue *queue,
+                struct Async_Io_Request *request) {
+    int status = EXIT_SUCCESS;
+
+    if ((NULL == queue) || (NULL == request)) {
+        status = EXIT_FAILURE;
+    }
+#ifdef ASYNC_IO_HAS_URING
+    else if (ASYNC_IO_BACKEND_URING == queue->backend) {
+        while ((EXIT_SUCCESS == status) && request->busy) {
+            status = ReapFromRing(queue);
+        }
+    }
+#endif /* ASYNC_IO_HAS_URING */
+    else {
+        pthread_mutex_lock(&(queue->lock));
+        while (request->busy) {
+            pthread_cond_wait(&(queue->completed), &(queue->lock));
+        }
+        pthread_mutex_unlock(&(queue->lock));
+    }
+
+    if ((EXIT_SUCCESS == status) && (EXIT_FAILURE == request->status)) {
+        status = EXIT_FAILURE;
+    }
+
+    return status;
+}
+
+void AsyncIoFree(struct Async_Io_Queue *queue) {
+    size_t i = 0;
+
+    if (NULL == queue) {
+        /* Nothing to release. */
+    }
+#ifdef ASYNC_IO_HAS_URING
+    else if (ASYNC_IO_BACKEND_URING == queue->backend) {
+        while ((queue->in_flight > 0) &&
+               (EXIT_SUCCESS == ReapFromRing(queue))) {
+            continue;
+        }
+        FreeRing(&(queue->ring));
+    }
+#endif /* ASYNC_IO_HAS_URING */
+    else {
+        /* The workers go through the queued requests before stopping. */
+        pthread_mutex_lock(&(queue->lock));
+        queue->stopping = true;
+        pthread_cond_broadcast(&(queue->queued));
+        pthread_mutex_unlock(&(queue->lock));
+        for (i = 0; i < queue->thread_count; i++) {
+            pthread_join(queue->threads[i], NULL);
+        }
+        pthread_cond_destroy(&(queue->completed));
+        pthread_cond_destroy(&(queue->queued));
+        pthread_mutex_destroy(&(queue->lock));
+        queue->thread_count = 0;
+    }
+}
+
+static void TransferNow(struct Async_Io_Request *request) {
+    ssize_t result = 0;
+    bool complete = false;
+
+    while (!complete) {
+        if (ASYNC_IO_READ == request->operation) {
+            result = pread(request->fd, request->data + request->done,
+                           request->count - request->done,
+                           request->offset + request->done);
+        }
+        else {
+            result = pwrite(request->fd, request->data + request->done,
+                            request->count - request->done,
+                            request->offset + request->done);
+        }
+        complete = UpdateTransfer(request, (result < 0) ? -errno : result);
+    }
+}
+
+static bool UpdateTransfer(struct Async_Io_Request *request, ssize_t result) {
+    bool complete = true;
+
+    if ((-EINTR == result) || (-EAGAIN == result)) {
+        complete = false;
+    }
+    else if (result < 0) {
+        request->status = EXIT_FAILURE;
+    }
+    else if (0 == result) {
+        /* A read stops at the end of the file, a write can't. */
+        if (ASYNC_IO_WRITE == request->operation) {
+            request->status = EXIT_FAILURE;
+        }
+    }
+    else {
+        request->done += result;
+        complete = (request->done >= request->count);
+    }
+
+    return complete;
+}
+
+static void *RunWorker(void *queue) {
+    struct Async_Io_Queue *io = queue;
+    struct Async_Io_Request *request = NULL;
+
+    pthread_mutex_lock(&(io->lock));
+    while ((NULL != io->first) || (!io->stopping)) {
+        if (NULL == io->first) {
+            pthread_cond_wait(&(io->queued), &(io->lock));
+            continue;
+        }
+
+        request = io->first;
+        io->first = request->next;
+        if (NULL == io->first) {
+            io->last = NULL;
+        }
+        pthread_mutex_unlock(&(io->lock));
+
+        TransferNow(request);
+
+        pthread_mutex_lock(&(io->lock));
+        request->busy = false;
+        io->in_flight--;
+        pthread_cond_broadcast(&(io->completed));
+    }
+    pthread_mutex_unlock(&(io->lock));
+
+    return NULL;
+}
+
+static int InitThreads(struct Async_Io_Queue *queue) {
+    size_t i = 0;
+    int status = EXIT_SUCCESS;
+
+    if ((0 != pthread_mutex_init(&(queue->lock), NULL)) ||
+        (0 != pthread_cond_init(&(queue->queued), NULL)) ||
+        (0 != pthread_cond_init(&(queue->completed), NULL))) {
+        status = EXIT_FAILURE;
+    }
+
+    /* Without any worker, the requests run on submission. */
+    for (i = 0; (EXIT_SUCCESS == status) && (i < ASYNC_IO_THREAD_COUNT);
+         i++) {
+        if (0 == pthread_create(&(queue->threads[queue->thread_count]),
+                                NULL, RunWorker, queue)) {
+            queue->thread_count++;
+        }
+    }
+
+    return status;
+}
+
+#ifdef ASYNC_IO_HAS_URING
+static int InitRing(struct Async_Io_Ring *ring) {
+    struct io_uring_params params;
+    uint8_t *sq_ring = NULL;
+    uint8_t *cq_ring = NULL;
+    long fd = -1;
+    int status = EXIT_SUCCESS;
+
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+
+    fd = syscall(__NR_io_uring_setup, ASYNC_IO_QUEUE_DEPTH, &params);
+    if (fd < 0) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        ring->fd = fd;
+        ring->sq_ring_size = params.sq_off.array +
+                             params.sq_entries * sizeof(uint32_t);
+        ring->cq_ring_size = params.cq_off.cqes +
+                             params.cq_entries * sizeof(struct io_uring_cqe);
+        ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+        /* Recent kernels map both rings at once. */
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            if (ring->cq_ring_size > ring->sq_ring_size) {
+                ring->sq_ring_size = ring->cq_ring_size;
+            }
+            ring->cq_ring_size = 0;
+        }
+        ring->sq_ring = mmap(NULL, ring->sq_ring_size,
+                             PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring->fd,
+                             IORING_OFF_SQ_RING);
+        if (0 == ring->cq_ring_size) {
+            ring->cq_ring = ring->sq_ring;
+        }
+        else {
+            ring->cq_ring = mmap(NULL, ring->cq_ring_size,
+                                 PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, ring->fd,
+                                 IORING_OFF_CQ_RING);
+        }
+        ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring->fd,
+                          IORING_OFF_SQES);
+        if ((MAP_FAILED == ring->sq_ring) || (MAP_FAILED == ring->cq_ring) ||
+            (MAP_FAILED == ring->sqes)) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    if (EXIT_SUCCESS == status) {
+        sq_ring = ring->sq_ring;
+        cq_ring = ring->cq_ring;
+        ring->sq_head = (uint32_t *) (sq_ring + params.sq_off.head);
+        ring->sq_tail = (uint32_t *) (sq_ring + params.sq_off.tail);
+        ring->sq_array = (uint32_t *) (sq_ring + params.sq_off.array);
+        ring->sq_mask = *(uint32_t *) (sq_ring + params.sq_off.ring_mask);
+        ring->sq_entries = params.sq_entries;
+        ring->cq_head = (uint32_t *) (cq_ring + params.cq_off.head);
+        ring->cq_tail = (uint32_t *) (cq_ring + params.cq_off.tail);
+        ring->cq_mask = *(uint32_t *) (cq_ring + params.cq_off.ring_mask);
+        ring->cqes = cq_ring + params.cq_off.cqes;
+    }
+    else {
+        FreeRing(ring);
+    }
+
+    return status;
+}
+
+static void FreeRing(struct Async_Io_Ring *ring) {
+    if ((NULL != ring->sqes) && (MAP_FAILED != ring->sqes)) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if ((0 != ring->cq_ring_size) && (NULL != ring->cq_ring) &&
+        (MAP_FAILED != ring->cq_ring)) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if ((NULL != ring->sq_ring) && (MAP_FAILED != ring->sq_ring)) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+static int SubmitToRing(struct Async_Io_Ring *ring,
+                        struct Async_Io_Request *request) {
+    struct io_uring_sqe *sqe = NULL;
+    size_t count = request->count - request->done;
+    uint32_t tail = *(ring->sq_tail);
+    uint32_t index = tail & ring->sq_mask;
+    long result = 0;
+    int status = EXIT_SUCCESS;
+
+    if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >=
+        ring->sq_entries) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        sqe = (struct io_uring_sqe *) ring->sqes + index;
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = (ASYNC_IO_READ == request->operation) ?
+                      IORING_OP_READ : IORING_OP_WRITE;
+        sqe->fd = request->fd;
+        sqe->addr = (uintptr_t) (request->data + request->done);
+        sqe->len = (count < ASYNC_IO_MAX_TRANSFER) ? count :
+                                                     ASYNC_IO_MAX_TRANSFER;
+        sqe->off = request->offset + request->done;
+        sqe->user_data = (uintptr_t) request;
+        ring->sq_array[index] = index;
+
+        /* The entry must be visible before the kernel sees the tail. */
+        __atomic_store_n(ring->sq_tail, tail + 1U, __ATOMIC_RELEASE);
+        do {
+            result = syscall(__NR_io_uring_enter, ring->fd, 1U, 0U, 0U,
+                             NULL, 0U);
+        } while ((result < 0) && (EINTR == errno));
+        if (1 != result) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    return status;
+}
+
+static int ReapFromRing(struct Async_Io_Queue *queue) {
+    struct Async_Io_Ring *ring = &(queue->ring);
+    struct io_uring_cqe *cqe = NULL;
+    struct Async_Io_Request *request = NULL;
+    uint32_t head = *(ring->cq_head);
+    uint32_t tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    long result = 0;
+    bool complete = false;
+    int status = EXIT_SUCCESS;
+
+    while ((EXIT_SUCCESS == status) && (head == tail)) {
+        result = syscall(__NR_io_uring_enter, ring->fd, 0U, 1U,
+                         IORING_ENTER_GETEVENTS, NULL, 0U);
+        if ((result < 0) && (EINTR != errno)) {
+            status = EXIT_FAILURE;
+        }
+        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    }
+
+    for (; (EXIT_SUCCESS == status) && (head != tail); head++) {
+        cqe = (struct io_uring_cqe *) ring->cqes + (head & ring->cq_mask);
+        request = (struct Async_Io_Request *) (uintptr_t) cqe->user_data;
+        result = cqe->res;
+
+        /* Free the entry before submitting the rest of the request. */
+        __atomic_store_n(ring->cq_head, head + 1U, __ATOMIC_RELEASE);
+        complete = UpdateTransfer(request, result);
+        if ((!complete) && (EXIT_FAILURE == SubmitToRing(ring, request))) {
+            request->status = EXIT_FAILURE;
+            complete = true;
+        }
+        if (complete) {
+            request->busy = false;
+            queue->in_flight--;
+        }
+    }
+
+    return status;
+}
+#endif /* ASYNC_IO_HAS_URING */
@@ -5,10 +5,50 @@
  
 #include "bitmap.h"
  
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
+/****************************************************************************
+ * LOCAL DECLARATIONS
+ ****************************************************************************/
+/**
+ *  @brief Allocate memory from an arena block, if it fits.
+ *
+ *  @param block  Block to allocate from
+ *  @param size   Number of bytes
+ *
+ *  @return The allocated memory, if it fits.
+ *          NULL, otherwise.
+ */
+static void *AllocFromBlock(struct Bitmap_Arena_Block *block, size_t size);
+
+/**
+ *  @brief Allocate a new arena block.
+ *
+ *  @param size  Minimum usable size
+ *
+ *  @return The new block, if successful.
+ *          NULL, if not successful.
+ */
+static struct Bitmap_Arena_Block *AllocBlock(size_t size);
+
+/**
+ *  @brief Count the pixels equal to the one at a given position.
+ *
+ *  @param row       Row pixels
+ *  @param position  First pixel of the run
+ *  @param width     Number of row pixels
+ *
+ *  @return The run length (up to 255 pixels, the RLE8 limit).
+ */
+static size_t GetRunLength(const uint8_t *row, size_t position,
+                           size_t width);
+
+/****************************************************************************/
+
 #ifdef USE_COLOR_TABLE
-int BitmapInit8BitGrayscale(struct Bitmap **bitmap) {
+int BitmapInit8BitGrayscale(struct Bitmap **bitmap, uint32_t compression) {
     int status = EXIT_SUCCESS;
     unsigned i = 0U;
     struct Bitmap_ColorEntry *color_table = NULL;
@@ -22,27 +62,30 @@ int BitmapInit8BitGrayscale(struct Bitmap **bitmap) {
         .header_size = sizeof(struct Bitmap_Info_Header),
         .planes_count = 1U,
         .bit_depth = 8U,
-        /* TODO: Add compression support */
-        .compression = 0,
+        .compression = compression,
         .colors_used = 256U,
     };
     
     if (NULL == bitmap) {
         status = EXIT_FAILURE;
     }
-    
-    *bitmap = malloc(sizeof(struct Bitmap));
-    (*bitmap)->color_table = malloc(256U * sizeof(struct Bitmap_ColorEntry));
-    color_table = (*bitmap)->color_table;
-
-    if ((NULL == (*bitmap)) ||
-        (NULL == color_table)) {
-        status = EXIT_FAILURE;
-    }
     else {
+        *bitmap = malloc(sizeof(struct Bitmap));
+        color_table = malloc(256U * sizeof(struct Bitmap_ColorEntry));
+        if ((NULL == (*bitmap)) || (NULL == color_table)) {
+            free(*bitmap);
+            free(color_table);
+            *bitmap = NULL;
+            status = EXIT_FAILURE;
+        }
+    }
+
+    if (EXIT_SUCCESS == status) {
         /* Populate only static fields */
         memcpy((*bitmap), &header, sizeof(header));
         memcpy(&((*bitmap)->info_header), &info_header, sizeof(info_header));
+        (*bitmap)->color_table = color_table;
+        (*bitmap)->pixel_data = NULL;
 
         /* Create color table containing the 8-bit gray color palette. */
         for (i = 0; i < 256; i++) {
@@ -57,23 +100,88 @@ int BitmapInit8BitGrayscale(struct Bitmap **bitmap) {
 }
 #endif /* USE_COLOR_TABLE */
 
+void BitmapArenaInit(struct Bitmap_Arena *arena) {
+    arena->blocks = NULL;
+}
+
+void *BitmapArenaAlloc(struct Bitmap_Arena *arena, size_t size) {
+    struct Bitmap_Arena_Block *block = NULL;
+    void *memory = NULL;
+
+    if (NULL != arena) {
+        if (NULL != arena->blocks) {
+            memory = AllocFromBlock(arena->blocks, size);
+        }
+        if (NULL == memory) {
+            block = AllocBlock(size);
+            if (NULL != block) {
+                block->next = arena->blocks;
+                arena->blocks = block;
+                memory = AllocFromBlock(block, size);
+            }
+        }
+    }
+
+    return memory;
+}
+
+void BitmapArenaReset(struct Bitmap_Arena *arena) {
+    struct Bitmap_Arena_Block *block = NULL;
+    size_t total = 0;
+
+    if ((NULL != arena) && (NULL != arena->blocks)) {
+        if (NULL == arena->blocks->next) {
+            arena->blocks->used = 0;
+        }
+        else {
+            /* Merge the blocks, so the next frame fits in a single one. */
+            while (NULL != arena->blocks) {
+                block = arena->blocks;
+                arena->blocks = block->next;
+                total += block->used + BITMAP_ARENA_ALIGNMENT;
+                free(block);
+            }
+
+            /* If this fails, the next allocation simply tries again. */
+            arena->blocks = AllocBlock(total);
+        }
+    }
+}
+
+void BitmapArenaFree(struct Bitmap_Arena *arena) {
+    struct Bitmap_Arena_Block *block = NULL;
+
+    if (NULL != arena) {
+        while (NULL != arena->blocks) {
+            block = arena->blocks;
+            arena->blocks = block->next;
+            free(block);
+        }
+    }
+}
+
 int BitmapSetWidthHeight(struct Bitmap *bitmap, 
-                         uint16_t width,
-                         uint16_t height) {
+                         uint32_t width,
+                         uint32_t height) {
+    uint64_t stride = 0;
     int status = EXIT_SUCCESS;
     
     if (NULL == bitmap) {
         status = EXIT_FAILURE;
     }
     else {
-        if (width % 4 != 0) {
+        /* Each row is padded to a whole number of 32-bit words. */
+        stride = ((uint64_t) width * bitmap->info_header.bit_depth + 31U) /
+                 32U * 4U;
+        if (stride * height >
+            UINT32_MAX - bitmap->header.pixel_data_offset) {
             status = EXIT_FAILURE;
         }
         else {
-            bitmap->info_header.image_size = width * height;
+            bitmap->info_header.image_size = stride * height;
             bitmap->info_header.width = width;
             bitmap->info_header.height = height;
-            bitmap->header.file_size = width * height + 
+            bitmap->header.file_size = bitmap->info_header.image_size + 
                                        bitmap->header.pixel_data_offset;
         }
     }
@@ -81,6 +189,27 @@ int BitmapSetWidthHeight(struct Bitmap *bitmap,
     return status;
 }
 
+int BitmapSetImageSize(struct Bitmap *bitmap, size_t size) {
+    int status = EXIT_SUCCESS;
+
+    if ((NULL == bitmap) ||
+        (size > UINT32_MAX - bitmap->header.pixel_data_offset)) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        bitmap->info_header.image_size = size;
+        bitmap->header.file_size = bitmap->info_header.image_size +
+                                   bitmap->header.pixel_data_offset;
+    }
+
+    return status;
+}
+
+uint32_t BitmapGetStride(const struct Bitmap *bitmap) {
+    return ((uint64_t) bitmap->info_header.width *
+            bitmap->info_header.bit_depth + 31U) / 32U * 4U;
+}
+
 uint32_t BitmapGetPixelData(const struct Bitmap *bitmap,
                             union Raw_Pixel_Data **data) {
     /* TODO */
@@ -88,31 +217,194 @@ uint32_t BitmapGetPixelData(const struct Bitmap *bitmap,
     return 0;
 }
 
-int BitmapFillPixelData(struct Bitmap *bitmap, union Raw_Pixel_Data *data) {
-    uint32_t i = 0;
+int BitmapFillPixelData(struct Bitmap *bitmap,
+                        const void *data,
+                        struct Bitmap_Arena *arena) {
     int status = EXIT_SUCCESS;
 
-    if ((NULL == bitmap) || (NULL == data)) {
+    if ((NULL == bitmap) || (NULL == data) ||
+        ((8U != bitmap->info_header.bit_depth) &&
+         (16U != bitmap->info_header.bit_depth))) {
        status = EXIT_FAILURE; 
     }
     else {
-        bitmap->pixel_data = malloc(bitmap->info_header.image_size);
+        bitmap->pixel_data = BitmapArenaAlloc(arena,
+                                              bitmap->info_header.image_size);
 
         if (NULL == bitmap->pixel_data) {
             status = EXIT_FAILURE;
         }
         else {
-            for (i = 0; i < bitmap->info_header.image_size; i++) {
-                if (8U == bitmap->info_header.bit_depth) {
-                    ((uint8_t *) bitmap->pixel_data)[i] = data[i].u8;
+            /* Both depths are stored as they are, no conversion needed. */
+            memcpy(bitmap->pixel_data, data, bitmap->info_header.image_size);
+        }
+    }
+    
+    return status;
+}
+
+size_t BitmapGetFormatSize(enum Bitmap_Format format, size_t size) {
+    size_t bytes = size;
+
+    if (BITMAP_FORMAT_PGM == format) {
+        bytes = size * sizeof(uint16_t);
+    }
+    else if (BITMAP_FORMAT_RAW12 == format) {
+        bytes = (size / 2U + size % 2U) * 3U;
+    }
+
+    return bytes;
+}
+
+const char *BitmapGetFormatExtension(enum Bitmap_Format format) {
+    const char *extension = "bmp";
+
+    if (BITMAP_FORMAT_PGM == format) {
+        extension = "pgm";
+    }
+    else if (BITMAP_FORMAT_RAW12 == format) {
+        extension = "raw12";
+    }
+
+    return extension;
+}
+
+size_t BitmapFormatPgmHeader(uint32_t width, uint32_t height, char *header) {
+    int length = snprintf(header, BITMAP_PGM_HEADER_SIZE,
+                          "P5\n%u %u\n65535\n", width, height);
+
+    return (length > 0) ? (size_t) length : 0;
+}
+
+void BitmapSwap16Bit(const uint16_t *data, size_t size, uint8_t *out) {
+    size_t i = 0;
+
+#if defined(__BYTE_ORDER__) && (__ORDER_BIG_ENDIAN__ == __BYTE_ORDER__)
+    memcpy(out, data, size * sizeof(data[0]));
+    (void) i;
+#else
+    for (i = 0; i < size; i++) {
+        out[2U * i] = data[i] >> 8;
+        out[2U * i + 1U] = data[i] & 0xFFU;
+    }
+#endif
+}
+
+void BitmapPack12Bit(const uint16_t *data, size_t size, uint8_t *out) {
+    uint16_t first = 0;
+    uint16_t second = 0;
+    size_t i = 0;
+
+    for (i = 0; i < size; i += 2U) {
+        first = data[i] >> 4;
+        second = (i + 1U < size) ? (data[i + 1U] >> 4) : 0;
+        out[0] = first >> 4;
+        out[1] = second >> 4;
+        out[2] = (uint8_t) (((second & 0x0FU) << 4) | (first & 0x0FU));
+        out += 3;
+    }
+}
+
+size_t BitmapEncodeRle8Row(const uint8_t *row, uint32_t width, bool last,
+                           uint8_t *out) {
+    uint8_t *start = out;
+    size_t position = 0;
+    size_t count = 0;
+    size_t run = 0;
+    size_t i = 0;
+
+    while (position < width) {
+        run = GetRunLength(row, position, width);
+        if (run >= 3U) {
+            /* Encoded mode: the run length, then the pixel value. */
+            *out++ = run;
+            *out++ = row[position];
+            position += run;
+        }
+        else {
+            /* Gather the pixels up to the next run worth encoding. */
+            for (count = 0; (position + count < width) && (count < 255U);
+                 count += run) {
+                run = GetRunLength(row, position + count, width);
+                if ((run >= 3U) || (count + run > 255U)) {
+                    break;
                 }
-                else {
-                    /* TODO */
-                    status = EXIT_FAILURE;
+            }
+            if (count >= 3U) {
+                /* Absolute mode, padded to a 16-bit word. */
+                *out++ = 0;
+                *out++ = count;
+                memcpy(out, &row[position], count);
+                out += count;
+                if (0 != count % 2U) {
+                    *out++ = 0;
                 }
             }
+            else {
+                for (i = 0; i < count; i++) {
+                    *out++ = 1U;
+                    *out++ = row[position + i];
+                }
+            }
+            position += count;
         }
     }
-    
-    return status;
+
+    /* End of line, or end of bitmap. */
+    *out++ = 0;
+    *out++ = last ? 1U : 0;
+
+    return out - start;
+}
+
+static void *AllocFromBlock(struct Bitmap_Arena_Block *block, size_t size) {
+    uint8_t *data = (uint8_t *) (block + 1);
+    uintptr_t start = (uintptr_t) (data + block->used);
+    size_t offset = 0;
+    void *memory = NULL;
+
+    /* Round the start up to the alignment. */
+    start = (start + BITMAP_ARENA_ALIGNMENT - 1U) &
+            ~((uintptr_t) BITMAP_ARENA_ALIGNMENT - 1U);
+    offset = start - (uintptr_t) data;
+
+    if ((offset <= block->size) && (size <= block->size - offset)) {
+        memory = data + offset;
+        block->used = offset + size;
+    }
+
+    return memory;
+}
+
+static struct Bitmap_Arena_Block *AllocBlock(size_t size) {
+    struct Bitmap_Arena_Block *block = NULL;
+
+    /* Leave room for aligning the first allocation. */
+    if (size <= SIZE_MAX - sizeof(*block) - BITMAP_ARENA_ALIGNMENT) {
+        size += BITMAP_ARENA_ALIGNMENT;
+        if (size < BITMAP_ARENA_BLOCK_SIZE) {
+            size = BITMAP_ARENA_BLOCK_SIZE;
+        }
+        block = malloc(sizeof(*block) + size);
+    }
+
+    if (NULL != block) {
+        block->next = NULL;
+        block->size = size;
+        block->used = 0;
+    }
+
+    return block;
+}
+
+static size_t GetRunLength(const uint8_t *row, size_t position,
+                           size_t width) {
+    size_t run = 1U;
+
+    while ((position + run < width) && (run < 255U) &&
+           (row[position + run] == row[position])) {
+        run++;
+    }
+
+    return run;
 }
@@ -0,0 +1,395 @@
+/**
+ *  @brief Fast compression codecs implementation file.
+ *
+ */
+
+#include "codec.h"
+
+#include "parallel.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS
+ ****************************************************************************/
+/* LZ4 frame magic number. */
+#define LZ4_MAGIC 0x184D2204U
+
+/* Frame descriptor: version 1 and independent blocks, without checksums or
+   content size, 4 MiB blocks, then the second byte of the XXH32 hash of
+   these two bytes, which never changes. */
+#define LZ4_FLAGS 0x60U
+#define LZ4_BLOCK_DESCRIPTOR 0x70U
+#define LZ4_HEADER_CHECKSUM 0x73U
+
+/* Block size flag marking a block stored as it is. */
+#define LZ4_UNCOMPRESSED 0x80000000U
+
+/* Sequence limits of the block format: the matches are at least 4 bytes
+   long and 65535 bytes away, the last one starts 12 bytes before the end
+   of the block at the latest and the last 5 bytes are literals. */
+#define LZ4_MIN_MATCH 4U
+#define LZ4_MAX_OFFSET 0xFFFFU
+#define LZ4_MATCH_LIMIT 12U
+#define LZ4_LAST_LITERALS 5U
+
+/* Misses after which the match search skips ahead faster (as a power of
+   2), so that incompressible data goes through quickly. */
+#define LZ4_SKIP_TRIGGER 6U
+
+/****************************************************************************
+ * TYPE DEFINITIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Compression work of one thread.
+ */
+struct Lz4_Task {
+    const uint8_t *data;        /* Input bytes */
+    size_t size;                /* Number of input bytes */
+    size_t first;               /* First block of the thread */
+    size_t step;                /* Distance to its next block */
+    uint32_t *table;            /* Hash table of the thread */
+    uint8_t *out;               /* Output, each block at its bound offset */
+    size_t *sizes;              /* Output size of each block */
+};
+
+/****************************************************************************
+ * LOCAL DECLARATIONS
+ ****************************************************************************/
+/**
+ *  @brief Compress the blocks of one thread.
+ *
+ *  @param task  Thread work (struct Lz4_Task)
+ *
+ *  @return none
+ */
+static void CompressTask(void *task);
+
+/**
+ *  @brief Compress one block, or store it as it is.
+ *
+ *  @param data   Block bytes
+ *  @param size   Block size (up to CODEC_LZ4_BLOCK_SIZE)
+ *  @param table  Hash table
+ *  @param out    Output block, its size first (size + 4 bytes)
+ *
+ *  @return The output block size.
+ */
+static size_t CompressBlock(const uint8_t *data,
+                            size_t size,
+                            uint32_t *table,
+                            uint8_t *out);
+
+/**
+ *  @brief Encode the sequences of a block.
+ *
+ *  @param data      Block bytes
+ *  @param size      Block size
+ *  @param table     Hash table
+ *  @param out       Output sequences
+ *  @param capacity  Output space
+ *
+ *  @return The size of the sequences, if they fit.
+ *          0, otherwise.
+ */
+static size_t EncodeSequences(const uint8_t *data,
+                              size_t size,
+                              uint32_t *table,
+                              uint8_t *out,
+                              size_t capacity);
+
+/**
+ *  @brief Encode one sequence: literals, then an optional match.
+ *
+ *  @param literals  Literal bytes
+ *  @param count     Number of literals
+ *  @param offset    Match distance (0 for the last sequence, without one)
+ *  @param length    Match length
+ *  @param out       Output position
+ *  @param end       Output end
+ *
+ *  @return The position after the sequence, if it fits.
+ *          NULL, otherwise.
+ */
+static uint8_t *EncodeSequence(const uint8_t *literals,
+                               size_t count,
+                               size_t offset,
+                               size_t length,
+                               uint8_t *out,
+                               const uint8_t *end);
+
+/**
+ *  @brief Encode the extra bytes of a sequence length.
+ *
+ *  @param length  Length left past the token nibble
+ *  @param out     Output position
+ *
+ *  @return The position after the length bytes.
+ */
+static uint8_t *EncodeLength(size_t length, uint8_t *out);
+
+/**
+ *  @brief Hash the bytes starting at a given position.
+ *
+ *  Eight bytes are read, so the position must be at least that far from
+ *  the end of the block.
+ *  @param data  Input position
+ *
+ *  @return The hash table entry.
+ */
+static uint32_t HashPosition(const uint8_t *data);
+
+/**
+ *  @brief Write a 32-bit little-endian integer.
+ *
+ *  @param value  Integer to write
+ *  @param out    Output bytes
+ *
+ *  @return none
+ */
+static void WriteLittleEndian32(uint32_t value, uint8_t *out);
+
+/****************************************************************************/
+
+size_t CodecLz4GetBound(size_t size) {
+    /* Each block holds at most its input, after its 4-byte size. */
+    return size + (size + CODEC_LZ4_BLOCK_SIZE - 1U) /
+                  CODEC_LZ4_BLOCK_SIZE * sizeof(uint32_t);
+}
+
+size_t CodecLz4WriteHeader(uint8_t *out) {
+    WriteLittleEndian32(LZ4_MAGIC, out);
+    out[4] = LZ4_FLAGS;
+    out[5] = LZ4_BLOCK_DESCRIPTOR;
+    out[6] = LZ4_HEADER_CHECKSUM;
+
+    return CODEC_LZ4_HEADER_SIZE;
+}
+
+size_t CodecLz4WriteEnd(uint8_t *out) {
+    WriteLittleEndian32(0, out);
+
+    return CODEC_LZ4_END_SIZE;
+}
+
+int CodecLz4Compress(const void *data,
+                     size_t size,
+                     size_t thread_count,
+                     uint32_t *tables,
+                     uint8_t *out,
+                     size_t *out_size) {
+    struct Lz4_Task tasks[PARALLEL_MAX_THREADS];
+    size_t block_count = (size + CODEC_LZ4_BLOCK_SIZE - 1U) /
+                         CODEC_LZ4_BLOCK_SIZE;
+    size_t *sizes = NULL;
+    size_t i = 0;
+    int status = EXIT_SUCCESS;
+
+    *out_size = 0;
+    if (thread_count > block_count) {
+        thread_count = block_count;
+    }
+
+    sizes = malloc((block_count + 1U) * sizeof(sizes[0]));
+    if ((NULL == sizes) || (thread_count > PARALLEL_MAX_THREADS)) {
+        status = EXIT_FAILURE;
+    }
+
+    for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+        tasks[i].data = data;
+        tasks[i].size = size;
+        tasks[i].first = i;
+        tasks[i].step = thread_count;
+        tasks[i].table = &tables[i << CODEC_LZ4_HASH_BITS];
+        tasks[i].out = out;
+        tasks[i].sizes = sizes;
+    }
+    if ((EXIT_SUCCESS == status) && (thread_count > 0)) {
+        status = ParallelRun(CompressTask, tasks, sizeof(tasks[0]),
+                             thread_count);
+    }
+
+    /* Each block starts at its bound offset, they now move up together. */
+    for (i = 0; (EXIT_SUCCESS == status) && (i < block_count); i++) {
+        memmove(out + *out_size,
+                out + i * (CODEC_LZ4_BLOCK_SIZE + sizeof(uint32_t)),
+                sizes[i]);
+        *out_size += sizes[i];
+    }
+
+    free(sizes);
+
+    return status;
+}
+
+static void CompressTask(void *task) {
+    struct Lz4_Task *lz4 = task;
+    size_t offset = 0;
+    size_t i = 0;
+
+    for (i = lz4->first; i * CODEC_LZ4_BLOCK_SIZE < lz4->size;
+         i += lz4->step) {
+        offset = i * CODEC_LZ4_BLOCK_SIZE;
+        lz4->sizes[i] = CompressBlock(lz4->data + offset,
+                                      (lz4->size - offset <
+                                       CODEC_LZ4_BLOCK_SIZE) ?
+                                      lz4->size - offset :
+                                      CODEC_LZ4_BLOCK_SIZE,
+                                      lz4->table,
+                                      lz4->out + i * (CODEC_LZ4_BLOCK_SIZE +
+                                                      sizeof(uint32_t)));
+    }
+}
+
+static size_t CompressBlock(const uint8_t *data,
+                            size_t size,
+                            uint32_t *table,
+                            uint8_t *out) {
+    size_t length = 0;
+
+    /* Anything not smaller than the input is stored as it is. */
+    length = EncodeSequences(data, size, table, out + sizeof(uint32_t),
+                             size - 1U);
+    if (0 == length) {
+        memcpy(out + sizeof(uint32_t), data, size);
+        WriteLittleEndian32(size | LZ4_UNCOMPRESSED, out);
+        length = size;
+    }
+    else {
+        WriteLittleEndian32(length, out);
+    }
+
+    return length + sizeof(uint32_t);
+}
+
+static size_t EncodeSequences(const uint8_t *data,
+                              size_t size,
+                              uint32_t *table,
+                              uint8_t *out,
+                              size_t capacity) {
+    const uint8_t *end = out + capacity;
+    uint8_t *position = out;
+    uint32_t value = 0;
+    uint32_t candidate_value = 0;
+    size_t anchor = 0;
+    size_t candidate = 0;
+    size_t length = 0;
+    size_t misses = 0;
+    size_t hash = 0;
+    size_t i = 0;
+
+    memset(table, 0, sizeof(uint32_t) << CODEC_LZ4_HASH_BITS);
+
+    /* A block too short for any match is all literals. */
+    while ((NULL != position) && (size > LZ4_MATCH_LIMIT) &&
+           (i <= size - LZ4_MATCH_LIMIT)) {
+        hash = HashPosition(&data[i]);
+        candidate = table[hash];
+        table[hash] = i;
+        memcpy(&value, &data[i], sizeof(value));
+        memcpy(&candidate_value, &data[candidate], sizeof(candidate_value));
+
+        if ((candidate < i) && (i - candidate <= LZ4_MAX_OFFSET) &&
+            (value == candidate_value)) {
+            /* Take in the equal bytes before and after the first four. */
+            while ((i > anchor) && (candidate > 0) &&
+                   (data[i - 1U] == data[candidate - 1U])) {
+                i--;
+                candidate--;
+            }
+            length = LZ4_MIN_MATCH;
+            while ((i + length < size - LZ4_LAST_LITERALS) &&
+                   (data[candidate + length] == data[i + length])) {
+                length++;
+            }
+
+            position = EncodeSequence(&data[anchor], i - anchor,
+                                      i - candidate, length, position, end);
+            i += length;
+            anchor = i;
+            misses = 0;
+
+            /* Keep a position from the end of the match searchable. */
+            if (i - 2U <= size - LZ4_MATCH_LIMIT) {
+                table[HashPosition(&data[i - 2U])] = i - 2U;
+            }
+        }
+        else {
+            i += 1U + (misses++ >> LZ4_SKIP_TRIGGER);
+        }
+    }
+
+    if (NULL != position) {
+        position = EncodeSequence(&data[anchor], size - anchor, 0, 0,
+                                  position, end);
+    }
+
+    return (NULL != position) ? (size_t) (position - out) : 0;
+}
+
+static uint8_t *EncodeSequence(const uint8_t *literals,
+                               size_t count,
+                               size_t offset,
+                               size_t length,
+                               uint8_t *out,
+                               const uint8_t *end) {
+    /* Token, literal length bytes, then the offset and match length. */
+    size_t needed = 1U + count / 255U + 1U + count +
+                    ((0 != offset) ? 2U + length / 255U + 1U : 0);
+    uint8_t *token = out;
+
+    if (needed > (size_t) (end - out)) {
+        out = NULL;
+    }
+    else {
+        *token = (count < 15U) ? (count << 4) : 0xF0U;
+        out = token + 1;
+        if (count >= 15U) {
+            out = EncodeLength(count - 15U, out);
+        }
+        memcpy(out, literals, count);
+        out += count;
+
+        if (0 != offset) {
+            out[0] = offset & 0xFFU;
+            out[1] = offset >> 8;
+            out += 2;
+            length -= LZ4_MIN_MATCH;
+            *token |= (length < 15U) ? length : 0x0FU;
+            if (length >= 15U) {
+                out = EncodeLength(length - 15U, out);
+            }
+        }
+    }
+
+    return out;
+}
+
+static uint8_t *EncodeLength(size_t length, uint8_t *out) {
+    for (; length >= 255U; length -= 255U) {
+        *out++ = 255U;
+    }
+    *out++ = length;
+
+    return out;
+}
+
+static uint32_t HashPosition(const uint8_t *data) {
+    uint64_t value = 0;
+
+    memcpy(&value, data, sizeof(value));
+
+    /* Multiplicative hash of the first five bytes (on little-endian hosts,
+       the others hash different bytes, which is just as valid), as the
+       reference encoder does on 64-bit hosts. */
+    return ((value << 24) * 889523592379ULL) >> (64U - CODEC_LZ4_HASH_BITS);
+}
+
+static void WriteLittleEndian32(uint32_t value, uint8_t *out) {
+    out[0] = value & 0xFFU;
+    out[1] = (value >> 8) & 0xFFU;
+    out[2] = (value >> 16) & 0xFFU;
+    out[3] = value >> 24;
+}
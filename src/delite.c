@@ -0,0 +1,5273 @@
+/**
+ *  @brief Delite library implementation file.
+ *
+ */
+
+#include "delite.h"
+
+#include "async_io.h"
+#include "bitmap.h"
+#include "codec.h"
+#include "frame.h"
+#include "kernels.h"
+#include "parallel.h"
+#include "selection.h"
+#include "stats.h"
+
+/* System includes */
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS
+ ****************************************************************************/
+/* Widest square preview whose bitmap file size still fits on 32 bits. */
+#define PREVIEW_MAX_WIDTH 65532U
+
+/* Chunks in use by the streaming mode: one being read, one being
+   processed and one whose outputs are being written. */
+#define STREAM_BUFFER_COUNT 3U
+
+/* The frame is split between the threads in stripes of this many pixels.
+   Each stripe maps onto a single dirty map byte, so no two threads ever
+   update the same one. */
+#define THREAD_STRIPE_SIZE (8U * FRAME_BLOCK_SIZE / sizeof(uint16_t))
+
+/* Pixels adjusted, written out and converted at once by the fused pass.
+   At 128 KiB, the tile is still in the cache for the last step. */
+#define FUSED_TILE_SIZE (32U * FRAME_BLOCK_SIZE / sizeof(uint16_t))
+
+/* Frame tiles compared with the previous frame by the sequence mode. Each
+   tile is a thread stripe, so it also maps onto a single dirty map byte. */
+#define SEQUENCE_TILE_SIZE THREAD_STRIPE_SIZE
+
+/****************************************************************************
+ * TYPE DEFINITIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Share of a batch processed by one worker thread.
+ */
+struct Batch_Worker {
+    char **paths;               /* Input file paths */
+    size_t count;               /* Number of input files */
+    size_t first;               /* First file processed by the worker */
+    size_t step;                /* Distance to the next file */
+    const char *preview_pattern;        /* Preview path pattern */
+    const char *altered_pattern;        /* Adjusted data path pattern */
+    struct Delite_Context context;      /* Worker context */
+    struct Stats stats;         /* Worker statistics */
+    size_t failed;              /* Number of files which failed */
+};
+
+/**
+ *  @brief State of a threshold adjustment over consecutive pixel chunks.
+ *
+ *  The equal pixels are counted across chunks, so the tie-break policy
+ *  gives the same result no matter how the frame is split.
+ */
+struct Adjustment_Sweep {
+    struct Selection_Threshold threshold; /* Selection threshold */
+    float factor;               /* Adjustment factor */
+    size_t equal_skip;          /* Equal pixels to leave untouched first */
+    size_t equal_lowest;        /* Position of the lowest ranked equal pixel */
+    size_t equal_seen;          /* Equal pixels seen so far */
+    size_t repeats;             /* Extra adjustments of the lowest ranked */
+};
+
+/**
+ *  @brief Detection and adjustment work over one frame partition.
+ */
+struct Adjustment_Task {
+    uint16_t *data;             /* Partition pixel data */
+    size_t size;                /* Partition size */
+    size_t offset;              /* Index of the first partition pixel */
+    const struct Frame *source; /* Frame to decode the partition from on
+                                   the first pass (NULL if decoded) */
+    size_t pixel_count;         /* Number of pixels to select */
+    enum Selection_Engine engine;       /* Heap or histogram */
+    enum Selection_Tie_Break tie_break; /* Tie-break policy */
+    size_t *histogram;          /* Partition histogram */
+    struct Selection_Heap heap; /* Partition heap */
+    struct Adjustment_Sweep sweep;      /* Partition sweep state */
+    uint8_t *dirty_map;         /* Partition dirty map (may be NULL) */
+    size_t adjusted;            /* Number of pixels adjusted */
+    int status;                 /* Detection result */
+};
+
+/**
+ *  @brief Preview conversion work over one frame partition.
+ */
+struct Downscale_Task {
+    const uint16_t *data;       /* First partition row */
+    size_t frame_width;         /* Frame row width in pixels */
+    size_t width;               /* Preview row width in pixels */
+    size_t scale;               /* Downsampling factor */
+    size_t rows;                /* Number of partition preview rows */
+    uint8_t *out;               /* First partition preview row */
+    size_t stride;              /* Preview row size in bytes */
+    enum Bitmap_Format format;  /* Preview image layout */
+    uint32_t *sums;             /* Column sums of one preview row */
+    uint16_t *averages;         /* Box averages of one preview row */
+    uint8_t *encoded;           /* End of the partition RLE8 rows (NULL if
+                                   uncompressed, out then holds one row) */
+    bool last;                  /* Whether the partition ends the preview */
+};
+
+/**
+ *  @brief Preview pyramid tiles of one level built by one thread.
+ *
+ *  The threads take the level tiles round-robin, each tile being
+ *  averaged from the previous level, then converted and written out
+ *  while it is still in the cache.
+ */
+struct Pyramid_Task {
+    const uint16_t *source;     /* Previous level (the frame for level 0) */
+    size_t source_width;        /* Previous level width in pixels */
+    size_t source_height;       /* Previous level height in pixels */
+    uint16_t *level;            /* Level pixels (NULL for level 0, the
+                                   frame being taken as it is) */
+    size_t width;               /* Level width in pixels */
+    size_t height;              /* Level height in pixels */
+    size_t first;               /* First tile built by the thread */
+    size_t step;                /* Distance to the next tile */
+    const char *directory;      /* Level directory */
+    const struct Bitmap *preview;       /* Preview bitmap template */
+    enum Bitmap_Format format;  /* Tile image layout */
+    uint8_t *pixel_data;        /* Pixel data of one tile */
+    uint8_t *row;               /* Converted row of one RLE8 tile */
+    size_t written;             /* Number of bytes written */
+    int status;                 /* Processing result */
+};
+
+/**
+ *  @brief Slice previews of a volume written by one thread.
+ *
+ *  The threads claim the slices one at a time from a shared counter, so
+ *  a thread held up by a slow write leaves the remaining slices to the
+ *  others, and each slice is converted and written out by the thread
+ *  claiming it while it is still in the cache.
+ */
+struct Volume_Task {
+    const uint16_t *data;       /* Volume pixel data */
+    size_t slice_size;          /* Number of pixels per slice */
+    size_t depth;               /* Number of slices */
+    size_t *next;               /* Next slice to claim (shared) */
+    const char *pattern;        /* Preview path pattern */
+    const char *input_path;     /* Volume file path */
+    const struct Bitmap *preview;       /* Preview bitmap, sized */
+    enum Bitmap_Format format;  /* Preview image layout */
+    uint8_t *pixel_data;        /* Pixel data of one slice preview */
+    struct Downscale_Task downscale;    /* Conversion of a whole slice */
+    size_t written;             /* Number of bytes written */
+    int status;                 /* Processing result */
+};
+
+/**
+ *  @brief Preview written out one frame chunk at a time.
+ *
+ *  The preview rows are completed across chunks and written out as
+ *  soon as their last frame row has gone through.
+ */
+struct Preview_Stream {
+    FILE *out;                  /* Preview file (NULL to keep the rows) */
+    enum Bitmap_Format format;  /* Preview image layout */
+    size_t frame_width;         /* Frame row width in pixels */
+    size_t width;               /* Preview row width in pixels */
+    size_t scale;               /* Downsampling factor */
+    size_t limit;               /* Number of frame pixels covered */
+    size_t stride;              /* Preview row size in bytes */
+    uint8_t *row;               /* Preview row being completed */
+    uint32_t *sums;             /* Column sums of that row */
+    uint16_t *averages;         /* Box averages of that row */
+    uint8_t *encoded;           /* End of the RLE8 rows (NULL if
+                                   uncompressed) */
+};
+
+/**
+ *  @brief Chunk buffers of the streaming mode, used round-robin.
+ *
+ *  While a chunk is processed, the next one is being read and the
+ *  outputs of the previous one are still being written.
+ */
+struct Stream_Buffers {
+    struct Async_Io_Queue queue;        /* Background reads and writes */
+    int in;                     /* Input file descriptor */
+    size_t file_size;           /* Input file size in bytes */
+    size_t chunk_size;          /* Chunk size in bytes */
+    uint16_t *chunks[STREAM_BUFFER_COUNT];  /* Chunk pixels */
+    uint8_t *rows[STREAM_BUFFER_COUNT];     /* Preview rows of each chunk */
+    uint8_t *packed[STREAM_BUFFER_COUNT];   /* Compressed chunks (NULL if
+                                               uncompressed) */
+    struct Async_Io_Request reads[STREAM_BUFFER_COUNT];   /* Chunk reads */
+    struct Async_Io_Request altered_writes[STREAM_BUFFER_COUNT];
+    struct Async_Io_Request preview_writes[STREAM_BUFFER_COUNT];
+};
+
+/**
+ *  @brief Fused adjustment, output and preview work over one partition.
+ *
+ *  The partition covers whole preview rows, so its preview rows are
+ *  completed in memory without sharing them with other threads.
+ */
+struct Fused_Task {
+    const struct Frame *frame;  /* Frame being adjusted */
+    const struct Frame_Output *output;  /* Adjusted data file */
+    struct Adjustment_Task *partition;  /* Partition and its sweep state */
+    size_t end;                 /* Partition end in the file, in bytes */
+    struct Preview_Stream preview;      /* Partition preview rows */
+    uint8_t *dirty_map;         /* Adjusted blocks of a tile (may be NULL) */
+    size_t adjusted;            /* Number of pixels adjusted */
+    int status;                 /* Processing result */
+};
+
+/**
+ *  @brief Neighborhood mode work over whole frame rows.
+ *
+ *  The rows are adjusted one after the other, the original rows around
+ *  the current one being kept as padded copies in a ring. The original
+ *  rows next to the partition are copied before any thread starts, since
+ *  the neighboring partitions adjust them meanwhile.
+ */
+struct Neighborhood_Task {
+    uint16_t *data;             /* Frame pixels */
+    const struct Frame *source; /* Frame to decode the rows from as they're
+                                   loaded (NULL if decoded) */
+    size_t width;               /* Frame width in pixels */
+    size_t height;              /* Number of frame rows */
+    size_t first;               /* First partition row */
+    size_t end;                 /* End of the partition rows */
+    size_t window;              /* Neighborhood side */
+    uint16_t margin;            /* Distance to the median to exceed */
+    float factor;               /* Adjustment factor */
+    uint16_t *halo;             /* Original rows above, then below the
+                                   partition (window / 2 of each) */
+    uint16_t *ring;             /* Padded original rows (window of them) */
+    uint8_t *dirty_map;         /* Partition dirty map, merged back into
+                                   the frame one (NULL if none) */
+    size_t adjusted;            /* Number of pixels adjusted */
+};
+
+/**
+ *  @brief State kept from one frame of a sequence to the next.
+ */
+struct Delite_Sequence {
+    uint16_t *previous;         /* Input pixels of the previous frame */
+    size_t size;                /* Its number of pixels (0 if none yet) */
+    size_t *histogram;          /* Its value histogram */
+    uint16_t *maxima;           /* Highest input pixel of each tile */
+    uint8_t *changed;           /* Tiles changed in the current frame */
+    size_t tile_count;          /* Number of tiles */
+};
+
+/**
+ *  @brief Sequence mode work over one frame partition.
+ *
+ *  The partition starts on a tile boundary.
+ */
+struct Sequence_Task {
+    uint16_t *data;             /* Partition pixel data */
+    size_t offset;              /* Index of the first partition pixel */
+    const struct Frame *source; /* Frame to decode the partition from on
+                                   the first pass (NULL if decoded) */
+    uint16_t *previous;         /* The same pixels in the previous frame */
+    size_t size;                /* Partition size */
+    uint8_t *changed;           /* Changed flags of the partition tiles */
+    uint16_t *maxima;           /* Highest pixel of the partition tiles */
+    uint8_t *dirty_map;         /* Partition dirty map (may be NULL) */
+    bool rebuild;               /* Whether every tile counts as changed */
+    size_t changed_count;       /* Number of changed tiles */
+    size_t *histogram;          /* Partition histogram, when rebuilt */
+    struct Adjustment_Sweep sweep;      /* Threshold sweep state */
+    size_t equal;               /* Threshold pixels in the partition */
+    size_t adjusted;            /* Number of pixels adjusted */
+    int status;                 /* Processing result */
+};
+
+/****************************************************************************
+ * LOCAL DECLARATIONS
+ ****************************************************************************/
+/**
+ *  @brief Process a raw pixel array by decreasing
+ *         the gray intensity for overexposed pixels.
+ * 
+ *  The pixel array is traversed, and the highest pixel_count elements
+ *  are adjusted by decreasing their value by adjustment_level%.
+ *  The histogram engine (which is always used for the "all" tie-break
+ *  policy) adjusts the pixels in a single sweep, without collecting
+ *  their indices. With the heap and histogram engines, each thread
+ *  handles one partition of the frame and the partial results are
+ *  merged, so the output doesn't depend on the number of threads.
+ *  Encoded pixels are decoded by the detection, one tile at a time, or
+ *  upfront for the partial select.
+ *  @param data              Pixel data to adjust
+ *  @param size              Array size
+ *  @param pixel_count       Number of pixels to consider
+ *  @param adjustment_level  Adjustment level (as a percentage)
+ *  @param engine            Selection engine
+ *  @param tie_break         Tie-break policy for equal pixels
+ *  @param dirty_map         Adjusted blocks map to update (may be NULL)
+ *  @param source            Frame to decode the pixels from along the
+ *                           way (NULL if data holds them)
+ *  @param thread_count      Number of threads
+ *  @param arena             Arena for the selection buffers
+ *  @param stats             Run statistics (may be NULL)
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int AdjustPixelData(uint16_t *data, 
+                           size_t size,
+                           size_t pixel_count,
+                           uint8_t adjustment_level,
+                           enum Selection_Engine engine,
+                           enum Selection_Tie_Break tie_break,
+                           uint8_t *dirty_map,
+                           const struct Frame *source,
+                           size_t thread_count,
+                           struct Bitmap_Arena *arena,
+                           struct Stats *stats);
+
+/**
+ *  @brief Adjust all the pixels above a fixed value.
+ *
+ *  Nothing needs to be selected first, so the frame goes through a single
+ *  pass, each thread adjusting its own partition.
+ *  @param data              Pixel data to adjust
+ *  @param size              Array size
+ *  @param value             Value the adjusted pixels exceed
+ *  @param adjustment_level  Adjustment level (as a percentage)
+ *  @param dirty_map         Adjusted blocks map to update (may be NULL)
+ *  @param source            Frame to decode the pixels from along the
+ *                           way (NULL if data holds them)
+ *  @param thread_count      Number of threads
+ *  @param stats             Run statistics (may be NULL)
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int AdjustPixelDataAbove(uint16_t *data,
+                                size_t size,
+                                uint16_t value,
+                                uint8_t adjustment_level,
+                                uint8_t *dirty_map,
+                                const struct Frame *source,
+                                size_t thread_count,
+                                struct Stats *stats);
+
+/**
+ *  @brief Adjust a frame of a sequence, starting from the previous one.
+ *
+ *  The histogram of the previous frame is kept along with its pixels, so
+ *  only the tiles which changed since are counted again, and the tiles
+ *  without any pixel reaching the threshold aren't swept at all. The
+ *  histogram is rebuilt in parallel when most tiles changed. The output
+ *  is the same as without the sequence state.
+ *  @param data              Pixel data to adjust
+ *  @param size              Array size
+ *  @param pixel_count       Number of pixels to consider
+ *  @param adjustment_level  Adjustment level (as a percentage)
+ *  @param tie_break         Tie-break policy for equal pixels
+ *  @param dirty_map         Adjusted blocks map to update (may be NULL)
+ *  @param source            Frame to decode the pixels from along the
+ *                           way (NULL if data holds them)
+ *  @param thread_count      Number of threads
+ *  @param sequence          Sequence state, allocated on the first frame
+ *                           and reset whenever the frame size changes
+ *  @param arena             Arena for the per-frame buffers
+ *  @param stats             Run statistics (may be NULL)
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int AdjustPixelDataSequence(uint16_t *data,
+                                   size_t size,
+                                   size_t pixel_count,
+                                   uint8_t adjustment_level,
+                                   enum Selection_Tie_Break tie_break,
+                                   uint8_t *dirty_map,
+                                   const struct Frame *source,
+                                   size_t thread_count,
+                                   struct Delite_Sequence **sequence,
+                                   struct Bitmap_Arena *arena,
+                                   struct Stats *stats);
+
+/**
+ *  @brief Adjust the pixels far above the median of their neighborhood.
+ *
+ *  Unlike the highest pixels, which may as well be bright details,
+ *  isolated hot or stuck pixels stand out from their neighbors: a pixel
+ *  is adjusted when it exceeds the median of the window x window square
+ *  around it by more than the margin, the borders being extended. The
+ *  medians are taken over the original pixels, in a single pass over the
+ *  frame, the threads splitting it in whole rows. The pixels after the
+ *  last whole row aren't checked.
+ *  @param data              Pixel data to adjust
+ *  @param size              Array size
+ *  @param width             Frame width
+ *  @param window            Neighborhood side (3 or 5)
+ *  @param margin            Distance to the median to exceed
+ *  @param adjustment_level  Adjustment level (as a percentage)
+ *  @param dirty_map         Adjusted blocks map to update (may be NULL)
+ *  @param source            Frame to decode the pixels from along the
+ *                           way (NULL if data holds them)
+ *  @param thread_count      Number of threads
+ *  @param arena             Arena for the row buffers
+ *  @param stats             Run statistics (may be NULL)
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int AdjustPixelDataNeighborhood(uint16_t *data,
+                                       size_t size,
+                                       size_t width,
+                                       size_t window,
+                                       uint16_t margin,
+                                       uint8_t adjustment_level,
+                                       uint8_t *dirty_map,
+                                       const struct Frame *source,
+                                       size_t thread_count,
+                                       struct Bitmap_Arena *arena,
+                                       struct Stats *stats);
+
+/**
+ *  @brief Allocate the sequence state for a frame size.
+ *
+ *  @param sequence  Sequence state, replaced if it exists
+ *  @param size      Number of frame pixels
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise (the state is then released).
+ */
+static int ResetSequence(struct Delite_Sequence **sequence, size_t size);
+
+/**
+ *  @brief Release the sequence state.
+ *
+ *  @param sequence  Sequence state (may be NULL)
+ * 
+ *  @return none
+ */
+static void FreeSequence(struct Delite_Sequence *sequence);
+
+/**
+ *  @brief Update the sequence histogram with the changed tiles.
+ *
+ *  The previous frame tiles are replaced by the current ones.
+ *  @param sequence  Sequence state
+ *  @param data      Current frame pixels
+ * 
+ *  @return The number of pixels counted again.
+ */
+static size_t UpdateSequenceHistogram(struct Delite_Sequence *sequence,
+                                      const uint16_t *data);
+
+/**
+ *  @brief Adjust a frame the way the parameters ask for.
+ *
+ *  @param context    Processing context
+ *  @param options    Parameters resolved for the frame
+ *  @param data       Pixel data to adjust
+ *  @param size       Array size
+ *  @param dirty_map  Adjusted blocks map to update (may be NULL)
+ *  @param source     Frame to decode the pixels from along the way (NULL
+ *                    if data holds them)
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int AdjustFrame(struct Delite_Context *context,
+                       const struct Delite_Options *options,
+                       uint16_t *data,
+                       size_t size,
+                       uint8_t *dirty_map,
+                       const struct Frame *source);
+
+/**
+ *  @brief Resolve the adjustment mode for a frame.
+ *
+ *  The percentile mode becomes a pixel count, using the histogram engine
+ *  unless another one was requested, so the other modes don't need to
+ *  know about it.
+ *  @param options   Adjustment parameters
+ *  @param size      Number of frame pixels
+ *  @param resolved  Parameters to use for the frame
+ * 
+ *  @return none
+ */
+static void ResolveAdjustmentMode(const struct Delite_Options *options,
+                                  size_t size,
+                                  struct Delite_Options *resolved);
+
+/**
+ *  @brief Set up the partition sweeps of a fixed threshold.
+ *
+ *  @param tasks         Partitions
+ *  @param thread_count  Number of partitions
+ *  @param value         Value the adjusted pixels exceed
+ *  @param factor        Adjustment factor
+ * 
+ *  @return none
+ */
+static void InitThresholdSweeps(struct Adjustment_Task *tasks,
+                                size_t thread_count,
+                                uint16_t value,
+                                float factor);
+
+/**
+ *  @brief Find the selection threshold from the partition histograms.
+ *
+ *  The partition histograms are added up and each partition gets its
+ *  own adjustment sweep, counting the equal pixels from where the
+ *  previous partition left off.
+ *  @param tasks         Partitions, with their histograms built
+ *  @param thread_count  Number of partitions
+ *  @param pixel_count   Number of pixels to consider
+ *  @param tie_break     Tie-break policy for equal pixels
+ *  @param factor        Adjustment factor
+ *  @param arena         Arena for the frame histogram
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int InitPartitionSweeps(struct Adjustment_Task *tasks,
+                               size_t thread_count,
+                               size_t pixel_count,
+                               enum Selection_Tie_Break tie_break,
+                               float factor,
+                               struct Bitmap_Arena *arena);
+
+/**
+ *  @brief Check whether a frame can go through the fused pass.
+ *
+ *  The fused pass needs the threshold to be known before adjusting,
+ *  which is the case with the histogram engine, and a valid preview
+ *  geometry.
+ *  @param size     Array size
+ *  @param options  Adjustment parameters
+ * 
+ *  @return true, if the fused pass can be used.
+ *          false, otherwise.
+ */
+static bool CanFuseAdjustment(size_t size,
+                              const struct Delite_Options *options);
+
+/**
+ *  @brief Adjust a frame, write it out and generate its preview at once.
+ *
+ *  After the histogram pass, each tile of the frame is adjusted, written
+ *  to the output file and converted to preview pixels while it's still
+ *  in the cache, instead of going through the whole frame three times.
+ *  The results are the same as with AdjustPixelData, FrameWriteToFile
+ *  and GeneratePreviewBitmapFrom16Bit.
+ *  @param frame              Frame to adjust
+ *  @param altered_file_path  Output path for the adjusted data
+ *  @param options            Adjustment parameters
+ *  @param context          Preview bitmap and buffers
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int AdjustFrameFused(const struct Frame *frame,
+                            const char *altered_file_path,
+                            const struct Delite_Options *options,
+                            struct Delite_Context *context);
+
+/**
+ *  @brief Adjust, write out and convert the tiles of a frame partition.
+ *
+ *  @param task  Partition to process (struct Fused_Task)
+ * 
+ *  @return none
+ */
+static void FusedTask(void *task);
+
+/**
+ *  @brief Get the bounds of a frame partition.
+ *
+ *  The frame is split in whole stripes, as evenly as possible. Trailing
+ *  partitions may be empty for small frames.
+ *  @param size          Array size
+ *  @param thread_count  Number of partitions
+ *  @param part          Partition number
+ *  @param start         Index of the first partition pixel
+ *  @param count         Partition size
+ * 
+ *  @return none
+ */
+static void GetPartition(size_t size,
+                         size_t thread_count,
+                         size_t part,
+                         size_t *start,
+                         size_t *count);
+
+/**
+ *  @brief Build the histogram or the heap of a frame partition.
+ *
+ *  @param task  Partition to process (struct Adjustment_Task)
+ * 
+ *  @return none
+ */
+static void DetectPixelsTask(void *task);
+
+/**
+ *  @brief Adjust the pixels above the threshold in a frame partition.
+ *
+ *  @param task  Partition to process (struct Adjustment_Task)
+ * 
+ *  @return none
+ */
+static void AdjustPixelsTask(void *task);
+
+/**
+ *  @brief Find the tiles of a partition which changed since the previous
+ *         frame, along with their highest pixel.
+ *
+ *  @param task  Partition to process (struct Sequence_Task)
+ * 
+ *  @return none
+ */
+static void CompareTilesTask(void *task);
+
+/**
+ *  @brief Build the histogram of a partition and keep its pixels for the
+ *         next frame.
+ *
+ *  @param task  Partition to process (struct Sequence_Task)
+ * 
+ *  @return none
+ */
+static void RebuildSequenceTask(void *task);
+
+/**
+ *  @brief Count the pixels equal to the threshold in a partition.
+ *
+ *  @param task  Partition to process (struct Sequence_Task)
+ * 
+ *  @return none
+ */
+static void CountEqualTask(void *task);
+
+/**
+ *  @brief Adjust the tiles of a partition which reach the threshold.
+ *
+ *  @param task  Partition to process (struct Sequence_Task)
+ * 
+ *  @return none
+ */
+static void AdjustTilesTask(void *task);
+
+/**
+ *  @brief Adjust the rows of a partition in the neighborhood mode.
+ *
+ *  @param task  Partition to process (struct Neighborhood_Task)
+ * 
+ *  @return none
+ */
+static void NeighborhoodTask(void *task);
+
+/**
+ *  @brief Copy an original frame row into the ring of a partition.
+ *
+ *  The copy is extended by window / 2 pixels on both sides, repeating
+ *  the first and last pixels.
+ *  @param neighborhood  Partition being adjusted
+ *  @param row           Frame row, in the partition or next to it
+ * 
+ *  @return none
+ */
+static void LoadNeighborhoodRow(struct Neighborhood_Task *neighborhood,
+                                size_t row);
+
+/**
+ *  @brief Convert the rows of a frame partition to preview pixels.
+ *
+ *  With a downsampling factor, each preview pixel is the rounded average
+ *  of a scale x scale box of frame pixels. The padding at the end of each
+ *  preview row is cleared.
+ *  @param task  Partition to process (struct Downscale_Task)
+ * 
+ *  @return none
+ */
+static void DownscaleTask(void *task);
+
+/**
+ *  @brief Add a run of frame pixels to the column sums of a preview row.
+ *
+ *  The frame rows of a preview row are first summed up column by column,
+ *  the columns of each box only being added up once the row is complete.
+ *  @param data    Frame pixels
+ *  @param count   Number of pixels
+ *  @param column  Frame column of the first pixel
+ *  @param limit   First frame column left out of the preview
+ *  @param sums    Column sums to update
+ * 
+ *  @return none
+ */
+static void AddPreviewSums(const uint16_t *data,
+                           size_t count,
+                           size_t column,
+                           size_t limit,
+                           uint32_t *sums);
+
+/**
+ *  @brief Turn the column sums of a preview row into box averages.
+ *
+ *  The averages are rounded to nearest and the sums are cleared for
+ *  the next row. With up to DELITE_PREVIEW_MAX_SCALE^2 pixels per box, the
+ *  box sums still fit on 32 bits.
+ *  @param sums      Column sums (count * scale)
+ *  @param count     Number of preview pixels
+ *  @param scale     Downsampling factor
+ *  @param averages  Output averages
+ * 
+ *  @return none
+ */
+static void AveragePreviewSums(uint32_t *sums,
+                               size_t count,
+                               size_t scale,
+                               uint16_t *averages);
+
+/**
+ *  @brief Add a frame chunk to a streamed preview.
+ *
+ *  Without a preview file, the completed rows are kept in memory, one
+ *  after the other, starting from the initial row.
+ *  @param stream  Preview being written
+ *  @param data    Adjusted frame pixels
+ *  @param count   Number of pixels
+ *  @param offset  Index of the first pixel within the frame
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int WritePreviewChunk(struct Preview_Stream *stream,
+                             const uint16_t *data,
+                             size_t count,
+                             size_t offset);
+
+/**
+ *  @brief Adjust a single pixel.
+ *
+ *  Once there are no more non-zero pixels left to select, the lowest
+ *  ranked pixel keeps being picked for the remaining pixel count, hence
+ *  the extra adjustments (which stop as soon as the value settles).
+ *  @param pixel    Pixel to adjust
+ *  @param factor   Adjustment factor
+ *  @param repeats  Number of extra adjustments
+ * 
+ *  @return none
+ */
+static void AdjustPixel(uint16_t *pixel, float factor, size_t repeats);
+
+/**
+ *  @brief Initialize a threshold adjustment sweep.
+ *
+ *  @param sweep        Sweep to be initialized
+ *  @param threshold    Selection threshold
+ *  @param tie_break    Tie-break policy for equal pixels
+ *  @param factor       Adjustment factor
+ *  @param pixel_count  Number of pixels requested for adjustment
+ * 
+ *  @return none
+ */
+static void InitAdjustmentSweep(struct Adjustment_Sweep *sweep,
+                                const struct Selection_Threshold *threshold,
+                                enum Selection_Tie_Break tie_break,
+                                float factor,
+                                size_t pixel_count);
+
+/**
+ *  @brief Adjust the pixels above a threshold in a single sweep.
+ *
+ *  Besides the pixels above the threshold value, only the equal pixels
+ *  allowed by the tie-break policy get adjusted. The chunks of a frame
+ *  must be passed in order.
+ *  @param data       Pixel data chunk to adjust
+ *  @param size       Chunk size
+ *  @param sweep      Sweep state
+ *  @param dirty_map  Adjusted blocks map to update (may be NULL)
+ * 
+ *  @return The number of pixels adjusted.
+ */
+static size_t AdjustPixelsAboveThreshold(uint16_t *data,
+                                         size_t size,
+                                         struct Adjustment_Sweep *sweep,
+                                         uint8_t *dirty_map);
+
+/**
+ *  @brief Convert 16-bit pixels to the preview layout.
+ *
+ *  The 8-bit preview keeps the high byte of each pixel, while the other
+ *  layouts keep the full (or 12-bit) depth without any scaling.
+ *  @param format  Preview format
+ *  @param data    Input pixel data
+ *  @param size    Number of pixels (even, except for the last call)
+ *  @param out     Output pixels (see BitmapGetFormatSize)
+ * 
+ *  @return none
+ */
+static void ConvertPreviewPixels(enum Bitmap_Format format,
+                                 const uint16_t *data,
+                                 size_t size,
+                                 uint8_t *out);
+
+/**
+ *  @brief Generate preview bitmap from a 16-bit encoded pixel array.
+ * 
+ *  The array is converted to the preview format straight into the pixel
+ *  data of the preview bitmap, which is either given by the caller or
+ *  allocated from the context arena. For the full-depth formats, that is
+ *  the only pass made over the adjusted pixels. The threads split the
+ *  preview in whole rows. An RLE8 preview is encoded one row at a time,
+ *  as soon as each row is converted, the pixel data then holding the
+ *  encoded rows.
+ *  @param data        Input pixel data
+ *  @param size        Data size
+ *  @param options     Adjustment parameters (format, geometry, threads)
+ *  @param context     Context holding the preview bitmap
+ *  @param pixel_data  Preview pixel data (NULL to allocate it)
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int GeneratePreviewBitmapFrom16Bit(const uint16_t *data, 
+                                          size_t size,
+                                          const struct Delite_Options
+                                              *options,
+                                          struct Delite_Context *context,
+                                          void *pixel_data);
+
+/**
+ *  @brief Write the tiled preview pyramid of a frame.
+ *
+ *  The levels are built one after the other, each one from the previous
+ *  one, and kept in the context arena. See DeliteWritePyramid.
+ *  @param data       Adjusted frame pixels
+ *  @param size       Number of frame pixels
+ *  @param directory  Pyramid directory
+ *  @param context    Context holding the preview bitmap
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int WritePyramid(const uint16_t *data,
+                        size_t size,
+                        const char *directory,
+                        struct Delite_Context *context);
+
+/**
+ *  @brief Build and write out the tiles of a pyramid level.
+ *
+ *  @param task  Level share to process (struct Pyramid_Task)
+ * 
+ *  @return none
+ */
+static void PyramidTask(void *task);
+
+/**
+ *  @brief Average a tile of a pyramid level from the previous level.
+ *
+ *  Each pixel is the rounded average of a 2x2 block. An odd last row or
+ *  column of the previous level is paired with itself.
+ *  @param pyramid  Level being built
+ *  @param column   First tile column, in pixels
+ *  @param row      First tile row, in pixels
+ *  @param width    Tile width
+ *  @param height   Tile height
+ * 
+ *  @return none
+ */
+static void AveragePyramidTile(const struct Pyramid_Task *pyramid,
+                               size_t column,
+                               size_t row,
+                               size_t width,
+                               size_t height);
+
+/**
+ *  @brief Write out a pyramid tile in the preview format.
+ *
+ *  @param pyramid  Level being built
+ *  @param pixels   First tile pixel
+ *  @param stride   Level row width in pixels
+ *  @param width    Tile width
+ *  @param height   Tile height
+ *  @param path     Tile file path
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int WritePyramidTile(struct Pyramid_Task *pyramid,
+                            const uint16_t *pixels,
+                            size_t stride,
+                            uint32_t width,
+                            uint32_t height,
+                            const char *path);
+
+/**
+ *  @brief Create a directory, unless it already exists.
+ *
+ *  @param path  Directory path
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int CreateDirectory(const char *path);
+
+/**
+ *  @brief Get the size of the slices a volume is made of.
+ *
+ *  The slices hold the requested geometry, or else an even share of the
+ *  volume in whole rows of the requested width (or height).
+ *  @param size        Number of volume pixels
+ *  @param options     Adjustment parameters (geometry, depth)
+ *  @param slice_size  Number of pixels per slice
+ * 
+ *  @return EXIT_SUCCESS, if the volume is made of exactly depth slices.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int GetVolumeSliceSize(size_t size,
+                              const struct Delite_Options *options,
+                              size_t *slice_size);
+
+/**
+ *  @brief Write out the previews of all the slices of a volume.
+ *
+ *  Each slice (see GetVolumeSliceSize) gets the preview of a frame of its
+ *  size. With at least as many slices as threads, the threads take
+ *  whole slices; otherwise each slice is split across all the threads
+ *  by rows, one slice after the other.
+ *  @param data        Volume pixel data
+ *  @param size        Number of volume pixels
+ *  @param options     Adjustment parameters (geometry, depth, threads)
+ *  @param pattern     Preview path pattern (%i for the slice index, %n
+ *                     for the volume file name)
+ *  @param input_path  Volume file path
+ *  @param context     Context holding the preview bitmap
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int WriteVolumePreviews(const uint16_t *data,
+                               size_t size,
+                               const struct Delite_Options *options,
+                               const char *pattern,
+                               const char *input_path,
+                               struct Delite_Context *context);
+
+/**
+ *  @brief Convert and write out the slices claimed by one thread.
+ *
+ *  @param task  Slices to process (struct Volume_Task)
+ * 
+ *  @return none
+ */
+static void VolumeTask(void *task);
+
+/**
+ *  @brief Write a converted preview to a new file.
+ *
+ *  @param bmp      Preview bitmap, sized and holding its pixels
+ *  @param format   Preview image layout
+ *  @param path     Preview file path
+ *  @param written  Number of bytes written, incremented
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int WritePreviewFile(const struct Bitmap *bmp,
+                            enum Bitmap_Format format,
+                            const char *path,
+                            size_t *written);
+
+/**
+ *  @brief Get the dimensions of the preview for a given pixel count.
+ * 
+ *  Without any requested dimension, the frame is cropped to the largest
+ *  square whose width is a multiple of 4. If only one dimension is
+ *  requested, the other one is derived from the pixel count. The preview
+ *  is then the frame divided by the downsampling factor, and any frame
+ *  pixels beyond the last full box are left out of it.
+ *  @param size         Number of pixels
+ *  @param options      Adjustment parameters (format, geometry, scale)
+ *  @param frame_width  Frame row width (set even if the frame doesn't
+ *                      hold the dimensions)
+ *  @param width        Preview width
+ *  @param height       Preview height
+ * 
+ *  @return EXIT_SUCCESS, if the frame holds the requested dimensions.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int GetPreviewGeometry(size_t size,
+                              const struct Delite_Options *options,
+                              size_t *frame_width,
+                              uint32_t *width,
+                              uint32_t *height);
+
+/**
+ *  @brief Move the RLE8 rows of a preview partition after the previous ones.
+ *
+ *  Each partition encodes its rows from the bound offset of its first row
+ *  on, so the partitions are packed together once all of them are done.
+ *  @param bmp   Preview bitmap, its pixel data holding the partitions
+ *  @param row   First row of the partition
+ *  @param end   End of the partition rows
+ *  @param size  Size of the rows packed so far, updated
+ * 
+ *  @return none
+ */
+static void PackPreviewRows(struct Bitmap *bmp,
+                            size_t row,
+                            const uint8_t *end,
+                            size_t *size);
+
+/**
+ *  @brief Get the size of a preview row in a given format.
+ * 
+ *  @param bmp     Preview bitmap
+ *  @param format  Preview format (only BMP rows are padded)
+ * 
+ *  @return The row size in bytes.
+ */
+static size_t GetPreviewStride(const struct Bitmap *bmp,
+                               enum Bitmap_Format format);
+
+/**
+ *  @brief Write a variable to file byte-by-byte.
+ * 
+ *  Write count bytes of the given input to the specified file. The bytes
+ *  go through the stream buffer, so write errors may only be reported
+ *  when the file is closed.
+ *  @param out    Output file
+ *  @param data   Memory to be written
+ *  @param count  Number of bytes to write
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int WriteBytesToFile(FILE *out, const void *data, size_t count);
+
+/**
+ *  @brief Write a list of memory areas to a file descriptor.
+ * 
+ *  Partial writes are resumed where they stopped, so the areas are
+ *  always written completely. The list is updated along the way.
+ *  @param fd     Output file descriptor
+ *  @param iov    Memory areas to be written
+ *  @param count  Number of memory areas
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int WriteVectorToFile(int fd, struct iovec *iov, int count);
+
+/**
+ *  @brief Get the largest size of compressed adjusted pixel data.
+ * 
+ *  @param size  Data size in bytes
+ * 
+ *  @return The compressed size at worst, frame header and end included.
+ */
+static size_t GetCompressedBound(size_t size);
+
+/**
+ *  @brief Compress adjusted pixel data into (part of) an LZ4 frame.
+ * 
+ *  The frame may be compressed in pieces, the header going with the first
+ *  one and the end mark with the last one.
+ *  @param data          Adjusted pixel data
+ *  @param size          Data size in bytes
+ *  @param first         Whether the piece starts the frame
+ *  @param last          Whether the piece ends the frame
+ *  @param thread_count  Number of threads
+ *  @param tables        Hash tables (see CODEC_LZ4_TABLES_SIZE)
+ *  @param out           Output bytes (see GetCompressedBound)
+ *  @param out_size      Output size
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int CompressAlteredData(const void *data,
+                               size_t size,
+                               bool first,
+                               bool last,
+                               size_t thread_count,
+                               uint32_t *tables,
+                               uint8_t *out,
+                               size_t *out_size);
+
+/**
+ *  @brief Write compressed adjusted pixel data to file.
+ * 
+ *  @param data          Adjusted pixel data
+ *  @param size          Data size in bytes
+ *  @param path          Path to the output file
+ *  @param thread_count  Number of threads
+ *  @param arena         Arena for the compressed data
+ *  @param written       Number of bytes written
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int WriteCompressedToFile(const void *data,
+                                 size_t size,
+                                 const char *path,
+                                 size_t thread_count,
+                                 struct Bitmap_Arena *arena,
+                                 size_t *written);
+
+/**
+ *  @brief Write a bitmap to file.
+ * 
+ *  The headers, the color table and the pixel data are written straight
+ *  from the bitmap with a single gathered write, without staging them in
+ *  a separate buffer. Anything buffered in the output stream is flushed
+ *  first.
+ *  @param out    Output file
+ *  @param bm     Bitmap to write
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int WriteBmpToFile(FILE *out, const struct Bitmap *bmp);
+
+/**
+ *  @brief Write everything preceding the pixel data of a bitmap to file.
+ * 
+ *  @param out    Output file
+ *  @param bm     Bitmap to write
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int WriteBmpHeaderToFile(FILE *out, const struct Bitmap *bmp);
+
+/**
+ *  @brief Write a preview to file in a given format.
+ * 
+ *  The pixel data of the bitmap must already be in that format.
+ *  @param out     Output file
+ *  @param bmp     Preview bitmap
+ *  @param format  Preview format
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int WritePreviewToFile(FILE *out, const struct Bitmap *bmp,
+                              enum Bitmap_Format format);
+
+/**
+ *  @brief Write the header of a preview in a given format to file.
+ * 
+ *  @param out     Output file
+ *  @param bmp     Preview bitmap (only its dimensions are used)
+ *  @param format  Preview format (there's no header for raw12)
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int WritePreviewHeaderToFile(FILE *out, const struct Bitmap *bmp,
+                                    enum Bitmap_Format format);
+
+/**
+ *  @brief Copy the header of a preview in a given format to memory.
+ *
+ *  @param bmp     Preview bitmap (only its dimensions are used)
+ *  @param format  Preview format (there's no header for raw12)
+ *  @param out     Header memory (NULL to only get its size)
+ * 
+ *  @return The header size in bytes.
+ */
+static size_t CopyPreviewHeader(const struct Bitmap *bmp,
+                                enum Bitmap_Format format,
+                                uint8_t *out);
+
+/**
+ *  @brief Compare two pixel indices for an ascending sort.
+ *
+ *  @param a  First index
+ *  @param b  Second index
+ *
+ *  @return -1, 0 or 1 as expected by qsort.
+ */
+static int CompareIndices(const void *a, const void *b);
+
+/**
+ *  @brief Count the bytes of an output file in the run statistics.
+ *
+ *  @param stats  Run statistics (nothing is done if NULL)
+ *  @param out    Output file, fully written
+ *
+ *  @return none
+ */
+static void CountOutputFile(struct Stats *stats, FILE *out);
+
+/**
+ *  @brief Start reading a streamed chunk in the background.
+ *
+ *  @param buffers  Streaming buffers
+ *  @param index    Chunk number (nothing is read past the end)
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int ReadStreamChunk(struct Stream_Buffers *buffers, size_t index);
+
+/**
+ *  @brief Wait for a streamed chunk and start reading the next one.
+ *
+ *  The outputs of the buffer the next chunk goes into must have been
+ *  written already.
+ *  @param buffers  Streaming buffers
+ *  @param index    Chunk number
+ *  @param count    Number of bytes read
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int FetchStreamChunk(struct Stream_Buffers *buffers,
+                            size_t index,
+                            size_t *count);
+
+/**
+ *  @brief Read from a descriptor until a count is reached or the input ends.
+ * 
+ *  @param fd     Input descriptor
+ *  @param data   Memory to read into
+ *  @param count  Number of bytes to read
+ *  @param done   Number of bytes read (less than count at the end)
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int ReadFully(int fd, void *data, size_t count, size_t *done);
+
+/**
+ *  @brief Read a whole input from a descriptor into memory.
+ * 
+ *  @param fd          Input descriptor
+ *  @param chunk_size  Minimum amount read at once
+ *  @param data        Newly allocated input
+ *  @param size        Input size in bytes
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int ReadWhole(int fd, size_t chunk_size, uint8_t **data,
+                     size_t *size);
+
+/**
+ *  @brief Write an output of the pipe mode, as a record if multiplexed.
+ * 
+ *  The prefix and the data make up a single record. Nothing is written
+ *  if both are empty.
+ *  @param fd           Output descriptor
+ *  @param framed       Whether the outputs are multiplexed
+ *  @param tag          Record tag (DELITE_RECORD_ALTERED or _PREVIEW)
+ *  @param prefix       Memory to write first (may be NULL if empty)
+ *  @param prefix_size  Prefix size
+ *  @param data         Memory to write next (may be NULL if empty)
+ *  @param size         Data size
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int WritePipeOutput(int fd,
+                           bool framed,
+                           uint8_t tag,
+                           const void *prefix,
+                           size_t prefix_size,
+                           const void *data,
+                           size_t size);
+
+/**
+ *  @brief Adjust a frame from a pipe in a single pass, one chunk at a time.
+ * 
+ *  Only a fixed threshold can be applied this way, and only if the preview
+ *  geometry doesn't depend on the frame size.
+ *  @param context  Processing context
+ *  @param in       Input descriptor
+ *  @param altered  Adjusted pixel data output descriptor (-1 for none)
+ *  @param preview  Preview output descriptor (-1 for none)
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int ProcessPipeChunks(struct Delite_Context *context,
+                             int in,
+                             int altered,
+                             int preview);
+
+/**
+ *  @brief Adjust a frame from a pipe, once all of it has been read.
+ * 
+ *  @param context  Processing context
+ *  @param in       Input descriptor
+ *  @param altered  Adjusted pixel data output descriptor (-1 for none)
+ *  @param preview  Preview output descriptor (-1 for none)
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int ProcessPipeFrame(struct Delite_Context *context,
+                            int in,
+                            int altered,
+                            int preview);
+
+/**
+ *  @brief Process the batch files assigned to a worker.
+ * 
+ *  @param worker  Worker to run (struct Batch_Worker)
+ * 
+ *  @return none
+ */
+static void ProcessBatchWorker(void *worker);
+
+/**
+ *  @brief Collect the input file paths of a batch.
+ * 
+ *  @param source  Directory, glob pattern or list file
+ *  @param paths   Newly allocated array of newly allocated paths
+ *  @param count   Number of paths
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int CollectBatchPaths(const char *source, char ***paths, size_t *count);
+
+/**
+ *  @brief Append a copy of a path to a growing path array.
+ * 
+ *  @param path      Path to append
+ *  @param paths     Path array
+ *  @param count     Number of paths
+ *  @param capacity  Number of allocated entries
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int AppendPath(const char *path,
+                      char ***paths,
+                      size_t *count,
+                      size_t *capacity);
+
+/**
+ *  @brief Compare two paths for an ascending sort.
+ *
+ *  @param a  First path
+ *  @param b  Second path
+ *
+ *  @return A negative, zero or positive value as expected by qsort.
+ */
+static int ComparePaths(const void *a, const void *b);
+
+/**
+ *  @brief Build an output path from a pattern.
+ * 
+ *  @param pattern     Output path pattern (see DeliteProcessBatch)
+ *  @param input_path  Input file path
+ *  @param index       Input position in the batch
+ *  @param path        Output path
+ *  @param path_size   Output path buffer size
+ * 
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if the path doesn't fit.
+ */
+static int ExpandPathPattern(const char *pattern,
+                             const char *input_path,
+                             size_t index,
+                             char *path,
+                             size_t path_size);
+
+/****************************************************************************/
+
+static void ConvertPreviewPixels(enum Bitmap_Format format,
+                                 const uint16_t *data,
+                                 size_t size,
+                                 uint8_t *out) {
+    if (BITMAP_FORMAT_PGM == format) {
+        BitmapSwap16Bit(data, size, out);
+    }
+    else if (BITMAP_FORMAT_RAW12 == format) {
+        BitmapPack12Bit(data, size, out);
+    }
+    else {
+        KernelDownscale(data, size, out);
+    }
+}
+
+static int AdjustPixelData(uint16_t *data, 
+                           size_t size,
+                           size_t pixel_count,
+                           uint8_t adjustment_level,
+                           enum Selection_Engine engine,
+                           enum Selection_Tie_Break tie_break,
+                           uint8_t *dirty_map,
+                           const struct Frame *source,
+                           size_t thread_count,
+                           struct Bitmap_Arena *arena,
+                           struct Stats *stats) {
+    size_t i = 0;
+    size_t start = 0;
+    size_t selected = 0;
+    size_t *indices = NULL;
+    struct Adjustment_Task tasks[PARALLEL_MAX_THREADS];
+    struct Selection_Heap heap;
+    float factor = KernelsGetScaleFactor(adjustment_level);
+    int status = EXIT_SUCCESS;
+
+    memset(tasks, 0, sizeof(tasks));
+    memset(&heap, 0, sizeof(heap));
+
+    engine = SelectionPickEngine(engine, size, pixel_count);
+    if (SELECTION_TIE_BREAK_ALL == tie_break) {
+        engine = SELECTION_ENGINE_HISTOGRAM;
+    }
+    StatsSetEngine(stats, SelectionGetEngineName(engine));
+    StatsBegin(stats, STATS_STAGE_DETECT);
+
+    if ((NULL == data) || (0 == size) || (0 == thread_count) ||
+        (thread_count > PARALLEL_MAX_THREADS)) {
+        status = EXIT_FAILURE;
+    }
+    else if (SELECTION_ENGINE_INTROSELECT == engine) {
+        /* The partial select needs the whole frame at once. */
+        indices = BitmapArenaAlloc(arena, ((pixel_count < size) ?
+                                           pixel_count : size) *
+                                          sizeof(size_t));
+        if (NULL == indices) {
+            status = EXIT_FAILURE;
+        }
+        else {
+            FrameDecode(source, 0, size, data);
+            status = SelectionTopK(data, size, pixel_count, engine,
+                                   tie_break, indices, &selected);
+        }
+    }
+    else {
+        for (i = 0; i < thread_count; i++) {
+            GetPartition(size, thread_count, i, &start, &tasks[i].size);
+            tasks[i].data = &data[start];
+            tasks[i].offset = start;
+            tasks[i].source = source;
+            tasks[i].pixel_count = pixel_count;
+            tasks[i].engine = engine;
+            tasks[i].tie_break = tie_break;
+            if (NULL != dirty_map) {
+                tasks[i].dirty_map = &dirty_map[start / THREAD_STRIPE_SIZE];
+            }
+            if (SELECTION_ENGINE_HISTOGRAM == engine) {
+                tasks[i].histogram = BitmapArenaAlloc(arena,
+                                                      SELECTION_HISTOGRAM_SIZE
+                                                      * sizeof(size_t));
+                if (NULL == tasks[i].histogram) {
+                    status = EXIT_FAILURE;
+                }
+            }
+        }
+
+        if (EXIT_SUCCESS == status) {
+            status = ParallelRun(DetectPixelsTask, tasks, sizeof(tasks[0]),
+                                 thread_count);
+        }
+        for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+            status = tasks[i].status;
+        }
+    }
+
+    if ((EXIT_SUCCESS == status) &&
+        (SELECTION_ENGINE_HISTOGRAM == engine)) {
+        status = InitPartitionSweeps(tasks, thread_count, pixel_count,
+                                     tie_break, factor, arena);
+    }
+    else if ((EXIT_SUCCESS == status) && (SELECTION_ENGINE_HEAP == engine)) {
+        status = SelectionHeapInit(&heap, (pixel_count < size) ?
+                                   pixel_count : size, tie_break);
+        for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+            SelectionHeapMerge(&heap, &tasks[i].heap);
+        }
+        if (EXIT_SUCCESS == status) {
+            indices = BitmapArenaAlloc(arena,
+                                       (heap.size + 1U) * sizeof(size_t));
+            if (NULL == indices) {
+                status = EXIT_FAILURE;
+            }
+            else {
+                selected = SelectionHeapExtract(&heap, indices);
+            }
+        }
+    }
+
+    StatsEnd(stats, STATS_STAGE_DETECT);
+    StatsBegin(stats, STATS_STAGE_ADJUST);
+    if (EXIT_SUCCESS == status) {
+        StatsAdd(stats, STATS_PIXELS_SCANNED, size);
+    }
+
+    if ((EXIT_SUCCESS == status) &&
+        (SELECTION_ENGINE_HISTOGRAM == engine)) {
+        status = ParallelRun(AdjustPixelsTask, tasks, sizeof(tasks[0]),
+                             thread_count);
+        for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+            StatsAdd(stats, STATS_PIXELS_ADJUSTED, tasks[i].adjusted);
+        }
+    }
+    else if (EXIT_SUCCESS == status) {
+        StatsAdd(stats, STATS_PIXELS_ADJUSTED, selected);
+    }
+
+    /* The lowest ranked pixel is the last one. */
+    for (i = 0; (EXIT_SUCCESS == status) && (i < selected); i++) {
+        AdjustPixel(&data[indices[i]], factor,
+                    (i + 1 < selected) ? 0 : pixel_count - selected);
+        if (NULL != dirty_map) {
+            FRAME_MARK_PIXEL(dirty_map, indices[i]);
+        }
+    }
+    StatsEnd(stats, STATS_STAGE_ADJUST);
+
+    /* The other buffers are released when the arena is reset. */
+    for (i = 0; i < PARALLEL_MAX_THREADS; i++) {
+        SelectionHeapFree(&tasks[i].heap);
+    }
+    SelectionHeapFree(&heap);
+
+    return status;
+}
+
+static int AdjustPixelDataAbove(uint16_t *data,
+                                size_t size,
+                                uint16_t value,
+                                uint8_t adjustment_level,
+                                uint8_t *dirty_map,
+                                const struct Frame *source,
+                                size_t thread_count,
+                                struct Stats *stats) {
+    size_t i = 0;
+    size_t start = 0;
+    struct Adjustment_Task tasks[PARALLEL_MAX_THREADS];
+    int status = EXIT_SUCCESS;
+
+    memset(tasks, 0, sizeof(tasks));
+
+    StatsSetEngine(stats, NULL);
+    StatsBegin(stats, STATS_STAGE_ADJUST);
+    if ((NULL == data) || (0 == size) || (0 == thread_count) ||
+        (thread_count > PARALLEL_MAX_THREADS)) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        InitThresholdSweeps(tasks, thread_count, value,
+                            KernelsGetScaleFactor(adjustment_level));
+        for (i = 0; i < thread_count; i++) {
+            GetPartition(size, thread_count, i, &start, &tasks[i].size);
+            tasks[i].data = &data[start];
+            tasks[i].offset = start;
+            tasks[i].source = source;
+            if (NULL != dirty_map) {
+                tasks[i].dirty_map = &dirty_map[start / THREAD_STRIPE_SIZE];
+            }
+        }
+        status = ParallelRun(AdjustPixelsTask, tasks, sizeof(tasks[0]),
+                             thread_count);
+    }
+    for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+        StatsAdd(stats, STATS_PIXELS_ADJUSTED, tasks[i].adjusted);
+    }
+    StatsEnd(stats, STATS_STAGE_ADJUST);
+
+    return status;
+}
+
+static int AdjustPixelDataSequence(uint16_t *data,
+                                   size_t size,
+                                   size_t pixel_count,
+                                   uint8_t adjustment_level,
+                                   enum Selection_Tie_Break tie_break,
+                                   uint8_t *dirty_map,
+                                   const struct Frame *source,
+                                   size_t thread_count,
+                                   struct Delite_Sequence **sequence,
+                                   struct Bitmap_Arena *arena,
+                                   struct Stats *stats) {
+    struct Sequence_Task tasks[PARALLEL_MAX_THREADS];
+    struct Selection_Threshold threshold;
+    struct Adjustment_Sweep sweep;
+    struct Delite_Sequence *state = NULL;
+    float factor = KernelsGetScaleFactor(adjustment_level);
+    bool rebuild = false;
+    size_t changed_count = 0;
+    size_t equal_seen = 0;
+    size_t scanned = 0;
+    size_t start = 0;
+    size_t value = 0;
+    size_t i = 0;
+    int status = EXIT_SUCCESS;
+
+    memset(tasks, 0, sizeof(tasks));
+    StatsSetEngine(stats, SelectionGetEngineName(SELECTION_ENGINE_HISTOGRAM));
+    StatsBegin(stats, STATS_STAGE_DETECT);
+
+    if ((NULL == data) || (0 == size) || (0 == thread_count) ||
+        (thread_count > PARALLEL_MAX_THREADS)) {
+        status = EXIT_FAILURE;
+    }
+    else if ((NULL == *sequence) || ((*sequence)->size != size)) {
+        status = ResetSequence(sequence, size);
+        rebuild = true;
+    }
+
+    if (EXIT_SUCCESS == status) {
+        state = *sequence;
+        for (i = 0; i < thread_count; i++) {
+            GetPartition(size, thread_count, i, &start, &tasks[i].size);
+            tasks[i].data = &data[start];
+            tasks[i].offset = start;
+            tasks[i].source = source;
+            tasks[i].previous = &(state->previous[start]);
+            tasks[i].changed = &(state->changed[start / SEQUENCE_TILE_SIZE]);
+            tasks[i].maxima = &(state->maxima[start / SEQUENCE_TILE_SIZE]);
+            tasks[i].rebuild = rebuild;
+            if (NULL != dirty_map) {
+                tasks[i].dirty_map = &dirty_map[start / THREAD_STRIPE_SIZE];
+            }
+        }
+        status = ParallelRun(CompareTilesTask, tasks, sizeof(tasks[0]),
+                             thread_count);
+        for (i = 0; i < thread_count; i++) {
+            changed_count += tasks[i].changed_count;
+        }
+    }
+
+    /* Counting a tile again takes twice the work of counting it from
+       scratch, so most of the frame changing means starting over. */
+    if ((EXIT_SUCCESS == status) &&
+        (rebuild || (2U * changed_count > state->tile_count))) {
+        state->size = 0;
+        for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+            tasks[i].histogram = BitmapArenaAlloc(arena,
+                                                  SELECTION_HISTOGRAM_SIZE *
+                                                  sizeof(size_t));
+            if (NULL == tasks[i].histogram) {
+                status = EXIT_FAILURE;
+            }
+        }
+        if (EXIT_SUCCESS == status) {
+            status = ParallelRun(RebuildSequenceTask, tasks,
+                                 sizeof(tasks[0]), thread_count);
+        }
+        for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+            status = tasks[i].status;
+        }
+        if (EXIT_SUCCESS == status) {
+            memset(state->histogram, 0,
+                   SELECTION_HISTOGRAM_SIZE * sizeof(size_t));
+            for (i = 0; i < thread_count; i++) {
+                for (value = 0; value < SELECTION_HISTOGRAM_SIZE; value++) {
+                    state->histogram[value] += tasks[i].histogram[value];
+                }
+            }
+            state->size = size;
+            scanned = size;
+        }
+    }
+    else if (EXIT_SUCCESS == status) {
+        scanned = UpdateSequenceHistogram(state, data);
+    }
+
+    if (EXIT_SUCCESS == status) {
+        status = SelectionFindThreshold(state->histogram, pixel_count,
+                                        tie_break, &threshold);
+    }
+    if (EXIT_SUCCESS == status) {
+        InitAdjustmentSweep(&sweep, &threshold, tie_break, factor,
+                            pixel_count);
+        for (i = 0; i < thread_count; i++) {
+            tasks[i].sweep = sweep;
+        }
+
+        /* Each partition counts the equal pixels from where the previous
+           one left off, which only matters when some are left out. */
+        if ((threshold.quota > 0) && (thread_count > 1U)) {
+            status = ParallelRun(CountEqualTask, tasks, sizeof(tasks[0]),
+                                 thread_count);
+        }
+        for (i = 0; i < thread_count; i++) {
+            tasks[i].sweep.equal_seen = equal_seen;
+            equal_seen += tasks[i].equal;
+        }
+    }
+
+    StatsEnd(stats, STATS_STAGE_DETECT);
+    StatsBegin(stats, STATS_STAGE_ADJUST);
+    if (EXIT_SUCCESS == status) {
+        StatsAdd(stats, STATS_PIXELS_SCANNED, scanned);
+        status = ParallelRun(AdjustTilesTask, tasks, sizeof(tasks[0]),
+                             thread_count);
+        for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+            StatsAdd(stats, STATS_PIXELS_ADJUSTED, tasks[i].adjusted);
+        }
+    }
+    StatsEnd(stats, STATS_STAGE_ADJUST);
+
+    return status;
+}
+
+static int AdjustPixelDataNeighborhood(uint16_t *data,
+                                       size_t size,
+                                       size_t width,
+                                       size_t window,
+                                       uint16_t margin,
+                                       uint8_t adjustment_level,
+                                       uint8_t *dirty_map,
+                                       const struct Frame *source,
+                                       size_t thread_count,
+                                       struct Bitmap_Arena *arena,
+                                       struct Stats *stats) {
+    struct Neighborhood_Task tasks[PARALLEL_MAX_THREADS];
+    size_t radius = window / 2U;
+    size_t height = (0 == width) ? 0 : size / width;
+    size_t map_size = size * sizeof(data[0]) / FRAME_BLOCK_SIZE / 8U + 1U;
+    size_t rows = 0;
+    size_t row = 0;
+    size_t i = 0;
+    size_t j = 0;
+    int status = EXIT_SUCCESS;
+
+    memset(tasks, 0, sizeof(tasks));
+
+    StatsSetEngine(stats, "median");
+    StatsBegin(stats, STATS_STAGE_ADJUST);
+    if ((NULL == data) || (0 == height) || (0 == thread_count) ||
+        (thread_count > PARALLEL_MAX_THREADS) ||
+        ((3U != window) && (5U != window))) {
+        status = EXIT_FAILURE;
+    }
+
+    rows = (height + thread_count - 1U) / thread_count;
+    for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+        tasks[i].data = data;
+        tasks[i].source = source;
+        tasks[i].width = width;
+        tasks[i].height = height;
+        tasks[i].first = (i * rows < height) ? i * rows : height;
+        tasks[i].end = (tasks[i].first + rows < height) ?
+                       tasks[i].first + rows : height;
+        tasks[i].window = window;
+        tasks[i].margin = margin;
+        tasks[i].factor = KernelsGetScaleFactor(adjustment_level);
+        tasks[i].halo = BitmapArenaAlloc(arena, 2U * radius * width *
+                                                sizeof(data[0]));
+        tasks[i].ring = BitmapArenaAlloc(arena, window *
+                                                (width + 2U * radius) *
+                                                sizeof(data[0]));
+        if (NULL != dirty_map) {
+            /* The partitions don't start on dirty map bytes. */
+            tasks[i].dirty_map = BitmapArenaAlloc(arena, map_size);
+            if (NULL != tasks[i].dirty_map) {
+                memset(tasks[i].dirty_map, 0, map_size);
+            }
+        }
+        if ((NULL == tasks[i].halo) || (NULL == tasks[i].ring) ||
+            ((NULL != dirty_map) && (NULL == tasks[i].dirty_map))) {
+            status = EXIT_FAILURE;
+        }
+
+        /* The rows next to the partition, while they're still intact. */
+        for (j = 0; (EXIT_SUCCESS == status) && (j < 2U * radius); j++) {
+            row = (j < radius) ? tasks[i].first + j - radius :
+                                 tasks[i].end + j - radius;
+            if ((tasks[i].first + j >= radius) && (row < height)) {
+                if ((NULL != source) && (NULL != source->encoded)) {
+                    FrameDecode(source, row * width, width,
+                                &tasks[i].halo[j * width]);
+                }
+                else {
+                    memcpy(&tasks[i].halo[j * width], &data[row * width],
+                           width * sizeof(data[0]));
+                }
+            }
+        }
+    }
+
+    /* The pixels after the last row are still part of the output. */
+    if (EXIT_SUCCESS == status) {
+        FrameDecode(source, height * width, size - height * width,
+                    &data[height * width]);
+    }
+
+    if (EXIT_SUCCESS == status) {
+        status = ParallelRun(NeighborhoodTask, tasks, sizeof(tasks[0]),
+                             thread_count);
+    }
+    for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+        StatsAdd(stats, STATS_PIXELS_ADJUSTED, tasks[i].adjusted);
+        for (j = 0; (NULL != dirty_map) && (j < map_size); j++) {
+            dirty_map[j] |= tasks[i].dirty_map[j];
+        }
+    }
+    if (EXIT_SUCCESS == status) {
+        StatsAdd(stats, STATS_PIXELS_SCANNED, height * width);
+    }
+    StatsEnd(stats, STATS_STAGE_ADJUST);
+
+    return status;
+}
+
+static int ResetSequence(struct Delite_Sequence **sequence, size_t size) {
+    struct Delite_Sequence *state = NULL;
+    size_t tile_count = (size + SEQUENCE_TILE_SIZE - 1U) / SEQUENCE_TILE_SIZE;
+    int status = EXIT_SUCCESS;
+
+    FreeSequence(*sequence);
+    *sequence = NULL;
+
+    state = calloc(1, sizeof(*state));
+    if ((NULL == state) || (size > SIZE_MAX / sizeof(uint16_t))) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        state->tile_count = tile_count;
+        state->previous = malloc(size * sizeof(state->previous[0]));
+        state->histogram = malloc(SELECTION_HISTOGRAM_SIZE *
+                                  sizeof(state->histogram[0]));
+        state->maxima = malloc(tile_count * sizeof(state->maxima[0]));
+        state->changed = malloc(tile_count * sizeof(state->changed[0]));
+        if ((NULL == state->previous) || (NULL == state->histogram) ||
+            (NULL == state->maxima) || (NULL == state->changed)) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    if (EXIT_SUCCESS == status) {
+        *sequence = state;
+    }
+    else {
+        FreeSequence(state);
+    }
+
+    return status;
+}
+
+static void FreeSequence(struct Delite_Sequence *sequence) {
+    if (NULL != sequence) {
+        free(sequence->previous);
+        free(sequence->histogram);
+        free(sequence->maxima);
+        free(sequence->changed);
+        free(sequence);
+    }
+}
+
+static size_t UpdateSequenceHistogram(struct Delite_Sequence *sequence,
+                                      const uint16_t *data) {
+    size_t *histogram = sequence->histogram;
+    uint16_t *previous = NULL;
+    size_t scanned = 0;
+    size_t start = 0;
+    size_t end = 0;
+    size_t tile = 0;
+    size_t i = 0;
+
+    for (tile = 0; tile < sequence->tile_count; tile++) {
+        if (0 != sequence->changed[tile]) {
+            start = tile * SEQUENCE_TILE_SIZE;
+            end = (start + SEQUENCE_TILE_SIZE < sequence->size) ?
+                  start + SEQUENCE_TILE_SIZE : sequence->size;
+            previous = sequence->previous;
+            for (i = start; i < end; i++) {
+                histogram[previous[i]]--;
+                histogram[data[i]]++;
+            }
+            memcpy(&previous[start], &data[start],
+                   (end - start) * sizeof(data[0]));
+            scanned += end - start;
+        }
+    }
+
+    return scanned;
+}
+
+static int AdjustFrame(struct Delite_Context *context,
+                       const struct Delite_Options *options,
+                       uint16_t *data,
+                       size_t size,
+                       uint8_t *dirty_map,
+                       const struct Frame *source) {
+    struct Delite_Options base = *options;
+    size_t frame_width = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    int status = EXIT_SUCCESS;
+
+    if (DELITE_MODE_THRESHOLD == options->mode) {
+        status = AdjustPixelDataAbove(data, size, options->threshold,
+                                      options->adjustment_level, dirty_map,
+                                      source, options->thread_count,
+                                      context->stats);
+    }
+    else if (DELITE_MODE_NEIGHBORHOOD == options->mode) {
+        /* The neighborhoods need the frame width, whatever the preview. */
+        base.preview_format = BITMAP_FORMAT_BMP;
+        base.preview_scale = 1U;
+        status = GetPreviewGeometry(size, &base, &frame_width, &width,
+                                    &height);
+        if (EXIT_SUCCESS == status) {
+            status = AdjustPixelDataNeighborhood(data, size, frame_width,
+                                                 options->median_window,
+                                                 options->median_margin,
+                                                 options->adjustment_level,
+                                                 dirty_map, source,
+                                                 options->thread_count,
+                                                 &(context->arena),
+                                                 context->stats);
+        }
+    }
+    else if (options->sequence) {
+        status = AdjustPixelDataSequence(data, size, options->pixel_count,
+                                         options->adjustment_level,
+                                         options->tie_break, dirty_map,
+                                         source, options->thread_count,
+                                         &(context->sequence),
+                                         &(context->arena), context->stats);
+    }
+    else {
+        status = AdjustPixelData(data, size, options->pixel_count,
+                                 options->adjustment_level, options->engine,
+                                 options->tie_break, dirty_map, source,
+                                 options->thread_count, &(context->arena),
+                                 context->stats);
+    }
+
+    return status;
+}
+
+static void ResolveAdjustmentMode(const struct Delite_Options *options,
+                                  size_t size,
+                                  struct Delite_Options *resolved) {
+    *resolved = *options;
+    if (DELITE_MODE_PERCENTILE == options->mode) {
+        resolved->mode = DELITE_MODE_COUNT;
+        resolved->pixel_count = ceil(size * options->percentile / 100.0);
+        if (SELECTION_ENGINE_AUTO == options->engine) {
+            resolved->engine = SELECTION_ENGINE_HISTOGRAM;
+        }
+    }
+}
+
+static void InitThresholdSweeps(struct Adjustment_Task *tasks,
+                                size_t thread_count,
+                                uint16_t value,
+                                float factor) {
+    struct Selection_Threshold threshold;
+    size_t i = 0;
+
+    /* Without a quota, exactly the pixels above the value are adjusted. */
+    memset(&threshold, 0, sizeof(threshold));
+    threshold.value = value;
+    for (i = 0; i < thread_count; i++) {
+        InitAdjustmentSweep(&tasks[i].sweep, &threshold,
+                            SELECTION_TIE_BREAK_FIRST, factor, 0);
+    }
+}
+
+static int InitPartitionSweeps(struct Adjustment_Task *tasks,
+                               size_t thread_count,
+                               size_t pixel_count,
+                               enum Selection_Tie_Break tie_break,
+                               float factor,
+                               struct Bitmap_Arena *arena) {
+    struct Selection_Threshold threshold;
+    struct Adjustment_Sweep sweep;
+    size_t *histogram = NULL;
+    size_t equal_seen = 0;
+    size_t value = 0;
+    size_t i = 0;
+    int status = EXIT_SUCCESS;
+
+    histogram = BitmapArenaAlloc(arena, SELECTION_HISTOGRAM_SIZE *
+                                        sizeof(size_t));
+    if (NULL == histogram) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        memset(histogram, 0, SELECTION_HISTOGRAM_SIZE * sizeof(size_t));
+        for (i = 0; i < thread_count; i++) {
+            for (value = 0; value < SELECTION_HISTOGRAM_SIZE; value++) {
+                histogram[value] += tasks[i].histogram[value];
+            }
+        }
+        status = SelectionFindThreshold(histogram, pixel_count,
+                                        tie_break, &threshold);
+    }
+    if (EXIT_SUCCESS == status) {
+        InitAdjustmentSweep(&sweep, &threshold, tie_break, factor,
+                            pixel_count);
+
+        /* Each partition counts the equal pixels from where the
+           previous one left off. */
+        for (i = 0; i < thread_count; i++) {
+            tasks[i].sweep = sweep;
+            tasks[i].sweep.equal_seen = equal_seen;
+            equal_seen += tasks[i].histogram[threshold.value];
+        }
+    }
+
+    return status;
+}
+
+static bool CanFuseAdjustment(size_t size,
+                              const struct Delite_Options *options) {
+    enum Selection_Engine engine = SELECTION_ENGINE_HISTOGRAM;
+    size_t frame_width = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    /* A fixed threshold needs no selection at all. */
+    if (DELITE_MODE_THRESHOLD != options->mode) {
+        engine = SelectionPickEngine(options->engine, size,
+                                     options->pixel_count);
+    }
+
+    /* The sequence mode keeps its own selection state instead, the
+       compressed blocks are only known once the frame is adjusted and the
+       pyramid levels need the whole adjusted frame, as do the volume slice
+       previews. The neighborhood mode has no threshold at all. */
+    return ((DELITE_MODE_THRESHOLD == options->mode) ||
+            !options->sequence) &&
+           (DELITE_MODE_NEIGHBORHOOD != options->mode) &&
+           (CODEC_FORMAT_NONE == options->altered_format) &&
+           !options->patch_input &&
+           (NULL == options->pyramid_path) && (0 == options->depth) &&
+           ((SELECTION_ENGINE_HISTOGRAM == engine) ||
+            (SELECTION_TIE_BREAK_ALL == options->tie_break)) &&
+           (EXIT_SUCCESS == GetPreviewGeometry(size, options, &frame_width,
+                                               &width, &height));
+}
+
+static int AdjustFrameFused(const struct Frame *frame,
+                            const char *altered_file_path,
+                            const struct Delite_Options *options,
+                            struct Delite_Context *context) {
+    struct Adjustment_Task tasks[PARALLEL_MAX_THREADS];
+    struct Fused_Task fused[PARALLEL_MAX_THREADS];
+    struct Frame_Output output;
+    struct Bitmap_Arena *arena = &(context->arena);
+    struct Bitmap *bmp = context->preview;
+    struct Stats *stats = context->stats;
+    uint16_t *data = frame->data;
+    size_t size = frame->size / sizeof(data[0]);
+    size_t thread_count = options->thread_count;
+    size_t scale = options->preview_scale;
+    size_t map_size = FUSED_TILE_SIZE * sizeof(data[0]) / FRAME_BLOCK_SIZE /
+                      8U + 1U;
+    size_t frame_width = 0;
+    size_t band = 0;
+    size_t stride = 0;
+    size_t rows = 0;
+    size_t row = 0;
+    size_t end = 0;
+    size_t packed = 0;
+    size_t i = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    float factor = KernelsGetScaleFactor(options->adjustment_level);
+    bool select = (DELITE_MODE_THRESHOLD != options->mode);
+    bool rle = (BITMAP_COMPRESSION_RLE8 == bmp->info_header.compression);
+    int status = EXIT_SUCCESS;
+
+    memset(tasks, 0, sizeof(tasks));
+    memset(fused, 0, sizeof(fused));
+    output.fd = -1;
+
+    if ((0 == size) || (0 == thread_count) ||
+        (thread_count > PARALLEL_MAX_THREADS)) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        status = GetPreviewGeometry(size, options, &frame_width, &width,
+                                    &height);
+    }
+    if (EXIT_SUCCESS == status) {
+        status = BitmapSetWidthHeight(bmp, width, height);
+    }
+    if (EXIT_SUCCESS == status) {
+        stride = GetPreviewStride(bmp, options->preview_format);
+        bmp->pixel_data = BitmapArenaAlloc(arena, rle ?
+                                           BITMAP_RLE8_ROW_BOUND(width) *
+                                           height : stride * height);
+        if (NULL == bmp->pixel_data) {
+            status = EXIT_FAILURE;
+        }
+    }
+    if (EXIT_SUCCESS == status) {
+        status = FrameOutputOpen(frame, altered_file_path, &output);
+    }
+
+    /* Each partition covers whole preview rows, the last one also takes
+       the frame pixels left out of the preview. */
+    band = frame_width * scale;
+    rows = (height + thread_count - 1U) / thread_count;
+    for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+        row = (i * rows < height) ? i * rows : height;
+        end = (i + 1U == thread_count) ? size :
+              ((row + rows < height) ? row + rows : height) * band;
+        tasks[i].data = &data[row * band];
+        tasks[i].size = end - row * band;
+        tasks[i].offset = row * band;
+        tasks[i].source = (NULL != frame->encoded) ? frame : NULL;
+        tasks[i].pixel_count = options->pixel_count;
+        tasks[i].engine = SELECTION_ENGINE_HISTOGRAM;
+        tasks[i].tie_break = options->tie_break;
+        if (select) {
+            tasks[i].histogram = BitmapArenaAlloc(arena,
+                                                  SELECTION_HISTOGRAM_SIZE *
+                                                  sizeof(size_t));
+        }
+
+        fused[i].frame = frame;
+        fused[i].output = &output;
+        fused[i].partition = &tasks[i];
+        fused[i].end = (i + 1U == thread_count) ? frame->size :
+                       end * sizeof(data[0]);
+        fused[i].preview.format = options->preview_format;
+        fused[i].preview.frame_width = frame_width;
+        fused[i].preview.width = width;
+        fused[i].preview.scale = scale;
+        fused[i].preview.limit = band * height;
+        fused[i].preview.stride = stride;
+        fused[i].preview.row = (uint8_t *) bmp->pixel_data + row * stride;
+        if (rle) {
+            fused[i].preview.encoded = (uint8_t *) bmp->pixel_data +
+                                       row * BITMAP_RLE8_ROW_BOUND(width);
+            fused[i].preview.row = BitmapArenaAlloc(arena, stride);
+        }
+        if ((select && (NULL == tasks[i].histogram)) ||
+            (NULL == fused[i].preview.row)) {
+            status = EXIT_FAILURE;
+        }
+        if ((EXIT_SUCCESS == status) && (1U != scale)) {
+            fused[i].preview.sums = BitmapArenaAlloc(arena, width * scale *
+                                                     sizeof(uint32_t));
+            fused[i].preview.averages = BitmapArenaAlloc(arena, width *
+                                                         sizeof(uint16_t));
+            if ((NULL == fused[i].preview.sums) ||
+                (NULL == fused[i].preview.averages)) {
+                status = EXIT_FAILURE;
+            }
+            else {
+                memset(fused[i].preview.sums, 0,
+                       width * scale * sizeof(uint32_t));
+            }
+        }
+        /* Only an in place output needs to know the adjusted blocks. */
+        if ((EXIT_SUCCESS == status) && output.in_place) {
+            fused[i].dirty_map = BitmapArenaAlloc(arena, map_size);
+            if (NULL == fused[i].dirty_map) {
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+
+    if ((EXIT_SUCCESS == status) && !select) {
+        /* The tiles go through once, without a detection pass. */
+        StatsSetEngine(stats, NULL);
+        InitThresholdSweeps(tasks, thread_count, options->threshold, factor);
+    }
+    else if (EXIT_SUCCESS == status) {
+        StatsSetEngine(stats,
+                       SelectionGetEngineName(SELECTION_ENGINE_HISTOGRAM));
+        StatsBegin(stats, STATS_STAGE_DETECT);
+        status = ParallelRun(DetectPixelsTask, tasks, sizeof(tasks[0]),
+                             thread_count);
+        for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+            status = tasks[i].status;
+        }
+        if (EXIT_SUCCESS == status) {
+            StatsAdd(stats, STATS_PIXELS_SCANNED, size);
+            status = InitPartitionSweeps(tasks, thread_count,
+                                         options->pixel_count,
+                                         options->tie_break, factor, arena);
+        }
+        StatsEnd(stats, STATS_STAGE_DETECT);
+    }
+
+    StatsBegin(stats, STATS_STAGE_FUSED);
+    if (EXIT_SUCCESS == status) {
+        status = ParallelRun(FusedTask, fused, sizeof(fused[0]),
+                             thread_count);
+    }
+    for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+        status = fused[i].status;
+        StatsAdd(stats, STATS_PIXELS_ADJUSTED, fused[i].adjusted);
+    }
+    for (i = 0; (EXIT_SUCCESS == status) && rle && (i < thread_count); i++) {
+        PackPreviewRows(bmp, (i * rows < height) ? i * rows : height,
+                        fused[i].preview.encoded, &packed);
+    }
+    if ((EXIT_SUCCESS == status) && rle) {
+        status = BitmapSetImageSize(bmp, packed);
+    }
+
+    if ((EXIT_FAILURE == FrameOutputClose(&output)) &&
+        (EXIT_SUCCESS == status)) {
+        status = EXIT_FAILURE;
+    }
+    StatsEnd(stats, STATS_STAGE_FUSED);
+    if (EXIT_SUCCESS == status) {
+        StatsAdd(stats, STATS_BYTES_WRITTEN, frame->size);
+    }
+
+    return status;
+}
+
+static void FusedTask(void *task) {
+    struct Fused_Task *fused = task;
+    struct Adjustment_Task *partition = fused->partition;
+    size_t map_size = FUSED_TILE_SIZE * sizeof(uint16_t) / FRAME_BLOCK_SIZE /
+                      8U + 1U;
+    size_t done = 0;
+    size_t count = 0;
+    size_t offset = 0;
+    int status = EXIT_SUCCESS;
+
+    for (done = 0; (EXIT_SUCCESS == status) && (done < partition->size);
+         done += count) {
+        count = (partition->size - done < FUSED_TILE_SIZE) ?
+                partition->size - done : FUSED_TILE_SIZE;
+        if (NULL != fused->dirty_map) {
+            memset(fused->dirty_map, 0, map_size);
+        }
+        FrameDecode(partition->source, partition->offset + done, count,
+                    &(partition->data[done]));
+        fused->adjusted += AdjustPixelsAboveThreshold(&(partition->data[done]),
+                                                      count,
+                                                      &(partition->sweep),
+                                                      fused->dirty_map);
+        status = FrameOutputWrite(fused->frame, fused->output,
+                                  (partition->offset + done) *
+                                  sizeof(uint16_t),
+                                  count * sizeof(uint16_t),
+                                  fused->dirty_map);
+        if (EXIT_SUCCESS == status) {
+            status = WritePreviewChunk(&(fused->preview),
+                                       &(partition->data[done]), count,
+                                       partition->offset + done);
+        }
+    }
+
+    /* A trailing odd byte isn't part of any pixel. */
+    offset = (partition->offset + partition->size) * sizeof(uint16_t);
+    if ((EXIT_SUCCESS == status) && (offset < fused->end)) {
+        status = FrameOutputWrite(fused->frame, fused->output, offset,
+                                  fused->end - offset, NULL);
+    }
+
+    fused->status = status;
+}
+
+static void GetPartition(size_t size,
+                         size_t thread_count,
+                         size_t part,
+                         size_t *start,
+                         size_t *count) {
+    size_t stripes = (size + THREAD_STRIPE_SIZE - 1U) / THREAD_STRIPE_SIZE;
+    size_t part_size = (stripes + thread_count - 1U) / thread_count *
+                       THREAD_STRIPE_SIZE;
+
+    *start = (part * part_size < size) ? part * part_size : size;
+    *count = (size - *start < part_size) ? size - *start : part_size;
+}
+
+static void DetectPixelsTask(void *task) {
+    struct Adjustment_Task *adjustment = task;
+    uint16_t *data = adjustment->data;
+    size_t size = adjustment->size;
+    size_t count = size;
+    size_t done = 0;
+
+    if (SELECTION_ENGINE_HISTOGRAM == adjustment->engine) {
+        adjustment->status = SelectionBuildHistogram(data, 0,
+                                                     adjustment->histogram);
+    }
+    else {
+        adjustment->status = SelectionHeapInit(&(adjustment->heap),
+                                               (adjustment->pixel_count <
+                                                size) ?
+                                               adjustment->pixel_count :
+                                               size,
+                                               adjustment->tie_break);
+    }
+
+    /* Encoded pixels are scanned right after decoding them, one tile at
+       a time, while they're still in the cache. */
+    for (done = 0; (EXIT_SUCCESS == adjustment->status) && (done < size);
+         done += count) {
+        if (NULL != adjustment->source) {
+            count = (size - done < FUSED_TILE_SIZE) ? size - done :
+                                                      FUSED_TILE_SIZE;
+        }
+        FrameDecode(adjustment->source, adjustment->offset + done, count,
+                    &data[done]);
+        if (SELECTION_ENGINE_HISTOGRAM == adjustment->engine) {
+            SelectionUpdateHistogram(&data[done], count,
+                                     adjustment->histogram);
+        }
+        else {
+            SelectionHeapUpdate(&(adjustment->heap), &data[done], count,
+                                adjustment->offset + done);
+        }
+    }
+
+    /* The later passes find the partition decoded. */
+    adjustment->source = NULL;
+}
+
+static void AdjustPixelsTask(void *task) {
+    struct Adjustment_Task *adjustment = task;
+    size_t size = adjustment->size;
+    size_t count = size;
+    size_t done = 0;
+
+    /* Without a detection pass, this is the one decoding the pixels. */
+    adjustment->adjusted = 0;
+    for (done = 0; done < size; done += count) {
+        if (NULL != adjustment->source) {
+            count = (size - done < FUSED_TILE_SIZE) ? size - done :
+                                                      FUSED_TILE_SIZE;
+        }
+        FrameDecode(adjustment->source, adjustment->offset + done, count,
+                    &(adjustment->data[done]));
+        adjustment->adjusted +=
+            AdjustPixelsAboveThreshold(&(adjustment->data[done]), count,
+                                       &(adjustment->sweep),
+                                       (NULL == adjustment->dirty_map) ?
+                                       NULL :
+                                       &(adjustment->dirty_map[
+                                           done / THREAD_STRIPE_SIZE]));
+    }
+}
+
+static void CompareTilesTask(void *task) {
+    struct Sequence_Task *sequence = task;
+    const uint16_t *data = NULL;
+    size_t start = 0;
+    size_t end = 0;
+    size_t tile = 0;
+    size_t i = 0;
+    uint16_t maximum = 0;
+
+    sequence->changed_count = 0;
+    for (start = 0; start < sequence->size; start = end) {
+        end = (start + SEQUENCE_TILE_SIZE < sequence->size) ?
+              start + SEQUENCE_TILE_SIZE : sequence->size;
+        data = &(sequence->data[start]);
+        FrameDecode(sequence->source, sequence->offset + start, end - start,
+                    &(sequence->data[start]));
+        sequence->changed[tile] =
+            sequence->rebuild ||
+            (0 != memcmp(data, &(sequence->previous[start]),
+                         (end - start) * sizeof(data[0])));
+        if (0 != sequence->changed[tile]) {
+            for (maximum = 0, i = 0; i < end - start; i++) {
+                maximum = (data[i] > maximum) ? data[i] : maximum;
+            }
+            sequence->maxima[tile] = maximum;
+            sequence->changed_count++;
+        }
+        tile++;
+    }
+}
+
+static void RebuildSequenceTask(void *task) {
+    struct Sequence_Task *sequence = task;
+
+    sequence->status = SelectionBuildHistogram(sequence->data,
+                                               sequence->size,
+                                               sequence->histogram);
+    memcpy(sequence->previous, sequence->data,
+           sequence->size * sizeof(sequence->data[0]));
+}
+
+static void CountEqualTask(void *task) {
+    struct Sequence_Task *sequence = task;
+    uint16_t value = sequence->sweep.threshold.value;
+    size_t start = 0;
+    size_t end = 0;
+    size_t tile = 0;
+    size_t i = 0;
+
+    sequence->equal = 0;
+    for (start = 0; start < sequence->size; start = end) {
+        end = (start + SEQUENCE_TILE_SIZE < sequence->size) ?
+              start + SEQUENCE_TILE_SIZE : sequence->size;
+        if (sequence->maxima[tile] >= value) {
+            i = start + KernelFindEqual(&(sequence->data[start]),
+                                        end - start, value);
+            while (i < end) {
+                sequence->equal++;
+                i++;
+                i += KernelFindEqual(&(sequence->data[i]), end - i, value);
+            }
+        }
+        tile++;
+    }
+}
+
+static void AdjustTilesTask(void *task) {
+    struct Sequence_Task *sequence = task;
+    size_t start = 0;
+    size_t end = 0;
+    size_t tile = 0;
+
+    /* A tile below the threshold holds neither pixels to adjust nor equal
+       pixels to count. */
+    sequence->adjusted = 0;
+    for (start = 0; start < sequence->size; start = end) {
+        end = (start + SEQUENCE_TILE_SIZE < sequence->size) ?
+              start + SEQUENCE_TILE_SIZE : sequence->size;
+        if (sequence->maxima[tile] >= sequence->sweep.threshold.value) {
+            sequence->adjusted +=
+                AdjustPixelsAboveThreshold(&(sequence->data[start]),
+                                           end - start, &(sequence->sweep),
+                                           (NULL == sequence->dirty_map) ?
+                                           NULL :
+                                           &(sequence->dirty_map[tile]));
+        }
+        tile++;
+    }
+}
+
+static void NeighborhoodTask(void *task) {
+    struct Neighborhood_Task *neighborhood = task;
+    const uint16_t *rows[KERNELS_MAX_WINDOW];
+    const uint16_t *segment[KERNELS_MAX_WINDOW];
+    size_t window = neighborhood->window;
+    size_t radius = window / 2U;
+    size_t width = neighborhood->width;
+    size_t height = neighborhood->height;
+    size_t stride = width + 2U * radius;
+    size_t block = FRAME_BLOCK_SIZE / sizeof(neighborhood->data[0]);
+    size_t start = 0;
+    size_t end = 0;
+    size_t count = 0;
+    size_t row = 0;
+    size_t y = 0;
+    size_t j = 0;
+    uint16_t *out = NULL;
+
+    /* The rows above the first one and the first ones below. */
+    neighborhood->adjusted = 0;
+    for (y = (neighborhood->first > radius) ? neighborhood->first - radius :
+                                              0;
+         (y < neighborhood->first + radius) && (y < height); y++) {
+        LoadNeighborhoodRow(neighborhood, y);
+    }
+
+    for (y = neighborhood->first; y < neighborhood->end; y++) {
+        if (y + radius < height) {
+            LoadNeighborhoodRow(neighborhood, y + radius);
+        }
+        for (j = 0; j < window; j++) {
+            row = (y + j < radius) ? 0 : y + j - radius;
+            row = (row < height) ? row : height - 1U;
+            rows[j] = &neighborhood->ring[row % window * stride + radius];
+        }
+        out = &neighborhood->data[y * width];
+
+        /* With a dirty map, the row goes one dirty map block at a time. */
+        for (start = 0; start < width; start = end) {
+            end = (NULL == neighborhood->dirty_map) ? width :
+                  (y * width + start) / block * block + block - y * width;
+            end = (end < width) ? end : width;
+            for (j = 0; j < window; j++) {
+                segment[j] = rows[j] + start;
+            }
+            count = KernelScaleAboveMedian(&out[start], segment, window,
+                                           end - start,
+                                           neighborhood->margin,
+                                           neighborhood->factor);
+            if ((NULL != neighborhood->dirty_map) && (count > 0)) {
+                FRAME_MARK_PIXEL(neighborhood->dirty_map, y * width + start);
+            }
+            neighborhood->adjusted += count;
+        }
+    }
+}
+
+static void LoadNeighborhoodRow(struct Neighborhood_Task *neighborhood,
+                                size_t row) {
+    size_t width = neighborhood->width;
+    size_t radius = neighborhood->window / 2U;
+    const uint16_t *source = &neighborhood->data[row * width];
+    uint16_t *copy = &neighborhood->ring[row % neighborhood->window *
+                                         (width + 2U * radius)];
+    size_t i = 0;
+
+    if (row < neighborhood->first) {
+        source = &neighborhood->halo[(row + radius - neighborhood->first) *
+                                     width];
+    }
+    else if (row >= neighborhood->end) {
+        source = &neighborhood->halo[(row + radius - neighborhood->end) *
+                                     width];
+    }
+    else {
+        /* Each partition row is loaded once, before being adjusted. */
+        FrameDecode(neighborhood->source, row * width, width,
+                    &neighborhood->data[row * width]);
+    }
+
+    memcpy(&copy[radius], source, width * sizeof(source[0]));
+    for (i = 0; i < radius; i++) {
+        copy[i] = source[0];
+        copy[radius + width + i] = source[width - 1U];
+    }
+}
+
+static void DownscaleTask(void *task) {
+    struct Downscale_Task *downscale = task;
+    const uint16_t *data = downscale->data;
+    uint8_t *out = downscale->out;
+    size_t row_size = BitmapGetFormatSize(downscale->format, downscale->width);
+    size_t scale = downscale->scale;
+    size_t row = 0;
+    size_t i = 0;
+
+    for (row = 0; row < downscale->rows; row++) {
+        if (1U == scale) {
+            ConvertPreviewPixels(downscale->format, data, downscale->width,
+                                 out);
+        }
+        else {
+            for (i = 0; i < scale; i++) {
+                AddPreviewSums(&data[i * downscale->frame_width],
+                               downscale->width * scale, 0,
+                               downscale->width * scale, downscale->sums);
+            }
+            AveragePreviewSums(downscale->sums, downscale->width, scale,
+                               downscale->averages);
+            ConvertPreviewPixels(downscale->format, downscale->averages,
+                                 downscale->width, out);
+        }
+        data += downscale->frame_width * scale;
+        if (NULL != downscale->encoded) {
+            /* The row is encoded right away, its buffer reused. */
+            downscale->encoded += BitmapEncodeRle8Row(out, downscale->width,
+                                                      downscale->last &&
+                                                      (row + 1U ==
+                                                       downscale->rows),
+                                                      downscale->encoded);
+        }
+        else {
+            memset(out + row_size, 0, downscale->stride - row_size);
+            out += downscale->stride;
+        }
+    }
+}
+
+static void AddPreviewSums(const uint16_t *data,
+                           size_t count,
+                           size_t column,
+                           size_t limit,
+                           uint32_t *sums) {
+    if (column < limit) {
+        KernelAccumulate(data, (count < limit - column) ? count :
+                                                          limit - column,
+                         &sums[column]);
+    }
+}
+
+static void AveragePreviewSums(uint32_t *sums,
+                               size_t count,
+                               size_t scale,
+                               uint16_t *averages) {
+    uint32_t area = scale * scale;
+    uint32_t sum = 0;
+    size_t i = 0;
+    size_t j = 0;
+
+    for (i = 0; i < count; i++) {
+        for (sum = 0, j = 0; j < scale; j++) {
+            sum += sums[j];
+            sums[j] = 0;
+        }
+        /* Round half up, in 64 bits since sum may be near 2^32. */
+        averages[i] = ((uint64_t) sum + area / 2U) / area;
+        sums += scale;
+    }
+}
+
+static int WritePreviewChunk(struct Preview_Stream *stream,
+                             const uint16_t *data,
+                             size_t count,
+                             size_t offset) {
+    size_t frame_width = stream->frame_width;
+    size_t done = 0;
+    size_t column = 0;
+    size_t segment = 0;
+    size_t row = 0;
+    size_t row_size = 0;
+    int status = EXIT_SUCCESS;
+
+    if (offset >= stream->limit) {
+        count = 0;
+    }
+    else if (count > stream->limit - offset) {
+        count = stream->limit - offset;
+    }
+
+    /* Go through the chunk one frame row segment at a time. */
+    for (done = 0; (EXIT_SUCCESS == status) && (done < count);
+         done += segment) {
+        row = (offset + done) / frame_width;
+        column = (offset + done) % frame_width;
+        segment = (frame_width - column < count - done) ?
+                  frame_width - column : count - done;
+
+        if (1U == stream->scale) {
+            /* Without downsampling, frame and preview columns match. */
+            ConvertPreviewPixels(stream->format, &data[done], segment,
+                                 stream->row +
+                                 BitmapGetFormatSize(stream->format, column));
+        }
+        else {
+            AddPreviewSums(&data[done], segment, column,
+                           stream->width * stream->scale, stream->sums);
+        }
+
+        /* The preview row is complete with the last row of its boxes. */
+        if ((column + segment == frame_width) &&
+            (0 == (row + 1U) % stream->scale)) {
+            if (1U != stream->scale) {
+                AveragePreviewSums(stream->sums, stream->width,
+                                   stream->scale, stream->averages);
+                ConvertPreviewPixels(stream->format, stream->averages,
+                                     stream->width, stream->row);
+            }
+            if (NULL != stream->out) {
+                status = WriteBytesToFile(stream->out, stream->row,
+                                          stream->stride);
+            }
+            else if (NULL != stream->encoded) {
+                /* The row is encoded right away, its buffer reused. */
+                stream->encoded += BitmapEncodeRle8Row(stream->row,
+                                                       stream->width,
+                                                       (row + 1U) *
+                                                       frame_width ==
+                                                       stream->limit,
+                                                       stream->encoded);
+            }
+            else {
+                /* Rows kept in memory are cleared up to the next one. */
+                row_size = BitmapGetFormatSize(stream->format,
+                                               stream->width);
+                memset(stream->row + row_size, 0, stream->stride - row_size);
+                stream->row += stream->stride;
+            }
+        }
+    }
+
+    return status;
+}
+
+static void AdjustPixel(uint16_t *pixel, float factor, size_t repeats) {
+    uint16_t value = 0;
+
+    *pixel = KernelScalePixel(*pixel, factor);
+    while ((repeats > 0) && (value != *pixel)) {
+        value = *pixel;
+        *pixel = KernelScalePixel(*pixel, factor);
+        repeats--;
+    }
+}
+
+static void InitAdjustmentSweep(struct Adjustment_Sweep *sweep,
+                                const struct Selection_Threshold *threshold,
+                                enum Selection_Tie_Break tie_break,
+                                float factor,
+                                size_t pixel_count) {
+    size_t selected = threshold->above + threshold->quota;
+
+    memset(sweep, 0, sizeof(*sweep));
+    sweep->threshold = *threshold;
+    sweep->factor = factor;
+    if (pixel_count > selected) {
+        sweep->repeats = pixel_count - selected;
+    }
+
+    /* With the last policy, the first equal pixels are skipped and
+       the lowest ranked one is the first adjusted. Otherwise, it's the
+       last adjusted one. */
+    if (SELECTION_TIE_BREAK_LAST == tie_break) {
+        sweep->equal_skip = threshold->equal - threshold->quota;
+        sweep->equal_lowest = sweep->equal_skip;
+    }
+    else if (threshold->quota > 0) {
+        sweep->equal_lowest = threshold->quota - 1;
+    }
+}
+
+static size_t AdjustPixelsAboveThreshold(uint16_t *data,
+                                         size_t size,
+                                         struct Adjustment_Sweep *sweep,
+                                         uint8_t *dirty_map) {
+    size_t i = 0;
+    size_t start = 0;
+    size_t end = 0;
+    size_t count = 0;
+    size_t scaled = 0;
+    bool adjusted = false;
+    uint16_t value = sweep->threshold.value;
+    size_t equal_end = sweep->equal_skip + sweep->threshold.quota;
+
+    /* The frame is processed one dirty map block at a time. */
+    for (start = 0; start < size; start = end) {
+        end = start + FRAME_BLOCK_SIZE / sizeof(data[0]);
+        if (end > size) {
+            end = size;
+        }
+        adjusted = false;
+
+        /* The equal pixels go first: once adjusted, they can't be above
+           the threshold anymore, so the scaling below skips them. Without
+           a quota, none of them is adjusted. */
+        i = (0 == sweep->threshold.quota) ? end :
+            start + KernelFindEqual(&data[start], end - start, value);
+        while (i < end) {
+            if ((sweep->equal_seen >= sweep->equal_skip) &&
+                (sweep->equal_seen < equal_end)) {
+                AdjustPixel(&data[i], sweep->factor,
+                            (sweep->equal_seen == sweep->equal_lowest) ?
+                            sweep->repeats : 0);
+                adjusted = true;
+                count++;
+            }
+            sweep->equal_seen++;
+            i++;
+            i += KernelFindEqual(&data[i], end - i, value);
+        }
+
+        scaled = KernelScaleAbove(&data[start], end - start, value,
+                                  sweep->factor);
+        if (scaled > 0) {
+            adjusted = true;
+            count += scaled;
+        }
+        if ((NULL != dirty_map) && adjusted) {
+            FRAME_MARK_PIXEL(dirty_map, start);
+        }
+    }
+
+    return count;
+}
+
+static int GeneratePreviewBitmapFrom16Bit(const uint16_t *data, 
+                                          size_t size,
+                                          const struct Delite_Options
+                                              *options,
+                                          struct Delite_Context *context,
+                                          void *pixel_data) {
+    struct Downscale_Task tasks[PARALLEL_MAX_THREADS];
+    struct Bitmap *bmp = NULL;
+    enum Bitmap_Format format = options->preview_format;
+    size_t thread_count = options->thread_count;
+    size_t scale = options->preview_scale;
+    size_t frame_width = 0;
+    size_t stride = 0;
+    size_t rows = 0;
+    size_t row = 0;
+    size_t packed = 0;
+    size_t i = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    bool rle = false;
+    int status = EXIT_SUCCESS;
+    
+    if ((NULL == data) || (NULL == context) ||
+        (NULL == context->preview) || (0 == thread_count) ||
+        (thread_count > PARALLEL_MAX_THREADS)) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        bmp = context->preview;
+        status = GetPreviewGeometry(size, options, &frame_width, &width,
+                                    &height);
+    }
+    if (EXIT_SUCCESS == status) {
+        status = BitmapSetWidthHeight(bmp, width, height);
+    }
+
+    if (EXIT_SUCCESS == status) {
+        rle = (BITMAP_COMPRESSION_RLE8 == bmp->info_header.compression);
+        stride = GetPreviewStride(bmp, format);
+        bmp->pixel_data = (NULL != pixel_data) ? pixel_data :
+                          BitmapArenaAlloc(&(context->arena),
+                                           rle ? BITMAP_RLE8_ROW_BOUND(width) *
+                                                 height :
+                                                 stride * height);
+        if (NULL == bmp->pixel_data) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    rows = (height + thread_count - 1U) / thread_count;
+    for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+        row = (i * rows < height) ? i * rows : height;
+        tasks[i].data = &data[row * scale * frame_width];
+        tasks[i].frame_width = frame_width;
+        tasks[i].width = width;
+        tasks[i].scale = scale;
+        tasks[i].rows = (height - row < rows) ? height - row : rows;
+        tasks[i].out = (uint8_t *) bmp->pixel_data + row * stride;
+        tasks[i].stride = stride;
+        tasks[i].format = format;
+        tasks[i].encoded = NULL;
+        tasks[i].last = (row + tasks[i].rows == height);
+        if (rle) {
+            tasks[i].encoded = (uint8_t *) bmp->pixel_data +
+                               row * BITMAP_RLE8_ROW_BOUND(width);
+            tasks[i].out = BitmapArenaAlloc(&(context->arena), stride);
+            if (NULL == tasks[i].out) {
+                status = EXIT_FAILURE;
+            }
+        }
+        if (1U != scale) {
+            /* Each thread needs its own row of box sums. */
+            tasks[i].sums = BitmapArenaAlloc(&(context->arena),
+                                             width * scale *
+                                             sizeof(uint32_t));
+            tasks[i].averages = BitmapArenaAlloc(&(context->arena),
+                                                 width * sizeof(uint16_t));
+            if ((NULL == tasks[i].sums) || (NULL == tasks[i].averages)) {
+                status = EXIT_FAILURE;
+            }
+            else {
+                memset(tasks[i].sums, 0, width * scale * sizeof(uint32_t));
+            }
+        }
+    }
+    if (EXIT_SUCCESS == status) {
+        status = ParallelRun(DownscaleTask, tasks, sizeof(tasks[0]),
+                             thread_count);
+    }
+    for (i = 0; (EXIT_SUCCESS == status) && rle && (i < thread_count); i++) {
+        PackPreviewRows(bmp, (i * rows < height) ? i * rows : height,
+                        tasks[i].encoded, &packed);
+    }
+    if ((EXIT_SUCCESS == status) && rle) {
+        status = BitmapSetImageSize(bmp, packed);
+    }
+    
+    return status;
+}
+
+static int WritePyramid(const uint16_t *data,
+                        size_t size,
+                        const char *directory,
+                        struct Delite_Context *context) {
+    struct Pyramid_Task tasks[PARALLEL_MAX_THREADS];
+    struct Delite_Options base = context->options;
+    char path[PATH_MAX];
+    size_t thread_count = base.thread_count;
+    size_t row_size = 0;
+    size_t tile_size = 0;
+    size_t frame_width = 0;
+    size_t level = 0;
+    size_t i = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    bool rle = false;
+    bool done = false;
+    int status = EXIT_SUCCESS;
+
+    memset(tasks, 0, sizeof(tasks));
+    if ((NULL == data) || (NULL == directory) ||
+        (NULL == context->preview) || (0 == thread_count) ||
+        (thread_count > PARALLEL_MAX_THREADS)) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        /* The pyramid starts from the frame at full resolution. */
+        base.preview_scale = 1U;
+        status = GetPreviewGeometry(size, &base, &frame_width, &width,
+                                    &height);
+    }
+    if (EXIT_SUCCESS == status) {
+        status = CreateDirectory(directory);
+        rle = (BITMAP_COMPRESSION_RLE8 ==
+               context->preview->info_header.compression);
+        /* Full tile rows are a whole number of words already. */
+        row_size = BitmapGetFormatSize(base.preview_format,
+                                       DELITE_PYRAMID_TILE_SIZE);
+        tile_size = (rle ? BITMAP_RLE8_ROW_BOUND(DELITE_PYRAMID_TILE_SIZE) :
+                           row_size) * DELITE_PYRAMID_TILE_SIZE;
+    }
+
+    /* Each thread keeps its tile buffers from one level to the next. */
+    for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+        tasks[i].source = data;
+        tasks[i].level = NULL;
+        tasks[i].width = width;
+        tasks[i].height = height;
+        tasks[i].first = i;
+        tasks[i].step = thread_count;
+        tasks[i].directory = path;
+        tasks[i].preview = context->preview;
+        tasks[i].format = base.preview_format;
+        tasks[i].pixel_data = BitmapArenaAlloc(&(context->arena), tile_size);
+        tasks[i].row = BitmapArenaAlloc(&(context->arena), row_size);
+        if ((NULL == tasks[i].pixel_data) || (NULL == tasks[i].row)) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    for (level = 0; (EXIT_SUCCESS == status) && !done; level++) {
+        if (0 != level) {
+            /* The level halves the previous one, rounded up. */
+            tasks[0].source = (NULL == tasks[0].level) ? data :
+                                                         tasks[0].level;
+            tasks[0].source_width = tasks[0].width;
+            tasks[0].source_height = tasks[0].height;
+            tasks[0].width = (tasks[0].width + 1U) / 2U;
+            tasks[0].height = (tasks[0].height + 1U) / 2U;
+            tasks[0].level = BitmapArenaAlloc(&(context->arena),
+                                              tasks[0].width *
+                                              tasks[0].height *
+                                              sizeof(uint16_t));
+            if (NULL == tasks[0].level) {
+                status = EXIT_FAILURE;
+            }
+        }
+        if ((size_t) snprintf(path, sizeof(path), "%s/%zu", directory,
+                              level) >= sizeof(path)) {
+            status = EXIT_FAILURE;
+        }
+        if (EXIT_SUCCESS == status) {
+            status = CreateDirectory(path);
+        }
+        for (i = 1; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+            tasks[i].source = tasks[0].source;
+            tasks[i].source_width = tasks[0].source_width;
+            tasks[i].source_height = tasks[0].source_height;
+            tasks[i].level = tasks[0].level;
+            tasks[i].width = tasks[0].width;
+            tasks[i].height = tasks[0].height;
+        }
+        if (EXIT_SUCCESS == status) {
+            status = ParallelRun(PyramidTask, tasks, sizeof(tasks[0]),
+                                 thread_count);
+        }
+        for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+            status = tasks[i].status;
+        }
+        done = (tasks[0].width <= DELITE_PYRAMID_TILE_SIZE) &&
+               (tasks[0].height <= DELITE_PYRAMID_TILE_SIZE);
+    }
+
+    for (i = 0; i < thread_count; i++) {
+        StatsAdd(context->stats, STATS_BYTES_WRITTEN, tasks[i].written);
+    }
+
+    return status;
+}
+
+static void PyramidTask(void *task) {
+    struct Pyramid_Task *pyramid = task;
+    char path[PATH_MAX];
+    const uint16_t *pixels = NULL;
+    size_t columns = (pyramid->width + DELITE_PYRAMID_TILE_SIZE - 1U) /
+                     DELITE_PYRAMID_TILE_SIZE;
+    size_t rows = (pyramid->height + DELITE_PYRAMID_TILE_SIZE - 1U) /
+                  DELITE_PYRAMID_TILE_SIZE;
+    size_t column = 0;
+    size_t row = 0;
+    size_t width = 0;
+    size_t height = 0;
+    size_t tile = 0;
+
+    pyramid->status = EXIT_SUCCESS;
+    for (tile = pyramid->first;
+         (EXIT_SUCCESS == pyramid->status) && (tile < columns * rows);
+         tile += pyramid->step) {
+        column = tile % columns * DELITE_PYRAMID_TILE_SIZE;
+        row = tile / columns * DELITE_PYRAMID_TILE_SIZE;
+        width = (pyramid->width - column < DELITE_PYRAMID_TILE_SIZE) ?
+                pyramid->width - column : DELITE_PYRAMID_TILE_SIZE;
+        height = (pyramid->height - row < DELITE_PYRAMID_TILE_SIZE) ?
+                 pyramid->height - row : DELITE_PYRAMID_TILE_SIZE;
+
+        if (NULL == pyramid->level) {
+            pixels = &(pyramid->source[row * pyramid->width + column]);
+        }
+        else {
+            AveragePyramidTile(pyramid, column, row, width, height);
+            pixels = &(pyramid->level[row * pyramid->width + column]);
+        }
+        if ((size_t) snprintf(path, sizeof(path), "%s/%zu_%zu.%s",
+                              pyramid->directory, tile % columns,
+                              tile / columns,
+                              BitmapGetFormatExtension(pyramid->format)) >=
+            sizeof(path)) {
+            pyramid->status = EXIT_FAILURE;
+        }
+        else {
+            pyramid->status = WritePyramidTile(pyramid, pixels,
+                                               pyramid->width, width, height,
+                                               path);
+        }
+    }
+}
+
+static void AveragePyramidTile(const struct Pyramid_Task *pyramid,
+                               size_t column,
+                               size_t row,
+                               size_t width,
+                               size_t height) {
+    const uint16_t *top = NULL;
+    const uint16_t *bottom = NULL;
+    uint16_t *out = &(pyramid->level[row * pyramid->width + column]);
+    size_t left = 0;
+    size_t right = 0;
+    size_t i = 0;
+    size_t j = 0;
+
+    for (i = 0; i < height; i++) {
+        top = &(pyramid->source[2U * (row + i) * pyramid->source_width]);
+        bottom = (2U * (row + i) + 1U < pyramid->source_height) ?
+                 top + pyramid->source_width : top;
+        for (j = 0; j < width; j++) {
+            left = 2U * (column + j);
+            right = (left + 1U < pyramid->source_width) ? left + 1U : left;
+            out[j] = ((uint32_t) top[left] + top[right] + bottom[left] +
+                      bottom[right] + 2U) / 4U;
+        }
+        out += pyramid->width;
+    }
+}
+
+static int WritePyramidTile(struct Pyramid_Task *pyramid,
+                            const uint16_t *pixels,
+                            size_t stride,
+                            uint32_t width,
+                            uint32_t height,
+                            const char *path) {
+    struct Bitmap tile = *(pyramid->preview);
+    enum Bitmap_Format format = pyramid->format;
+    uint8_t *encoded = pyramid->pixel_data;
+    uint8_t *pixel_row = pyramid->pixel_data;
+    size_t row_size = BitmapGetFormatSize(format, width);
+    size_t tile_stride = 0;
+    size_t i = 0;
+    bool rle = (BITMAP_COMPRESSION_RLE8 == tile.info_header.compression);
+    int status = EXIT_SUCCESS;
+
+    status = BitmapSetWidthHeight(&tile, width, height);
+    if (EXIT_SUCCESS == status) {
+        tile_stride = GetPreviewStride(&tile, format);
+        for (i = 0; i < height; i++) {
+            if (rle) {
+                ConvertPreviewPixels(format, &pixels[i * stride], width,
+                                     pyramid->row);
+                encoded += BitmapEncodeRle8Row(pyramid->row, width,
+                                               i + 1U == height, encoded);
+            }
+            else {
+                ConvertPreviewPixels(format, &pixels[i * stride], width,
+                                     pixel_row);
+                memset(pixel_row + row_size, 0, tile_stride - row_size);
+                pixel_row += tile_stride;
+            }
+        }
+        tile.pixel_data = pyramid->pixel_data;
+        if (rle) {
+            status = BitmapSetImageSize(&tile,
+                                        encoded - pyramid->pixel_data);
+        }
+    }
+
+    if (EXIT_SUCCESS == status) {
+        status = WritePreviewFile(&tile, format, path, &(pyramid->written));
+    }
+
+    return status;
+}
+
+static int CreateDirectory(const char *path) {
+    int status = EXIT_SUCCESS;
+
+    if ((0 != mkdir(path, 0777)) && (EEXIST != errno)) {
+        status = EXIT_FAILURE;
+    }
+
+    return status;
+}
+
+static int GetVolumeSliceSize(size_t size,
+                              const struct Delite_Options *options,
+                              size_t *slice_size) {
+    size_t depth = options->depth;
+    int status = EXIT_SUCCESS;
+
+    if ((0 != options->width) && (0 != options->height)) {
+        *slice_size = (size_t) options->width * options->height;
+    }
+    else {
+        *slice_size = (0 != depth) ? size / depth : 0;
+    }
+    if ((0 == depth) || (0 == *slice_size) || (0 != size % depth) ||
+        (size / depth != *slice_size) ||
+        ((0 != options->width) && (0 != *slice_size % options->width)) ||
+        ((0 != options->height) && (0 != *slice_size % options->height))) {
+        status = EXIT_FAILURE;
+    }
+
+    return status;
+}
+
+static int WriteVolumePreviews(const uint16_t *data,
+                               size_t size,
+                               const struct Delite_Options *options,
+                               const char *pattern,
+                               const char *input_path,
+                               struct Delite_Context *context) {
+    struct Volume_Task tasks[PARALLEL_MAX_THREADS];
+    struct Bitmap *bmp = context->preview;
+    char path[PATH_MAX];
+    size_t depth = options->depth;
+    size_t thread_count = options->thread_count;
+    size_t scale = options->preview_scale;
+    size_t slice_size = 0;
+    size_t frame_width = 0;
+    size_t stride = 0;
+    size_t buffer_size = 0;
+    size_t written = 0;
+    size_t next = 0;
+    size_t slice = 0;
+    size_t i = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    bool rle = false;
+    int status = EXIT_SUCCESS;
+
+    memset(tasks, 0, sizeof(tasks));
+    if ((NULL == data) || (NULL == pattern) || (NULL == input_path) ||
+        (NULL == bmp) || (0 == depth) || (0 == thread_count) ||
+        (thread_count > PARALLEL_MAX_THREADS)) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        status = GetVolumeSliceSize(size, options, &slice_size);
+    }
+    if (EXIT_SUCCESS == status) {
+        status = GetPreviewGeometry(slice_size, options, &frame_width,
+                                    &width, &height);
+    }
+    if (EXIT_SUCCESS == status) {
+        status = BitmapSetWidthHeight(bmp, width, height);
+    }
+    if (EXIT_SUCCESS == status) {
+        rle = (BITMAP_COMPRESSION_RLE8 == bmp->info_header.compression);
+        stride = GetPreviewStride(bmp, options->preview_format);
+        buffer_size = rle ? BITMAP_RLE8_ROW_BOUND(width) * height :
+                            stride * height;
+    }
+
+    if ((EXIT_SUCCESS == status) && (depth < thread_count)) {
+        /* Too few slices to go around, the rows are split instead. */
+        bmp->pixel_data = BitmapArenaAlloc(&(context->arena), buffer_size);
+        if (NULL == bmp->pixel_data) {
+            status = EXIT_FAILURE;
+        }
+        for (slice = 0; (EXIT_SUCCESS == status) && (slice < depth);
+             slice++) {
+            status = GeneratePreviewBitmapFrom16Bit(&data[slice *
+                                                          slice_size],
+                                                    slice_size, options,
+                                                    context,
+                                                    bmp->pixel_data);
+            if (EXIT_SUCCESS == status) {
+                status = ExpandPathPattern(pattern, input_path, slice, path,
+                                           sizeof(path));
+            }
+            if (EXIT_SUCCESS == status) {
+                status = WritePreviewFile(bmp, options->preview_format,
+                                          path, &written);
+            }
+        }
+    }
+    else {
+        /* Each thread keeps its buffers from one slice to the next. */
+        for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+            tasks[i].data = data;
+            tasks[i].slice_size = slice_size;
+            tasks[i].depth = depth;
+            tasks[i].next = &next;
+            tasks[i].pattern = pattern;
+            tasks[i].input_path = input_path;
+            tasks[i].preview = bmp;
+            tasks[i].format = options->preview_format;
+            tasks[i].pixel_data = BitmapArenaAlloc(&(context->arena),
+                                                   buffer_size);
+            tasks[i].downscale.frame_width = frame_width;
+            tasks[i].downscale.width = width;
+            tasks[i].downscale.scale = scale;
+            tasks[i].downscale.rows = height;
+            tasks[i].downscale.out = tasks[i].pixel_data;
+            tasks[i].downscale.stride = stride;
+            tasks[i].downscale.format = options->preview_format;
+            tasks[i].downscale.encoded = NULL;
+            tasks[i].downscale.last = true;
+            if (rle) {
+                tasks[i].downscale.encoded = tasks[i].pixel_data;
+                tasks[i].downscale.out = BitmapArenaAlloc(&(context->arena),
+                                                          stride);
+            }
+            if ((NULL == tasks[i].pixel_data) ||
+                (NULL == tasks[i].downscale.out)) {
+                status = EXIT_FAILURE;
+            }
+            else if (1U != scale) {
+                tasks[i].downscale.sums = BitmapArenaAlloc(
+                                              &(context->arena),
+                                              width * scale *
+                                              sizeof(uint32_t));
+                tasks[i].downscale.averages = BitmapArenaAlloc(
+                                                  &(context->arena),
+                                                  width * sizeof(uint16_t));
+                if ((NULL == tasks[i].downscale.sums) ||
+                    (NULL == tasks[i].downscale.averages)) {
+                    status = EXIT_FAILURE;
+                }
+                else {
+                    memset(tasks[i].downscale.sums, 0,
+                           width * scale * sizeof(uint32_t));
+                }
+            }
+        }
+        if (EXIT_SUCCESS == status) {
+            status = ParallelRun(VolumeTask, tasks, sizeof(tasks[0]),
+                                 thread_count);
+        }
+        for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+            status = tasks[i].status;
+        }
+        for (i = 0; i < thread_count; i++) {
+            written += tasks[i].written;
+        }
+    }
+
+    StatsAdd(context->stats, STATS_BYTES_WRITTEN, written);
+
+    return status;
+}
+
+static void VolumeTask(void *task) {
+    struct Volume_Task *volume = task;
+    struct Bitmap preview = *(volume->preview);
+    struct Downscale_Task downscale;
+    char path[PATH_MAX];
+    size_t slice = 0;
+
+    preview.pixel_data = volume->pixel_data;
+    volume->status = EXIT_SUCCESS;
+    for (slice = __atomic_fetch_add(volume->next, 1U, __ATOMIC_RELAXED);
+         (EXIT_SUCCESS == volume->status) && (slice < volume->depth);
+         slice = __atomic_fetch_add(volume->next, 1U, __ATOMIC_RELAXED)) {
+        /* The conversion starts over from the slice buffers each time. */
+        downscale = volume->downscale;
+        downscale.data = &(volume->data[slice * volume->slice_size]);
+        DownscaleTask(&downscale);
+        if (NULL != downscale.encoded) {
+            volume->status = BitmapSetImageSize(&preview,
+                                                downscale.encoded -
+                                                volume->pixel_data);
+        }
+        if (EXIT_SUCCESS == volume->status) {
+            volume->status = ExpandPathPattern(volume->pattern,
+                                               volume->input_path, slice,
+                                               path, sizeof(path));
+        }
+        if (EXIT_SUCCESS == volume->status) {
+            volume->status = WritePreviewFile(&preview, volume->format,
+                                              path, &(volume->written));
+        }
+    }
+}
+
+static int WritePreviewFile(const struct Bitmap *bmp,
+                            enum Bitmap_Format format,
+                            const char *path,
+                            size_t *written) {
+    FILE *out = fopen(path, "wb");
+    int status = EXIT_SUCCESS;
+
+    status = WritePreviewToFile(out, bmp, format);
+    if ((NULL != out) && (0 != fclose(out))) {
+        status = EXIT_FAILURE;
+    }
+    if (EXIT_SUCCESS == status) {
+        *written += (BITMAP_FORMAT_BMP == format) ?
+                    bmp->header.file_size :
+                    CopyPreviewHeader(bmp, format, NULL) +
+                    GetPreviewStride(bmp, format) * bmp->info_header.height;
+    }
+
+    return status;
+}
+
+int DeliteInit(struct Delite_Context *context,
+               const struct Delite_Options *options) {
+    int status = EXIT_SUCCESS;
+
+    memset(context, 0, sizeof(*context));
+    BitmapArenaInit(&(context->arena));
+    context->options = *options;
+
+    /* The CLI checks the same limits, other callers may not. */
+    if ((options->adjustment_level > 100U) ||
+        (0 == options->thread_count) ||
+        (options->thread_count > PARALLEL_MAX_THREADS) ||
+        (0 == options->preview_scale) ||
+        (options->preview_scale > DELITE_PREVIEW_MAX_SCALE) ||
+        (options->preview_rle &&
+         (BITMAP_FORMAT_BMP != options->preview_format)) ||
+        ((DELITE_MODE_COUNT == options->mode) &&
+         (0 == options->pixel_count)) ||
+        ((DELITE_MODE_PERCENTILE == options->mode) &&
+         !((options->percentile > 0) && (options->percentile <= 100))) ||
+        ((DELITE_MODE_NEIGHBORHOOD == options->mode) &&
+         (options->streaming ||
+          ((3U != options->median_window) &&
+           (5U != options->median_window)))) ||
+        ((FRAME_PIXEL_U16LE != options->pixel_format) &&
+         options->streaming) ||
+        ((0 != options->depth) &&
+         (options->streaming ||
+          (DELITE_MODE_NEIGHBORHOOD == options->mode))) ||
+        (((CODEC_FORMAT_DELTA == options->altered_format) ||
+          options->patch_input) &&
+         (options->streaming ||
+          (FRAME_PIXEL_U16LE != options->pixel_format))) ||
+        (options->patch_input &&
+         (CODEC_FORMAT_LZ4 == options->altered_format))) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        status = BitmapInit8BitGrayscale(&(context->preview),
+                                         options->preview_rle ?
+                                         BITMAP_COMPRESSION_RLE8 :
+                                         BITMAP_COMPRESSION_RGB);
+    }
+
+    return status;
+}
+
+void DeliteFree(struct Delite_Context *context) {
+    if (NULL != context->preview) {
+        free(context->preview->color_table);
+    }
+
+    /* Free tolerates NULL, no need to check. */
+    free(context->preview);
+    FreeSequence(context->sequence);
+    BitmapArenaFree(&(context->arena));
+    memset(context, 0, sizeof(*context));
+}
+
+int DeliteAdjust(struct Delite_Context *context, uint16_t *data, size_t size) {
+    struct Delite_Options options;
+    int status = EXIT_SUCCESS;
+
+    /* Everything allocated for the previous frame goes away at once. */
+    BitmapArenaReset(&(context->arena));
+    ResolveAdjustmentMode(&(context->options), size, &options);
+
+    status = AdjustFrame(context, &options, data, size, NULL, NULL);
+    if (EXIT_SUCCESS == status) {
+        StatsAdd(context->stats, STATS_FRAMES, 1U);
+    }
+
+    return status;
+}
+
+int DeliteGetPreviewSize(struct Delite_Context *context,
+                         size_t size,
+                         size_t *preview_size) {
+    enum Bitmap_Format format = context->options.preview_format;
+    struct Bitmap *bmp = context->preview;
+    size_t frame_width = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    int status = EXIT_SUCCESS;
+
+    status = GetPreviewGeometry(size, &(context->options), &frame_width,
+                                &width, &height);
+    if (EXIT_SUCCESS == status) {
+        status = BitmapSetWidthHeight(bmp, width, height);
+    }
+    if (EXIT_SUCCESS == status) {
+        *preview_size = CopyPreviewHeader(bmp, format, NULL) +
+                        (context->options.preview_rle ?
+                         BITMAP_RLE8_ROW_BOUND(width) :
+                         GetPreviewStride(bmp, format)) * height;
+    }
+
+    return status;
+}
+
+int DeliteRenderPreview(struct Delite_Context *context,
+                        const uint16_t *data,
+                        size_t size,
+                        void *preview,
+                        size_t preview_size,
+                        size_t *rendered) {
+    enum Bitmap_Format format = context->options.preview_format;
+    size_t header_size = 0;
+    size_t needed = 0;
+    int status = EXIT_SUCCESS;
+
+    BitmapArenaReset(&(context->arena));
+    StatsBegin(context->stats, STATS_STAGE_PREVIEW);
+    status = DeliteGetPreviewSize(context, size, &needed);
+    if ((EXIT_SUCCESS == status) &&
+        ((NULL == preview) || (preview_size < needed))) {
+        status = EXIT_FAILURE;
+    }
+    if (EXIT_SUCCESS == status) {
+        header_size = CopyPreviewHeader(context->preview, format, NULL);
+        status = GeneratePreviewBitmapFrom16Bit(data, size,
+                                                &(context->options), context,
+                                                (uint8_t *) preview +
+                                                header_size);
+    }
+
+    /* The header goes last, once the encoded size is known. */
+    if (EXIT_SUCCESS == status) {
+        CopyPreviewHeader(context->preview, format, preview);
+        if (NULL != rendered) {
+            *rendered = context->options.preview_rle ?
+                        context->preview->header.file_size : needed;
+        }
+    }
+    StatsEnd(context->stats, STATS_STAGE_PREVIEW);
+
+    /* The preview rows belong to the caller. */
+    context->preview->pixel_data = NULL;
+
+    return status;
+}
+
+int DeliteWritePyramid(struct Delite_Context *context,
+                       const uint16_t *data,
+                       size_t size,
+                       const char *directory) {
+    int status = EXIT_SUCCESS;
+
+    BitmapArenaReset(&(context->arena));
+    StatsBegin(context->stats, STATS_STAGE_PREVIEW);
+    status = WritePyramid(data, size, directory, context);
+    StatsEnd(context->stats, STATS_STAGE_PREVIEW);
+
+    return status;
+}
+
+static int GetPreviewGeometry(size_t size,
+                              const struct Delite_Options *options,
+                              size_t *frame_width,
+                              uint32_t *width,
+                              uint32_t *height) {
+    int status = EXIT_SUCCESS;
+
+    *width = options->width;
+    *height = options->height;
+
+    if ((0 == *width) && (0 == *height)) {
+        *width = (sqrt(size) < PREVIEW_MAX_WIDTH) ? sqrt(size) :
+                                                    PREVIEW_MAX_WIDTH;
+        /* Keep the square preview width a multiple of 4. */
+        *width &= ~0x03U;
+        *height = *width;
+    }
+    else if (0 == *width) {
+        *width = (size / *height < UINT32_MAX) ? size / *height : UINT32_MAX;
+    }
+    else if (0 == *height) {
+        *height = (size / *width < UINT32_MAX) ? size / *width : UINT32_MAX;
+    }
+
+    *frame_width = *width;
+    if ((uint64_t) *width * *height > size) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        *width /= options->preview_scale;
+        *height /= options->preview_scale;
+    }
+
+    /* RAW12 rows must hold whole pixel pairs. */
+    if ((0 == *width) || (0 == *height) ||
+        ((BITMAP_FORMAT_RAW12 == options->preview_format) &&
+         (0 != *width % 2U))) {
+        status = EXIT_FAILURE;
+    }
+
+    return status;
+}
+
+static void PackPreviewRows(struct Bitmap *bmp,
+                            size_t row,
+                            const uint8_t *end,
+                            size_t *size) {
+    uint8_t *start = (uint8_t *) bmp->pixel_data +
+                     row * BITMAP_RLE8_ROW_BOUND(bmp->info_header.width);
+
+    memmove((uint8_t *) bmp->pixel_data + *size, start, end - start);
+    *size += end - start;
+}
+
+static size_t GetPreviewStride(const struct Bitmap *bmp,
+                               enum Bitmap_Format format) {
+    return (BITMAP_FORMAT_BMP == format) ?
+           BitmapGetStride(bmp) :
+           BitmapGetFormatSize(format, bmp->info_header.width);
+}
+
+static int WriteBytesToFile(FILE *out, const void *data, size_t count) {
+    int status = EXIT_SUCCESS;
+    
+    if ((NULL != out) && (NULL != data)) {
+        if (count != fwrite(data, 1U, count, out)) {
+            status = EXIT_FAILURE;
+        }
+    }
+    else {
+        status = EXIT_FAILURE;
+    }
+
+    return status;
+}
+
+static int WriteVectorToFile(int fd, struct iovec *iov, int count) {
+    ssize_t written = 0;
+    int status = EXIT_SUCCESS;
+
+    while ((EXIT_SUCCESS == status) && (count > 0)) {
+        written = writev(fd, iov, count);
+        if ((written < 0) && (EINTR == errno)) {
+            continue;
+        }
+        else if (written <= 0) {
+            status = EXIT_FAILURE;
+        }
+        else {
+            /* Skip the areas already written, then resume the partial one. */
+            while ((count > 0) && ((size_t) written >= iov->iov_len)) {
+                written -= iov->iov_len;
+                iov++;
+                count--;
+            }
+            if (count > 0) {
+                iov->iov_base = (uint8_t *) iov->iov_base + written;
+                iov->iov_len -= written;
+            }
+        }
+    }
+
+    return status;
+}
+
+static size_t GetCompressedBound(size_t size) {
+    return CODEC_LZ4_HEADER_SIZE + CodecLz4GetBound(size) +
+           CODEC_LZ4_END_SIZE;
+}
+
+static int CompressAlteredData(const void *data,
+                               size_t size,
+                               bool first,
+                               bool last,
+                               size_t thread_count,
+                               uint32_t *tables,
+                               uint8_t *out,
+                               size_t *out_size) {
+    size_t header_size = first ? CodecLz4WriteHeader(out) : 0;
+    int status = EXIT_SUCCESS;
+
+    status = CodecLz4Compress(data, size, thread_count, tables,
+                              out + header_size, out_size);
+    *out_size += header_size;
+    if (last) {
+        *out_size += CodecLz4WriteEnd(out + *out_size);
+    }
+
+    return status;
+}
+
+static int WriteCompressedToFile(const void *data,
+                                 size_t size,
+                                 const char *path,
+                                 size_t thread_count,
+                                 struct Bitmap_Arena *arena,
+                                 size_t *written) {
+    struct iovec iov;
+    uint32_t *tables = BitmapArenaAlloc(arena,
+                                        CODEC_LZ4_TABLES_SIZE(thread_count));
+    uint8_t *out = BitmapArenaAlloc(arena, GetCompressedBound(size));
+    int fd = -1;
+    int status = EXIT_SUCCESS;
+
+    *written = 0;
+    if ((NULL == tables) || (NULL == out)) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        status = CompressAlteredData(data, size, true, true, thread_count,
+                                     tables, out, written);
+    }
+    if (EXIT_SUCCESS == status) {
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        iov.iov_base = out;
+        iov.iov_len = *written;
+        status = (fd < 0) ? EXIT_FAILURE : WriteVectorToFile(fd, &iov, 1);
+    }
+    if ((fd >= 0) && (0 != close(fd))) {
+        status = EXIT_FAILURE;
+    }
+
+    return status;
+}
+
+static int WriteBmpToFile(FILE *out, const struct Bitmap *bmp) {
+    struct iovec iov[4];
+    int status = EXIT_SUCCESS;
+    
+    if ((NULL == out) || (NULL == bmp) || (0 != fflush(out))) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        iov[0].iov_base = (void *) &(bmp->header);
+        iov[0].iov_len = sizeof(bmp->header);
+        iov[1].iov_base = (void *) &(bmp->info_header);
+        iov[1].iov_len = bmp->info_header.header_size;
+        iov[2].iov_base = bmp->color_table;
+        iov[2].iov_len = bmp->info_header.colors_used *
+                         sizeof(struct Bitmap_ColorEntry);
+        iov[3].iov_base = bmp->pixel_data;
+        iov[3].iov_len = bmp->info_header.image_size;
+
+        status = WriteVectorToFile(fileno(out), iov, 4);
+    }
+
+    return status;
+}
+
+static int WriteBmpHeaderToFile(FILE *out, const struct Bitmap *bmp) {
+    int status = EXIT_SUCCESS;
+
+    if (NULL == bmp) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        status = WriteBytesToFile(out, &(bmp->header), sizeof(bmp->header));
+        if (EXIT_SUCCESS == status) {
+            status = WriteBytesToFile(out, &(bmp->info_header),
+                                      bmp->info_header.header_size);
+        }
+        if (EXIT_SUCCESS == status) {
+            status = WriteBytesToFile(out, bmp->color_table,
+                                      bmp->info_header.colors_used *
+                                      sizeof(struct Bitmap_ColorEntry));
+        }
+    }
+
+    return status;
+}
+
+static int WritePreviewToFile(FILE *out, const struct Bitmap *bmp,
+                              enum Bitmap_Format format) {
+    int status = EXIT_SUCCESS;
+
+    if (BITMAP_FORMAT_BMP == format) {
+        status = WriteBmpToFile(out, bmp);
+    }
+    else if (NULL == bmp) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        status = WritePreviewHeaderToFile(out, bmp, format);
+        if (EXIT_SUCCESS == status) {
+            status = WriteBytesToFile(out, bmp->pixel_data,
+                                      GetPreviewStride(bmp, format) *
+                                      bmp->info_header.height);
+        }
+    }
+
+    return status;
+}
+
+static int WritePreviewHeaderToFile(FILE *out, const struct Bitmap *bmp,
+                                    enum Bitmap_Format format) {
+    char header[BITMAP_PGM_HEADER_SIZE];
+    int status = EXIT_SUCCESS;
+
+    if (NULL == bmp) {
+        status = EXIT_FAILURE;
+    }
+    else if (BITMAP_FORMAT_BMP == format) {
+        status = WriteBmpHeaderToFile(out, bmp);
+    }
+    else if (BITMAP_FORMAT_PGM == format) {
+        status = WriteBytesToFile(out, header,
+                                  BitmapFormatPgmHeader(
+                                      bmp->info_header.width,
+                                      bmp->info_header.height, header));
+    }
+
+    return status;
+}
+
+static size_t CopyPreviewHeader(const struct Bitmap *bmp,
+                                enum Bitmap_Format format,
+                                uint8_t *out) {
+    char header[BITMAP_PGM_HEADER_SIZE];
+    size_t colors_size = 0;
+    size_t size = 0;
+
+    if (BITMAP_FORMAT_BMP == format) {
+        colors_size = bmp->info_header.colors_used *
+                      sizeof(struct Bitmap_ColorEntry);
+        size = sizeof(bmp->header) + bmp->info_header.header_size +
+               colors_size;
+        if (NULL != out) {
+            memcpy(out, &(bmp->header), sizeof(bmp->header));
+            out += sizeof(bmp->header);
+            memcpy(out, &(bmp->info_header), bmp->info_header.header_size);
+            out += bmp->info_header.header_size;
+            memcpy(out, bmp->color_table, colors_size);
+        }
+    }
+    else if (BITMAP_FORMAT_PGM == format) {
+        size = BitmapFormatPgmHeader(bmp->info_header.width,
+                                     bmp->info_header.height, header);
+        if (NULL != out) {
+            memcpy(out, header, size);
+        }
+    }
+
+    return size;
+}
+
+static int CompareIndices(const void *a, const void *b) {
+    size_t index_a = *((const size_t *) a);
+    size_t index_b = *((const size_t *) b);
+
+    return (index_a > index_b) - (index_a < index_b);
+}
+
+static void CountOutputFile(struct Stats *stats, FILE *out) {
+    struct stat file_stat;
+
+    /* Part of the file may still be buffered. */
+    if ((NULL != stats) && (NULL != out) && (0 == fflush(out)) &&
+        (0 == fstat(fileno(out), &file_stat))) {
+        StatsAdd(stats, STATS_BYTES_WRITTEN, file_stat.st_size);
+    }
+}
+
+int DeliteProcessFile(struct Delite_Context *context,
+                      const char *input_file_path,
+                      const char *preview_file_path,
+                      const char *altered_file_path) {
+    const struct Delite_Options *options = &(context->options);
+    struct Delite_Options resolved;
+    struct Frame frame;
+    struct Stats *stats = context->stats;
+    FILE *out = NULL;
+    uint16_t *raw_data = NULL;
+    size_t raw_data_size = 0U;
+    size_t slice_size = 0;
+    size_t written = 0;
+    int status = EXIT_SUCCESS;
+
+    /* Everything allocated for the previous frame goes away at once. */
+    BitmapArenaReset(&(context->arena));
+    StatsBegin(stats, STATS_STAGE_READ);
+    status = FrameOpen(input_file_path, options->input_mode,
+                       &(context->arena), &frame);
+    if ((EXIT_SUCCESS == status) &&
+        (EXIT_FAILURE == FrameSetPixelFormat(&frame, options->pixel_format,
+                                             &(context->arena)))) {
+        FrameClose(&frame);
+        status = EXIT_FAILURE;
+    }
+    StatsEnd(stats, STATS_STAGE_READ);
+
+    /* TODO: Add dedicated error reporting. */ 
+    if (EXIT_SUCCESS == status) {
+        raw_data = frame.data;
+        raw_data_size = frame.size;
+        StatsAdd(stats, STATS_FRAMES, 1U);
+        StatsAdd(stats, STATS_BYTES_READ, frame.encoded_size);
+        ResolveAdjustmentMode(options, raw_data_size / sizeof(raw_data[0]),
+                              &resolved);
+        options = &resolved;
+    }
+    if ((EXIT_SUCCESS == status) && (0 != options->depth) &&
+        (EXIT_FAILURE == GetVolumeSliceSize(raw_data_size /
+                                            sizeof(raw_data[0]),
+                                            options, &slice_size))) {
+        /* Nothing is written for a volume whose slices don't add up. */
+        if ((0 != options->width) && (0 != options->height)) {
+            printf("The input size doesn't match %u slices of %ux%u.\n",
+                   options->depth, options->width, options->height);
+        }
+        else {
+            printf("The input size doesn't split into %u slices of whole "
+                   "rows.\n", options->depth);
+        }
+        FrameClose(&frame);
+        status = EXIT_FAILURE;
+    }
+    else if ((EXIT_SUCCESS == status) &&
+             CanFuseAdjustment(raw_data_size / sizeof(raw_data[0]), options)) {
+        /* The threshold is known upfront, each tile goes through once. */
+        status = AdjustFrameFused(&frame, altered_file_path, options,
+                                  context);
+        if (EXIT_SUCCESS == status) {
+            StatsBegin(stats, STATS_STAGE_WRITE);
+            out = fopen(preview_file_path, "wb");
+            status = WritePreviewToFile(out, context->preview,
+                                        options->preview_format);
+            CountOutputFile(stats, out);
+            StatsEnd(stats, STATS_STAGE_WRITE);
+            if (EXIT_FAILURE == status) {
+                printf("Unexpected error when writing the "
+                       "preview bitmap.\n");
+            }
+        }
+        else {
+            printf("Unexpected error when adjusting and writing the "
+                   "pixel data.\n");
+        }
+
+        FrameClose(&frame);
+    }
+    else if (EXIT_SUCCESS == status) {
+        status = AdjustFrame(context, options, raw_data,
+                             raw_data_size / sizeof(raw_data[0]),
+                             frame.dirty_map,
+                             (NULL != frame.encoded) ? &frame : NULL);
+        if (EXIT_SUCCESS == status) {
+            /* Output the adjusted pixel data in binary. */
+            StatsBegin(stats, STATS_STAGE_WRITE);
+            if ((CODEC_FORMAT_DELTA == options->altered_format) ||
+                options->patch_input) {
+                /* Only the adjusted pixels go out, next to or over the
+                   input file. */
+                status = FrameWriteChanges(&frame,
+                                           (CODEC_FORMAT_DELTA ==
+                                            options->altered_format) ?
+                                           altered_file_path : NULL,
+                                           options->patch_input ?
+                                           input_file_path : NULL,
+                                           &written);
+            }
+            else if (CODEC_FORMAT_NONE == options->altered_format) {
+                status = FrameWriteToFile(&frame, altered_file_path);
+                written = frame.size;
+            }
+            else {
+                status = WriteCompressedToFile(frame.data, frame.size,
+                                               altered_file_path,
+                                               options->thread_count,
+                                               &(context->arena), &written);
+            }
+            StatsEnd(stats, STATS_STAGE_WRITE);
+            if ((EXIT_SUCCESS == status) && (0 != options->depth)) {
+                /* The volume threshold is shared by all the slices. */
+                StatsAdd(stats, STATS_BYTES_WRITTEN, written);
+                StatsBegin(stats, STATS_STAGE_PREVIEW);
+                status = WriteVolumePreviews(raw_data, raw_data_size /
+                                                       sizeof(raw_data[0]),
+                                             options, preview_file_path,
+                                             input_file_path, context);
+                StatsEnd(stats, STATS_STAGE_PREVIEW);
+                if (EXIT_FAILURE == status) {
+                    printf("Unexpected error when writing the slice "
+                           "previews.\n");
+                }
+            }
+            else if (EXIT_SUCCESS == status) {
+                StatsAdd(stats, STATS_BYTES_WRITTEN, written);
+                StatsBegin(stats, STATS_STAGE_PREVIEW);
+                status = GeneratePreviewBitmapFrom16Bit(raw_data, 
+                                                        raw_data_size /
+                                                        sizeof(raw_data[0]),
+                                                        options, context,
+                                                        NULL);
+                StatsEnd(stats, STATS_STAGE_PREVIEW);
+                if (EXIT_SUCCESS == status) {
+                    StatsBegin(stats, STATS_STAGE_WRITE);
+                    out = fopen(preview_file_path, "wb");
+                    status = WritePreviewToFile(out, context->preview,
+                                                options->preview_format);
+                    CountOutputFile(stats, out);
+                    StatsEnd(stats, STATS_STAGE_WRITE);
+                    if (EXIT_FAILURE == status) {
+                        printf("Unexpected error when writing the "
+                               "preview bitmap.\n");
+                    }
+                }
+                else {
+                    printf("Unexpected error when generating the preview.\n");
+                }
+                if ((EXIT_SUCCESS == status) &&
+                    (NULL != options->pyramid_path)) {
+                    StatsBegin(stats, STATS_STAGE_PREVIEW);
+                    status = WritePyramid(raw_data, raw_data_size /
+                                                    sizeof(raw_data[0]),
+                                          options->pyramid_path, context);
+                    StatsEnd(stats, STATS_STAGE_PREVIEW);
+                    if (EXIT_FAILURE == status) {
+                        printf("Unexpected error when writing the "
+                               "preview pyramid.\n");
+                    }
+                }
+            }
+            else {
+                printf("Unexpected error when writing the "
+                       "adjusted pixel data to file.\n");
+            }
+        }
+        else {
+            printf("Unexpected error when processing the pixel data.\n");
+        }
+
+        FrameClose(&frame);
+    }
+    else {
+        printf("Unexpected error when reading the raw input byte stream.\n");
+        status = EXIT_FAILURE;
+    }
+
+    if (NULL != out) {
+        fclose(out);
+    }
+
+    return status;
+}
+
+int DeliteProcessStream(struct Delite_Context *context,
+                        const char *input_file_path,
+                        const char *preview_file_path,
+                        const char *altered_file_path) {
+    const struct Delite_Options *options = &(context->options);
+    struct Bitmap *output_bmp = context->preview;
+    struct Bitmap_Arena *arena = &(context->arena);
+    struct Stats *stats = context->stats;
+    struct Delite_Options resolved;
+    struct Selection_Heap heap;
+    struct Selection_Threshold threshold;
+    struct Adjustment_Sweep sweep;
+    struct Stream_Buffers buffers;
+    struct stat file_stat;
+    FILE *preview = NULL;
+    struct Preview_Stream stream;
+    uint16_t *chunk = NULL;
+    uint8_t *rows = NULL;
+    uint32_t *tables = NULL;
+    size_t *histogram = NULL;
+    size_t *indices = NULL;
+    size_t size = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    size_t selected = 0;
+    size_t next = 0;
+    size_t last_index = 0;
+    size_t offset = 0;
+    size_t count = 0;
+    size_t pixels = 0;
+    size_t chunk_count = 0;
+    size_t rows_size = 0;
+    size_t buffer = 0;
+    size_t spare = 0;
+    size_t written = 0;
+    size_t length = 0;
+    size_t i = 0;
+    off_t preview_offset = 0;
+    off_t altered_offset = 0;
+    int altered = -1;
+    bool queue_ready = false;
+    bool select = (DELITE_MODE_THRESHOLD != options->mode);
+    bool rle = options->preview_rle;
+    bool compress = (CODEC_FORMAT_NONE != options->altered_format);
+    size_t pixel_count = 0;
+    enum Selection_Engine engine = SELECTION_ENGINE_AUTO;
+    enum Selection_Tie_Break tie_break = options->tie_break;
+    enum Bitmap_Format format = options->preview_format;
+    float factor = KernelsGetScaleFactor(options->adjustment_level);
+    int status = EXIT_SUCCESS;
+
+    memset(&heap, 0, sizeof(heap));
+    memset(&stream, 0, sizeof(stream));
+    memset(&buffers, 0, sizeof(buffers));
+    BitmapArenaReset(arena);
+
+    /* Chunks must hold whole pixels. */
+    buffers.chunk_size = options->chunk_size & ~((size_t) 1U);
+    buffers.in = open(input_file_path, O_RDONLY);
+    for (i = 0; i < STREAM_BUFFER_COUNT; i++) {
+        buffers.chunks[i] = BitmapArenaAlloc(arena, buffers.chunk_size);
+        if (compress) {
+            buffers.packed[i] = BitmapArenaAlloc(arena, GetCompressedBound(
+                                                    buffers.chunk_size));
+        }
+        if ((NULL == buffers.chunks[i]) ||
+            (compress && (NULL == buffers.packed[i]))) {
+            status = EXIT_FAILURE;
+        }
+    }
+    if (compress) {
+        tables = BitmapArenaAlloc(arena, CODEC_LZ4_TABLES_SIZE(
+                                             options->thread_count));
+        if (NULL == tables) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    if ((buffers.in < 0) || (EXIT_FAILURE == status) ||
+        (0 == buffers.chunk_size) || (fstat(buffers.in, &file_stat) < 0) ||
+        (file_stat.st_size <= 0) ||
+        ((uintmax_t) file_stat.st_size > SIZE_MAX)) {
+        printf("Unexpected error when reading the raw input byte stream.\n");
+        status = EXIT_FAILURE;
+    }
+    else if (EXIT_FAILURE == AsyncIoInit(&(buffers.queue),
+                                         options->io_backend)) {
+        printf("The requested I/O backend isn't available.\n");
+        status = EXIT_FAILURE;
+    }
+    else {
+        queue_ready = true;
+        StatsSetIoBackend(stats, AsyncIoGetBackendName(&(buffers.queue)));
+        StatsAdd(stats, STATS_FRAMES, 1U);
+        buffers.file_size = file_stat.st_size;
+        size = buffers.file_size / sizeof(chunk[0]);
+        chunk_count = (buffers.file_size + buffers.chunk_size - 1U) /
+                      buffers.chunk_size;
+        ResolveAdjustmentMode(options, size, &resolved);
+        pixel_count = resolved.pixel_count;
+
+        /* Only the heap and the histogram can be updated chunk by chunk,
+           a fixed threshold is swept as the histogram one. */
+        engine = SelectionPickEngine(resolved.engine, size, pixel_count);
+        if ((SELECTION_TIE_BREAK_ALL == tie_break) || !select ||
+            (SELECTION_ENGINE_HEAP != engine)) {
+            engine = SELECTION_ENGINE_HISTOGRAM;
+        }
+        StatsSetEngine(stats, select ? SelectionGetEngineName(engine) :
+                                       NULL);
+
+        if (!select) {
+            /* A fixed threshold only needs the second pass. */
+            memset(&threshold, 0, sizeof(threshold));
+            threshold.value = options->threshold;
+            InitAdjustmentSweep(&sweep, &threshold, tie_break, factor, 0);
+        }
+        else if (SELECTION_ENGINE_HEAP == engine) {
+            status = SelectionHeapInit(&heap, (pixel_count < size) ?
+                                       pixel_count : size, tie_break);
+        }
+        else {
+            histogram = BitmapArenaAlloc(arena, SELECTION_HISTOGRAM_SIZE *
+                                                sizeof(size_t));
+            if (NULL == histogram) {
+                status = EXIT_FAILURE;
+            }
+            else {
+                memset(histogram, 0,
+                       SELECTION_HISTOGRAM_SIZE * sizeof(size_t));
+            }
+        }
+        if ((EXIT_SUCCESS == status) && select) {
+            status = ReadStreamChunk(&buffers, 0);
+        }
+    }
+
+    /* First pass: feed the running selection. */
+    for (i = 0; (EXIT_SUCCESS == status) && select && (i < chunk_count);
+         i++) {
+        StatsBegin(stats, STATS_STAGE_READ);
+        status = FetchStreamChunk(&buffers, i, &count);
+        StatsEnd(stats, STATS_STAGE_READ);
+        if (EXIT_SUCCESS == status) {
+            StatsBegin(stats, STATS_STAGE_DETECT);
+            chunk = buffers.chunks[i % STREAM_BUFFER_COUNT];
+            pixels = count / sizeof(chunk[0]);
+            if (SELECTION_ENGINE_HEAP == engine) {
+                SelectionHeapUpdate(&heap, chunk, pixels, offset);
+            }
+            else {
+                SelectionUpdateHistogram(chunk, pixels, histogram);
+            }
+            offset += pixels;
+            StatsEnd(stats, STATS_STAGE_DETECT);
+            StatsAdd(stats, STATS_BYTES_READ, count);
+            StatsAdd(stats, STATS_PIXELS_SCANNED, pixels);
+        }
+        else {
+            printf("Unexpected error when reading the raw input "
+                   "byte stream.\n");
+        }
+    }
+
+    if ((EXIT_SUCCESS == status) && select) {
+        StatsBegin(stats, STATS_STAGE_DETECT);
+        if (SELECTION_ENGINE_HEAP == engine) {
+            indices = BitmapArenaAlloc(arena,
+                                       (heap.size + 1U) * sizeof(size_t));
+            if (NULL == indices) {
+                status = EXIT_FAILURE;
+            }
+            else {
+                selected = SelectionHeapExtract(&heap, indices);
+                if (selected > 0) {
+                    last_index = indices[selected - 1];
+                }
+                /* The second pass goes through the frame in order. */
+                qsort(indices, selected, sizeof(size_t), CompareIndices);
+                StatsAdd(stats, STATS_PIXELS_ADJUSTED, selected);
+            }
+        }
+        else {
+            status = SelectionFindThreshold(histogram, pixel_count,
+                                            tie_break, &threshold);
+            if (EXIT_SUCCESS == status) {
+                InitAdjustmentSweep(&sweep, &threshold, tie_break, factor,
+                                    pixel_count);
+            }
+        }
+        StatsEnd(stats, STATS_STAGE_DETECT);
+        if (EXIT_FAILURE == status) {
+            printf("Unexpected error when processing the pixel data.\n");
+        }
+    }
+
+    if (EXIT_SUCCESS == status) {
+        status = GetPreviewGeometry(size, options, &stream.frame_width,
+                                    &width, &height);
+        if (EXIT_SUCCESS == status) {
+            status = BitmapSetWidthHeight(output_bmp, width, height);
+        }
+        if (EXIT_SUCCESS == status) {
+            stream.format = format;
+            stream.width = width;
+            stream.scale = options->preview_scale;
+            stream.limit = stream.frame_width * height * stream.scale;
+            stream.stride = GetPreviewStride(output_bmp, format);
+            stream.sums = BitmapArenaAlloc(arena, width * stream.scale *
+                                                  sizeof(uint32_t));
+            stream.averages = BitmapArenaAlloc(arena,
+                                               width * sizeof(uint16_t));
+            if ((NULL == stream.sums) || (NULL == stream.averages)) {
+                status = EXIT_FAILURE;
+            }
+            else {
+                memset(stream.sums, 0,
+                       width * stream.scale * sizeof(uint32_t));
+            }
+
+            /* Each chunk completes its own preview rows, plus the one
+               started by the previous chunk. The RLE8 rows are encoded
+               as they are completed, from a row of their own. */
+            rows_size = (buffers.chunk_size / sizeof(chunk[0]) /
+                         stream.frame_width + 2U) *
+                        (rle ? BITMAP_RLE8_ROW_BOUND(width) : stream.stride);
+            for (i = 0; (EXIT_SUCCESS == status) &&
+                        (i < STREAM_BUFFER_COUNT); i++) {
+                buffers.rows[i] = BitmapArenaAlloc(arena, rows_size);
+                if (NULL == buffers.rows[i]) {
+                    status = EXIT_FAILURE;
+                }
+            }
+            if ((EXIT_SUCCESS == status) && rle) {
+                stream.row = BitmapArenaAlloc(arena, stream.stride);
+                if (NULL == stream.row) {
+                    status = EXIT_FAILURE;
+                }
+            }
+        }
+        if (EXIT_SUCCESS == status) {
+            preview = fopen(preview_file_path, "wb");
+            status = WritePreviewHeaderToFile(preview, output_bmp, format);
+        }
+        if (EXIT_FAILURE == status) {
+            printf("Unexpected error when generating the preview.\n");
+        }
+        /* The rows are written behind the buffered header. */
+        else if ((0 != fflush(preview)) ||
+                 ((preview_offset = ftello(preview)) < 0)) {
+            printf("Unexpected error when writing the preview bitmap.\n");
+            status = EXIT_FAILURE;
+        }
+        else {
+            StatsAdd(stats, STATS_BYTES_WRITTEN, preview_offset);
+        }
+        if (EXIT_SUCCESS == status) {
+            altered = open(altered_file_path, O_WRONLY | O_CREAT | O_TRUNC,
+                           0666);
+            if (altered < 0) {
+                status = EXIT_FAILURE;
+            }
+            else {
+                status = ReadStreamChunk(&buffers, 0);
+            }
+            if (EXIT_FAILURE == status) {
+                printf("Unexpected error when writing the "
+                       "adjusted pixel data to file.\n");
+            }
+        }
+    }
+
+    /* Second pass: adjust each chunk and write it to both outputs. */
+    offset = 0;
+    if (!rle) {
+        stream.row = buffers.rows[0];
+    }
+    for (i = 0; (EXIT_SUCCESS == status) && (i < chunk_count); i++) {
+        buffer = i % STREAM_BUFFER_COUNT;
+        spare = (i + 1U) % STREAM_BUFFER_COUNT;
+
+        /* The next chunk goes where the outputs of an earlier one were. */
+        StatsBegin(stats, STATS_STAGE_WRITE);
+        if (EXIT_FAILURE == AsyncIoWait(&(buffers.queue),
+                                        &(buffers.altered_writes[spare]))) {
+            printf("Unexpected error when writing the "
+                   "adjusted pixel data to file.\n");
+            status = EXIT_FAILURE;
+        }
+        else if (EXIT_FAILURE ==
+                 AsyncIoWait(&(buffers.queue),
+                             &(buffers.preview_writes[spare]))) {
+            printf("Unexpected error when writing the preview bitmap.\n");
+            status = EXIT_FAILURE;
+        }
+        StatsEnd(stats, STATS_STAGE_WRITE);
+
+        StatsBegin(stats, STATS_STAGE_READ);
+        if ((EXIT_SUCCESS == status) &&
+            (EXIT_FAILURE == FetchStreamChunk(&buffers, i, &count))) {
+            printf("Unexpected error when reading the raw input "
+                   "byte stream.\n");
+            status = EXIT_FAILURE;
+        }
+        StatsEnd(stats, STATS_STAGE_READ);
+
+        if (EXIT_SUCCESS == status) {
+            StatsBegin(stats, STATS_STAGE_ADJUST);
+            chunk = buffers.chunks[buffer];
+            pixels = count / sizeof(chunk[0]);
+            if (SELECTION_ENGINE_HEAP == engine) {
+                for (; (next < selected) &&
+                       (indices[next] < offset + pixels); next++) {
+                    AdjustPixel(&chunk[indices[next] - offset], factor,
+                                (indices[next] != last_index) ? 0 :
+                                pixel_count - selected);
+                }
+            }
+            else {
+                StatsAdd(stats, STATS_PIXELS_ADJUSTED,
+                         AdjustPixelsAboveThreshold(chunk, pixels, &sweep,
+                                                    NULL));
+            }
+            StatsEnd(stats, STATS_STAGE_ADJUST);
+
+            /* The preview rows completed by the chunk are kept in its
+               buffer, the row left in progress moves to the next one. */
+            StatsBegin(stats, STATS_STAGE_PREVIEW);
+            rows = buffers.rows[buffer];
+            stream.encoded = rle ? rows : NULL;
+            status = WritePreviewChunk(&stream, chunk, pixels, offset);
+            StatsEnd(stats, STATS_STAGE_PREVIEW);
+            StatsAdd(stats, STATS_BYTES_READ, count);
+        }
+        StatsBegin(stats, STATS_STAGE_WRITE);
+        written = count;
+        if ((EXIT_SUCCESS == status) && compress) {
+            /* The blocks of each chunk follow those of the previous one. */
+            status = CompressAlteredData(chunk, count, 0 == i,
+                                         i + 1U == chunk_count,
+                                         options->thread_count, tables,
+                                         buffers.packed[buffer], &written);
+        }
+        if (EXIT_SUCCESS == status) {
+            status = AsyncIoSubmit(&(buffers.queue),
+                                   &(buffers.altered_writes[buffer]),
+                                   ASYNC_IO_WRITE, altered,
+                                   compress ? buffers.packed[buffer] :
+                                              (void *) chunk,
+                                   written, altered_offset);
+            altered_offset += written;
+        }
+        if (EXIT_SUCCESS == status) {
+            length = rle ? (size_t) (stream.encoded - rows) :
+                           (size_t) (stream.row - rows);
+            status = AsyncIoSubmit(&(buffers.queue),
+                                   &(buffers.preview_writes[buffer]),
+                                   ASYNC_IO_WRITE, fileno(preview), rows,
+                                   length, preview_offset);
+            preview_offset += length;
+            StatsAdd(stats, STATS_BYTES_WRITTEN, written + length);
+            if (!rle) {
+                memmove(buffers.rows[spare], stream.row, stream.stride);
+                stream.row = buffers.rows[spare];
+            }
+        }
+        StatsEnd(stats, STATS_STAGE_WRITE);
+        offset += pixels;
+    }
+
+    /* Whatever happened, nothing may be in flight past this point. */
+    StatsBegin(stats, STATS_STAGE_WRITE);
+    for (i = 0; queue_ready && (i < STREAM_BUFFER_COUNT); i++) {
+        if ((EXIT_FAILURE == AsyncIoWait(&(buffers.queue),
+                                         &(buffers.altered_writes[i]))) &&
+            (EXIT_SUCCESS == status)) {
+            printf("Unexpected error when writing the "
+                   "adjusted pixel data to file.\n");
+            status = EXIT_FAILURE;
+        }
+        if ((EXIT_FAILURE == AsyncIoWait(&(buffers.queue),
+                                         &(buffers.preview_writes[i]))) &&
+            (EXIT_SUCCESS == status)) {
+            printf("Unexpected error when writing the preview bitmap.\n");
+            status = EXIT_FAILURE;
+        }
+    }
+    if (queue_ready) {
+        AsyncIoFree(&(buffers.queue));
+    }
+
+    /* The RLE8 size is only known now, the header goes back in with it. */
+    if ((EXIT_SUCCESS == status) && rle &&
+        ((EXIT_FAILURE ==
+          BitmapSetImageSize(output_bmp,
+                             preview_offset -
+                             output_bmp->header.pixel_data_offset)) ||
+         (0 != fseeko(preview, 0, SEEK_SET)) ||
+         (EXIT_FAILURE == WritePreviewHeaderToFile(preview, output_bmp,
+                                                   format)))) {
+        printf("Unexpected error when writing the preview bitmap.\n");
+        status = EXIT_FAILURE;
+    }
+    StatsEnd(stats, STATS_STAGE_WRITE);
+
+    if (buffers.in >= 0) {
+        close(buffers.in);
+    }
+    if ((altered >= 0) && (0 != close(altered)) &&
+        (EXIT_SUCCESS == status)) {
+        printf("Unexpected error when writing the "
+               "adjusted pixel data to file.\n");
+        status = EXIT_FAILURE;
+    }
+    if ((NULL != preview) && (0 != fclose(preview)) &&
+        (EXIT_SUCCESS == status)) {
+        printf("Unexpected error when writing the preview bitmap.\n");
+        status = EXIT_FAILURE;
+    }
+
+    /* The buffers are released when the arena is reset. */
+    SelectionHeapFree(&heap);
+
+    return status;
+}
+
+static int ReadStreamChunk(struct Stream_Buffers *buffers, size_t index) {
+    size_t offset = index * buffers->chunk_size;
+    int status = EXIT_SUCCESS;
+
+    if (offset < buffers->file_size) {
+        status = AsyncIoSubmit(&(buffers->queue),
+                               &(buffers->reads[index % STREAM_BUFFER_COUNT]),
+                               ASYNC_IO_READ, buffers->in,
+                               buffers->chunks[index % STREAM_BUFFER_COUNT],
+                               (buffers->file_size - offset <
+                                buffers->chunk_size) ?
+                               buffers->file_size - offset :
+                               buffers->chunk_size, offset);
+    }
+
+    return status;
+}
+
+static int FetchStreamChunk(struct Stream_Buffers *buffers,
+                            size_t index,
+                            size_t *count) {
+    struct Async_Io_Request *read =
+        &(buffers->reads[index % STREAM_BUFFER_COUNT]);
+    int status = EXIT_SUCCESS;
+
+    status = AsyncIoWait(&(buffers->queue), read);
+
+    /* The input must not have shrunk since the size was taken. */
+    if ((EXIT_SUCCESS == status) && (read->done != read->count)) {
+        status = EXIT_FAILURE;
+    }
+    if (EXIT_SUCCESS == status) {
+        *count = read->done;
+        status = ReadStreamChunk(buffers, index + 1U);
+    }
+
+    return status;
+}
+
+int DeliteProcessPipe(struct Delite_Context *context,
+                      int in,
+                      int altered,
+                      int preview) {
+    const struct Delite_Options *options = &(context->options);
+    int status = EXIT_SUCCESS;
+
+    BitmapArenaReset(&(context->arena));
+    if ((CODEC_FORMAT_DELTA == options->altered_format) ||
+        options->patch_input) {
+        /* Both need the original pixels, from the input file. */
+        status = EXIT_FAILURE;
+    }
+    else if ((DELITE_MODE_THRESHOLD == options->mode) &&
+             (FRAME_PIXEL_U16LE == options->pixel_format) &&
+             ((preview < 0) || (!options->preview_rle &&
+                                (0 != options->width) &&
+                                (0 != options->height)))) {
+        status = ProcessPipeChunks(context, in, altered, preview);
+    }
+    else {
+        status = ProcessPipeFrame(context, in, altered, preview);
+    }
+
+    return status;
+}
+
+static int ReadFully(int fd, void *data, size_t count, size_t *done) {
+    ssize_t length = 0;
+    int status = EXIT_SUCCESS;
+
+    for (*done = 0; (EXIT_SUCCESS == status) && (*done < count);
+         *done += length) {
+        length = read(fd, (uint8_t *) data + *done, count - *done);
+        if ((length < 0) && (EINTR == errno)) {
+            length = 0;
+        }
+        else if (length < 0) {
+            status = EXIT_FAILURE;
+        }
+        else if (0 == length) {
+            break;
+        }
+    }
+
+    return status;
+}
+
+static int ReadWhole(int fd, size_t chunk_size, uint8_t **data,
+                     size_t *size) {
+    uint8_t *grown = NULL;
+    size_t capacity = 0;
+    size_t done = 0;
+    int status = EXIT_SUCCESS;
+
+    *data = NULL;
+    *size = 0;
+
+    /* The buffer at least doubles, so the input is copied a few times at
+       most while it grows. */
+    do {
+        if (capacity - *size < chunk_size) {
+            capacity = (capacity > chunk_size) ? 2U * capacity :
+                                                 capacity + chunk_size;
+            grown = realloc(*data, capacity);
+            if (NULL == grown) {
+                status = EXIT_FAILURE;
+            }
+            else {
+                *data = grown;
+            }
+        }
+        if (EXIT_SUCCESS == status) {
+            status = ReadFully(fd, *data + *size, capacity - *size, &done);
+            *size += done;
+        }
+    } while ((EXIT_SUCCESS == status) && (*size == capacity));
+
+    return status;
+}
+
+static int WritePipeOutput(int fd,
+                           bool framed,
+                           uint8_t tag,
+                           const void *prefix,
+                           size_t prefix_size,
+                           const void *data,
+                           size_t size) {
+    uint8_t header[DELITE_RECORD_HEADER_SIZE];
+    uint64_t length = (uint64_t) prefix_size + size;
+    struct iovec iov[3];
+    int count = 0;
+    size_t i = 0;
+    int status = EXIT_SUCCESS;
+
+    if (framed) {
+        header[0] = tag;
+        for (i = 1; i < sizeof(header); i++) {
+            header[i] = (length >> (8U * (i - 1U))) & 0xFFU;
+        }
+        iov[count].iov_base = header;
+        iov[count].iov_len = sizeof(header);
+        count++;
+    }
+    if (prefix_size > 0) {
+        iov[count].iov_base = (void *) prefix;
+        iov[count].iov_len = prefix_size;
+        count++;
+    }
+    if (size > 0) {
+        iov[count].iov_base = (void *) data;
+        iov[count].iov_len = size;
+        count++;
+    }
+    if (length > 0) {
+        status = WriteVectorToFile(fd, iov, count);
+    }
+
+    return status;
+}
+
+static int ProcessPipeChunks(struct Delite_Context *context,
+                             int in,
+                             int altered,
+                             int preview) {
+    const struct Delite_Options *options = &(context->options);
+    struct Bitmap_Arena *arena = &(context->arena);
+    struct Bitmap *bmp = context->preview;
+    struct Stats *stats = context->stats;
+    struct Preview_Stream stream;
+    enum Bitmap_Format format = options->preview_format;
+    bool framed = (altered >= 0) && (altered == preview);
+    bool compress = (CODEC_FORMAT_NONE != options->altered_format);
+    uint16_t *chunk = NULL;
+    uint8_t *rows = NULL;
+    uint8_t *header = NULL;
+    uint8_t *packed = NULL;
+    uint32_t *tables = NULL;
+    size_t chunk_size = options->chunk_size & ~((size_t) 1U);
+    size_t header_size = 0;
+    size_t rows_size = 0;
+    size_t written = 0;
+    size_t count = 0;
+    size_t pixels = 0;
+    size_t offset = 0;
+    size_t total = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    int status = EXIT_SUCCESS;
+
+    memset(&stream, 0, sizeof(stream));
+
+    chunk = BitmapArenaAlloc(arena, chunk_size);
+    if (compress) {
+        tables = BitmapArenaAlloc(arena, CODEC_LZ4_TABLES_SIZE(
+                                             options->thread_count));
+        packed = BitmapArenaAlloc(arena, GetCompressedBound(chunk_size));
+    }
+    if ((0 == chunk_size) || (NULL == chunk) ||
+        (compress && ((NULL == tables) || (NULL == packed)))) {
+        printf("Unexpected error when reading the raw input byte stream.\n");
+        status = EXIT_FAILURE;
+    }
+    else if (preview >= 0) {
+        /* The frame size isn't known yet, both dimensions are given. */
+        status = GetPreviewGeometry(SIZE_MAX, options, &stream.frame_width,
+                                    &width, &height);
+        if (EXIT_SUCCESS == status) {
+            status = BitmapSetWidthHeight(bmp, width, height);
+        }
+        if (EXIT_SUCCESS == status) {
+            stream.format = format;
+            stream.width = width;
+            stream.scale = options->preview_scale;
+            stream.limit = stream.frame_width * height * stream.scale;
+            stream.stride = GetPreviewStride(bmp, format);
+            stream.sums = BitmapArenaAlloc(arena, width * stream.scale *
+                                                  sizeof(uint32_t));
+            stream.averages = BitmapArenaAlloc(arena,
+                                               width * sizeof(uint16_t));
+            rows_size = (chunk_size / sizeof(chunk[0]) / stream.frame_width +
+                         2U) * stream.stride;
+            rows = BitmapArenaAlloc(arena, rows_size);
+            header_size = CopyPreviewHeader(bmp, format, NULL);
+            header = BitmapArenaAlloc(arena, header_size + 1U);
+            if ((NULL == stream.sums) || (NULL == stream.averages) ||
+                (NULL == rows) || (NULL == header)) {
+                status = EXIT_FAILURE;
+            }
+            else {
+                memset(stream.sums, 0,
+                       width * stream.scale * sizeof(uint32_t));
+                CopyPreviewHeader(bmp, format, header);
+                stream.row = rows;
+            }
+        }
+        if (EXIT_FAILURE == status) {
+            printf("Unexpected error when generating the preview.\n");
+        }
+        else {
+            StatsBegin(stats, STATS_STAGE_WRITE);
+            status = WritePipeOutput(preview, framed, DELITE_RECORD_PREVIEW,
+                                     NULL, 0, header, header_size);
+            StatsEnd(stats, STATS_STAGE_WRITE);
+            StatsAdd(stats, STATS_BYTES_WRITTEN, header_size);
+            if (EXIT_FAILURE == status) {
+                printf("Unexpected error when writing the preview "
+                       "bitmap.\n");
+            }
+        }
+    }
+
+    /* Only the last chunk may be short, or hold an odd trailing byte. */
+    count = chunk_size;
+    while ((EXIT_SUCCESS == status) && (count == chunk_size)) {
+        StatsBegin(stats, STATS_STAGE_READ);
+        status = ReadFully(in, chunk, chunk_size, &count);
+        StatsEnd(stats, STATS_STAGE_READ);
+        pixels = count / sizeof(chunk[0]);
+        total += count;
+        if (EXIT_FAILURE == status) {
+            printf("Unexpected error when reading the raw input "
+                   "byte stream.\n");
+        }
+        else if (pixels > 0) {
+            /* An input ending on a chunk boundary ends with an empty
+               read, which only closes the outputs. */
+            StatsAdd(stats, STATS_BYTES_READ, count);
+            status = AdjustPixelDataAbove(chunk, pixels, options->threshold,
+                                          options->adjustment_level, NULL,
+                                          NULL, options->thread_count,
+                                          stats);
+            if (EXIT_FAILURE == status) {
+                printf("Unexpected error when processing the pixel "
+                       "data.\n");
+            }
+        }
+
+        if ((EXIT_SUCCESS == status) && (altered >= 0)) {
+            StatsBegin(stats, STATS_STAGE_WRITE);
+            written = count;
+            if (compress) {
+                /* The input ends with the first short chunk. */
+                status = CompressAlteredData(chunk, count, total == count,
+                                             count != chunk_size,
+                                             options->thread_count, tables,
+                                             packed, &written);
+            }
+            if (EXIT_SUCCESS == status) {
+                status = WritePipeOutput(altered, framed,
+                                         DELITE_RECORD_ALTERED, NULL, 0,
+                                         compress ? packed : (void *) chunk,
+                                         written);
+            }
+            StatsEnd(stats, STATS_STAGE_WRITE);
+            StatsAdd(stats, STATS_BYTES_WRITTEN, written);
+            if (EXIT_FAILURE == status) {
+                printf("Unexpected error when writing the "
+                       "adjusted pixel data to file.\n");
+            }
+        }
+
+        /* The completed preview rows go out, the row in progress moves
+           back to the beginning of the buffer. */
+        if ((EXIT_SUCCESS == status) && (preview >= 0)) {
+            StatsBegin(stats, STATS_STAGE_PREVIEW);
+            status = WritePreviewChunk(&stream, chunk, pixels, offset);
+            StatsEnd(stats, STATS_STAGE_PREVIEW);
+            StatsBegin(stats, STATS_STAGE_WRITE);
+            if (EXIT_SUCCESS == status) {
+                status = WritePipeOutput(preview, framed,
+                                         DELITE_RECORD_PREVIEW, NULL, 0,
+                                         rows, stream.row - rows);
+                StatsAdd(stats, STATS_BYTES_WRITTEN, stream.row - rows);
+                memmove(rows, stream.row, stream.stride);
+                stream.row = rows;
+            }
+            StatsEnd(stats, STATS_STAGE_WRITE);
+            if (EXIT_FAILURE == status) {
+                printf("Unexpected error when writing the preview "
+                       "bitmap.\n");
+            }
+        }
+        offset += pixels;
+    }
+
+    if ((EXIT_SUCCESS == status) && (0 == offset)) {
+        printf("Unexpected error when reading the raw input byte stream.\n");
+        status = EXIT_FAILURE;
+    }
+    else if ((EXIT_SUCCESS == status) && (preview >= 0) &&
+             (offset < stream.limit)) {
+        printf("The input is shorter than the frame dimensions.\n");
+        status = EXIT_FAILURE;
+    }
+    if (total > 0) {
+        StatsAdd(stats, STATS_FRAMES, 1U);
+    }
+
+    return status;
+}
+
+static int ProcessPipeFrame(struct Delite_Context *context,
+                            int in,
+                            int altered,
+                            int preview) {
+    struct Delite_Options options;
+    struct Frame frame;
+    struct Bitmap *bmp = context->preview;
+    struct Stats *stats = context->stats;
+    bool framed = (altered >= 0) && (altered == preview);
+    bool compress = (CODEC_FORMAT_NONE != context->options.altered_format);
+    uint8_t *data = NULL;
+    uint8_t *header = NULL;
+    uint8_t *packed = NULL;
+    uint32_t *tables = NULL;
+    size_t size = 0;
+    size_t pixels = 0;
+    size_t header_size = 0;
+    size_t written = 0;
+    int status = EXIT_SUCCESS;
+
+    StatsBegin(stats, STATS_STAGE_READ);
+    status = ReadWhole(in, context->options.chunk_size, &data, &size);
+
+    /* The input stays owned here, the decoded pixels go to the arena. */
+    memset(&frame, 0, sizeof(frame));
+    frame.data = data;
+    frame.size = size;
+    frame.fd = -1;
+    frame.pooled = true;
+    if (EXIT_SUCCESS == status) {
+        status = FrameSetPixelFormat(&frame, context->options.pixel_format,
+                                     &(context->arena));
+    }
+    StatsEnd(stats, STATS_STAGE_READ);
+    pixels = frame.size / sizeof(uint16_t);
+
+    if ((EXIT_FAILURE == status) || (0 == pixels)) {
+        printf("Unexpected error when reading the raw input byte stream.\n");
+        status = EXIT_FAILURE;
+    }
+    else {
+        StatsAdd(stats, STATS_FRAMES, 1U);
+        StatsAdd(stats, STATS_BYTES_READ, size);
+        ResolveAdjustmentMode(&(context->options), pixels, &options);
+        status = AdjustFrame(context, &options, frame.data, pixels, NULL,
+                             (NULL != frame.encoded) ? &frame : NULL);
+        if (EXIT_FAILURE == status) {
+            printf("Unexpected error when processing the pixel data.\n");
+        }
+    }
+
+    if ((EXIT_SUCCESS == status) && (altered >= 0)) {
+        StatsBegin(stats, STATS_STAGE_WRITE);
+        written = frame.size;
+        if (compress) {
+            tables = BitmapArenaAlloc(&(context->arena),
+                                      CODEC_LZ4_TABLES_SIZE(
+                                          options.thread_count));
+            packed = BitmapArenaAlloc(&(context->arena),
+                                      GetCompressedBound(frame.size));
+            status = ((NULL == tables) || (NULL == packed)) ? EXIT_FAILURE :
+                     CompressAlteredData(frame.data, frame.size, true, true,
+                                         options.thread_count, tables,
+                                         packed, &written);
+        }
+        if (EXIT_SUCCESS == status) {
+            status = WritePipeOutput(altered, framed, DELITE_RECORD_ALTERED,
+                                     NULL, 0,
+                                     compress ? packed : frame.data,
+                                     written);
+        }
+        StatsEnd(stats, STATS_STAGE_WRITE);
+        StatsAdd(stats, STATS_BYTES_WRITTEN, written);
+        if (EXIT_FAILURE == status) {
+            printf("Unexpected error when writing the "
+                   "adjusted pixel data to file.\n");
+        }
+    }
+
+    if ((EXIT_SUCCESS == status) && (preview >= 0)) {
+        StatsBegin(stats, STATS_STAGE_PREVIEW);
+        status = GeneratePreviewBitmapFrom16Bit(frame.data, pixels,
+                                                &options, context, NULL);
+        if (EXIT_SUCCESS == status) {
+            header_size = CopyPreviewHeader(bmp, options.preview_format,
+                                            NULL);
+            header = BitmapArenaAlloc(&(context->arena), header_size + 1U);
+        }
+        StatsEnd(stats, STATS_STAGE_PREVIEW);
+        if ((EXIT_FAILURE == status) || (NULL == header)) {
+            printf("Unexpected error when generating the preview.\n");
+            status = EXIT_FAILURE;
+        }
+        else {
+            CopyPreviewHeader(bmp, options.preview_format, header);
+            size = options.preview_rle ? bmp->info_header.image_size :
+                   GetPreviewStride(bmp, options.preview_format) *
+                   bmp->info_header.height;
+            StatsBegin(stats, STATS_STAGE_WRITE);
+            status = WritePipeOutput(preview, framed, DELITE_RECORD_PREVIEW,
+                                     header, header_size, bmp->pixel_data,
+                                     size);
+            StatsEnd(stats, STATS_STAGE_WRITE);
+            StatsAdd(stats, STATS_BYTES_WRITTEN, header_size + size);
+            if (EXIT_FAILURE == status) {
+                printf("Unexpected error when writing the preview "
+                       "bitmap.\n");
+            }
+        }
+    }
+
+    free(data);
+
+    return status;
+}
+
+int DeliteProcessBatch(const char *source,
+                       const char *preview_pattern,
+                       const char *altered_pattern,
+                       const struct Delite_Options *options,
+                       size_t job_count,
+                       struct Stats *stats) {
+    struct Batch_Worker workers[PARALLEL_MAX_THREADS];
+    char **paths = NULL;
+    size_t count = 0;
+    size_t failed = 0;
+    size_t i = 0;
+    int status = EXIT_SUCCESS;
+
+    memset(workers, 0, sizeof(workers));
+    status = CollectBatchPaths(source, &paths, &count);
+
+    if (EXIT_FAILURE == status) {
+        printf("Unexpected error when collecting the batch input files.\n");
+    }
+    else if (0 == count) {
+        printf("No batch input files found.\n");
+        status = EXIT_FAILURE;
+    }
+    else if ((count > 1) &&
+             (((NULL == strstr(preview_pattern, "%n")) &&
+               (NULL == strstr(preview_pattern, "%i"))) ||
+              ((NULL == strstr(altered_pattern, "%n")) &&
+               (NULL == strstr(altered_pattern, "%i"))))) {
+        /* Otherwise, every file would overwrite the previous outputs. */
+        printf("The output paths must contain %%n or %%i in batch mode.\n");
+        status = EXIT_FAILURE;
+    }
+
+    if (job_count > count) {
+        job_count = count;
+    }
+
+    /* Each worker takes every job_count-th file. */
+    for (i = 0; (EXIT_SUCCESS == status) && (i < job_count); i++) {
+        workers[i].paths = paths;
+        workers[i].count = count;
+        workers[i].first = i;
+        workers[i].step = job_count;
+        workers[i].preview_pattern = preview_pattern;
+        workers[i].altered_pattern = altered_pattern;
+        status = DeliteInit(&(workers[i].context), options);
+        StatsInit(&(workers[i].stats));
+        if (NULL != stats) {
+            workers[i].context.stats = &(workers[i].stats);
+        }
+    }
+
+    if (EXIT_SUCCESS == status) {
+        status = ParallelRun(ProcessBatchWorker, workers, sizeof(workers[0]),
+                             job_count);
+    }
+
+    for (i = 0; i < job_count; i++) {
+        failed += workers[i].failed;
+        if (NULL != stats) {
+            StatsMerge(stats, &(workers[i].stats));
+        }
+        DeliteFree(&(workers[i].context));
+    }
+
+    if ((EXIT_SUCCESS == status) && (failed > 0)) {
+        printf("%zu out of %zu files failed.\n", failed, count);
+        status = EXIT_FAILURE;
+    }
+
+    for (i = 0; i < count; i++) {
+        free(paths[i]);
+    }
+    free(paths);
+
+    return status;
+}
+
+static void ProcessBatchWorker(void *worker) {
+    struct Batch_Worker *batch = worker;
+    char preview_file_path[PATH_MAX];
+    char altered_file_path[PATH_MAX];
+    size_t i = 0;
+    int status = EXIT_SUCCESS;
+
+    for (i = batch->first; i < batch->count; i += batch->step) {
+        status = ExpandPathPattern(batch->preview_pattern, batch->paths[i],
+                                   i, preview_file_path,
+                                   sizeof(preview_file_path));
+        if (EXIT_SUCCESS == status) {
+            status = ExpandPathPattern(batch->altered_pattern,
+                                       batch->paths[i], i, altered_file_path,
+                                       sizeof(altered_file_path));
+        }
+
+        if (EXIT_FAILURE == status) {
+            printf("Invalid output file path.\n");
+        }
+        else if (true == batch->context.options.streaming) {
+            status = DeliteProcessStream(&(batch->context), batch->paths[i],
+                                         preview_file_path,
+                                         altered_file_path);
+        }
+        else {
+            status = DeliteProcessFile(&(batch->context), batch->paths[i],
+                                       preview_file_path, altered_file_path);
+        }
+
+        if (EXIT_FAILURE == status) {
+            printf("Failed to process %s.\n", batch->paths[i]);
+            batch->failed++;
+        }
+    }
+}
+
+static int CollectBatchPaths(const char *source, char ***paths, size_t *count) {
+    struct stat file_stat;
+    struct dirent *entry = NULL;
+    glob_t matches;
+    DIR *dir = NULL;
+    FILE *list = NULL;
+    char path[PATH_MAX];
+    char *line = NULL;
+    size_t line_size = 0;
+    size_t capacity = 0;
+    size_t i = 0;
+    ssize_t length = 0;
+    int status = EXIT_SUCCESS;
+
+    *paths = NULL;
+    *count = 0;
+
+    if ((0 == stat(source, &file_stat)) && S_ISDIR(file_stat.st_mode)) {
+        dir = opendir(source);
+        if (NULL == dir) {
+            status = EXIT_FAILURE;
+        }
+        while ((EXIT_SUCCESS == status) && (NULL != (entry = readdir(dir)))) {
+            /* Hidden files (including . and ..) are skipped. */
+            if ('.' == entry->d_name[0]) {
+                continue;
+            }
+            if ((size_t) snprintf(path, sizeof(path), "%s/%s", source,
+                                  entry->d_name) >= sizeof(path)) {
+                status = EXIT_FAILURE;
+            }
+            else if ((0 == stat(path, &file_stat)) &&
+                     S_ISREG(file_stat.st_mode)) {
+                status = AppendPath(path, paths, count, &capacity);
+            }
+        }
+        if (NULL != dir) {
+            closedir(dir);
+        }
+
+        /* Directory entries come in no particular order. */
+        if (EXIT_SUCCESS == status) {
+            qsort(*paths, *count, sizeof(char *), ComparePaths);
+        }
+    }
+    else if (NULL != strpbrk(source, "*?[")) {
+        /* No match simply means an empty batch. */
+        if (0 == glob(source, 0, NULL, &matches)) {
+            for (i = 0; (EXIT_SUCCESS == status) && (i < matches.gl_pathc);
+                 i++) {
+                if ((0 == stat(matches.gl_pathv[i], &file_stat)) &&
+                    S_ISREG(file_stat.st_mode)) {
+                    status = AppendPath(matches.gl_pathv[i], paths, count,
+                                        &capacity);
+                }
+            }
+            globfree(&matches);
+        }
+    }
+    else {
+        /* List file, one path per line. */
+        list = fopen(source, "r");
+        if (NULL == list) {
+            status = EXIT_FAILURE;
+        }
+        while ((EXIT_SUCCESS == status) &&
+               ((length = getline(&line, &line_size, list)) > 0)) {
+            while ((length > 0) && (('\n' == line[length - 1]) ||
+                                    ('\r' == line[length - 1]))) {
+                line[--length] = '\0';
+            }
+            /* Empty lines and comments are skipped. */
+            if ((length > 0) && ('#' != line[0])) {
+                status = AppendPath(line, paths, count, &capacity);
+            }
+        }
+        if (NULL != list) {
+            fclose(list);
+        }
+        free(line);
+    }
+
+    if (EXIT_FAILURE == status) {
+        for (i = 0; i < *count; i++) {
+            free((*paths)[i]);
+        }
+        free(*paths);
+        *paths = NULL;
+        *count = 0;
+    }
+
+    return status;
+}
+
+static int AppendPath(const char *path,
+                      char ***paths,
+                      size_t *count,
+                      size_t *capacity) {
+    char **grown = NULL;
+    int status = EXIT_SUCCESS;
+
+    if (*count == *capacity) {
+        grown = realloc(*paths, ((0 == *capacity) ? 16U : 2U * *capacity) *
+                                sizeof(char *));
+        if (NULL == grown) {
+            status = EXIT_FAILURE;
+        }
+        else {
+            *paths = grown;
+            *capacity = (0 == *capacity) ? 16U : 2U * *capacity;
+        }
+    }
+
+    if (EXIT_SUCCESS == status) {
+        (*paths)[*count] = strdup(path);
+        if (NULL == (*paths)[*count]) {
+            status = EXIT_FAILURE;
+        }
+        else {
+            (*count)++;
+        }
+    }
+
+    return status;
+}
+
+static int ComparePaths(const void *a, const void *b) {
+    return strcmp(*((char * const *) a), *((char * const *) b));
+}
+
+static int ExpandPathPattern(const char *pattern,
+                             const char *input_path,
+                             size_t index,
+                             char *path,
+                             size_t path_size) {
+    const char *name = strrchr(input_path, '/');
+    const char *extension = NULL;
+    size_t name_length = 0;
+    size_t length = 0;
+    int written = 0;
+    int status = EXIT_SUCCESS;
+
+    name = (NULL == name) ? input_path : name + 1;
+    extension = strrchr(name, '.');
+    name_length = ((NULL == extension) || (extension == name)) ?
+                  strlen(name) : (size_t) (extension - name);
+
+    if (0 == path_size) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        path[0] = '\0';
+    }
+
+    for (; (EXIT_SUCCESS == status) && ('\0' != *pattern); pattern++) {
+        if (('%' == pattern[0]) && ('n' == pattern[1])) {
+            written = snprintf(&path[length], path_size - length, "%.*s",
+                               (int) name_length, name);
+            pattern++;
+        }
+        else if (('%' == pattern[0]) && ('i' == pattern[1])) {
+            written = snprintf(&path[length], path_size - length, "%zu",
+                               index);
+            pattern++;
+        }
+        else if (('%' == pattern[0]) && ('%' == pattern[1])) {
+            written = snprintf(&path[length], path_size - length, "%%");
+            pattern++;
+        }
+        else {
+            written = snprintf(&path[length], path_size - length, "%c",
+                               *pattern);
+        }
+
+        if ((written < 0) || ((size_t) written >= path_size - length)) {
+            status = EXIT_FAILURE;
+        }
+        else {
+            length += written;
+        }
+    }
+
+    return status;
+}
+
+int DeliteQuickSearch(const char *input_file_path,
+                      size_t count,
+                      const struct Delite_Options *options,
+                      struct Stats *stats) {
+    struct Adjustment_Task tasks[PARALLEL_MAX_THREADS];
+    struct Selection_Heap heap;
+    struct Frame frame;
+    uint16_t *raw_data = NULL;
+    size_t *indices = NULL;
+    size_t size = 0;
+    size_t width = 0;
+    size_t start = 0;
+    size_t selected = 0;
+    size_t i = 0;
+    size_t thread_count = options->thread_count;
+    uint32_t preview_width = 0;
+    uint32_t preview_height = 0;
+    enum Selection_Tie_Break tie_break = options->tie_break;
+    int status = EXIT_SUCCESS;
+
+    memset(tasks, 0, sizeof(tasks));
+    memset(&heap, 0, sizeof(heap));
+
+    StatsBegin(stats, STATS_STAGE_READ);
+    status = FrameOpen(input_file_path, options->input_mode, NULL, &frame);
+    if ((EXIT_SUCCESS == status) &&
+        (EXIT_FAILURE == FrameSetPixelFormat(&frame, options->pixel_format,
+                                             NULL))) {
+        FrameClose(&frame);
+        status = EXIT_FAILURE;
+    }
+    StatsEnd(stats, STATS_STAGE_READ);
+    if (EXIT_SUCCESS == status) {
+        StatsAdd(stats, STATS_FRAMES, 1U);
+        StatsAdd(stats, STATS_BYTES_READ, frame.encoded_size);
+        StatsSetEngine(stats, SelectionGetEngineName(SELECTION_ENGINE_HEAP));
+        StatsBegin(stats, STATS_STAGE_DETECT);
+        raw_data = frame.data;
+        size = frame.size / sizeof(raw_data[0]);
+        /* The positions are those of the preview of the same frame, a
+           frame too small for one being taken as a single row. */
+        if ((EXIT_FAILURE == GetPreviewGeometry(size, options, &width,
+                                                &preview_width,
+                                                &preview_height)) &&
+            (0 == width)) {
+            width = size;
+        }
+        if (count > size) {
+            count = size;
+        }
+
+        for (i = 0; i < thread_count; i++) {
+            GetPartition(size, thread_count, i, &start, &tasks[i].size);
+            tasks[i].data = &raw_data[start];
+            tasks[i].offset = start;
+            tasks[i].source = (NULL != frame.encoded) ? &frame : NULL;
+            tasks[i].pixel_count = count;
+            tasks[i].engine = SELECTION_ENGINE_HEAP;
+            tasks[i].tie_break = tie_break;
+        }
+        status = ParallelRun(DetectPixelsTask, tasks, sizeof(tasks[0]),
+                             thread_count);
+        for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+            status = tasks[i].status;
+        }
+
+        if (EXIT_SUCCESS == status) {
+            status = SelectionHeapInit(&heap, count, tie_break);
+        }
+        for (i = 0; (EXIT_SUCCESS == status) && (i < thread_count); i++) {
+            SelectionHeapMerge(&heap, &tasks[i].heap);
+        }
+        if (EXIT_SUCCESS == status) {
+            indices = malloc((heap.size + 1U) * sizeof(size_t));
+            if (NULL == indices) {
+                status = EXIT_FAILURE;
+            }
+            else {
+                selected = SelectionHeapExtract(&heap, indices);
+                status = SelectionSortByRank(raw_data, indices, selected,
+                                             tie_break);
+            }
+        }
+        StatsEnd(stats, STATS_STAGE_DETECT);
+        if (EXIT_SUCCESS == status) {
+            StatsAdd(stats, STATS_PIXELS_SCANNED, size);
+        }
+
+        if (EXIT_SUCCESS == status) {
+            printf("Overexposed pixel data (pos is the pixel index "
+                   "relative to the beginning of the file): \n");
+            for (i = 0; i < selected; i++) {
+                printf("# Pixel value: 0x%04X - Pos: %" PRIu64
+                       " (x: %" PRIu64 ", y: %" PRIu64 ")\n",
+                       raw_data[indices[i]], (uint64_t) indices[i],
+                       (uint64_t) (indices[i] % width),
+                       (uint64_t) (indices[i] / width));
+            }
+        }
+        else {
+            printf("Unexpected error when processing the pixel data.\n");
+        }
+
+        FrameClose(&frame);
+    }
+    else {
+        printf("Unexpected error when reading the raw input byte stream.\n");
+    }
+
+    for (i = 0; i < PARALLEL_MAX_THREADS; i++) {
+        SelectionHeapFree(&tasks[i].heap);
+    }
+    SelectionHeapFree(&heap);
+    free(indices);
+    
+    return status;
+}
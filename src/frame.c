@@ -0,0 +1,616 @@
+/**
+ *  @brief Raw frame I/O implementation file.
+ *
+ */
+
+/* Needed for copy_file_range(). */
+#define _GNU_SOURCE
+
+#include "frame.h"
+#include "kernels.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/****************************************************************************
+ * LOCAL DECLARATIONS
+ ****************************************************************************/
+/**
+ *  @brief Write a memory area to a file at a given offset.
+ *
+ *  @param fd      Output file descriptor
+ *  @param data    Memory to be written
+ *  @param count   Number of bytes to write
+ *  @param offset  File offset to write at
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int WriteAt(int fd, const uint8_t *data, size_t count, off_t offset);
+
+/**
+ *  @brief Read a file area into memory from a given offset.
+ *
+ *  @param fd      Input file descriptor
+ *  @param data    Memory to be filled
+ *  @param count   Number of bytes to read
+ *  @param offset  File offset to read from
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, if the area can't be read whole.
+ */
+static int ReadAt(int fd, uint8_t *data, size_t count, off_t offset);
+
+/**
+ *  @brief Copy the beginning of one file into another, in-kernel.
+ *
+ *  @param in     Input file descriptor
+ *  @param out    Output file descriptor
+ *  @param count  Number of bytes to copy
+ *
+ *  @return The number of bytes copied (may be less than count if the
+ *          in-kernel copy isn't supported).
+ */
+static size_t CopyFileData(int in, int out, size_t count);
+
+/**
+ *  @brief Check if a pixel format is the 16-bit one of the host.
+ *
+ *  @param format  Input pixel format
+ *
+ *  @return true, if the pixels need no decoding.
+ *          false, otherwise.
+ */
+static bool IsHostFormat(enum Frame_Pixel_Format format);
+
+/**
+ *  @brief Get the number of whole pixels held by some input bytes.
+ *
+ *  @param format  Input pixel format
+ *  @param size    Number of bytes
+ *
+ *  @return The number of pixels.
+ */
+static size_t GetPixelCount(enum Frame_Pixel_Format format, size_t size);
+
+/**
+ *  @brief Store an integer in little-endian order.
+ *
+ *  @param out    Output bytes
+ *  @param value  Integer to store
+ *  @param size   Number of bytes to store
+ *
+ *  @return none
+ */
+static void PackLittleEndian(uint8_t *out, uint64_t value, size_t size);
+
+/****************************************************************************/
+
+int FrameOpen(const char *path, enum Frame_Input_Mode mode,
+              struct Bitmap_Arena *arena, struct Frame *frame) {
+    struct stat file_stat;
+    void *mapping = MAP_FAILED;
+    ssize_t count = 0;
+    size_t offset = 0;
+    size_t map_size = 0;
+    int status = EXIT_SUCCESS;
+
+    if ((NULL == path) || (NULL == frame)) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        memset(frame, 0, sizeof(*frame));
+        frame->fd = open(path, O_RDONLY);
+        if ((frame->fd < 0) || (fstat(frame->fd, &file_stat) < 0) ||
+            (file_stat.st_size <= 0) ||
+            ((uintmax_t) file_stat.st_size > SIZE_MAX)) {
+            status = EXIT_FAILURE;
+        }
+        else {
+            frame->size = file_stat.st_size;
+            frame->pooled = (NULL != arena);
+        }
+    }
+
+    if ((EXIT_SUCCESS == status) && (FRAME_INPUT_MMAP == mode)) {
+        mapping = mmap(NULL, frame->size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE, frame->fd, 0);
+        if (MAP_FAILED != mapping) {
+            map_size = frame->size / FRAME_BLOCK_SIZE / 8U + 1U;
+            if (frame->pooled) {
+                frame->dirty_map = BitmapArenaAlloc(arena, map_size);
+                if (NULL != frame->dirty_map) {
+                    memset(frame->dirty_map, 0, map_size);
+                }
+            }
+            else {
+                frame->dirty_map = calloc(map_size, sizeof(uint8_t));
+            }
+            if (NULL == frame->dirty_map) {
+                munmap(mapping, frame->size);
+            }
+            else {
+                /* Detection goes through the frame front to back. */
+                madvise(mapping, frame->size, MADV_SEQUENTIAL);
+                frame->data = mapping;
+                frame->mapped = true;
+            }
+        }
+    }
+
+    /* Fall back to reading the whole file. */
+    if ((EXIT_SUCCESS == status) && (!frame->mapped)) {
+        frame->data = (frame->pooled) ? BitmapArenaAlloc(arena, frame->size) :
+                                        malloc(frame->size);
+        if (NULL == frame->data) {
+            status = EXIT_FAILURE;
+        }
+        while ((EXIT_SUCCESS == status) && (offset < frame->size)) {
+            count = read(frame->fd, (uint8_t *) frame->data + offset,
+                         frame->size - offset);
+            if (count > 0) {
+                offset += count;
+            }
+            else if ((count < 0) && (EINTR == errno)) {
+                continue;
+            }
+            else {
+                /* File read failed. */
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+
+    if ((EXIT_FAILURE == status) && (NULL != path) && (NULL != frame)) {
+        FrameClose(frame);
+    }
+
+    return status;
+}
+
+int FrameSetPixelFormat(struct Frame *frame,
+                        enum Frame_Pixel_Format format,
+                        struct Bitmap_Arena *arena) {
+    size_t pixels = 0;
+    int status = EXIT_SUCCESS;
+
+    if ((NULL == frame) || (NULL == frame->data) ||
+        (frame->pooled && (NULL == arena))) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        frame->format = format;
+        frame->encoded_size = frame->size;
+        pixels = GetPixelCount(format, frame->size);
+    }
+
+    if ((EXIT_SUCCESS == status) && !IsHostFormat(format) && (0 == pixels)) {
+        status = EXIT_FAILURE;
+    }
+    else if ((EXIT_SUCCESS == status) && !IsHostFormat(format)) {
+        frame->encoded = frame->data;
+        frame->size = pixels * sizeof(uint16_t);
+        frame->data = (frame->pooled) ? BitmapArenaAlloc(arena, frame->size) :
+                                        malloc(frame->size);
+        if (NULL == frame->data) {
+            /* Leave the frame as it was, for FrameClose. */
+            frame->data = frame->encoded;
+            frame->size = frame->encoded_size;
+            frame->encoded = NULL;
+            status = EXIT_FAILURE;
+        }
+        else {
+            /* The output no longer matches the input file anywhere. */
+            if (!frame->pooled) {
+                free(frame->dirty_map);
+            }
+            frame->dirty_map = NULL;
+        }
+    }
+
+    return status;
+}
+
+void FrameDecode(const struct Frame *frame,
+                 size_t offset,
+                 size_t count,
+                 uint16_t *out) {
+    const uint8_t *in = NULL;
+    uint16_t pair[2];
+
+    if ((NULL != frame) && (NULL != frame->encoded) && (count > 0)) {
+        in = frame->encoded;
+        if ((FRAME_PIXEL_U16LE == frame->format) ||
+            (FRAME_PIXEL_U16BE == frame->format)) {
+            KernelSwap16Bit((const uint16_t *) &in[offset * 2U], count, out);
+        }
+        else if (FRAME_PIXEL_U8 == frame->format) {
+            KernelDecode8Bit(&in[offset], count, out);
+        }
+        else if (FRAME_PIXEL_RAW12 == frame->format) {
+            /* An odd pixel shares its bytes with the previous one. */
+            if (0 != offset % 2U) {
+                KernelDecode12Bit(&in[offset / 2U * 3U], 2U, pair);
+                *out++ = pair[1];
+                offset++;
+                count--;
+            }
+            KernelDecode12Bit(&in[offset / 2U * 3U], count, out);
+        }
+        else {
+            KernelDecodeFloat(&in[offset * 4U], count, out);
+        }
+    }
+}
+
+int FrameWriteToFile(const struct Frame *frame, const char *path) {
+    struct Frame_Output output;
+    int status = EXIT_SUCCESS;
+
+    /* Only the adjusted blocks differ from the copied input. */
+    status = FrameOutputOpen(frame, path, &output);
+    if (EXIT_SUCCESS == status) {
+        status = FrameOutputWrite(frame, &output, 0, frame->size,
+                                  frame->dirty_map);
+    }
+
+    if ((EXIT_FAILURE == FrameOutputClose(&output)) &&
+        (EXIT_SUCCESS == status)) {
+        status = EXIT_FAILURE;
+    }
+
+    return status;
+}
+
+int FrameWriteChanges(const struct Frame *frame,
+                      const char *delta_path,
+                      const char *patch_path,
+                      size_t *written) {
+    uint16_t original[FRAME_BLOCK_SIZE / sizeof(uint16_t)];
+    uint8_t records[FRAME_BLOCK_SIZE / sizeof(uint16_t) *
+                    FRAME_DELTA_RECORD_SIZE];
+    struct stat in_stat;
+    struct stat out_stat;
+    const uint16_t *data = NULL;
+    off_t delta_offset = FRAME_DELTA_HEADER_SIZE;
+    int delta = -1;
+    int patch = -1;
+    size_t pixels = 0;
+    size_t block = 0;
+    size_t first = 0;
+    size_t count = 0;
+    size_t run = 0;
+    size_t filled = 0;
+    size_t i = 0;
+    bool dirty = false;
+    int status = EXIT_SUCCESS;
+
+    if ((NULL == frame) || (NULL == frame->data) ||
+        (NULL != frame->encoded) || (NULL == written) ||
+        (fstat(frame->fd, &in_stat) < 0)) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        data = frame->data;
+        pixels = frame->size / sizeof(uint16_t);
+    }
+
+    if ((EXIT_SUCCESS == status) && (NULL != delta_path)) {
+        /* Truncating the input would lose the original pixels. */
+        delta = open(delta_path, O_WRONLY | O_CREAT, 0666);
+        if ((delta < 0) || (fstat(delta, &out_stat) < 0) ||
+            ((in_stat.st_dev == out_stat.st_dev) &&
+             (in_stat.st_ino == out_stat.st_ino)) ||
+            (ftruncate(delta, 0) < 0)) {
+            status = EXIT_FAILURE;
+        }
+        else {
+            memcpy(records, FRAME_DELTA_MAGIC, 4U);
+            PackLittleEndian(&records[4], pixels, 8U);
+            status = WriteAt(delta, records, FRAME_DELTA_HEADER_SIZE, 0);
+        }
+        if (EXIT_SUCCESS == status) {
+            *written += FRAME_DELTA_HEADER_SIZE;
+        }
+    }
+    if ((EXIT_SUCCESS == status) && (NULL != patch_path)) {
+        /* Only the input file itself holds the other pixels already. */
+        patch = open(patch_path, O_WRONLY);
+        if ((patch < 0) || (fstat(patch, &out_stat) < 0) ||
+            (in_stat.st_dev != out_stat.st_dev) ||
+            (in_stat.st_ino != out_stat.st_ino)) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    for (block = 0; (EXIT_SUCCESS == status) && (first < pixels);
+         block++, first += count) {
+        count = (pixels - first < FRAME_BLOCK_SIZE / sizeof(uint16_t)) ?
+                pixels - first : FRAME_BLOCK_SIZE / sizeof(uint16_t);
+        /* The other blocks hold the original pixels only. */
+        dirty = (NULL == frame->dirty_map) ||
+                (frame->dirty_map[block / 8U] & (1U << (block % 8U)));
+        if (dirty) {
+            status = ReadAt(frame->fd, (uint8_t *) original,
+                            count * sizeof(uint16_t),
+                            first * sizeof(uint16_t));
+        }
+        for (i = 0, run = 0, filled = 0;
+             dirty && (EXIT_SUCCESS == status) && (i <= count); i++) {
+            /* The pixel past the block ends the last run. */
+            if ((i < count) && (data[first + i] != original[i])) {
+                PackLittleEndian(&records[filled], first + i, 8U);
+                PackLittleEndian(&records[filled + 8U], original[i], 2U);
+                PackLittleEndian(&records[filled + 10U], data[first + i], 2U);
+                filled += FRAME_DELTA_RECORD_SIZE;
+            }
+            else {
+                if ((patch >= 0) && (run < i)) {
+                    status = WriteAt(patch,
+                                     (const uint8_t *) &data[first + run],
+                                     (i - run) * sizeof(uint16_t),
+                                     (first + run) * sizeof(uint16_t));
+                    *written += (i - run) * sizeof(uint16_t);
+                }
+                run = i + 1U;
+            }
+        }
+        if ((EXIT_SUCCESS == status) && (delta >= 0) && (filled > 0)) {
+            status = WriteAt(delta, records, filled, delta_offset);
+            delta_offset += filled;
+            *written += filled;
+        }
+    }
+
+    if ((delta >= 0) && (0 != close(delta))) {
+        status = EXIT_FAILURE;
+    }
+    if ((patch >= 0) && (0 != close(patch))) {
+        status = EXIT_FAILURE;
+    }
+
+    return status;
+}
+
+int FrameOutputOpen(const struct Frame *frame, const char *path,
+                    struct Frame_Output *output) {
+    struct stat in_stat;
+    struct stat out_stat;
+    bool same_file = false;
+    int status = EXIT_SUCCESS;
+
+    if (NULL != output) {
+        output->fd = -1;
+        output->in_place = false;
+    }
+
+    if ((NULL == frame) || (NULL == frame->data) || (NULL == path) ||
+        (NULL == output)) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        output->fd = open(path, O_WRONLY | O_CREAT, 0666);
+        if ((output->fd < 0) || (fstat(output->fd, &out_stat) < 0) ||
+            (fstat(frame->fd, &in_stat) < 0)) {
+            status = EXIT_FAILURE;
+        }
+        else {
+            same_file = (in_stat.st_dev == out_stat.st_dev) &&
+                        (in_stat.st_ino == out_stat.st_ino);
+            output->in_place = frame->mapped && same_file;
+
+            /* The decoded pixels don't fit where the input ones were. */
+            if (same_file && (NULL != frame->encoded)) {
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+
+    /* Truncating the input would invalidate its mapping. */
+    if ((EXIT_SUCCESS == status) && (!same_file)) {
+        if (ftruncate(output->fd, 0) < 0) {
+            status = EXIT_FAILURE;
+        }
+        else if (frame->mapped && (NULL == frame->encoded)) {
+            /* Once the input is copied in-kernel, the output is as good
+               as in place. */
+            output->in_place = (CopyFileData(frame->fd, output->fd,
+                                             frame->size) == frame->size);
+        }
+    }
+
+    if ((EXIT_FAILURE == status) && (NULL != output)) {
+        FrameOutputClose(output);
+    }
+
+    return status;
+}
+
+int FrameOutputWrite(const struct Frame *frame,
+                     const struct Frame_Output *output,
+                     size_t offset,
+                     size_t count,
+                     const uint8_t *dirty_map) {
+    const uint8_t *data = NULL;
+    size_t block = 0;
+    size_t done = 0;
+    int status = EXIT_SUCCESS;
+
+    if ((NULL == frame) || (NULL == output) || (output->fd < 0) ||
+        (offset > frame->size) || (count > frame->size - offset)) {
+        status = EXIT_FAILURE;
+    }
+    else if (!output->in_place) {
+        status = WriteAt(output->fd, (const uint8_t *) frame->data + offset,
+                         count, offset);
+    }
+    else {
+        data = (const uint8_t *) frame->data + offset;
+        for (block = 0; (EXIT_SUCCESS == status) && (done < count);
+             block++, done += FRAME_BLOCK_SIZE) {
+            if ((NULL == dirty_map) ||
+                (dirty_map[block / 8U] & (1U << (block % 8U)))) {
+                status = WriteAt(output->fd, data + done,
+                                 (count - done < FRAME_BLOCK_SIZE) ?
+                                 count - done : FRAME_BLOCK_SIZE,
+                                 offset + done);
+            }
+        }
+    }
+
+    return status;
+}
+
+int FrameOutputClose(struct Frame_Output *output) {
+    int status = EXIT_SUCCESS;
+
+    if ((NULL != output) && (output->fd >= 0)) {
+        if (close(output->fd) < 0) {
+            status = EXIT_FAILURE;
+        }
+        output->fd = -1;
+    }
+
+    return status;
+}
+
+void FrameClose(struct Frame *frame) {
+    void *input = NULL;
+
+    if (NULL != frame) {
+        input = (NULL != frame->encoded) ? frame->encoded : frame->data;
+        if (frame->mapped) {
+            munmap(input, (NULL != frame->encoded) ? frame->encoded_size :
+                                                     frame->size);
+        }
+        else if (!frame->pooled) {
+            free(input);
+        }
+        if ((NULL != frame->encoded) && !frame->pooled) {
+            free(frame->data);
+        }
+        if (frame->fd >= 0) {
+            close(frame->fd);
+        }
+
+        /* Free tolerates NULL, no need to check. */
+        if (!frame->pooled) {
+            free(frame->dirty_map);
+        }
+
+        memset(frame, 0, sizeof(*frame));
+        frame->fd = -1;
+    }
+}
+
+static int WriteAt(int fd, const uint8_t *data, size_t count, off_t offset) {
+    ssize_t written = 0;
+    int status = EXIT_SUCCESS;
+
+    while ((EXIT_SUCCESS == status) && (count > 0)) {
+        written = pwrite(fd, data, count, offset);
+        if (written > 0) {
+            data += written;
+            count -= written;
+            offset += written;
+        }
+        else if ((written < 0) && (EINTR == errno)) {
+            continue;
+        }
+        else {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    return status;
+}
+
+static int ReadAt(int fd, uint8_t *data, size_t count, off_t offset) {
+    ssize_t done = 0;
+    int status = EXIT_SUCCESS;
+
+    while ((EXIT_SUCCESS == status) && (count > 0)) {
+        done = pread(fd, data, count, offset);
+        if (done > 0) {
+            data += done;
+            count -= done;
+            offset += done;
+        }
+        else if ((done < 0) && (EINTR == errno)) {
+            continue;
+        }
+        else {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    return status;
+}
+
+static size_t CopyFileData(int in, int out, size_t count) {
+    size_t copied = 0;
+#ifdef __linux__
+    ssize_t result = 0;
+    loff_t in_offset = 0;
+    loff_t out_offset = 0;
+
+    while (copied < count) {
+        result = copy_file_range(in, &in_offset, out, &out_offset,
+                                 count - copied, 0U);
+        if (result > 0) {
+            copied += result;
+        }
+        else if ((result < 0) && (EINTR == errno)) {
+            continue;
+        }
+        else {
+            /* Not supported (e.g. across file systems), the caller
+               writes the rest of the data from memory. */
+            break;
+        }
+    }
+#else
+    (void) in;
+    (void) out;
+    (void) count;
+#endif /* __linux__ */
+
+    return copied;
+}
+
+static bool IsHostFormat(enum Frame_Pixel_Format format) {
+#if defined(__BYTE_ORDER__) && (__ORDER_BIG_ENDIAN__ == __BYTE_ORDER__)
+    return (FRAME_PIXEL_U16BE == format);
+#else
+    return (FRAME_PIXEL_U16LE == format);
+#endif
+}
+
+static size_t GetPixelCount(enum Frame_Pixel_Format format, size_t size) {
+    size_t pixels = size / sizeof(uint16_t);
+
+    if (FRAME_PIXEL_U8 == format) {
+        pixels = size;
+    }
+    else if (FRAME_PIXEL_RAW12 == format) {
+        pixels = size / 3U * 2U;
+    }
+    else if (FRAME_PIXEL_F32 == format) {
+        pixels = size / sizeof(float);
+    }
+
+    return pixels;
+}
+
+static void PackLittleEndian(uint8_t *out, uint64_t value, size_t size) {
+    size_t i = 0;
+
+    for (i = 0; i < size; i++) {
+        out[i] = (uint8_t) (value >> (8U * i));
+    }
+}
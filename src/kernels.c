@@ -0,0 +1,1257 @@
+/**
+ *  @brief Pixel processing kernels implementation file.
+ *
+ *  The x86 kernels are compiled with per-function target attributes,
+ *  so no global instruction set flags are needed and the binary still
+ *  runs on CPUs lacking AVX2. The vectorized adjustment converts each
+ *  pixel to single precision before multiplying it, so it rounds the
+ *  same way as the scalar code. A 16-bit multiply-high or a lookup
+ *  table gather were both considered instead: the first one can't
+ *  reproduce the single precision rounding for most factors and the
+ *  second one is about twice as slow as the float multiply.
+ */
+
+#include "kernels.h"
+
+#include <float.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define KERNELS_X86
+    #include <immintrin.h>
+#elif defined(__aarch64__)
+    #define KERNELS_NEON
+    #include <arm_neon.h>
+#endif
+
+/* Where float math runs in a wider format (e.g. x87), the intermediate
+   results are forced through memory to round them to single precision. */
+#if defined(FLT_EVAL_METHOD) && (0 != FLT_EVAL_METHOD)
+    #define KERNELS_FLOAT volatile float
+#else
+    #define KERNELS_FLOAT float
+#endif
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS
+ ****************************************************************************/
+/* Number of comparators of the median selection networks. */
+#define MEDIAN_9_SIZE 19U
+#define MEDIAN_25_SIZE 99U
+
+/****************************************************************************
+ * TYPE DEFINITIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Set of kernel implementations.
+ */
+struct Kernels {
+    const char *name;           /* Instruction set name */
+    void (*downscale)(const uint16_t *, size_t, uint8_t *);
+    size_t (*find_at_least)(const uint16_t *, size_t, uint16_t);
+    size_t (*find_equal)(const uint16_t *, size_t, uint16_t);
+    size_t (*scale_above)(uint16_t *, size_t, uint16_t, float);
+    void (*accumulate)(const uint16_t *, size_t, uint32_t *);
+    size_t (*scale_above_median)(uint16_t *, const uint16_t *const *, size_t,
+                                 size_t, uint16_t, float);
+    void (*swap_16_bit)(const uint16_t *, size_t, uint16_t *);
+    void (*decode_8_bit)(const uint8_t *, size_t, uint16_t *);
+    void (*decode_12_bit)(const uint8_t *, size_t, uint16_t *);
+    void (*decode_float)(const uint8_t *, size_t, uint16_t *);
+};
+
+/****************************************************************************
+ * LOCAL DECLARATIONS
+ ****************************************************************************/
+/* Scalar implementations (see kernels.h for the API). */
+static void DownscaleScalar(const uint16_t *data, size_t size, uint8_t *out);
+static size_t FindAtLeastScalar(const uint16_t *data,
+                                size_t size,
+                                uint16_t value);
+static size_t FindEqualScalar(const uint16_t *data,
+                              size_t size,
+                              uint16_t value);
+static size_t ScaleAboveScalar(uint16_t *data,
+                               size_t size,
+                               uint16_t value,
+                               float factor);
+static void AccumulateScalar(const uint16_t *data,
+                             size_t size,
+                             uint32_t *sums);
+static size_t ScaleAboveMedianScalar(uint16_t *data,
+                                     const uint16_t *const *rows,
+                                     size_t window,
+                                     size_t size,
+                                     uint16_t margin,
+                                     float factor);
+static void Swap16BitScalar(const uint16_t *in, size_t size, uint16_t *out);
+static void Decode8BitScalar(const uint8_t *in, size_t size, uint16_t *out);
+static void Decode12BitScalar(const uint8_t *in, size_t size, uint16_t *out);
+static void DecodeFloatScalar(const uint8_t *in, size_t size, uint16_t *out);
+
+/**
+ *  @brief Get the median selection network of a neighborhood.
+ *
+ *  @param window   Neighborhood side (3 or 5)
+ *  @param network  Comparators, each putting the lower value first
+ *
+ *  @return The number of comparators.
+ */
+static size_t GetMedianNetwork(size_t window, const uint8_t (**network)[2]);
+
+#ifdef KERNELS_X86
+/* SSE2 implementations, 8 pixels at a time. */
+static void DownscaleSse2(const uint16_t *data, size_t size, uint8_t *out);
+static size_t FindAtLeastSse2(const uint16_t *data,
+                              size_t size,
+                              uint16_t value);
+static size_t FindEqualSse2(const uint16_t *data,
+                            size_t size,
+                            uint16_t value);
+static size_t ScaleAboveSse2(uint16_t *data,
+                             size_t size,
+                             uint16_t value,
+                             float factor);
+static void AccumulateSse2(const uint16_t *data, size_t size, uint32_t *sums);
+static size_t ScaleAboveMedianSse2(uint16_t *data,
+                                   const uint16_t *const *rows,
+                                   size_t window,
+                                   size_t size,
+                                   uint16_t margin,
+                                   float factor);
+static void Swap16BitSse2(const uint16_t *in, size_t size, uint16_t *out);
+static void Decode8BitSse2(const uint8_t *in, size_t size, uint16_t *out);
+static void DecodeFloatSse2(const uint8_t *in, size_t size, uint16_t *out);
+
+/* AVX2 implementations, 16 pixels at a time. */
+static void DownscaleAvx2(const uint16_t *data, size_t size, uint8_t *out);
+static size_t FindAtLeastAvx2(const uint16_t *data,
+                              size_t size,
+                              uint16_t value);
+static size_t FindEqualAvx2(const uint16_t *data,
+                            size_t size,
+                            uint16_t value);
+static size_t ScaleAboveAvx2(uint16_t *data,
+                             size_t size,
+                             uint16_t value,
+                             float factor);
+static void AccumulateAvx2(const uint16_t *data, size_t size, uint32_t *sums);
+static size_t ScaleAboveMedianAvx2(uint16_t *data,
+                                   const uint16_t *const *rows,
+                                   size_t window,
+                                   size_t size,
+                                   uint16_t margin,
+                                   float factor);
+static void Swap16BitAvx2(const uint16_t *in, size_t size, uint16_t *out);
+static void Decode8BitAvx2(const uint8_t *in, size_t size, uint16_t *out);
+static void Decode12BitAvx2(const uint8_t *in, size_t size, uint16_t *out);
+static void DecodeFloatAvx2(const uint8_t *in, size_t size, uint16_t *out);
+
+/* Vector pixel scaling, as by KernelScalePixel. */
+static __m128i ScalePixelsSse2(__m128i pixels, __m128 scale);
+static __m256i ScalePixelsAvx2(__m256i pixels, __m256 scale);
+#endif /* KERNELS_X86 */
+
+#ifdef KERNELS_NEON
+/* NEON implementations, 8 pixels at a time. */
+static void DownscaleNeon(const uint16_t *data, size_t size, uint8_t *out);
+static size_t FindAtLeastNeon(const uint16_t *data,
+                              size_t size,
+                              uint16_t value);
+static size_t FindEqualNeon(const uint16_t *data,
+                            size_t size,
+                            uint16_t value);
+static size_t ScaleAboveNeon(uint16_t *data,
+                             size_t size,
+                             uint16_t value,
+                             float factor);
+static void AccumulateNeon(const uint16_t *data, size_t size, uint32_t *sums);
+static size_t ScaleAboveMedianNeon(uint16_t *data,
+                                   const uint16_t *const *rows,
+                                   size_t window,
+                                   size_t size,
+                                   uint16_t margin,
+                                   float factor);
+static void Swap16BitNeon(const uint16_t *in, size_t size, uint16_t *out);
+static void Decode8BitNeon(const uint8_t *in, size_t size, uint16_t *out);
+static void Decode12BitNeon(const uint8_t *in, size_t size, uint16_t *out);
+static void DecodeFloatNeon(const uint8_t *in, size_t size, uint16_t *out);
+
+/* Vector pixel scaling, as by KernelScalePixel. */
+static uint16x8_t ScalePixelsNeon(uint16x8_t pixels, float factor);
+#endif /* KERNELS_NEON */
+
+static const struct Kernels scalar_kernels = {
+    "scalar", DownscaleScalar, FindAtLeastScalar, FindEqualScalar,
+    ScaleAboveScalar, AccumulateScalar, ScaleAboveMedianScalar,
+    Swap16BitScalar, Decode8BitScalar, Decode12BitScalar, DecodeFloatScalar
+};
+
+#ifdef KERNELS_X86
+static const struct Kernels sse2_kernels = {
+    "sse2", DownscaleSse2, FindAtLeastSse2, FindEqualSse2, ScaleAboveSse2,
+    AccumulateSse2, ScaleAboveMedianSse2, Swap16BitSse2, Decode8BitSse2,
+    Decode12BitScalar, DecodeFloatSse2
+};
+
+static const struct Kernels avx2_kernels = {
+    "avx2", DownscaleAvx2, FindAtLeastAvx2, FindEqualAvx2, ScaleAboveAvx2,
+    AccumulateAvx2, ScaleAboveMedianAvx2, Swap16BitAvx2, Decode8BitAvx2,
+    Decode12BitAvx2, DecodeFloatAvx2
+};
+#endif /* KERNELS_X86 */
+
+#ifdef KERNELS_NEON
+static const struct Kernels neon_kernels = {
+    "neon", DownscaleNeon, FindAtLeastNeon, FindEqualNeon, ScaleAboveNeon,
+    AccumulateNeon, ScaleAboveMedianNeon, Swap16BitNeon, Decode8BitNeon,
+    Decode12BitNeon, DecodeFloatNeon
+};
+#endif /* KERNELS_NEON */
+
+/* Selected implementations. */
+static const struct Kernels *kernels = &scalar_kernels;
+
+/* Median selection networks of 3x3 and 5x5 neighborhoods (N. Devillard,
+   "Fast median search"), the median ending up in the middle. */
+static const uint8_t median_9[MEDIAN_9_SIZE][2] = {
+    {1, 2}, {4, 5}, {7, 8}, {0, 1}, {3, 4}, {6, 7}, {1, 2}, {4, 5}, {7, 8},
+    {0, 3}, {5, 8}, {4, 7}, {3, 6}, {1, 4}, {2, 5}, {4, 7}, {4, 2}, {6, 4},
+    {4, 2}
+};
+
+static const uint8_t median_25[MEDIAN_25_SIZE][2] = {
+    {0, 1}, {3, 4}, {2, 4}, {2, 3}, {6, 7}, {5, 7}, {5, 6}, {9, 10},
+    {8, 10}, {8, 9}, {12, 13}, {11, 13}, {11, 12}, {15, 16}, {14, 16},
+    {14, 15}, {18, 19}, {17, 19}, {17, 18}, {21, 22}, {20, 22}, {20, 21},
+    {23, 24}, {2, 5}, {3, 6}, {0, 6}, {0, 3}, {4, 7}, {1, 7}, {1, 4},
+    {11, 14}, {8, 14}, {8, 11}, {12, 15}, {9, 15}, {9, 12}, {13, 16},
+    {10, 16}, {10, 13}, {20, 23}, {17, 23}, {17, 20}, {21, 24}, {18, 24},
+    {18, 21}, {19, 22}, {8, 17}, {9, 18}, {0, 18}, {0, 9}, {10, 19},
+    {1, 19}, {1, 10}, {11, 20}, {2, 20}, {2, 11}, {12, 21}, {3, 21},
+    {3, 12}, {13, 22}, {4, 22}, {4, 13}, {14, 23}, {5, 23}, {5, 14},
+    {15, 24}, {6, 24}, {6, 15}, {7, 16}, {7, 19}, {13, 21}, {15, 23},
+    {7, 13}, {7, 15}, {1, 9}, {3, 11}, {5, 17}, {11, 17}, {9, 17}, {4, 10},
+    {6, 12}, {7, 14}, {4, 6}, {4, 7}, {12, 14}, {10, 14}, {6, 7}, {10, 12},
+    {6, 10}, {6, 17}, {12, 17}, {7, 17}, {7, 10}, {12, 18}, {7, 12},
+    {10, 18}, {12, 20}, {10, 20}, {10, 12}
+};
+
+/****************************************************************************/
+
+void KernelsInit(void) {
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels = &avx2_kernels;
+    }
+    else if (__builtin_cpu_supports("sse2")) {
+        kernels = &sse2_kernels;
+    }
+#elif defined(KERNELS_NEON)
+    /* NEON is part of the base AArch64 instruction set. */
+    kernels = &neon_kernels;
+#endif
+}
+
+const char *KernelsGetName(void) {
+    return kernels->name;
+}
+
+float KernelsGetScaleFactor(unsigned adjustment_level) {
+    KERNELS_FLOAT level = ((float) adjustment_level) / 100;
+    KERNELS_FLOAT factor = 1 - level;
+
+    return factor;
+}
+
+uint16_t KernelScalePixel(uint16_t pixel, float factor) {
+    KERNELS_FLOAT product = pixel * factor;
+
+    return (uint16_t) product;
+}
+
+void KernelDownscale(const uint16_t *data, size_t size, uint8_t *out) {
+    kernels->downscale(data, size, out);
+}
+
+size_t KernelFindAtLeast(const uint16_t *data, size_t size, uint16_t value) {
+    return kernels->find_at_least(data, size, value);
+}
+
+size_t KernelFindEqual(const uint16_t *data, size_t size, uint16_t value) {
+    return kernels->find_equal(data, size, value);
+}
+
+size_t KernelScaleAbove(uint16_t *data,
+                        size_t size,
+                        uint16_t value,
+                        float factor) {
+    return kernels->scale_above(data, size, value, factor);
+}
+
+void KernelAccumulate(const uint16_t *data, size_t size, uint32_t *sums) {
+    kernels->accumulate(data, size, sums);
+}
+
+size_t KernelScaleAboveMedian(uint16_t *data,
+                              const uint16_t *const *rows,
+                              size_t window,
+                              size_t size,
+                              uint16_t margin,
+                              float factor) {
+    return kernels->scale_above_median(data, rows, window, size, margin,
+                                       factor);
+}
+
+void KernelSwap16Bit(const uint16_t *in, size_t size, uint16_t *out) {
+    kernels->swap_16_bit(in, size, out);
+}
+
+void KernelDecode8Bit(const uint8_t *in, size_t size, uint16_t *out) {
+    kernels->decode_8_bit(in, size, out);
+}
+
+void KernelDecode12Bit(const uint8_t *in, size_t size, uint16_t *out) {
+    kernels->decode_12_bit(in, size, out);
+}
+
+void KernelDecodeFloat(const uint8_t *in, size_t size, uint16_t *out) {
+    kernels->decode_float(in, size, out);
+}
+
+static void DownscaleScalar(const uint16_t *data, size_t size, uint8_t *out) {
+    size_t i = 0;
+
+    for (i = 0; i < size; i++) {
+        out[i] = data[i] >> 8;
+    }
+}
+
+static size_t FindAtLeastScalar(const uint16_t *data,
+                                size_t size,
+                                uint16_t value) {
+    size_t i = 0;
+
+    while ((i < size) && (data[i] < value)) {
+        i++;
+    }
+
+    return i;
+}
+
+static size_t FindEqualScalar(const uint16_t *data,
+                              size_t size,
+                              uint16_t value) {
+    size_t i = 0;
+
+    while ((i < size) && (data[i] != value)) {
+        i++;
+    }
+
+    return i;
+}
+
+static size_t ScaleAboveScalar(uint16_t *data,
+                               size_t size,
+                               uint16_t value,
+                               float factor) {
+    size_t i = 0;
+    size_t count = 0;
+
+    for (i = 0; i < size; i++) {
+        if (data[i] > value) {
+            data[i] = KernelScalePixel(data[i], factor);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static void AccumulateScalar(const uint16_t *data,
+                             size_t size,
+                             uint32_t *sums) {
+    size_t i = 0;
+
+    for (i = 0; i < size; i++) {
+        sums[i] += data[i];
+    }
+}
+
+static size_t ScaleAboveMedianScalar(uint16_t *data,
+                                     const uint16_t *const *rows,
+                                     size_t window,
+                                     size_t size,
+                                     uint16_t margin,
+                                     float factor) {
+    uint16_t values[KERNELS_MAX_WINDOW * KERNELS_MAX_WINDOW];
+    const uint8_t (*network)[2] = NULL;
+    size_t comparators = GetMedianNetwork(window, &network);
+    size_t radius = window / 2U;
+    size_t count = 0;
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+    uint16_t center = 0;
+    uint16_t low = 0;
+
+    for (i = 0; i < size; i++) {
+        for (j = 0; j < window; j++) {
+            for (k = 0; k < window; k++) {
+                values[j * window + k] = (rows[j] - radius)[i + k];
+            }
+        }
+        for (j = 0; j < comparators; j++) {
+            low = values[network[j][0]];
+            if (low > values[network[j][1]]) {
+                values[network[j][0]] = values[network[j][1]];
+                values[network[j][1]] = low;
+            }
+        }
+
+        center = rows[radius][i];
+        if ((center > values[window * window / 2U]) &&
+            (center - values[window * window / 2U] > margin)) {
+            data[i] = KernelScalePixel(center, factor);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static void Swap16BitScalar(const uint16_t *in, size_t size, uint16_t *out) {
+    size_t i = 0;
+
+    for (i = 0; i < size; i++) {
+        out[i] = (uint16_t) ((in[i] << 8) | (in[i] >> 8));
+    }
+}
+
+static void Decode8BitScalar(const uint8_t *in, size_t size, uint16_t *out) {
+    size_t i = 0;
+
+    for (i = 0; i < size; i++) {
+        out[i] = in[i] * 257U;
+    }
+}
+
+static void Decode12BitScalar(const uint8_t *in, size_t size, uint16_t *out) {
+    const uint8_t *pair = NULL;
+    uint16_t value = 0;
+    size_t i = 0;
+
+    for (i = 0; i < size; i++) {
+        pair = &in[i / 2U * 3U];
+        if (0 == i % 2U) {
+            value = (uint16_t) ((pair[0] << 4) | (pair[2] & 0x0F));
+        } else {
+            value = (uint16_t) ((pair[1] << 4) | (pair[2] >> 4));
+        }
+        out[i] = (uint16_t) ((value << 4) | (value >> 8));
+    }
+}
+
+static void DecodeFloatScalar(const uint8_t *in, size_t size, uint16_t *out) {
+    KERNELS_FLOAT product = 0;
+    uint32_t bits = 0;
+    float value = 0;
+    size_t i = 0;
+
+    for (i = 0; i < size; i++) {
+        bits = (uint32_t) in[4U * i] | ((uint32_t) in[4U * i + 1U] << 8) |
+               ((uint32_t) in[4U * i + 2U] << 16) |
+               ((uint32_t) in[4U * i + 3U] << 24);
+        memcpy(&value, &bits, sizeof(value));
+
+        /* NaN fails the comparison as well. */
+        product = (value > 0) ? value * 65536 : 0;
+        out[i] = (product < 65535) ? (uint16_t) product : 0xFFFFU;
+    }
+}
+
+static size_t GetMedianNetwork(size_t window, const uint8_t (**network)[2]) {
+    size_t comparators = MEDIAN_25_SIZE;
+
+    *network = median_25;
+    if (3U == window) {
+        *network = median_9;
+        comparators = MEDIAN_9_SIZE;
+    }
+
+    return comparators;
+}
+
+#ifdef KERNELS_X86
+__attribute__((target("sse2")))
+static void DownscaleSse2(const uint16_t *data, size_t size, uint8_t *out) {
+    __m128i low;
+    __m128i high;
+    size_t i = 0;
+
+    for (i = 0; i + 16U <= size; i += 16U) {
+        low = _mm_srli_epi16(_mm_loadu_si128((const __m128i *) &data[i]), 8);
+        high = _mm_srli_epi16(_mm_loadu_si128((const __m128i *) &data[i + 8U]),
+                              8);
+        _mm_storeu_si128((__m128i *) &out[i], _mm_packus_epi16(low, high));
+    }
+
+    DownscaleScalar(&data[i], size - i, &out[i]);
+}
+
+__attribute__((target("sse2")))
+static size_t FindAtLeastSse2(const uint16_t *data,
+                              size_t size,
+                              uint16_t value) {
+    const __m128i threshold = _mm_set1_epi16((short) value);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i pixels;
+    size_t i = 0;
+    int mask = 0;
+
+    /* A pixel is at least the value when value - pixel saturates to 0. */
+    for (i = 0; i + 8U <= size; i += 8U) {
+        pixels = _mm_loadu_si128((const __m128i *) &data[i]);
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_subs_epu16(threshold,
+                                                                pixels),
+                                                 zero));
+        if (0 != mask) {
+            return i + __builtin_ctz(mask) / 2U;
+        }
+    }
+
+    return i + FindAtLeastScalar(&data[i], size - i, value);
+}
+
+__attribute__((target("sse2")))
+static size_t FindEqualSse2(const uint16_t *data,
+                            size_t size,
+                            uint16_t value) {
+    const __m128i match = _mm_set1_epi16((short) value);
+    __m128i pixels;
+    size_t i = 0;
+    int mask = 0;
+
+    for (i = 0; i + 8U <= size; i += 8U) {
+        pixels = _mm_loadu_si128((const __m128i *) &data[i]);
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi16(pixels, match));
+        if (0 != mask) {
+            return i + __builtin_ctz(mask) / 2U;
+        }
+    }
+
+    return i + FindEqualScalar(&data[i], size - i, value);
+}
+
+__attribute__((target("sse2")))
+static size_t ScaleAboveSse2(uint16_t *data,
+                             size_t size,
+                             uint16_t value,
+                             float factor) {
+    const __m128i threshold = _mm_set1_epi16((short) value);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 scale = _mm_set1_ps(factor);
+    __m128i pixels;
+    __m128i unchanged;
+    size_t i = 0;
+    size_t count = 0;
+    int mask = 0;
+
+    for (i = 0; i + 8U <= size; i += 8U) {
+        pixels = _mm_loadu_si128((const __m128i *) &data[i]);
+        /* A pixel isn't above the value when pixel - value saturates
+           to 0. */
+        unchanged = _mm_cmpeq_epi16(_mm_subs_epu16(pixels, threshold), zero);
+        mask = _mm_movemask_epi8(unchanged) ^ 0xFFFF;
+        if (0 != mask) {
+            pixels = _mm_or_si128(_mm_and_si128(unchanged, pixels),
+                                  _mm_andnot_si128(unchanged,
+                                                   ScalePixelsSse2(pixels,
+                                                                   scale)));
+            _mm_storeu_si128((__m128i *) &data[i], pixels);
+            count += __builtin_popcount(mask) / 2U;
+        }
+    }
+
+    return count + ScaleAboveScalar(&data[i], size - i, value, factor);
+}
+
+__attribute__((target("sse2")))
+static void AccumulateSse2(const uint16_t *data, size_t size, uint32_t *sums) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i pixels;
+    __m128i *out = NULL;
+    size_t i = 0;
+
+    for (i = 0; i + 8U <= size; i += 8U) {
+        pixels = _mm_loadu_si128((const __m128i *) &data[i]);
+        out = (__m128i *) &sums[i];
+        _mm_storeu_si128(out, _mm_add_epi32(_mm_loadu_si128(out),
+                                            _mm_unpacklo_epi16(pixels,
+                                                               zero)));
+        _mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1),
+                                                _mm_unpackhi_epi16(pixels,
+                                                                   zero)));
+    }
+
+    AccumulateScalar(&data[i], size - i, &sums[i]);
+}
+
+__attribute__((target("sse2")))
+static size_t ScaleAboveMedianSse2(uint16_t *data,
+                                   const uint16_t *const *rows,
+                                   size_t window,
+                                   size_t size,
+                                   uint16_t margin,
+                                   float factor) {
+    const __m128i limit = _mm_set1_epi16((short) margin);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16((short) 0x8000);
+    const __m128 scale = _mm_set1_ps(factor);
+    __m128i values[KERNELS_MAX_WINDOW * KERNELS_MAX_WINDOW];
+    const uint16_t *tail[KERNELS_MAX_WINDOW];
+    const uint8_t (*network)[2] = NULL;
+    size_t comparators = GetMedianNetwork(window, &network);
+    size_t radius = window / 2U;
+    __m128i center;
+    __m128i median;
+    __m128i unchanged;
+    __m128i low;
+    size_t count = 0;
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+    int mask = 0;
+
+    /* SSE2 only compares signed words, so the values are biased while
+       they are sorted. */
+    for (i = 0; i + 8U <= size; i += 8U) {
+        for (j = 0; j < window; j++) {
+            for (k = 0; k < window; k++) {
+                values[j * window + k] = _mm_xor_si128(_mm_loadu_si128(
+                    (const __m128i *) &(rows[j] - radius)[i + k]), bias);
+            }
+        }
+        for (j = 0; j < comparators; j++) {
+            low = _mm_min_epi16(values[network[j][0]],
+                                values[network[j][1]]);
+            values[network[j][1]] = _mm_max_epi16(values[network[j][0]],
+                                                  values[network[j][1]]);
+            values[network[j][0]] = low;
+        }
+
+        /* A pixel is left alone when pixel - median - margin saturates
+           to 0. */
+        center = _mm_loadu_si128((const __m128i *) &rows[radius][i]);
+        median = _mm_xor_si128(values[window * window / 2U], bias);
+        unchanged = _mm_cmpeq_epi16(_mm_subs_epu16(_mm_subs_epu16(center,
+                                                                  median),
+                                                   limit), zero);
+        mask = _mm_movemask_epi8(unchanged) ^ 0xFFFF;
+        if (0 != mask) {
+            center = _mm_or_si128(_mm_and_si128(unchanged,
+                                                _mm_loadu_si128(
+                                                    (const __m128i *)
+                                                    &data[i])),
+                                  _mm_andnot_si128(unchanged,
+                                                   ScalePixelsSse2(center,
+                                                                   scale)));
+            _mm_storeu_si128((__m128i *) &data[i], center);
+            count += __builtin_popcount(mask) / 2U;
+        }
+    }
+
+    for (j = 0; j < window; j++) {
+        tail[j] = rows[j] + i;
+    }
+
+    return count + ScaleAboveMedianScalar(&data[i], tail, window, size - i,
+                                          margin, factor);
+}
+
+__attribute__((target("sse2")))
+static void Swap16BitSse2(const uint16_t *in, size_t size, uint16_t *out) {
+    __m128i pixels;
+    size_t i = 0;
+
+    for (i = 0; i + 8U <= size; i += 8U) {
+        pixels = _mm_loadu_si128((const __m128i *) &in[i]);
+        _mm_storeu_si128((__m128i *) &out[i],
+                         _mm_or_si128(_mm_slli_epi16(pixels, 8),
+                                      _mm_srli_epi16(pixels, 8)));
+    }
+
+    Swap16BitScalar(&in[i], size - i, &out[i]);
+}
+
+__attribute__((target("sse2")))
+static void Decode8BitSse2(const uint8_t *in, size_t size, uint16_t *out) {
+    __m128i bytes;
+    size_t i = 0;
+
+    /* Interleaving the bytes with themselves gives v * 257. */
+    for (i = 0; i + 16U <= size; i += 16U) {
+        bytes = _mm_loadu_si128((const __m128i *) &in[i]);
+        _mm_storeu_si128((__m128i *) &out[i], _mm_unpacklo_epi8(bytes, bytes));
+        _mm_storeu_si128((__m128i *) &out[i + 8U],
+                         _mm_unpackhi_epi8(bytes, bytes));
+    }
+
+    Decode8BitScalar(&in[i], size - i, &out[i]);
+}
+
+__attribute__((target("sse2")))
+static void DecodeFloatSse2(const uint8_t *in, size_t size, uint16_t *out) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(65536.0f);
+    const __m128i bias_32 = _mm_set1_epi32(0x8000);
+    const __m128i bias_16 = _mm_set1_epi16((short) 0x8000);
+    __m128i low;
+    __m128i high;
+    size_t i = 0;
+
+    /* The maximum gives its second operand for NaN. */
+    for (i = 0; i + 8U <= size; i += 8U) {
+        low = _mm_cvttps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(
+                  _mm_loadu_ps((const float *) &in[4U * i]), zero), one),
+                  scale));
+        high = _mm_cvttps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(
+                   _mm_loadu_ps((const float *) &in[4U * i + 16U]), zero),
+                   one), scale));
+
+        /* As for the scaling, 65536 saturates to 0xFFFF. */
+        low = _mm_packs_epi32(_mm_sub_epi32(low, bias_32),
+                              _mm_sub_epi32(high, bias_32));
+        _mm_storeu_si128((__m128i *) &out[i], _mm_xor_si128(low, bias_16));
+    }
+
+    DecodeFloatScalar(&in[4U * i], size - i, &out[i]);
+}
+
+__attribute__((target("sse2")))
+static __m128i ScalePixelsSse2(__m128i pixels, __m128 scale) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias_32 = _mm_set1_epi32(0x8000);
+    const __m128i bias_16 = _mm_set1_epi16((short) 0x8000);
+    __m128i low;
+    __m128i high;
+
+    low = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(
+              _mm_unpacklo_epi16(pixels, zero)), scale));
+    high = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(
+               _mm_unpackhi_epi16(pixels, zero)), scale));
+
+    /* There's no unsigned saturating pack in SSE2, so pack the values
+       around 0 and bias them back. */
+    low = _mm_packs_epi32(_mm_sub_epi32(low, bias_32),
+                          _mm_sub_epi32(high, bias_32));
+
+    return _mm_xor_si128(low, bias_16);
+}
+
+__attribute__((target("avx2")))
+static void DownscaleAvx2(const uint16_t *data, size_t size, uint8_t *out) {
+    __m256i low;
+    __m256i high;
+    size_t i = 0;
+
+    for (i = 0; i + 32U <= size; i += 32U) {
+        low = _mm256_srli_epi16(_mm256_loadu_si256(
+                  (const __m256i *) &data[i]), 8);
+        high = _mm256_srli_epi16(_mm256_loadu_si256(
+                   (const __m256i *) &data[i + 16U]), 8);
+
+        /* The pack works on each 128-bit lane, restore the order. */
+        _mm256_storeu_si256((__m256i *) &out[i],
+                            _mm256_permute4x64_epi64(
+                                _mm256_packus_epi16(low, high), 0xD8));
+    }
+
+    DownscaleSse2(&data[i], size - i, &out[i]);
+}
+
+__attribute__((target("avx2")))
+static size_t FindAtLeastAvx2(const uint16_t *data,
+                              size_t size,
+                              uint16_t value) {
+    const __m256i threshold = _mm256_set1_epi16((short) value);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i pixels;
+    size_t i = 0;
+    unsigned mask = 0;
+
+    for (i = 0; i + 16U <= size; i += 16U) {
+        pixels = _mm256_loadu_si256((const __m256i *) &data[i]);
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(
+                   _mm256_subs_epu16(threshold, pixels), zero));
+        if (0 != mask) {
+            return i + __builtin_ctz(mask) / 2U;
+        }
+    }
+
+    return i + FindAtLeastSse2(&data[i], size - i, value);
+}
+
+__attribute__((target("avx2")))
+static size_t FindEqualAvx2(const uint16_t *data,
+                            size_t size,
+                            uint16_t value) {
+    const __m256i match = _mm256_set1_epi16((short) value);
+    __m256i pixels;
+    size_t i = 0;
+    unsigned mask = 0;
+
+    for (i = 0; i + 16U <= size; i += 16U) {
+        pixels = _mm256_loadu_si256((const __m256i *) &data[i]);
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(pixels, match));
+        if (0 != mask) {
+            return i + __builtin_ctz(mask) / 2U;
+        }
+    }
+
+    return i + FindEqualSse2(&data[i], size - i, value);
+}
+
+__attribute__((target("avx2")))
+static size_t ScaleAboveAvx2(uint16_t *data,
+                             size_t size,
+                             uint16_t value,
+                             float factor) {
+    const __m256i threshold = _mm256_set1_epi16((short) value);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256 scale = _mm256_set1_ps(factor);
+    __m256i pixels;
+    __m256i unchanged;
+    size_t i = 0;
+    size_t count = 0;
+    unsigned mask = 0;
+
+    for (i = 0; i + 16U <= size; i += 16U) {
+        pixels = _mm256_loadu_si256((const __m256i *) &data[i]);
+        unchanged = _mm256_cmpeq_epi16(_mm256_subs_epu16(pixels, threshold),
+                                       zero);
+        mask = ~((unsigned) _mm256_movemask_epi8(unchanged));
+        if (0 != mask) {
+            pixels = _mm256_blendv_epi8(ScalePixelsAvx2(pixels, scale),
+                                        pixels, unchanged);
+            _mm256_storeu_si256((__m256i *) &data[i], pixels);
+            count += __builtin_popcount(mask) / 2U;
+        }
+    }
+
+    return count + ScaleAboveSse2(&data[i], size - i, value, factor);
+}
+
+__attribute__((target("avx2")))
+static void AccumulateAvx2(const uint16_t *data, size_t size, uint32_t *sums) {
+    __m256i *out = NULL;
+    size_t i = 0;
+
+    for (i = 0; i + 8U <= size; i += 8U) {
+        out = (__m256i *) &sums[i];
+        _mm256_storeu_si256(out, _mm256_add_epi32(
+                                     _mm256_loadu_si256(out),
+                                     _mm256_cvtepu16_epi32(_mm_loadu_si128(
+                                         (const __m128i *) &data[i]))));
+    }
+
+    AccumulateScalar(&data[i], size - i, &sums[i]);
+}
+
+__attribute__((target("avx2")))
+static size_t ScaleAboveMedianAvx2(uint16_t *data,
+                                   const uint16_t *const *rows,
+                                   size_t window,
+                                   size_t size,
+                                   uint16_t margin,
+                                   float factor) {
+    const __m256i limit = _mm256_set1_epi16((short) margin);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256 scale = _mm256_set1_ps(factor);
+    __m256i values[KERNELS_MAX_WINDOW * KERNELS_MAX_WINDOW];
+    const uint16_t *tail[KERNELS_MAX_WINDOW];
+    const uint8_t (*network)[2] = NULL;
+    size_t comparators = GetMedianNetwork(window, &network);
+    size_t radius = window / 2U;
+    __m256i center;
+    __m256i unchanged;
+    __m256i low;
+    size_t count = 0;
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+    unsigned mask = 0;
+
+    for (i = 0; i + 16U <= size; i += 16U) {
+        for (j = 0; j < window; j++) {
+            for (k = 0; k < window; k++) {
+                values[j * window + k] = _mm256_loadu_si256(
+                    (const __m256i *) &(rows[j] - radius)[i + k]);
+            }
+        }
+        for (j = 0; j < comparators; j++) {
+            low = _mm256_min_epu16(values[network[j][0]],
+                                   values[network[j][1]]);
+            values[network[j][1]] = _mm256_max_epu16(values[network[j][0]],
+                                                     values[network[j][1]]);
+            values[network[j][0]] = low;
+        }
+
+        /* A pixel is left alone when pixel - median - margin saturates
+           to 0. */
+        center = _mm256_loadu_si256((const __m256i *) &rows[radius][i]);
+        unchanged = _mm256_cmpeq_epi16(_mm256_subs_epu16(
+                        _mm256_subs_epu16(center,
+                                          values[window * window / 2U]),
+                        limit), zero);
+        mask = ~((unsigned) _mm256_movemask_epi8(unchanged));
+        if (0 != mask) {
+            center = _mm256_blendv_epi8(ScalePixelsAvx2(center, scale),
+                                        _mm256_loadu_si256(
+                                            (const __m256i *) &data[i]),
+                                        unchanged);
+            _mm256_storeu_si256((__m256i *) &data[i], center);
+            count += __builtin_popcount(mask) / 2U;
+        }
+    }
+
+    for (j = 0; j < window; j++) {
+        tail[j] = rows[j] + i;
+    }
+
+    return count + ScaleAboveMedianSse2(&data[i], tail, window, size - i,
+                                        margin, factor);
+}
+
+__attribute__((target("avx2")))
+static void Swap16BitAvx2(const uint16_t *in, size_t size, uint16_t *out) {
+    __m256i pixels;
+    size_t i = 0;
+
+    for (i = 0; i + 16U <= size; i += 16U) {
+        pixels = _mm256_loadu_si256((const __m256i *) &in[i]);
+        _mm256_storeu_si256((__m256i *) &out[i],
+                            _mm256_or_si256(_mm256_slli_epi16(pixels, 8),
+                                            _mm256_srli_epi16(pixels, 8)));
+    }
+
+    Swap16BitSse2(&in[i], size - i, &out[i]);
+}
+
+__attribute__((target("avx2")))
+static void Decode8BitAvx2(const uint8_t *in, size_t size, uint16_t *out) {
+    __m256i pixels;
+    size_t i = 0;
+
+    for (i = 0; i + 16U <= size; i += 16U) {
+        pixels = _mm256_cvtepu8_epi16(_mm_loadu_si128(
+                     (const __m128i *) &in[i]));
+        _mm256_storeu_si256((__m256i *) &out[i],
+                            _mm256_or_si256(_mm256_slli_epi16(pixels, 8),
+                                            pixels));
+    }
+
+    Decode8BitSse2(&in[i], size - i, &out[i]);
+}
+
+__attribute__((target("avx2")))
+static void Decode12BitAvx2(const uint8_t *in, size_t size, uint16_t *out) {
+    /* Each pixel gets its low nibble byte below its high byte. */
+    const __m256i order = _mm256_setr_epi8(2, 0, 2, 1, 5, 3, 5, 4,
+                                           8, 6, 8, 7, 11, 9, 11, 10,
+                                           2, 0, 2, 1, 5, 3, 5, 4,
+                                           8, 6, 8, 7, 11, 9, 11, 10);
+    const __m256i high_mask = _mm256_set1_epi32((int) 0xFFF0FF00U);
+    const __m256i low_mask = _mm256_set1_epi32(0x000000F0);
+    const uint8_t *bytes = NULL;
+    __m256i pixels;
+    size_t i = 0;
+
+    /* The second load reads 4 bytes past the 16 pixels. */
+    for (i = 0; i + 20U <= size; i += 16U) {
+        bytes = &in[i / 2U * 3U];
+        pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                     _mm_loadu_si128((const __m128i *) bytes)),
+                     _mm_loadu_si128((const __m128i *) &bytes[12]), 1);
+        pixels = _mm256_shuffle_epi8(pixels, order);
+
+        /* The even pixels take the low nibble, the odd ones the high
+           one, and the top 4 bits are repeated below. */
+        pixels = _mm256_or_si256(_mm256_or_si256(
+                     _mm256_and_si256(pixels, high_mask),
+                     _mm256_and_si256(_mm256_slli_epi16(pixels, 4),
+                                      low_mask)),
+                     _mm256_srli_epi16(pixels, 12));
+        _mm256_storeu_si256((__m256i *) &out[i], pixels);
+    }
+
+    Decode12BitScalar(&in[i / 2U * 3U], size - i, &out[i]);
+}
+
+__attribute__((target("avx2")))
+static void DecodeFloatAvx2(const uint8_t *in, size_t size, uint16_t *out) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(65536.0f);
+    __m256i low;
+    __m256i high;
+    size_t i = 0;
+
+    /* The maximum gives its second operand for NaN. */
+    for (i = 0; i + 16U <= size; i += 16U) {
+        low = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(
+                  _mm256_loadu_ps((const float *) &in[4U * i]), zero), one),
+                  scale));
+        high = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_min_ps(
+                   _mm256_max_ps(_mm256_loadu_ps(
+                       (const float *) &in[4U * i + 32U]), zero), one),
+                   scale));
+
+        /* The pack works on each 128-bit lane, restore the order. */
+        _mm256_storeu_si256((__m256i *) &out[i],
+                            _mm256_permute4x64_epi64(
+                                _mm256_packus_epi32(low, high), 0xD8));
+    }
+
+    DecodeFloatSse2(&in[4U * i], size - i, &out[i]);
+}
+
+__attribute__((target("avx2")))
+static __m256i ScalePixelsAvx2(__m256i pixels, __m256 scale) {
+    __m256i low;
+    __m256i high;
+
+    low = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(pixels));
+    high = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(pixels, 1));
+    low = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(low), scale));
+    high = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(high),
+                                             scale));
+
+    /* The pack works on each 128-bit lane, restore the order. */
+    return _mm256_permute4x64_epi64(_mm256_packus_epi32(low, high), 0xD8);
+}
+#endif /* KERNELS_X86 */
+
+#ifdef KERNELS_NEON
+static void DownscaleNeon(const uint16_t *data, size_t size, uint8_t *out) {
+    size_t i = 0;
+
+    for (i = 0; i + 16U <= size; i += 16U) {
+        vst1q_u8(&out[i], vcombine_u8(vshrn_n_u16(vld1q_u16(&data[i]), 8),
+                                      vshrn_n_u16(vld1q_u16(&data[i + 8U]),
+                                                  8)));
+    }
+
+    DownscaleScalar(&data[i], size - i, &out[i]);
+}
+
+static size_t FindAtLeastNeon(const uint16_t *data,
+                              size_t size,
+                              uint16_t value) {
+    const uint16x8_t threshold = vdupq_n_u16(value);
+    size_t i = 0;
+
+    /* Locate the matching 8 pixels, then the pixel itself. */
+    for (i = 0; i + 8U <= size; i += 8U) {
+        if (0 != vmaxvq_u16(vcgeq_u16(vld1q_u16(&data[i]), threshold))) {
+            break;
+        }
+    }
+
+    return i + FindAtLeastScalar(&data[i], size - i, value);
+}
+
+static size_t FindEqualNeon(const uint16_t *data,
+                            size_t size,
+                            uint16_t value) {
+    const uint16x8_t match = vdupq_n_u16(value);
+    size_t i = 0;
+
+    for (i = 0; i + 8U <= size; i += 8U) {
+        if (0 != vmaxvq_u16(vceqq_u16(vld1q_u16(&data[i]), match))) {
+            break;
+        }
+    }
+
+    return i + FindEqualScalar(&data[i], size - i, value);
+}
+
+static size_t ScaleAboveNeon(uint16_t *data,
+                             size_t size,
+                             uint16_t value,
+                             float factor) {
+    const uint16x8_t threshold = vdupq_n_u16(value);
+    uint16x8_t pixels;
+    uint16x8_t above;
+    size_t i = 0;
+    size_t count = 0;
+
+    for (i = 0; i + 8U <= size; i += 8U) {
+        pixels = vld1q_u16(&data[i]);
+        above = vcgtq_u16(pixels, threshold);
+        if (0 != vmaxvq_u16(above)) {
+            pixels = vbslq_u16(above, ScalePixelsNeon(pixels, factor),
+                               pixels);
+            vst1q_u16(&data[i], pixels);
+            count += vaddvq_u16(vshrq_n_u16(above, 15));
+        }
+    }
+
+    return count + ScaleAboveScalar(&data[i], size - i, value, factor);
+}
+
+static void AccumulateNeon(const uint16_t *data, size_t size, uint32_t *sums) {
+    uint16x8_t pixels;
+    size_t i = 0;
+
+    for (i = 0; i + 8U <= size; i += 8U) {
+        pixels = vld1q_u16(&data[i]);
+        vst1q_u32(&sums[i], vaddw_u16(vld1q_u32(&sums[i]),
+                                      vget_low_u16(pixels)));
+        vst1q_u32(&sums[i + 4U], vaddw_u16(vld1q_u32(&sums[i + 4U]),
+                                           vget_high_u16(pixels)));
+    }
+
+    AccumulateScalar(&data[i], size - i, &sums[i]);
+}
+
+static size_t ScaleAboveMedianNeon(uint16_t *data,
+                                   const uint16_t *const *rows,
+                                   size_t window,
+                                   size_t size,
+                                   uint16_t margin,
+                                   float factor) {
+    const uint16x8_t limit = vdupq_n_u16(margin);
+    uint16x8_t values[KERNELS_MAX_WINDOW * KERNELS_MAX_WINDOW];
+    const uint16_t *tail[KERNELS_MAX_WINDOW];
+    const uint8_t (*network)[2] = NULL;
+    size_t comparators = GetMedianNetwork(window, &network);
+    size_t radius = window / 2U;
+    uint16x8_t center;
+    uint16x8_t above;
+    uint16x8_t low;
+    size_t count = 0;
+    size_t i = 0;
+    size_t j = 0;
+    size_t k = 0;
+
+    for (i = 0; i + 8U <= size; i += 8U) {
+        for (j = 0; j < window; j++) {
+            for (k = 0; k < window; k++) {
+                values[j * window + k] = vld1q_u16(
+                    &(rows[j] - radius)[i + k]);
+            }
+        }
+        for (j = 0; j < comparators; j++) {
+            low = vminq_u16(values[network[j][0]], values[network[j][1]]);
+            values[network[j][1]] = vmaxq_u16(values[network[j][0]],
+                                              values[network[j][1]]);
+            values[network[j][0]] = low;
+        }
+
+        /* The difference saturates to 0 when the pixel isn't above. */
+        center = vld1q_u16(&rows[radius][i]);
+        above = vcgtq_u16(vqsubq_u16(center, values[window * window / 2U]),
+                          limit);
+        if (0 != vmaxvq_u16(above)) {
+            vst1q_u16(&data[i], vbslq_u16(above,
+                                          ScalePixelsNeon(center, factor),
+                                          vld1q_u16(&data[i])));
+            count += vaddvq_u16(vshrq_n_u16(above, 15));
+        }
+    }
+
+    for (j = 0; j < window; j++) {
+        tail[j] = rows[j] + i;
+    }
+
+    return count + ScaleAboveMedianScalar(&data[i], tail, window, size - i,
+                                          margin, factor);
+}
+
+static void Swap16BitNeon(const uint16_t *in, size_t size, uint16_t *out) {
+    size_t i = 0;
+
+    for (i = 0; i + 8U <= size; i += 8U) {
+        vst1q_u16(&out[i], vreinterpretq_u16_u8(vrev16q_u8(
+                               vreinterpretq_u8_u16(vld1q_u16(&in[i])))));
+    }
+
+    Swap16BitScalar(&in[i], size - i, &out[i]);
+}
+
+static void Decode8BitNeon(const uint8_t *in, size_t size, uint16_t *out) {
+    uint8x16x2_t pixels;
+    size_t i = 0;
+
+    /* Interleaving the bytes with themselves gives v * 257. */
+    for (i = 0; i + 16U <= size; i += 16U) {
+        pixels = vzipq_u8(vld1q_u8(&in[i]), vld1q_u8(&in[i]));
+        vst1q_u16(&out[i], vreinterpretq_u16_u8(pixels.val[0]));
+        vst1q_u16(&out[i + 8U], vreinterpretq_u16_u8(pixels.val[1]));
+    }
+
+    Decode8BitScalar(&in[i], size - i, &out[i]);
+}
+
+static void Decode12BitNeon(const uint8_t *in, size_t size, uint16_t *out) {
+    uint8x8x3_t bytes;
+    uint16x8x2_t pixels;
+    size_t i = 0;
+
+    /* The loads split the high bytes of the even and odd pixels from
+       their low nibbles. */
+    for (i = 0; i + 16U <= size; i += 16U) {
+        bytes = vld3_u8(&in[i / 2U * 3U]);
+        pixels.val[0] = vorrq_u16(vshll_n_u8(bytes.val[0], 8),
+                                  vmovl_u8(vorr_u8(vshl_n_u8(bytes.val[2], 4),
+                                                   vshr_n_u8(bytes.val[0],
+                                                             4))));
+        pixels.val[1] = vorrq_u16(vshll_n_u8(bytes.val[1], 8),
+                                  vmovl_u8(vorr_u8(vand_u8(bytes.val[2],
+                                                           vdup_n_u8(0xF0U)),
+                                                   vshr_n_u8(bytes.val[1],
+                                                             4))));
+        vst2q_u16(&out[i], pixels);
+    }
+
+    Decode12BitScalar(&in[i / 2U * 3U], size - i, &out[i]);
+}
+
+static void DecodeFloatNeon(const uint8_t *in, size_t size, uint16_t *out) {
+    const float32x4_t zero = vdupq_n_f32(0);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    uint32x4_t low;
+    uint32x4_t high;
+    size_t i = 0;
+
+    /* The number maximum gives 0 for NaN. */
+    for (i = 0; i + 8U <= size; i += 8U) {
+        low = vcvtq_u32_f32(vmulq_n_f32(vminnmq_f32(vmaxnmq_f32(
+                  vreinterpretq_f32_u8(vld1q_u8(&in[4U * i])), zero), one),
+                  65536.0f));
+        high = vcvtq_u32_f32(vmulq_n_f32(vminnmq_f32(vmaxnmq_f32(
+                   vreinterpretq_f32_u8(vld1q_u8(&in[4U * i + 16U])), zero),
+                   one), 65536.0f));
+        vst1q_u16(&out[i], vcombine_u16(vqmovn_u32(low), vqmovn_u32(high)));
+    }
+
+    DecodeFloatScalar(&in[4U * i], size - i, &out[i]);
+}
+
+static uint16x8_t ScalePixelsNeon(uint16x8_t pixels, float factor) {
+    uint32x4_t low;
+    uint32x4_t high;
+
+    /* The float to integer conversion truncates, as in C. */
+    low = vcvtq_u32_f32(vmulq_n_f32(vcvtq_f32_u32(
+              vmovl_u16(vget_low_u16(pixels))), factor));
+    high = vcvtq_u32_f32(vmulq_n_f32(vcvtq_f32_u32(
+               vmovl_u16(vget_high_u16(pixels))), factor));
+
+    return vcombine_u16(vmovn_u32(low), vmovn_u32(high));
+}
+#endif /* KERNELS_NEON */
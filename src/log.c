@@ -0,0 +1,92 @@
+/**
+ *  @brief Buffered logger implementation file.
+ *
+ */
+
+#include "log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/****************************************************************************/
+
+int LogOpen(struct Log *log, const char *path) {
+    int status = EXIT_SUCCESS;
+
+    log->length = 0;
+    log->owned = (NULL != path);
+    log->fd = (NULL == path) ? STDERR_FILENO :
+              open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (log->fd < 0) {
+        status = EXIT_FAILURE;
+    }
+    log->status = status;
+
+    return status;
+}
+
+void LogPrintf(struct Log *log, const char *format, ...) {
+    va_list args;
+    int length = 0;
+
+    va_start(args, format);
+    length = vsnprintf(&(log->buffer[log->length]),
+                       LOG_BUFFER_SIZE - log->length, format, args);
+    va_end(args);
+
+    /* A message which doesn't fit is formatted again in an empty buffer. */
+    if ((length >= 0) &&
+        ((size_t) length >= LOG_BUFFER_SIZE - log->length) &&
+        (EXIT_SUCCESS == LogFlush(log)) &&
+        ((size_t) length < LOG_BUFFER_SIZE)) {
+        va_start(args, format);
+        length = vsnprintf(log->buffer, LOG_BUFFER_SIZE, format, args);
+        va_end(args);
+    }
+
+    if ((length < 0) || ((size_t) length >= LOG_BUFFER_SIZE - log->length)) {
+        log->status = EXIT_FAILURE;
+    }
+    else {
+        log->length += length;
+    }
+}
+
+int LogFlush(struct Log *log) {
+    size_t done = 0;
+    ssize_t written = 0;
+
+    for (done = 0; (EXIT_SUCCESS == log->status) && (done < log->length);
+         done += written) {
+        written = write(log->fd, &(log->buffer[done]), log->length - done);
+        if ((written < 0) && (EINTR == errno)) {
+            written = 0;
+        }
+        else if (written <= 0) {
+            log->status = EXIT_FAILURE;
+        }
+    }
+    log->length = 0;
+
+    return log->status;
+}
+
+int LogClose(struct Log *log) {
+    int status = EXIT_SUCCESS;
+
+    if (log->fd >= 0) {
+        status = LogFlush(log);
+        if (log->owned && (0 != close(log->fd))) {
+            status = EXIT_FAILURE;
+        }
+    }
+    else {
+        status = EXIT_FAILURE;
+    }
+    log->fd = -1;
+
+    return status;
+}
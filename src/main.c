@@ -1,24 +1,27 @@
 /**
  *  @brief Application entry point
  *  
- *  This file contains the CLI entry point and 
- *  the pixel manipulation logic.
+ *  This file contains the CLI entry point, the pixel manipulation
+ *  logic itself being in the delite library.
  *  
  */
 
-#include "bitmap.h"
-
-/*TODO: Add buffered logging functionality. */
+#include "delite.h"
+#include "kernels.h"
+#include "log.h"
+#include "parallel.h"
+#include "server.h"
+#include "stats.h"
 
 /* System includes */
-#include <math.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
-#include <sys/types.h>
 #include <unistd.h>
 
 /****************************************************************************
@@ -27,9 +30,37 @@
 /* Default path for the binary file containing the adjusted pixel data. */
 #define ALTERED_FILE_PATH "altered.bin"
 
+/* Added to the default adjusted data paths when they're compressed. */
+#define LZ4_FILE_EXTENSION ".lz4"
+
+/* Added to the default adjusted data paths for the delta records. */
+#define DELTA_FILE_EXTENSION ".delta"
+
+/* Default output path patterns for the batch mode. */
+#define BATCH_PREVIEW_PATTERN "%n"
+#define BATCH_ALTERED_PATTERN "%n.altered.bin"
+
+/* Default preview path, without the format extension. */
+#define PREVIEW_FILE_PATH "out"
+
+/* Default preview path pattern for the volume slices, without extension. */
+#define VOLUME_PREVIEW_PATTERN "out.%i"
+
+/* Default chunk size for the streaming mode (in MiB). */
+#define STREAM_CHUNK_SIZE 16U
+
+/* Default number of pixels reported by the quick search. */
+#define QUICK_SEARCH_COUNT 50U
+
+/* Path standing for the standard input or output. */
+#define PIPE_FILE_PATH "-"
+
 /****************************************************************************
  * LOCAL DECLARATIONS
  ****************************************************************************/
+/* Set once the server mode is asked to stop. */
+static volatile sig_atomic_t stop_requested = 0;
+
 /**
  *  @brief Print help message
  *
@@ -51,106 +82,128 @@ static void PrintUsage(void);
 static bool FileIsRegular(const char *file_path);
 
 /**
- *  @brief Process a raw pixel array by decreasing
- *         the gray intensity for overexposed pixels.
- * 
- *  The pixel array is traversed, and the highest pixel_count elements
- *  are adjusted by decreasing their value by adjustment_level%.
- *  @param data              Pixel data to adjust
- *  @param size              Array size
- *  @param pixel_count       Number of pixels to consider
- *  @param adjustment_level  Adjustment level (as a percentage)
+ *  @brief Parse a selection engine name.
+ *
+ *  @param name    Engine name (auto, heap, select or histogram)
+ *  @param engine  Parsed engine
  * 
- *  @return EXIT_SUCCESS, if successful.
- *          EXIT_FAILURE, otherwise.
+ *  @return true, if the name is valid.
+ *          false, otherwise.
  */
-static int AdjustPixelData(uint16_t *data, 
-                           uint32_t size,
-                           uint32_t pixel_count,
-                           uint8_t adjustment_level);
+static bool ParseEngine(const char *name, enum Selection_Engine *engine);
 
 /**
- *  @brief Read raw byte data from a file.
- * 
- *  A new array is allocated dependening on the size of the file,
- *  and the whole file is read into the newly allocated array.
- *  @param in    File to read from
- *  @param data  Generic reference to read into
+ *  @brief Parse an I/O backend name.
+ *
+ *  @param name     Backend name (auto, uring or threads)
+ *  @param backend  Parsed backend
  * 
- *  @return The size of the read data, if successful.
- *          0, otherwise.
+ *  @return true, if the name is valid.
+ *          false, otherwise.
  */
-static uint32_t ReadBytesFromFile(FILE *in, void **data);
+static bool ParseIoBackend(const char *name, enum Async_Io_Backend *backend);
 
 /**
- *  @brief Generate preview bitmap from a 16-bit encoded pixel array.
+ *  @brief Parse a tie-break policy name.
+ *
+ *  @param name       Policy name (first, last or all)
+ *  @param tie_break  Parsed policy
  * 
- *  The array is first scaled down to an 8-bit encoded array, then
- *  the bitmap is initialized and populated with the given pixel data. 
- *  @param data  Input pixel data
- *  @param size  Data size
- *  @param bmp   Output preview bitmap
+ *  @return true, if the name is valid.
+ *          false, otherwise.
+ */
+static bool ParseTieBreak(const char *name,
+                          enum Selection_Tie_Break *tie_break);
+
+/**
+ *  @brief Parse a preview format name.
+ *
+ *  @param name    Format name (bmp, pgm or raw12)
+ *  @param format  Parsed format
  * 
- *  @return EXIT_SUCCESS, if successful.
- *          EXIT_FAILURE, otherwise.
+ *  @return true, if the name is valid.
+ *          false, otherwise.
  */
-static int GeneratePreviewBitmapFrom16Bit(const uint16_t *data, 
-                                          uint32_t size,
-                                          struct Bitmap **bmp);
+static bool ParseFormat(const char *name, enum Bitmap_Format *format);
 
 /**
- *  @brief Write a variable to file byte-by-byte.
+ *  @brief Parse an adjusted data container name.
+ *
+ *  @param name    Container name (none, lz4 or delta)
+ *  @param format  Parsed container
  * 
- *  Write count bytes of the given input to the specified file.
- *  @param out    Output file
- *  @param data   Memory to be written
- *  @param count  Number of bytes to write
+ *  @return true, if the name is valid.
+ *          false, otherwise.
+ */
+static bool ParseCodec(const char *name, enum Codec_Format *format);
+
+/**
+ *  @brief Parse an input pixel format name.
+ *
+ *  @param name    Format name (u16le, u16be, u8, raw12 or f32)
+ *  @param format  Parsed format
  * 
- *  @return EXIT_SUCCESS, if successful.
- *          EXIT_FAILURE, otherwise.
+ *  @return true, if the name is valid.
+ *          false, otherwise.
  */
-static int WriteBytesToFile(FILE *out, const void *data, uint32_t count);
+static bool ParseInputFormat(const char *name,
+                             enum Frame_Pixel_Format *format);
 
 /**
- *  @brief Write a bitmap to file.
+ *  @brief Parse the names of the outputs to emit.
+ *
+ *  @param name     Outputs (raw, preview or both)
+ *  @param altered  Whether to emit the adjusted pixel data
+ *  @param preview  Whether to emit the preview
  * 
- *  @param out    Output file
- *  @param bm     Bitmap to write
+ *  @return true, if the name is valid.
+ *          false, otherwise.
+ */
+static bool ParseEmit(const char *name, bool *altered, bool *preview);
+
+/**
+ *  @brief Adjust a frame in the pipe mode.
+ *
+ *  Any of the paths may be "-" for the standard input or output. The
+ *  messages printed go to the standard error instead when the standard
+ *  output carries data, and both outputs are multiplexed on it when both
+ *  are emitted there.
+ *  @param context            Processing context
+ *  @param input_file_path    Path to the input file
+ *  @param preview_file_path  Path to the final preview (NULL for none)
+ *  @param altered_file_path  Path to the adjusted pixel data (NULL for
+ *                            none)
  * 
  *  @return EXIT_SUCCESS, if successful.
  *          EXIT_FAILURE, otherwise.
  */
-static int WriteBmpToFile(FILE *out, const struct Bitmap *bmp);
+static int RunPipeMode(struct Delite_Context *context,
+                       const char *input_file_path,
+                       const char *preview_file_path,
+                       const char *altered_file_path);
 
 /**
- *  @brief Run parameterized pixel adjustment.
- * 
- *  Read the input raw byte stream, detect overexposed pixels and
- *  output the altered binary file + the preview bitmap.
- *  @param input_file_path    Path to the input file 
- *  @param preview_file_path  Path to the final preview bitmap 
- *  @param pixel_count        Number of pixels to adjust
- *  @param adjustment_level   Adjustment level as percentage
+ *  @brief Serve frame requests on a socket until interrupted.
+ *
+ *  @param socket_path  Path of the Unix socket to listen on
+ *  @param options      Adjustment parameters
+ *  @param stats        Run statistics (may be NULL)
  * 
  *  @return EXIT_SUCCESS, if successful.
  *          EXIT_FAILURE, otherwise.
  */
-static int RunAdjustment(const char *input_file_path,
-                         const char *preview_file_path,
-                         unsigned pixel_count,
-                         unsigned adjustment_level);
+static int RunServerMode(const char *socket_path,
+                         const struct Delite_Options *options,
+                         struct Stats *stats);
 
 /**
- *  @brief Run quick search for the first 50 overexposed pixels.
- * 
- *  Read the input raw byte stream and print the first 50 overexposed
- *  pixel values and their position.
- *  @param input_file_path    Path to the input file 
+ *  @brief Ask the server mode to stop.
+ *
+ *  @param signal_number  Signal received
  * 
- *  @return EXIT_SUCCESS, if successful.
- *          EXIT_FAILURE, otherwise.
+ *  @return none
  */
-static int RunQuickSearch(const char *input_file_path);
+static void RequestStop(int signal_number);
 
 /****************************************************************************/
 
@@ -168,12 +221,50 @@ static int RunQuickSearch(const char *input_file_path);
 int main (int argc, char **argv) {
     char **arg_iterator = NULL;
     char input_file_path[256] = { '\0' };
-    char preview_file_path[256] = "out.bmp";
-    unsigned pixel_count = 50U;
-    unsigned adjustment_level = 50U;
+    char preview_file_path[256] = { '\0' };
+    char altered_file_path[256] = { '\0' };
+    char batch_source[256] = { '\0' };
+    char stats_file_path[256] = { '\0' };
+    char socket_path[256] = { '\0' };
+    char pyramid_path[256] = { '\0' };
     bool quick_search = false;
+    bool stats_enabled = false;
+    bool emit_altered = true;
+    bool emit_preview = true;
+    bool pipe_mode = false;
+    size_t quick_count = QUICK_SEARCH_COUNT;
+    size_t chunk_size = STREAM_CHUNK_SIZE;
+    size_t job_count = 1U;
+    unsigned long long value = 0;
+    char *end = NULL;
+    uint32_t *dimension = NULL;
+    struct Delite_Options options = {
+        .mode = DELITE_MODE_COUNT,
+        .pixel_count = 50U,
+        .median_window = 3U,
+        .adjustment_level = 50U,
+        .engine = SELECTION_ENGINE_AUTO,
+        .tie_break = SELECTION_TIE_BREAK_FIRST,
+        .input_mode = FRAME_INPUT_MMAP,
+        .pixel_format = FRAME_PIXEL_U16LE,
+        .thread_count = 1U,
+        .streaming = false,
+        .sequence = false,
+        .preview_format = BITMAP_FORMAT_BMP,
+        .preview_rle = false,
+        .altered_format = CODEC_FORMAT_NONE,
+        .pyramid_path = NULL,
+        .preview_scale = 1U,
+        .io_backend = ASYNC_IO_BACKEND_AUTO
+    };
+    struct Delite_Context context;
+    struct Stats run_stats;
+    struct Stats *stats = NULL;
+    struct Log log;
     int status = EXIT_SUCCESS;
 
+    KernelsInit();
+
     /* Need at least one argument. */ 
     if (argc < 2) {
         PrintUsage();
@@ -192,7 +283,8 @@ int main (int argc, char **argv) {
                     case 'f':
                         arg_iterator++;
                         if ((NULL != *arg_iterator) &&
-                            (FileIsRegular(*arg_iterator))) {
+                            ((0 == strcmp(*arg_iterator, PIPE_FILE_PATH)) ||
+                             (FileIsRegular(*arg_iterator)))) {
                             strcpy(input_file_path, *arg_iterator);
                         }
                         else {
@@ -206,28 +298,88 @@ int main (int argc, char **argv) {
                     case 'p':
                         arg_iterator++;
                         if (NULL != *arg_iterator) {
-                            pixel_count = strtol(*arg_iterator, NULL, 0);
+                            options.pixel_count = strtoull(*arg_iterator,
+                                                           NULL, 0);
                         }
                         else {
-                            pixel_count = 0;
+                            options.pixel_count = 0;
                         }
-                        if (pixel_count == 0) {
+                        if (options.pixel_count == 0) {
                             printf("Invalid pixel count.\n");
                             status = EXIT_FAILURE;
                             *(arg_iterator + 1) = NULL;
                         }
+                        options.mode = DELITE_MODE_COUNT;
+
+                        break;
+                    /* Threshold to adjust the pixels above */
+                    case 't':
+                        arg_iterator++;
+                        end = NULL;
+                        if (NULL != *arg_iterator) {
+                            value = strtoull(*arg_iterator, &end, 0);
+                        }
+                        if ((NULL == end) || (end == *arg_iterator) ||
+                            ('\0' != *end) || (value > UINT16_MAX)) {
+                            printf("Invalid threshold.\n");
+                            status = EXIT_FAILURE;
+                            *(arg_iterator + 1) = NULL;
+                        }
+                        else {
+                            options.threshold = value;
+                        }
+                        options.mode = DELITE_MODE_THRESHOLD;
+
+                        break;
+                    /* Percentage of the highest pixels to adjust */
+                    case 'P':
+                        arg_iterator++;
+                        if (NULL != *arg_iterator) {
+                            options.percentile = strtod(*arg_iterator, NULL);
+                        }
+                        else {
+                            options.percentile = 0;
+                        }
+                        /* Written so that NaN is rejected too. */
+                        if (!((options.percentile > 0) &&
+                              (options.percentile <= 100))) {
+                            printf("Invalid percentile.\n");
+                            status = EXIT_FAILURE;
+                            *(arg_iterator + 1) = NULL;
+                        }
+                        options.mode = DELITE_MODE_PERCENTILE;
+
+                        break;
+                    /* Distance to the neighborhood median to exceed */
+                    case 'n':
+                        arg_iterator++;
+                        end = NULL;
+                        if (NULL != *arg_iterator) {
+                            value = strtoull(*arg_iterator, &end, 0);
+                        }
+                        if ((NULL == end) || (end == *arg_iterator) ||
+                            ('\0' != *end) || (value > UINT16_MAX)) {
+                            printf("Invalid neighborhood margin.\n");
+                            status = EXIT_FAILURE;
+                            *(arg_iterator + 1) = NULL;
+                        }
+                        else {
+                            options.median_margin = value;
+                        }
+                        options.mode = DELITE_MODE_NEIGHBORHOOD;
 
                         break;
                     /* Adjustment level */
                     case 'l':
                         arg_iterator++;
                         if (NULL != *arg_iterator) {
-                            adjustment_level = strtol(*arg_iterator, NULL, 0);
+                            options.adjustment_level = strtol(*arg_iterator,
+                                                              NULL, 0);
                         }
                         else {
-                            adjustment_level = UINT32_MAX;
+                            options.adjustment_level = UINT32_MAX;
                         }
-                        if (adjustment_level > 100) {
+                        if (options.adjustment_level > 100) {
                             printf("Invalid adjustment level "
                                    "(must be a valid percentage).\n");
                             status = EXIT_FAILURE;
@@ -249,9 +401,52 @@ int main (int argc, char **argv) {
                         }
 
                         break;
-                    /* Quick search flag */
+                    /* Quick search flag, with an optional pixel count */
                     case 'q':
                         quick_search = true;
+                        if ((NULL != arg_iterator[1]) &&
+                            ('0' <= arg_iterator[1][0]) &&
+                            ('9' >= arg_iterator[1][0])) {
+                            arg_iterator++;
+                            quick_count = strtoull(*arg_iterator, NULL, 0);
+                            if (0 == quick_count) {
+                                printf("Invalid quick search count.\n");
+                                status = EXIT_FAILURE;
+                                *(arg_iterator + 1) = NULL;
+                            }
+                        }
+
+                        break;
+                    /* Selection engine */
+                    case 'e':
+                        arg_iterator++;
+                        if ((NULL == *arg_iterator) || 
+                            (!ParseEngine(*arg_iterator, &options.engine))) {
+                            printf("Invalid selection engine.\n");
+                            status = EXIT_FAILURE;
+                            *(arg_iterator + 1) = NULL;
+                        }
+
+                        break;
+                    /* Number of threads */
+                    case 'j':
+                        arg_iterator++;
+                        if (NULL != *arg_iterator) {
+                            options.thread_count = strtoull(*arg_iterator,
+                                                            NULL, 0);
+                            if (0 == options.thread_count) {
+                                options.thread_count = ParallelGetCpuCount();
+                            }
+                        }
+                        else {
+                            options.thread_count = 0;
+                        }
+                        if ((0 == options.thread_count) ||
+                            (options.thread_count > PARALLEL_MAX_THREADS)) {
+                            printf("Invalid number of threads.\n");
+                            status = EXIT_FAILURE;
+                            *(arg_iterator + 1) = NULL;
+                        }
 
                         break;
                     /* Invalid input */
@@ -262,6 +457,264 @@ int main (int argc, char **argv) {
                         break;
                 }
             }
+            /* Tie-break policy */
+            else if (0 == strcmp(*arg_iterator, "--tie-break")) {
+                arg_iterator++;
+                if ((NULL == *arg_iterator) ||
+                    (!ParseTieBreak(*arg_iterator, &options.tie_break))) {
+                    printf("Invalid tie-break policy.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+            }
+            /* Preview format */
+            else if (0 == strcmp(*arg_iterator, "--format")) {
+                arg_iterator++;
+                if ((NULL == *arg_iterator) ||
+                    (!ParseFormat(*arg_iterator, &options.preview_format))) {
+                    printf("Invalid preview format.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+            }
+            /* Run-length encoded preview */
+            else if (0 == strcmp(*arg_iterator, "--rle")) {
+                options.preview_rle = true;
+            }
+            /* Adjusted data container */
+            else if (0 == strcmp(*arg_iterator, "--compress")) {
+                arg_iterator++;
+                if ((NULL == *arg_iterator) ||
+                    (!ParseCodec(*arg_iterator, &options.altered_format))) {
+                    printf("Invalid adjusted data compression.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+            }
+            /* Neighborhood side */
+            else if (0 == strcmp(*arg_iterator, "--window")) {
+                arg_iterator++;
+                if (NULL != *arg_iterator) {
+                    value = strtoull(*arg_iterator, NULL, 0);
+                }
+                else {
+                    value = 0;
+                }
+                if ((3U != value) && (5U != value)) {
+                    printf("Invalid neighborhood window.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+                else {
+                    options.median_window = value;
+                }
+            }
+            /* Preview pyramid directory */
+            else if (0 == strcmp(*arg_iterator, "--pyramid")) {
+                arg_iterator++;
+                if ((NULL != *arg_iterator) &&
+                    (strlen(*arg_iterator) < sizeof(pyramid_path))) {
+                    strcpy(pyramid_path, *arg_iterator);
+                    options.pyramid_path = pyramid_path;
+                }
+                else {
+                    printf("Invalid preview pyramid directory.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+            }
+            /* Frame dimensions */
+            else if ((0 == strcmp(*arg_iterator, "--width")) ||
+                     (0 == strcmp(*arg_iterator, "--height"))) {
+                dimension = ('w' == (*arg_iterator)[2]) ? &options.width :
+                                                          &options.height;
+                arg_iterator++;
+                if (NULL != *arg_iterator) {
+                    value = strtoull(*arg_iterator, NULL, 0);
+                }
+                else {
+                    value = 0;
+                }
+                if ((0 == value) || (value > UINT32_MAX)) {
+                    printf("Invalid frame dimension.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+                else {
+                    *dimension = value;
+                }
+            }
+            /* Number of volume slices */
+            else if (0 == strcmp(*arg_iterator, "--depth")) {
+                arg_iterator++;
+                if (NULL != *arg_iterator) {
+                    value = strtoull(*arg_iterator, NULL, 0);
+                }
+                else {
+                    value = 0;
+                }
+                if ((0 == value) || (value > UINT32_MAX)) {
+                    printf("Invalid volume depth.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+                else {
+                    options.depth = value;
+                }
+            }
+            /* Preview downsampling factor */
+            else if (0 == strcmp(*arg_iterator, "--preview-scale")) {
+                arg_iterator++;
+                if (NULL != *arg_iterator) {
+                    value = strtoull(*arg_iterator, NULL, 0);
+                }
+                else {
+                    value = 0;
+                }
+                if ((0 == value) || (value > DELITE_PREVIEW_MAX_SCALE)) {
+                    printf("Invalid preview scale.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+                else {
+                    options.preview_scale = value;
+                }
+            }
+            /* Read the input instead of mapping it */
+            else if (0 == strcmp(*arg_iterator, "--no-mmap")) {
+                options.input_mode = FRAME_INPUT_READ;
+            }
+            /* Write the adjusted pixels back into the input file */
+            else if (0 == strcmp(*arg_iterator, "--patch")) {
+                options.patch_input = true;
+            }
+            /* Input pixel format */
+            else if (0 == strcmp(*arg_iterator, "--input-format")) {
+                arg_iterator++;
+                if ((NULL == *arg_iterator) ||
+                    (!ParseInputFormat(*arg_iterator,
+                                       &options.pixel_format))) {
+                    printf("Invalid input pixel format.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+            }
+            /* Streaming mode */
+            else if (0 == strcmp(*arg_iterator, "--stream")) {
+                options.streaming = true;
+            }
+            /* Frames forming a sequence */
+            else if (0 == strcmp(*arg_iterator, "--sequence")) {
+                options.sequence = true;
+            }
+            /* Streaming I/O backend */
+            else if (0 == strcmp(*arg_iterator, "--io-backend")) {
+                arg_iterator++;
+                if ((NULL == *arg_iterator) ||
+                    (!ParseIoBackend(*arg_iterator, &options.io_backend))) {
+                    printf("Invalid I/O backend.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+            }
+            /* Streaming chunk size */
+            else if (0 == strcmp(*arg_iterator, "--chunk-size")) {
+                arg_iterator++;
+                if (NULL != *arg_iterator) {
+                    chunk_size = strtoull(*arg_iterator, NULL, 0);
+                }
+                else {
+                    chunk_size = 0;
+                }
+                if ((0 == chunk_size) || (chunk_size > SIZE_MAX >> 20)) {
+                    printf("Invalid chunk size.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+            }
+            /* Adjusted pixel data path */
+            else if (0 == strcmp(*arg_iterator, "--altered")) {
+                arg_iterator++;
+                if ((NULL != *arg_iterator) &&
+                    (strlen(*arg_iterator) < sizeof(altered_file_path))) {
+                    strcpy(altered_file_path, *arg_iterator);
+                }
+                else {
+                    printf("Invalid adjusted data file path.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+            }
+            /* Outputs to emit */
+            else if (0 == strcmp(*arg_iterator, "--emit")) {
+                arg_iterator++;
+                if ((NULL == *arg_iterator) ||
+                    (!ParseEmit(*arg_iterator, &emit_altered,
+                                &emit_preview))) {
+                    printf("Invalid outputs to emit.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+            }
+            /* Batch input */
+            else if (0 == strcmp(*arg_iterator, "--batch")) {
+                arg_iterator++;
+                if ((NULL != *arg_iterator) &&
+                    (strlen(*arg_iterator) < sizeof(batch_source))) {
+                    strcpy(batch_source, *arg_iterator);
+                }
+                else {
+                    printf("Invalid batch source.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+            }
+            /* Number of files processed at the same time */
+            else if (0 == strcmp(*arg_iterator, "--batch-jobs")) {
+                arg_iterator++;
+                if (NULL != *arg_iterator) {
+                    job_count = strtoull(*arg_iterator, NULL, 0);
+                    if (0 == job_count) {
+                        job_count = ParallelGetCpuCount();
+                    }
+                }
+                else {
+                    job_count = 0;
+                }
+                if ((0 == job_count) || (job_count > PARALLEL_MAX_THREADS)) {
+                    printf("Invalid number of batch jobs.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+            }
+            /* Server mode socket */
+            else if (0 == strcmp(*arg_iterator, "--serve")) {
+                arg_iterator++;
+                if ((NULL != *arg_iterator) &&
+                    (strlen(*arg_iterator) < sizeof(socket_path))) {
+                    strcpy(socket_path, *arg_iterator);
+                }
+                else {
+                    printf("Invalid server socket path.\n");
+                    status = EXIT_FAILURE;
+                    *(arg_iterator + 1) = NULL;
+                }
+            }
+            /* Run statistics, with an optional output file */
+            else if (0 == strcmp(*arg_iterator, "--stats")) {
+                stats_enabled = true;
+                if ((NULL != arg_iterator[1]) && ('-' != arg_iterator[1][0])) {
+                    arg_iterator++;
+                    if (strlen(*arg_iterator) < sizeof(stats_file_path)) {
+                        strcpy(stats_file_path, *arg_iterator);
+                    }
+                    else {
+                        printf("Invalid statistics file path.\n");
+                        status = EXIT_FAILURE;
+                        *(arg_iterator + 1) = NULL;
+                    }
+                }
+            }
             else {
                 /* Invalid input */
                 PrintUsage();
@@ -269,17 +722,180 @@ int main (int argc, char **argv) {
             }
         }
 
-        if ((EXIT_SUCCESS == status) && (0 == strlen(input_file_path))) {
+        options.chunk_size = chunk_size << 20;
+        if (0 == strlen(preview_file_path)) {
+            snprintf(preview_file_path, sizeof(preview_file_path), "%s.%s",
+                     (0 != strlen(batch_source)) ? BATCH_PREVIEW_PATTERN :
+                     (0 != options.depth) ? VOLUME_PREVIEW_PATTERN :
+                                            PREVIEW_FILE_PATH,
+                     BitmapGetFormatExtension(options.preview_format));
+        }
+        if (0 == strlen(altered_file_path)) {
+            snprintf(altered_file_path, sizeof(altered_file_path), "%s%s",
+                     (0 == strlen(batch_source)) ? ALTERED_FILE_PATH :
+                                                   BATCH_ALTERED_PATTERN,
+                     (CODEC_FORMAT_LZ4 == options.altered_format) ?
+                     LZ4_FILE_EXTENSION :
+                     (CODEC_FORMAT_DELTA == options.altered_format) ?
+                     DELTA_FILE_EXTENSION : "");
+        }
+        /* Pipes can only be read once, so they go through the pipe mode,
+           as do runs leaving out one of the outputs. */
+        pipe_mode = (0 == strcmp(input_file_path, PIPE_FILE_PATH)) ||
+                    (emit_preview &&
+                     (0 == strcmp(preview_file_path, PIPE_FILE_PATH))) ||
+                    (emit_altered &&
+                     (0 == strcmp(altered_file_path, PIPE_FILE_PATH))) ||
+                    !emit_altered || !emit_preview;
+        if ((EXIT_SUCCESS == status) && (true == stats_enabled)) {
+            StatsInit(&run_stats);
+            run_stats.thread_count = options.thread_count;
+            stats = &run_stats;
+        }
+
+        if ((EXIT_SUCCESS == status) && (true == options.preview_rle) &&
+            (BITMAP_FORMAT_BMP != options.preview_format)) {
+            printf("The run-length encoding only applies to the bmp "
+                   "format.\n");
+            status = EXIT_FAILURE;
+        }
+        else if ((EXIT_SUCCESS == status) && (NULL != options.pyramid_path) &&
+                 ((0 != strlen(socket_path)) || (0 != strlen(batch_source)) ||
+                  (true == quick_search) || (true == pipe_mode) ||
+                  (true == options.streaming))) {
+            printf("The preview pyramid can't be combined with --serve, "
+                   "--batch, -q, --stream, pipes or --emit.\n");
+            status = EXIT_FAILURE;
+        }
+        else if ((EXIT_SUCCESS == status) &&
+                 (DELITE_MODE_NEIGHBORHOOD == options.mode) &&
+                 (true == options.streaming)) {
+            printf("The neighborhood mode can't be combined with "
+                   "--stream.\n");
+            status = EXIT_FAILURE;
+        }
+        else if ((EXIT_SUCCESS == status) &&
+                 (FRAME_PIXEL_U16LE != options.pixel_format) &&
+                 ((0 != strlen(socket_path)) ||
+                  (true == options.streaming))) {
+            printf("The input format can't be combined with --serve or "
+                   "--stream.\n");
+            status = EXIT_FAILURE;
+        }
+        else if ((EXIT_SUCCESS == status) && (0 != options.depth) &&
+                 ((0 != strlen(socket_path)) || (0 != strlen(batch_source)) ||
+                  (true == quick_search) || (true == pipe_mode) ||
+                  (true == options.streaming) ||
+                  (NULL != options.pyramid_path) ||
+                  (DELITE_MODE_NEIGHBORHOOD == options.mode))) {
+            printf("The volume mode can't be combined with --serve, --batch, "
+                   "-q, --stream, --pyramid, -n, pipes or --emit.\n");
+            status = EXIT_FAILURE;
+        }
+        else if ((EXIT_SUCCESS == status) && (0 != options.depth) &&
+                 (NULL == strstr(preview_file_path, "%i"))) {
+            /* Otherwise, every slice would overwrite the previous one. */
+            printf("The preview path must contain %%i in volume mode.\n");
+            status = EXIT_FAILURE;
+        }
+        else if ((EXIT_SUCCESS == status) &&
+                 ((CODEC_FORMAT_DELTA == options.altered_format) ||
+                  (true == options.patch_input)) &&
+                 ((0 != strlen(socket_path)) || (true == pipe_mode) ||
+                  (true == options.streaming) ||
+                  (FRAME_PIXEL_U16LE != options.pixel_format))) {
+            printf("The delta output and --patch can't be combined with "
+                   "--serve, --stream, --input-format, pipes or --emit.\n");
+            status = EXIT_FAILURE;
+        }
+        else if ((EXIT_SUCCESS == status) && (true == options.patch_input) &&
+                 (CODEC_FORMAT_LZ4 == options.altered_format)) {
+            printf("The input file can't be patched with --compress lz4.\n");
+            status = EXIT_FAILURE;
+        }
+        else if ((EXIT_SUCCESS == status) && (0 != strlen(socket_path))) {
+            if ((0 != strlen(input_file_path)) || (true == quick_search) ||
+                (0 != strlen(batch_source)) || (true == pipe_mode)) {
+                printf("The server mode can't be combined with -f, -q, "
+                       "--batch or --emit.\n");
+                status = EXIT_FAILURE;
+            }
+            else {
+                status = RunServerMode(socket_path, &options, stats);
+            }
+        }
+        else if ((EXIT_SUCCESS == status) && (0 != strlen(batch_source))) {
+            if ((0 != strlen(input_file_path)) || (true == quick_search) ||
+                !emit_altered || !emit_preview) {
+                printf("The batch mode can't be combined with -f, -q or "
+                       "--emit.\n");
+                status = EXIT_FAILURE;
+            }
+            else {
+                status = DeliteProcessBatch(batch_source, preview_file_path,
+                                            altered_file_path, &options,
+                                            job_count, stats);
+            }
+        }
+        else if ((EXIT_SUCCESS == status) && (0 == strlen(input_file_path))) {
             printf("You must provide a valid input file path.\n");
             status = EXIT_FAILURE;
         }
+        else if ((EXIT_SUCCESS == status) && (true == quick_search) &&
+                 (DELITE_MODE_COUNT != options.mode)) {
+            printf("The quick search can't be combined with -t, -P or "
+                   "-n.\n");
+            status = EXIT_FAILURE;
+        }
+        else if ((EXIT_SUCCESS == status) && (true == quick_search) &&
+                 (true == pipe_mode)) {
+            printf("The quick search can't be combined with pipes or "
+                   "--emit.\n");
+            status = EXIT_FAILURE;
+        }
         else if (EXIT_SUCCESS == status) {
             if (true == quick_search) {
-                status = RunQuickSearch(input_file_path);    
+                status = DeliteQuickSearch(input_file_path, quick_count,
+                                           &options, stats);
             }
             else {
-                status = RunAdjustment(input_file_path, preview_file_path,
-                                       pixel_count, adjustment_level);
+                status = DeliteInit(&context, &options);
+                context.stats = stats;
+                if (EXIT_FAILURE == status) {
+                    printf("Unexpected error when generating the "
+                           "preview.\n");
+                }
+                else if (true == pipe_mode) {
+                    status = RunPipeMode(&context, input_file_path,
+                                         emit_preview ? preview_file_path :
+                                                        NULL,
+                                         emit_altered ? altered_file_path :
+                                                        NULL);
+                }
+                else if (true == options.streaming) {
+                    status = DeliteProcessStream(&context, input_file_path,
+                                                 preview_file_path,
+                                                 altered_file_path);
+                }
+                else {
+                    status = DeliteProcessFile(&context, input_file_path,
+                                               preview_file_path,
+                                               altered_file_path);
+                }
+                DeliteFree(&context);
+            }
+        }
+
+        /* Failed runs are reported too, up to where they stopped. */
+        if (NULL != stats) {
+            if (EXIT_SUCCESS == LogOpen(&log, ('\0' == stats_file_path[0]) ?
+                                              NULL : stats_file_path)) {
+                StatsWrite(stats, &log);
+            }
+            if (EXIT_FAILURE == LogClose(&log)) {
+                printf("Unexpected error when writing the run "
+                       "statistics.\n");
+                status = EXIT_FAILURE;
             }
         }
     }
@@ -289,19 +905,127 @@ int main (int argc, char **argv) {
 
 static void PrintUsage(void) {
     char help_message[] = "Usage: delite -h | "
-                          "-f <input_file> [-p pixel_count] "
-                          "[-l adjustment_level] [-o output_file] [-q]\n"
+                          "-f <input_file> "
+                          "[-p pixel_count | -t threshold | -P percentile | "
+                          "-n margin [--window size]] "
+                          "[-l adjustment_level] [-o output_file] [-q [count]] "
+                          "[-e engine] [-j threads] [--tie-break policy] "
+                          "[--format format] [--rle] [--compress codec] "
+                          "[--pyramid directory] "
+                          "[--width pixels] [--height pixels] "
+                          "[--depth slices] [--preview-scale factor] "
+                          "[--no-mmap] [--patch] [--input-format format] "
+                          "[--stream [--chunk-size MiB] "
+                          "[--io-backend backend]] "
+                          "[--altered output_file] [--emit outputs] "
+                          "[--batch source [--batch-jobs jobs]] [--sequence] "
+                          "[--serve socket] "
+                          "[--stats [file]]\n"
                           "\n"
                           "-h  Display help message\n"
-                          "-f  Raw pixel data file (must be binary)\n"
+                          "-f  Raw pixel data file (must be binary), "
+                          "- for the standard input\n"
                           "-p  The first number of pixels to adjust "
                           "for over exposure (default is 50)\n"
+                          "-t  Adjust all the pixels above this value "
+                          "instead, in a single pass\n"
+                          "-P  Adjust this percentage of the highest pixels "
+                          "instead (e.g. 0.1)\n"
+                          "-n  Adjust the pixels exceeding the median of "
+                          "their neighborhood by more than\n"
+                          "    this value instead (hot or stuck pixels)\n"
+                          "--window  Neighborhood side for -n: 3 or 5 "
+                          "(default is 3)\n"
                           "-l  Adjustment level given as a percentage "
                           "(default is 50%)\n"
                           "-o  Output preview file as a result of the "
-                          "adjustment (default is out.bmp)\n"
-                          "-q  Quick search for the first 50 overexposed "
-                          "pixels\n";
+                          "adjustment (default is out.<format>,\n"
+                          "    out.%i.<format> with --depth)\n"
+                          "-q  Quick search for the most overexposed "
+                          "pixels (default is 50)\n"
+                          "-e  Selection engine: auto, heap, select or "
+                          "histogram (default is auto)\n"
+                          "-j  Number of threads, 0 for one per CPU "
+                          "(default is 1)\n"
+                          "--tie-break  Which of the equal pixels get "
+                          "adjusted: first, last or all (default is first)\n"
+                          "--format  Preview format: bmp (8-bit), pgm "
+                          "(16-bit) or raw12 (12-bit packed)\n"
+                          "           (default is bmp, -o defaults to "
+                          "out.<format>)\n"
+                          "--rle  Run-length encode the bmp preview "
+                          "(BI_RLE8)\n"
+                          "--compress  Adjusted data container: none, "
+                          "lz4, a frame of blocks compressed\n"
+                          "            in parallel (--altered then defaults "
+                          "to altered.bin.lz4), or delta,\n"
+                          "            records of the adjusted pixels only "
+                          "(altered.bin.delta)\n"
+                          "            (default is none)\n"
+                          "--pyramid  Also write the preview as tiles of "
+                          "256x256 pixels, into\n"
+                          "           <directory>/<level>/<column>_<row>."
+                          "<format>, each level halving the\n"
+                          "           previous one from the full resolution "
+                          "frame (level 0)\n"
+                          "--width, --height  Frame dimensions, either "
+                          "one is derived from the other\n"
+                          "                   (default is the largest "
+                          "square preview)\n"
+                          "--depth  Read the input as a volume of this many "
+                          "slices of --width by --height,\n"
+                          "         sharing one threshold, with one preview "
+                          "per slice\n"
+                          "--preview-scale  Shrink the preview by this "
+                          "factor, averaging each box of pixels\n"
+                          "                 (default is 1)\n"
+                          "--no-mmap  Read the input file into memory "
+                          "instead of mapping it\n"
+                          "--patch  Write the adjusted pixels back into the "
+                          "input file instead of altered.bin\n"
+                          "--input-format  Input pixels: u16le, u16be, u8, "
+                          "raw12 (12-bit packed) or f32\n"
+                          "                (float from 0 to 1) (default is "
+                          "u16le)\n"
+                          "--stream  Process the input in fixed-size chunks, "
+                          "in two passes\n"
+                          "--chunk-size  Chunk size for the streaming mode "
+                          "in MiB (default is 16)\n"
+                          "--io-backend  Streaming mode I/O: auto, uring "
+                          "or threads (default is auto)\n"
+                          "--altered  Output file for the adjusted pixel "
+                          "data (default is altered.bin)\n"
+                          "--emit  Outputs to write: raw, preview or both "
+                          "(default is both)\n"
+                          "--batch  Process all the files given by a "
+                          "directory, a glob pattern or a list file\n"
+                          "--batch-jobs  Number of files processed at the "
+                          "same time, 0 for one per CPU (default is 1)\n"
+                          "--sequence  Update the selection of the previous "
+                          "frame (batch and server modes)\n"
+                          "--serve  Adjust the frames requested over this "
+                          "Unix socket, in shared memory\n"
+                          "--stats  Report the stage times and counters "
+                          "as JSON, to stderr or to a file\n"
+                          "\n"
+                          "In batch mode, -o and --altered are patterns where "
+                          "%n is the input file name\n"
+                          "without extension and %i its position in the "
+                          "batch (defaults are %n.<format> and\n"
+                          "%n.altered.bin).\n"
+                          "\n"
+                          "In volume mode, -o is a pattern where %i is the "
+                          "slice index (default is\n"
+                          "out.%i.<format>), the adjusted data holding the "
+                          "whole volume.\n"
+                          "\n"
+                          "Any of -f, -o and --altered may be - to read "
+                          "from or write to a pipe. When both\n"
+                          "outputs go to the standard output, they're "
+                          "multiplexed as records: a tag (R for\n"
+                          "the adjusted data, P for the preview), the "
+                          "payload size as 8 bytes little-endian\n"
+                          "and the payload.\n";
 
     printf("%s", help_message);
 }
@@ -317,265 +1041,254 @@ static bool FileIsRegular(const char *file_path) {
    return result;
 }
 
-/* TODO: Add support for other word sizes. */
-static int AdjustPixelData(uint16_t *data, 
-                           uint32_t size,
-                           uint32_t pixel_count,
-                           uint8_t adjustment_level) {
-    unsigned i = 0;
-    unsigned j = 0;
-    uint16_t current_max = 0;
-    uint16_t max_index = 0;
-    int status = EXIT_SUCCESS;
-    /* In this case, a selection algorithm won't be more efficient.
-       Use flag array instead to avoid wasting memory. */
-    bool *adjusted_flag = NULL;
+static bool ParseEngine(const char *name, enum Selection_Engine *engine) {
+    bool result = true;
 
-    adjusted_flag = calloc(size, sizeof(bool));
-
-    if ((NULL == data) || (NULL == adjusted_flag) || (0 == size)) {
-        status = EXIT_FAILURE;
+    if (0 == strcmp(name, "auto")) {
+        *engine = SELECTION_ENGINE_AUTO;
+    }
+    else if (0 == strcmp(name, "heap")) {
+        *engine = SELECTION_ENGINE_HEAP;
+    }
+    else if (0 == strcmp(name, "select")) {
+        *engine = SELECTION_ENGINE_INTROSELECT;
+    }
+    else if (0 == strcmp(name, "histogram")) {
+        *engine = SELECTION_ENGINE_HISTOGRAM;
     }
     else {
-        for (i = 0; i < pixel_count; i++) {
-            current_max = 0;
-            for (j = 0; j < size; j++) {
-                if ((data[j] > current_max) && (!adjusted_flag[j])) {
-                    current_max = data[j];
-                    max_index = j;
-                }
-            }
-            data[max_index] *= (1 - ((float) adjustment_level) / 100);
-            adjusted_flag[max_index] = true;
-        }
+        result = false;
+    }
 
-        free(adjusted_flag);
-    } 
+    return result;
+}
 
-    return status;
+static bool ParseIoBackend(const char *name, enum Async_Io_Backend *backend) {
+    bool result = true;
+
+    if (0 == strcmp(name, "auto")) {
+        *backend = ASYNC_IO_BACKEND_AUTO;
+    }
+    else if (0 == strcmp(name, "uring")) {
+        *backend = ASYNC_IO_BACKEND_URING;
+    }
+    else if (0 == strcmp(name, "threads")) {
+        *backend = ASYNC_IO_BACKEND_THREADS;
+    }
+    else {
+        result = false;
+    }
+
+    return result;
 }
 
-static uint32_t ReadBytesFromFile(FILE *in, void **data) {
-    uint32_t size = 0;
-    
-    if ((NULL != in) && (NULL != data)) {
-        /* Get total size. */
-        fseek(in, 0, SEEK_END);
-        size = ftell(in);
-        fseek(in, 0, SEEK_SET);
-
-        *data = malloc(size);
-        if (NULL != *data) {
-            if (size != fread(*data, 1, size, in)) {
-                /* File read failed. */
-                size = 0;
-                free(*data);
-            }
-        }
+static bool ParseTieBreak(const char *name,
+                          enum Selection_Tie_Break *tie_break) {
+    bool result = true;
+
+    if (0 == strcmp(name, "first")) {
+        *tie_break = SELECTION_TIE_BREAK_FIRST;
+    }
+    else if (0 == strcmp(name, "last")) {
+        *tie_break = SELECTION_TIE_BREAK_LAST;
+    }
+    else if (0 == strcmp(name, "all")) {
+        *tie_break = SELECTION_TIE_BREAK_ALL;
+    }
+    else {
+        result = false;
     }
 
-    return size;
+    return result;
 }
 
-static int GeneratePreviewBitmapFrom16Bit(const uint16_t *data, 
-                                          uint32_t size,
-                                          struct Bitmap **bmp) {
-    uint32_t i = 0;
-    uint32_t image_size = 0;
-    union Raw_Pixel_Data *scaled_data = NULL;
-    int status = EXIT_SUCCESS;
-    
-    scaled_data = malloc(size * sizeof(union Raw_Pixel_Data));
-    if ((NULL == data) || (scaled_data == NULL) 
-        || (0 == size) || (NULL == bmp)) {
-        status = EXIT_FAILURE;
+static bool ParseFormat(const char *name, enum Bitmap_Format *format) {
+    bool result = true;
+
+    if (0 == strcmp(name, "bmp")) {
+        *format = BITMAP_FORMAT_BMP;
+    }
+    else if (0 == strcmp(name, "pgm")) {
+        *format = BITMAP_FORMAT_PGM;
+    }
+    else if (0 == strcmp(name, "raw12")) {
+        *format = BITMAP_FORMAT_RAW12;
+    }
+    else {
+        result = false;
     }
-    
-    status = BitmapInit8BitGrayscale(bmp);
-    if (EXIT_SUCCESS == status) {
-        image_size = sqrt(size);
-        /* The width must be a multiple of 4. */
-        image_size = image_size & ~0x03;
-        /* Trim data size if the size isn't a perfect square. */
-        size = image_size * image_size;
-    
-        for (i = 0; i < size; i++) {
-            /* TODO: Average out the scaled data array
-                     in case the size gets trimmed. */
-            scaled_data[i].u8 = data[i] / 256U;
-        }
 
-        status = BitmapSetWidthHeight(*bmp, image_size, image_size);
-        if (EXIT_SUCCESS == status) {
-            status = BitmapFillPixelData(*bmp, scaled_data);
-        }
+    return result;
+}
+
+static bool ParseCodec(const char *name, enum Codec_Format *format) {
+    bool result = true;
+
+    if (0 == strcmp(name, "none")) {
+        *format = CODEC_FORMAT_NONE;
     }
-    
-    return status;
+    else if (0 == strcmp(name, "lz4")) {
+        *format = CODEC_FORMAT_LZ4;
+    }
+    else if (0 == strcmp(name, "delta")) {
+        *format = CODEC_FORMAT_DELTA;
+    }
+    else {
+        result = false;
+    }
+
+    return result;
 }
 
-static int WriteBytesToFile(FILE *out, const void *data, uint32_t count) {
-    int status = EXIT_SUCCESS;
-    
-    if ((NULL != out) && (NULL != data)) {
-        if (count != fwrite(data, 1U, count, out)) {
-            status = EXIT_FAILURE;
-        }
-        else {
-            fflush(out);
-        }
+static bool ParseInputFormat(const char *name,
+                             enum Frame_Pixel_Format *format) {
+    bool result = true;
+
+    if (0 == strcmp(name, "u16le")) {
+        *format = FRAME_PIXEL_U16LE;
+    }
+    else if (0 == strcmp(name, "u16be")) {
+        *format = FRAME_PIXEL_U16BE;
+    }
+    else if (0 == strcmp(name, "u8")) {
+        *format = FRAME_PIXEL_U8;
+    }
+    else if (0 == strcmp(name, "raw12")) {
+        *format = FRAME_PIXEL_RAW12;
+    }
+    else if (0 == strcmp(name, "f32")) {
+        *format = FRAME_PIXEL_F32;
     }
     else {
-        status = EXIT_FAILURE;
+        result = false;
     }
 
-    return status;
+    return result;
 }
 
-static int WriteBmpToFile(FILE *out, const struct Bitmap *bmp) {
-    int status = EXIT_SUCCESS;
-    void *mem_to_write = NULL;
-    
-    if (NULL == bmp) {
-        status = EXIT_FAILURE;
+static bool ParseEmit(const char *name, bool *altered, bool *preview) {
+    bool result = true;
+
+    if (0 == strcmp(name, "raw")) {
+        *altered = true;
+        *preview = false;
+    }
+    else if (0 == strcmp(name, "preview")) {
+        *altered = false;
+        *preview = true;
+    }
+    else if (0 == strcmp(name, "both")) {
+        *altered = true;
+        *preview = true;
     }
     else {
-        mem_to_write = malloc(GET_BITMAP_SIZE(bmp));
-        if (NULL != mem_to_write) {
-            memcpy(mem_to_write, &(bmp->header), sizeof(bmp->header));
-            memcpy(mem_to_write + sizeof(bmp->header),
-                   &(bmp->info_header),
-                   bmp->info_header.header_size);
-            memcpy(mem_to_write + sizeof(bmp->header) 
-                   + bmp->info_header.header_size, 
-                   bmp->color_table,
-                   bmp->info_header.colors_used 
-                   * sizeof(struct Bitmap_ColorEntry));
-            memcpy(mem_to_write + bmp->header.pixel_data_offset,
-                   bmp->pixel_data,
-                   bmp->info_header.image_size);
-            
-            status = WriteBytesToFile(out, mem_to_write, GET_BITMAP_SIZE(bmp));
-        }
-        else {
-            status = EXIT_FAILURE;
-        }
+        result = false;
     }
 
-    return status;
+    return result;
 }
 
-static int RunAdjustment(const char *input_file_path,
-                         const char *preview_file_path,
-                         unsigned pixel_count,
-                         unsigned adjustment_level) {
-    struct Bitmap *output_bmp = NULL;
-    FILE *in = NULL;
-    FILE *out = NULL;
-    uint16_t *raw_data = NULL;
-    uint32_t raw_data_size = 0U;
+static int RunPipeMode(struct Delite_Context *context,
+                       const char *input_file_path,
+                       const char *preview_file_path,
+                       const char *altered_file_path) {
+    bool to_stdout = ((NULL != preview_file_path) &&
+                      (0 == strcmp(preview_file_path, PIPE_FILE_PATH))) ||
+                     ((NULL != altered_file_path) &&
+                      (0 == strcmp(altered_file_path, PIPE_FILE_PATH)));
+    int out = -1;
+    int in = -1;
+    int preview = -1;
+    int altered = -1;
     int status = EXIT_SUCCESS;
 
-    in = fopen(input_file_path, "rb");
-    raw_data_size = ReadBytesFromFile(in, (void **) &raw_data);
-
-    /* TODO: Add dedicated error reporting. */ 
-    if (raw_data_size > 0) {
-        status = AdjustPixelData(raw_data,
-                                 raw_data_size / sizeof(raw_data[0]),
-                                 pixel_count,
-                                 adjustment_level);
-        if (EXIT_SUCCESS == status) {
-            /* Output the adjusted pixel data in binary. */
-            out = fopen(ALTERED_FILE_PATH, "wb");
-            status = WriteBytesToFile(out, raw_data, raw_data_size);
-            if (EXIT_SUCCESS == status) {
-                fclose(out);
-                status = GeneratePreviewBitmapFrom16Bit(raw_data, 
-                                                        raw_data_size /
-                                                        sizeof(raw_data[0]),
-                                                        &output_bmp);
-                if (EXIT_SUCCESS == status) {
-                    out = fopen(preview_file_path, "wb");
-                    status = WriteBmpToFile(out, output_bmp);
-                    if (EXIT_FAILURE == status) {
-                        printf("Unexpected error when writing the "
-                               "preview bitmap.\n");
-                    }
+    /* The data keeps the standard output, the messages move to stderr. */
+    if (to_stdout) {
+        fflush(stdout);
+        out = dup(STDOUT_FILENO);
+        if ((out < 0) || (dup2(STDERR_FILENO, STDOUT_FILENO) < 0)) {
+            printf("Unexpected error when writing the "
+                   "adjusted pixel data to file.\n");
+            status = EXIT_FAILURE;
+        }
+    }
 
-                    free(output_bmp->color_table);
-                    free(output_bmp->pixel_data);
-                }
-                else {
-                    printf("Unexpected error when generating the preview.\n");
-                }
-            }
-            else {
-                printf("Unexpected error when writing the "
-                       "adjusted pixel data to file.\n");
-            }
+    if (EXIT_SUCCESS == status) {
+        in = (0 == strcmp(input_file_path, PIPE_FILE_PATH)) ? STDIN_FILENO :
+             open(input_file_path, O_RDONLY);
+        if (in < 0) {
+            printf("Unexpected error when reading the raw input "
+                   "byte stream.\n");
+            status = EXIT_FAILURE;
+        }
+    }
+    if ((EXIT_SUCCESS == status) && (NULL != altered_file_path)) {
+        altered = (0 == strcmp(altered_file_path, PIPE_FILE_PATH)) ? out :
+                  open(altered_file_path, O_WRONLY | O_CREAT | O_TRUNC,
+                       0666);
+        if (altered < 0) {
+            printf("Unexpected error when writing the "
+                   "adjusted pixel data to file.\n");
+            status = EXIT_FAILURE;
         }
-        else {
-            printf("Unexpected error when processing the pixel data.\n");
+    }
+    if ((EXIT_SUCCESS == status) && (NULL != preview_file_path)) {
+        preview = (0 == strcmp(preview_file_path, PIPE_FILE_PATH)) ? out :
+                  open(preview_file_path, O_WRONLY | O_CREAT | O_TRUNC,
+                       0666);
+        if (preview < 0) {
+            printf("Unexpected error when writing the preview bitmap.\n");
+            status = EXIT_FAILURE;
         }
+    }
 
+    if (EXIT_SUCCESS == status) {
+        status = DeliteProcessPipe(context, in, altered, preview);
     }
-    else {
-        printf("Unexpected error when reading the raw input byte stream.\n");
+
+    /* Errors on close mean the data may not have reached the files. */
+    if ((preview >= 0) && (preview != out) && (0 != close(preview))) {
+        printf("Unexpected error when writing the preview bitmap.\n");
         status = EXIT_FAILURE;
     }
-
-    if (NULL != in) {
-        fclose(in);
+    if ((altered >= 0) && (altered != out) && (0 != close(altered))) {
+        printf("Unexpected error when writing the "
+               "adjusted pixel data to file.\n");
+        status = EXIT_FAILURE;
     }
-    if (NULL != out) {
-        fclose(out);
+    if ((in >= 0) && (STDIN_FILENO != in)) {
+        close(in);
+    }
+    if (out >= 0) {
+        close(out);
     }
-
-    /* Free tolerates NULL, no need to check. */
-    free(raw_data);
-    free(output_bmp);
 
     return status;
 }
 
-static int RunQuickSearch(const char *input_file_path) {
-    FILE *in = NULL;
-    uint16_t *raw_data = NULL;
-    uint16_t max = 0;
-    uint32_t max_pos = 0;
-    uint32_t raw_data_size = 0;
-    uint32_t i = 0;
-    uint32_t j = 0;
+static int RunServerMode(const char *socket_path,
+                         const struct Delite_Options *options,
+                         struct Stats *stats) {
+    struct sigaction action;
     int status = EXIT_SUCCESS;
-    
-    in = fopen(input_file_path, "rb");
-    raw_data_size = ReadBytesFromFile(in, (void **) &raw_data);
-
-    /* Need at least 50 pixels. */
-    if (raw_data_size > 100U) {
-        printf("Overexposed pixel data (pos is the pixel index "
-               "relative to the beginning of the file): \n");
-        for (i = 0; i < 50; i++) {
-            max = 0;
-            max_pos = 0;
-
-            for (j = 0; j < raw_data_size; j++) {
-                if (raw_data[j] > max) {
-                    max = raw_data[j];
-                    max_pos = j;
-                } 
-            }
-            /* Zero out the max so we exclude it in the further iterations. */
-            raw_data[max_pos] = 0;
-            printf("# Pixel value: 0x%04X - Pos: %u\n", max, max_pos);
-        }
-    }
 
-    if (NULL != in) {
-        fclose(in);
+    /* Without SA_RESTART, the signals interrupt the wait for requests. */
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = RequestStop;
+    sigemptyset(&action.sa_mask);
+    if ((0 != sigaction(SIGINT, &action, NULL)) ||
+        (0 != sigaction(SIGTERM, &action, NULL))) {
+        printf("Unexpected error when opening the server socket.\n");
+        status = EXIT_FAILURE;
     }
-    free(raw_data);
-    
+    else {
+        status = ServerRun(socket_path, options, &stop_requested, stats);
+    }
+
     return status;
 }
+
+static void RequestStop(int signal_number) {
+    (void) signal_number;
+    stop_requested = 1;
+}
@@ -0,0 +1,244 @@
+/**
+ *  @brief Worker threads implementation file.
+ *
+ */
+
+#include "parallel.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+
+/****************************************************************************
+ * TYPE DEFINITIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Task bound to one of its arguments.
+ */
+struct Parallel_Job {
+    void (*task)(void *);       /* Task to run */
+    void *arg;                  /* Task argument */
+};
+
+/**
+ *  @brief Worker threads waiting for the runs.
+ */
+struct Parallel_Pool {
+    pthread_mutex_t busy;       /* Held by the run using the workers */
+    pthread_mutex_t mutex;      /* Protects the fields below */
+    pthread_cond_t wake;        /* Signals a new run or the stop */
+    pthread_cond_t idle;        /* Signals the end of a run */
+    pthread_t threads[PARALLEL_MAX_THREADS];    /* Worker threads */
+    size_t ids[PARALLEL_MAX_THREADS];           /* Worker positions */
+    unsigned long seen[PARALLEL_MAX_THREADS];   /* Last run of each worker */
+    size_t thread_count;        /* Number of workers (0 if stopped) */
+    void (*task)(void *);       /* Task of the current run */
+    uint8_t *args;              /* Its arguments */
+    size_t arg_size;            /* Size of one argument */
+    size_t count;               /* Number of arguments */
+    size_t next;                /* Next argument to claim */
+    size_t workers;             /* Workers taking part in the run */
+    size_t running;             /* Workers still in the run */
+    unsigned long run;          /* Number of runs so far */
+    bool stopping;              /* Whether the workers must exit */
+};
+
+/****************************************************************************
+ * LOCAL DECLARATIONS
+ ****************************************************************************/
+/**
+ *  @brief Worker thread entry point.
+ *
+ *  @param job  Job to run (struct Parallel_Job)
+ *
+ *  @return NULL
+ */
+static void *RunJob(void *job);
+
+/**
+ *  @brief Pool worker thread entry point.
+ *
+ *  @param id  Worker position in the pool (size_t)
+ *
+ *  @return NULL
+ */
+static void *RunPoolWorker(void *id);
+
+/**
+ *  @brief Process the arguments of the current run until none is left.
+ *
+ *  The pool mutex must be held, it is released while the task runs.
+ *  @param none
+ *
+ *  @return none
+ */
+static void ClaimPoolJobs(void);
+
+/* Process-wide pool, stopped until ParallelPoolStart. */
+static struct Parallel_Pool pool = {
+    .busy = PTHREAD_MUTEX_INITIALIZER,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .idle = PTHREAD_COND_INITIALIZER
+};
+
+/****************************************************************************/
+
+size_t ParallelGetCpuCount(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (count < 1) {
+        count = 1;
+    }
+    else if ((unsigned long) count > PARALLEL_MAX_THREADS) {
+        count = PARALLEL_MAX_THREADS;
+    }
+
+    return count;
+}
+
+int ParallelPoolStart(size_t count) {
+    size_t i = 0;
+    int status = EXIT_SUCCESS;
+
+    if ((0 != pool.thread_count) || (0 == count) ||
+        (count >= PARALLEL_MAX_THREADS)) {
+        status = EXIT_FAILURE;
+    }
+    for (i = 0; (EXIT_SUCCESS == status) && (i < count); i++) {
+        pool.ids[i] = i;
+        /* A run started before the worker gets going is still its own. */
+        pthread_mutex_lock(&pool.mutex);
+        pool.seen[i] = pool.run;
+        pthread_mutex_unlock(&pool.mutex);
+        if (0 != pthread_create(&pool.threads[i], NULL, RunPoolWorker,
+                                &pool.ids[i])) {
+            status = EXIT_FAILURE;
+        }
+        else {
+            pool.thread_count++;
+        }
+    }
+    if (EXIT_FAILURE == status) {
+        ParallelPoolStop();
+    }
+
+    return status;
+}
+
+void ParallelPoolStop(void) {
+    size_t i = 0;
+
+    pthread_mutex_lock(&pool.mutex);
+    pool.stopping = true;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.mutex);
+
+    for (i = 0; i < pool.thread_count; i++) {
+        pthread_join(pool.threads[i], NULL);
+    }
+    pool.thread_count = 0;
+    pool.stopping = false;
+}
+
+int ParallelRun(void (*task)(void *),
+                void *args,
+                size_t arg_size,
+                size_t count) {
+    pthread_t threads[PARALLEL_MAX_THREADS];
+    struct Parallel_Job jobs[PARALLEL_MAX_THREADS];
+    bool started[PARALLEL_MAX_THREADS] = { false };
+    size_t i = 0;
+    int status = EXIT_SUCCESS;
+
+    if ((NULL == task) || (NULL == args) || (count > PARALLEL_MAX_THREADS)) {
+        status = EXIT_FAILURE;
+    }
+    else if ((count > 1U) && (0 != pool.thread_count) &&
+             (0 == pthread_mutex_trylock(&pool.busy))) {
+        /* Only the workers needed for the run are woken up. */
+        pthread_mutex_lock(&pool.mutex);
+        pool.task = task;
+        pool.args = args;
+        pool.arg_size = arg_size;
+        pool.count = count;
+        pool.next = 0;
+        pool.workers = (count - 1U < pool.thread_count) ? count - 1U :
+                                                          pool.thread_count;
+        pool.running = pool.workers;
+        pool.run++;
+        pthread_cond_broadcast(&pool.wake);
+        ClaimPoolJobs();
+        while (pool.running > 0) {
+            pthread_cond_wait(&pool.idle, &pool.mutex);
+        }
+        pthread_mutex_unlock(&pool.mutex);
+        pthread_mutex_unlock(&pool.busy);
+    }
+    else {
+        for (i = 1; i < count; i++) {
+            jobs[i].task = task;
+            jobs[i].arg = (uint8_t *) args + i * arg_size;
+            started[i] = (0 == pthread_create(&threads[i], NULL, RunJob,
+                                              &jobs[i]));
+        }
+
+        if (count > 0) {
+            task(args);
+        }
+
+        for (i = 1; i < count; i++) {
+            if (started[i]) {
+                pthread_join(threads[i], NULL);
+            }
+            else {
+                task(jobs[i].arg);
+            }
+        }
+    }
+
+    return status;
+}
+
+static void *RunJob(void *job) {
+    ((struct Parallel_Job *) job)->task(((struct Parallel_Job *) job)->arg);
+
+    return NULL;
+}
+
+static void *RunPoolWorker(void *id) {
+    size_t i = *(size_t *) id;
+
+    pthread_mutex_lock(&pool.mutex);
+    while (!pool.stopping) {
+        if (pool.seen[i] == pool.run) {
+            pthread_cond_wait(&pool.wake, &pool.mutex);
+        }
+        else {
+            pool.seen[i] = pool.run;
+            if (i < pool.workers) {
+                ClaimPoolJobs();
+                pool.running--;
+                if (0 == pool.running) {
+                    pthread_cond_signal(&pool.idle);
+                }
+            }
+        }
+    }
+    pthread_mutex_unlock(&pool.mutex);
+
+    return NULL;
+}
+
+static void ClaimPoolJobs(void) {
+    size_t i = 0;
+
+    while (pool.next < pool.count) {
+        i = pool.next++;
+        pthread_mutex_unlock(&pool.mutex);
+        pool.task(pool.args + i * pool.arg_size);
+        pthread_mutex_lock(&pool.mutex);
+    }
+}
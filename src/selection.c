@@ -0,0 +1,635 @@
+/**
+ *  @brief Pixel selection engine implementation file.
+ *
+ *  Each candidate pixel is encoded as a 64-bit key holding the pixel
+ *  value in the upper 16 bits and the pixel index in the lower 48 bits.
+ *  The index is inverted when the pixel closer to the beginning must win
+ *  the tie-break. This way, a greater key always means a higher ranked
+ *  pixel and the engines only have to compare plain integers.
+ */
+
+#include "selection.h"
+#include "kernels.h"
+
+#include <string.h>
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS AND MACROS
+ ****************************************************************************/
+/* Bits of the ranking key holding the pixel index. */
+#define SELECTION_INDEX_MASK ((UINT64_C(1) << 48) - 1U)
+
+/* Build the ranking key of a pixel, given the tie-break index mask. */
+#define SELECTION_KEY(value, index, mask) (((uint64_t) (value) << 48) | \
+                                           ((uint64_t) (index) ^ (mask)))
+
+/* Extract the pixel value and index from a ranking key. */
+#define SELECTION_KEY_VALUE(key) ((uint16_t) ((key) >> 48))
+#define SELECTION_KEY_INDEX(key, mask) \
+        ((size_t) (((key) & SELECTION_INDEX_MASK) ^ (mask)))
+
+/* Get the index mask corresponding to a tie-break policy. */
+#define SELECTION_TIE_BREAK_MASK(tie_break) \
+        ((SELECTION_TIE_BREAK_LAST == (tie_break)) ? 0U : SELECTION_INDEX_MASK)
+
+/****************************************************************************
+ * LOCAL DECLARATIONS
+ ****************************************************************************/
+/**
+ *  @brief Restore the min-heap property starting from a given node.
+ *
+ *  @param heap  Heap array
+ *  @param size  Number of heap entries
+ *  @param node  Node that may be greater than its children
+ *
+ *  @return none
+ */
+static void HeapSiftDown(uint64_t *heap, size_t size, size_t node);
+
+/**
+ *  @brief Restore the min-heap property after appending a node.
+ *
+ *  @param heap  Heap array
+ *  @param node  Node that may be smaller than its parent
+ *
+ *  @return none
+ */
+static void HeapSiftUp(uint64_t *heap, size_t node);
+
+/**
+ *  @brief Select the highest ranked pixels through the value histogram.
+ *
+ *  The threshold is determined from the histogram, then the pixels
+ *  above it (and the required ones equal to it) are collected in a
+ *  single sweep. The lowest ranked pixel is stored last.
+ *  @param data       Pixel data to select from
+ *  @param size       Array size
+ *  @param count      Number of pixels to select
+ *  @param tie_break  Tie-break policy (first or last)
+ *  @param indices    Output array (must hold at least count entries)
+ *  @param selected   Number of pixels actually selected
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int HistogramTopK(const uint16_t *data,
+                         size_t size,
+                         size_t count,
+                         enum Selection_Tie_Break tie_break,
+                         size_t *indices,
+                         size_t *selected);
+
+/**
+ *  @brief Partially order an array of keys around the nth element.
+ *
+ *  After the call, keys[nth] holds the key which would be found at that
+ *  position in a descending sort, all keys before it are greater and all
+ *  keys after it are smaller. Quickselect is used with a median of three
+ *  pivot, falling back to a heap select once the recursion depth gets
+ *  too high (i.e. introselect).
+ *  @param keys  Array of distinct keys
+ *  @param size  Array size
+ *  @param nth   Position to order around
+ *
+ *  @return none
+ */
+static void IntroSelect(uint64_t *keys, size_t size, size_t nth);
+
+/**
+ *  @brief Compare two ranking keys for a descending sort.
+ *
+ *  @param a  First key
+ *  @param b  Second key
+ *
+ *  @return -1, 0 or 1 as expected by qsort.
+ */
+static int CompareKeysDescending(const void *a, const void *b);
+
+/****************************************************************************/
+
+enum Selection_Engine SelectionPickEngine(enum Selection_Engine engine,
+                                          size_t size,
+                                          size_t count) {
+    if (SELECTION_ENGINE_AUTO == engine) {
+        engine = (count < size / SELECTION_HEAP_RATIO) ?
+                 SELECTION_ENGINE_HEAP : SELECTION_ENGINE_HISTOGRAM;
+    }
+
+    return engine;
+}
+
+const char *SelectionGetEngineName(enum Selection_Engine engine) {
+    const char *name = "auto";
+
+    switch (engine) {
+        case SELECTION_ENGINE_HEAP:
+            name = "heap";
+
+            break;
+        case SELECTION_ENGINE_INTROSELECT:
+            name = "select";
+
+            break;
+        case SELECTION_ENGINE_HISTOGRAM:
+            name = "histogram";
+
+            break;
+        default:
+
+            break;
+    }
+
+    return name;
+}
+
+int SelectionTopK(const uint16_t *data,
+                  size_t size,
+                  size_t count,
+                  enum Selection_Engine engine,
+                  enum Selection_Tie_Break tie_break,
+                  size_t *indices,
+                  size_t *selected) {
+    size_t i = 0;
+    size_t key_count = 0;
+    size_t lowest = 0;
+    uint64_t mask = 0;
+    uint64_t *keys = NULL;
+    struct Selection_Heap heap;
+    int status = EXIT_SUCCESS;
+
+    if ((NULL == data) || (NULL == indices) || (NULL == selected) ||
+        ((uint64_t) size > SELECTION_INDEX_MASK)) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        *selected = 0;
+        if (count > size) {
+            count = size;
+        }
+        if (SELECTION_TIE_BREAK_ALL == tie_break) {
+            tie_break = SELECTION_TIE_BREAK_FIRST;
+        }
+        mask = SELECTION_TIE_BREAK_MASK(tie_break);
+
+        engine = SelectionPickEngine(engine, size, count);
+
+        if ((count > 0) && (SELECTION_ENGINE_INTROSELECT == engine)) {
+            keys = malloc(size * sizeof(uint64_t));
+            if (NULL == keys) {
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+
+    if ((EXIT_SUCCESS == status) && (count > 0) &&
+        (SELECTION_ENGINE_HISTOGRAM == engine)) {
+        status = HistogramTopK(data, size, count, tie_break,
+                               indices, selected);
+    }
+    else if ((EXIT_SUCCESS == status) && (count > 0) &&
+             (SELECTION_ENGINE_HEAP == engine)) {
+        status = SelectionHeapInit(&heap, count, tie_break);
+        if (EXIT_SUCCESS == status) {
+            SelectionHeapUpdate(&heap, data, size, 0);
+            *selected = SelectionHeapExtract(&heap, indices);
+        }
+        SelectionHeapFree(&heap);
+    }
+    else if ((EXIT_SUCCESS == status) && (NULL != keys)) {
+        for (i = 0; i < size; i++) {
+            if (0 != data[i]) {
+                keys[key_count++] = SELECTION_KEY(data[i], i, mask);
+            }
+        }
+
+        if (key_count > count) {
+            IntroSelect(keys, key_count, count - 1);
+            key_count = count;
+            lowest = count - 1;
+        }
+        else {
+            for (i = 1; i < key_count; i++) {
+                if (keys[i] < keys[lowest]) {
+                    lowest = i;
+                }
+            }
+        }
+
+        if (key_count > 0) {
+            /* Move the lowest ranked key at the end. */
+            indices[key_count - 1] = SELECTION_KEY_INDEX(keys[lowest], mask);
+            keys[lowest] = keys[key_count - 1];
+            for (i = 0; i < key_count - 1; i++) {
+                indices[i] = SELECTION_KEY_INDEX(keys[i], mask);
+            }
+        }
+        *selected = key_count;
+    }
+
+    free(keys);
+
+    return status;
+}
+
+int SelectionHeapInit(struct Selection_Heap *heap,
+                      size_t capacity,
+                      enum Selection_Tie_Break tie_break) {
+    int status = EXIT_SUCCESS;
+
+    if (NULL == heap) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        heap->size = 0;
+        heap->capacity = capacity;
+        heap->mask = SELECTION_TIE_BREAK_MASK(tie_break);
+        heap->keys = malloc(((capacity > 0) ? capacity : 1U) *
+                            sizeof(uint64_t));
+        if (NULL == heap->keys) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    return status;
+}
+
+void SelectionHeapUpdate(struct Selection_Heap *heap,
+                         const uint16_t *data,
+                         size_t size,
+                         size_t offset) {
+    size_t i = 0;
+    uint16_t root_value = 0;
+    uint32_t entry = 0;
+    uint64_t *keys = heap->keys;
+    uint64_t mask = heap->mask;
+
+    /* Fill the heap with the first non-zero pixels. */
+    for (i = 0; (i < size) && (heap->size < heap->capacity); i++) {
+        if (0 != data[i]) {
+            keys[heap->size] = SELECTION_KEY(data[i], offset + i, mask);
+            HeapSiftUp(keys, heap->size);
+            heap->size++;
+        }
+    }
+
+    if (heap->size > 0) {
+        root_value = SELECTION_KEY_VALUE(keys[0]);
+    }
+    else {
+        /* Nothing to select (the capacity is 0). */
+        i = size;
+    }
+
+    /* Pixels are visited in ascending index order, so an equal value
+       either always ranks lower than the root or always higher. Only
+       the pixels reaching the entry value have to be looked at. */
+    while (i < size) {
+        entry = (0U == mask) ? root_value : root_value + 1U;
+        if (entry > UINT16_MAX) {
+            /* Nothing can outrank the root anymore. */
+            break;
+        }
+        i += KernelFindAtLeast(&data[i], size - i, entry);
+        if (i < size) {
+            keys[0] = SELECTION_KEY(data[i], offset + i, mask);
+            HeapSiftDown(keys, heap->size, 0);
+            root_value = SELECTION_KEY_VALUE(keys[0]);
+            i++;
+        }
+    }
+}
+
+void SelectionHeapMerge(struct Selection_Heap *heap,
+                        const struct Selection_Heap *other) {
+    size_t i = 0;
+
+    for (i = 0; i < other->size; i++) {
+        if (heap->size < heap->capacity) {
+            heap->keys[heap->size] = other->keys[i];
+            HeapSiftUp(heap->keys, heap->size);
+            heap->size++;
+        }
+        else if ((heap->size > 0) && (other->keys[i] > heap->keys[0])) {
+            heap->keys[0] = other->keys[i];
+            HeapSiftDown(heap->keys, heap->size, 0);
+        }
+    }
+}
+
+size_t SelectionHeapExtract(const struct Selection_Heap *heap,
+                            size_t *indices) {
+    size_t i = 0;
+
+    /* The heap root is the lowest ranked key. */
+    if (heap->size > 0) {
+        for (i = 1; i < heap->size; i++) {
+            indices[i - 1] = SELECTION_KEY_INDEX(heap->keys[i], heap->mask);
+        }
+        indices[heap->size - 1] = SELECTION_KEY_INDEX(heap->keys[0],
+                                                      heap->mask);
+    }
+
+    return heap->size;
+}
+
+void SelectionHeapFree(struct Selection_Heap *heap) {
+    if (NULL != heap) {
+        free(heap->keys);
+        heap->keys = NULL;
+        heap->size = 0;
+        heap->capacity = 0;
+    }
+}
+
+int SelectionSortByRank(const uint16_t *data,
+                        size_t *indices,
+                        size_t count,
+                        enum Selection_Tie_Break tie_break) {
+    size_t i = 0;
+    uint64_t mask = SELECTION_TIE_BREAK_MASK(tie_break);
+    uint64_t *keys = NULL;
+    int status = EXIT_SUCCESS;
+
+    if ((NULL == data) || (NULL == indices)) {
+        status = EXIT_FAILURE;
+    }
+    else if (count > 1) {
+        keys = malloc(count * sizeof(uint64_t));
+        if (NULL == keys) {
+            status = EXIT_FAILURE;
+        }
+        else {
+            for (i = 0; i < count; i++) {
+                keys[i] = SELECTION_KEY(data[indices[i]], indices[i], mask);
+            }
+            qsort(keys, count, sizeof(uint64_t), CompareKeysDescending);
+            for (i = 0; i < count; i++) {
+                indices[i] = SELECTION_KEY_INDEX(keys[i], mask);
+            }
+        }
+    }
+
+    free(keys);
+
+    return status;
+}
+
+int SelectionBuildHistogram(const uint16_t *data,
+                            size_t size,
+                            size_t *histogram) {
+    int status = EXIT_SUCCESS;
+
+    if ((NULL == data) || (NULL == histogram)) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        memset(histogram, 0, SELECTION_HISTOGRAM_SIZE * sizeof(size_t));
+        SelectionUpdateHistogram(data, size, histogram);
+    }
+
+    return status;
+}
+
+void SelectionUpdateHistogram(const uint16_t *data,
+                              size_t size,
+                              size_t *histogram) {
+    size_t i = 0;
+
+    for (i = 0; i < size; i++) {
+        histogram[data[i]]++;
+    }
+}
+
+int SelectionFindThreshold(const size_t *histogram,
+                           size_t count,
+                           enum Selection_Tie_Break tie_break,
+                           struct Selection_Threshold *threshold) {
+    size_t value = 0;
+    size_t lowest = 0;
+    size_t above = 0;
+    int status = EXIT_SUCCESS;
+
+    if ((NULL == histogram) || (NULL == threshold)) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        memset(threshold, 0, sizeof(*threshold));
+
+        for (value = SELECTION_HISTOGRAM_SIZE - 1; value > 0; value--) {
+            if (0 == histogram[value]) {
+                continue;
+            }
+            lowest = value;
+            if (above + histogram[value] >= count) {
+                break;
+            }
+            above += histogram[value];
+        }
+
+        /* Either count was reached at the lowest visited value,
+           or there are not enough non-zero pixels and all get selected. */
+        if (0 != lowest) {
+            threshold->value = lowest;
+            threshold->equal = histogram[lowest];
+            threshold->above = (0 != value) ? above :
+                               above - histogram[lowest];
+            threshold->quota = (SELECTION_TIE_BREAK_ALL == tie_break) ?
+                               threshold->equal :
+                               count - threshold->above;
+            if (threshold->quota > threshold->equal) {
+                threshold->quota = threshold->equal;
+            }
+        }
+    }
+
+    return status;
+}
+
+static void HeapSiftDown(uint64_t *heap, size_t size, size_t node) {
+    uint64_t key = heap[node];
+    size_t child = 0;
+
+    while ((child = 2 * node + 1) < size) {
+        if ((child + 1 < size) && (heap[child + 1] < heap[child])) {
+            child++;
+        }
+        if (heap[child] >= key) {
+            break;
+        }
+        heap[node] = heap[child];
+        node = child;
+    }
+    heap[node] = key;
+}
+
+static void HeapSiftUp(uint64_t *heap, size_t node) {
+    uint64_t key = heap[node];
+    size_t parent = 0;
+
+    while (node > 0) {
+        parent = (node - 1) / 2;
+        if (heap[parent] <= key) {
+            break;
+        }
+        heap[node] = heap[parent];
+        node = parent;
+    }
+    heap[node] = key;
+}
+
+static int HistogramTopK(const uint16_t *data,
+                         size_t size,
+                         size_t count,
+                         enum Selection_Tie_Break tie_break,
+                         size_t *indices,
+                         size_t *selected) {
+    size_t i = 0;
+    size_t equal_seen = 0;
+    size_t equal_skip = 0;
+    size_t lowest = 0;
+    size_t *histogram = NULL;
+    struct Selection_Threshold threshold;
+    int status = EXIT_SUCCESS;
+
+    histogram = malloc(SELECTION_HISTOGRAM_SIZE * sizeof(size_t));
+    if (NULL == histogram) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        status = SelectionBuildHistogram(data, size, histogram);
+    }
+
+    if (EXIT_SUCCESS == status) {
+        status = SelectionFindThreshold(histogram, count, tie_break,
+                                        &threshold);
+    }
+
+    if ((EXIT_SUCCESS == status) && (0 != threshold.value)) {
+        /* With the last policy, the first equal pixels are skipped. */
+        if (SELECTION_TIE_BREAK_LAST == tie_break) {
+            equal_skip = threshold.equal - threshold.quota;
+        }
+
+        /* Only the pixels reaching the threshold have to be looked at. */
+        i = KernelFindAtLeast(data, size, threshold.value);
+        while (i < size) {
+            if (data[i] > threshold.value) {
+                indices[(*selected)++] = i;
+            }
+            else if (data[i] == threshold.value) {
+                if ((equal_seen >= equal_skip) &&
+                    (equal_seen < equal_skip + threshold.quota)) {
+                    /* The lowest ranked equal pixel is the last one taken
+                       with the first policy and the first one otherwise. */
+                    if ((SELECTION_TIE_BREAK_LAST != tie_break) ||
+                        (equal_seen == equal_skip)) {
+                        lowest = *selected;
+                    }
+                    indices[(*selected)++] = i;
+                }
+                equal_seen++;
+            }
+            i++;
+            i += KernelFindAtLeast(&data[i], size - i, threshold.value);
+        }
+
+        i = indices[lowest];
+        indices[lowest] = indices[*selected - 1];
+        indices[*selected - 1] = i;
+    }
+
+    free(histogram);
+
+    return status;
+}
+
+static void IntroSelect(uint64_t *keys, size_t size, size_t nth) {
+    int64_t low = 0;
+    int64_t high = (int64_t) size - 1;
+    int64_t i = 0;
+    int64_t j = 0;
+    size_t depth_limit = 0;
+    size_t heap_size = 0;
+    uint64_t pivot = 0;
+    uint64_t a = 0;
+    uint64_t b = 0;
+    uint64_t c = 0;
+    uint64_t tmp = 0;
+
+    for (i = size; i > 1; i >>= 1) {
+        depth_limit += 2;
+    }
+
+    while (high > low) {
+        if (0 == depth_limit) {
+            /* Heap select the (nth - low + 1) greatest keys of the range. */
+            heap_size = nth - low + 1;
+            for (i = 1; i < (int64_t) heap_size; i++) {
+                HeapSiftUp(keys + low, i);
+            }
+            for (i = low + heap_size; i <= high; i++) {
+                if (keys[i] > keys[low]) {
+                    tmp = keys[low];
+                    keys[low] = keys[i];
+                    keys[i] = tmp;
+                    HeapSiftDown(keys + low, heap_size, 0);
+                }
+            }
+            tmp = keys[low];
+            keys[low] = keys[nth];
+            keys[nth] = tmp;
+            break;
+        }
+        depth_limit--;
+
+        /* Median of three pivot. */
+        a = keys[low];
+        b = keys[low + (high - low) / 2];
+        c = keys[high];
+        if ((a > b) == (b > c)) {
+            pivot = b;
+        }
+        else if ((b > a) == (a > c)) {
+            pivot = a;
+        }
+        else {
+            pivot = c;
+        }
+
+        /* Hoare partitioning in descending order. */
+        i = low;
+        j = high;
+        while (i <= j) {
+            while (keys[i] > pivot) {
+                i++;
+            }
+            while (keys[j] < pivot) {
+                j--;
+            }
+            if (i <= j) {
+                tmp = keys[i];
+                keys[i] = keys[j];
+                keys[j] = tmp;
+                i++;
+                j--;
+            }
+        }
+
+        if ((int64_t) nth <= j) {
+            high = j;
+        }
+        else if ((int64_t) nth >= i) {
+            low = i;
+        }
+        else {
+            break;
+        }
+    }
+}
+
+static int CompareKeysDescending(const void *a, const void *b) {
+    uint64_t key_a = *((const uint64_t *) a);
+    uint64_t key_b = *((const uint64_t *) b);
+
+    return (key_a < key_b) - (key_a > key_b);
+}
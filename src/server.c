@@ -0,0 +1,517 @@
+/**
+ *  @brief Frame server implementation file.
+ *
+ */
+
+/* Needed for F_GET_SEALS. */
+#define _GNU_SOURCE
+
+#include "server.h"
+
+#include "parallel.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/****************************************************************************
+ * SYMBOLIC CONSTANTS AND MACROS
+ ****************************************************************************/
+/* Most descriptors passed with a request (frame, then preview memory). */
+#define SERVER_MAX_FDS 2U
+
+/* Pending connections queued by the kernel. */
+#define SERVER_BACKLOG 16
+
+/****************************************************************************
+ * TYPE DEFINITIONS
+ ****************************************************************************/
+
+/**
+ *  @brief Shared memory mapped for a connection.
+ */
+struct Server_Mapping {
+    uint8_t *data;              /* Mapped memory (NULL if none) */
+    size_t size;                /* Mapping size in bytes */
+    dev_t device;               /* Device of the memory object */
+    ino_t inode;                /* Inode of the memory object */
+};
+
+/**
+ *  @brief Connection state.
+ */
+struct Server_Client {
+    int fd;                     /* Connection socket (non-blocking) */
+    struct Server_Mapping frame;    /* Frame memory */
+    struct Server_Mapping preview;  /* Preview memory */
+    struct Server_Request request;  /* Request being received */
+    size_t received;            /* Number of request bytes received */
+    int fds[SERVER_MAX_FDS];    /* Descriptors received with it */
+    size_t fd_count;            /* Number of those descriptors */
+};
+
+/****************************************************************************
+ * LOCAL DECLARATIONS
+ ****************************************************************************/
+/**
+ *  @brief Bind and listen on a Unix socket.
+ *
+ *  @param socket_path  Socket path
+ *  @param fd           Listening socket
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise.
+ */
+static int OpenServerSocket(const char *socket_path, int *fd);
+
+/**
+ *  @brief Map the shared memory behind a descriptor.
+ *
+ *  The current mapping is kept if it is the same memory object with the
+ *  same size. The memory must be sealed against shrinking, so it can't
+ *  be cut short under a mapping kept from one request to the next. The
+ *  descriptor is closed either way.
+ *  @param mapping  Mapping to update
+ *  @param fd       Shared memory descriptor
+ *
+ *  @return EXIT_SUCCESS, if successful.
+ *          EXIT_FAILURE, otherwise (the mapping is then released).
+ */
+static int MapSharedMemory(struct Server_Mapping *mapping, int fd);
+
+/**
+ *  @brief Release a shared memory mapping.
+ *
+ *  @param mapping  Mapping to release
+ *
+ *  @return none
+ */
+static void UnmapSharedMemory(struct Server_Mapping *mapping);
+
+/**
+ *  @brief Receive what has come of a request and its descriptors.
+ *
+ *  A request may come in pieces, which are kept in the connection along
+ *  with the descriptors passed so far, so a client stopping halfway
+ *  doesn't hold up the others. Once the request is whole, its memory is
+ *  mapped.
+ *  @param client    Connection to receive from
+ *  @param complete  Whether the connection request is now whole
+ *
+ *  @return EXIT_SUCCESS, if the received part was taken in (and the
+ *          memory of a whole request mapped).
+ *          EXIT_FAILURE, if the connection ended or is malformed.
+ */
+static int ReceiveRequest(struct Server_Client *client, bool *complete);
+
+/**
+ *  @brief Process a request.
+ *
+ *  The statistics of the context are reset first, to count the work done
+ *  for this request alone.
+ *  @param context   Processing context
+ *  @param client    Connection the request came from
+ *  @param request   Request to process
+ *  @param response  Reply to fill in
+ *  @param stats     Run statistics (may be NULL)
+ *
+ *  @return none
+ */
+static void ProcessRequest(struct Delite_Context *context,
+                           const struct Server_Client *client,
+                           const struct Server_Request *request,
+                           struct Server_Response *response,
+                           struct Stats *stats);
+
+/**
+ *  @brief Serve the next request of a connection, once it is whole.
+ *
+ *  A client whose replies can't be sent right away, not reading them, is
+ *  dropped rather than waited for.
+ *  @param context  Processing context
+ *  @param client   Connection with incoming data
+ *  @param stats    Run statistics (may be NULL)
+ *
+ *  @return EXIT_SUCCESS, if the request was served or is still partial.
+ *          EXIT_FAILURE, if the connection must be closed.
+ */
+static int ServeClient(struct Delite_Context *context,
+                       struct Server_Client *client,
+                       struct Stats *stats);
+
+/**
+ *  @brief Close a connection and release its memory.
+ *
+ *  @param client  Connection to close
+ *
+ *  @return none
+ */
+static void CloseClient(struct Server_Client *client);
+
+/****************************************************************************/
+
+int ServerRun(const char *socket_path,
+              const struct Delite_Options *options,
+              volatile sig_atomic_t *stop,
+              struct Stats *stats) {
+    struct Delite_Context context;
+    struct Stats request_stats;
+    struct Server_Client clients[SERVER_MAX_CLIENTS];
+    struct pollfd fds[SERVER_MAX_CLIENTS + 1U];
+    bool context_ready = false;
+    bool pool_ready = false;
+    size_t client_count = 0;
+    size_t polled = 0;
+    size_t i = 0;
+    int listener = -1;
+    int fd = -1;
+    int status = EXIT_SUCCESS;
+
+    status = DeliteInit(&context, options);
+    if (EXIT_FAILURE == status) {
+        printf("Unexpected error when generating the preview.\n");
+    }
+    else {
+        context_ready = true;
+        context.stats = &request_stats;
+        status = OpenServerSocket(socket_path, &listener);
+        if (EXIT_FAILURE == status) {
+            printf("Unexpected error when opening the server socket.\n");
+        }
+    }
+
+    /* The frames run on the same workers from one request to the next,
+       or on threads of their own if the pool can't be started. */
+    if ((EXIT_SUCCESS == status) && (options->thread_count > 1U)) {
+        pool_ready = (EXIT_SUCCESS ==
+                      ParallelPoolStart(options->thread_count - 1U));
+    }
+
+    while ((EXIT_SUCCESS == status) && (0 == *stop)) {
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        for (i = 0; i < client_count; i++) {
+            fds[i + 1U].fd = clients[i].fd;
+            fds[i + 1U].events = POLLIN;
+        }
+
+        /* A signal interrupts the wait, to check whether to stop. */
+        if (poll(fds, client_count + 1U, -1) < 0) {
+            if (EINTR != errno) {
+                printf("Unexpected error when waiting for requests.\n");
+                status = EXIT_FAILURE;
+            }
+            fds[0].revents = 0;
+            polled = 0;
+        }
+        else {
+            polled = client_count;
+        }
+
+        /* Closed connections are replaced by the last one. */
+        for (i = polled; i > 0; i--) {
+            if ((0 != fds[i].revents) &&
+                (EXIT_FAILURE == ServeClient(&context, &clients[i - 1U],
+                                             stats))) {
+                CloseClient(&clients[i - 1U]);
+                clients[i - 1U] = clients[--client_count];
+            }
+        }
+
+        if (0 != (fds[0].revents & POLLIN)) {
+            fd = accept(listener, NULL, NULL);
+            /* No connection may block the others. */
+            if ((fd >= 0) &&
+                (0 != fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK))) {
+                close(fd);
+                fd = -1;
+            }
+            if ((fd >= 0) && (client_count < SERVER_MAX_CLIENTS)) {
+                memset(&clients[client_count], 0, sizeof(clients[0]));
+                clients[client_count].fd = fd;
+                client_count++;
+            }
+            else if (fd >= 0) {
+                close(fd);
+            }
+        }
+        else if ((EXIT_SUCCESS == status) && (0 != fds[0].revents)) {
+            printf("Unexpected error when waiting for requests.\n");
+            status = EXIT_FAILURE;
+        }
+    }
+
+    for (i = 0; i < client_count; i++) {
+        CloseClient(&clients[i]);
+    }
+    if (listener >= 0) {
+        close(listener);
+        unlink(socket_path);
+    }
+    if (pool_ready) {
+        ParallelPoolStop();
+    }
+    if (context_ready) {
+        DeliteFree(&context);
+    }
+
+    return status;
+}
+
+static int OpenServerSocket(const char *socket_path, int *fd) {
+    struct sockaddr_un address;
+    struct stat file_stat;
+    int status = EXIT_SUCCESS;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    *fd = -1;
+
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        strcpy(address.sun_path, socket_path);
+        /* A socket left over by a previous run would make bind() fail. */
+        if ((0 == lstat(socket_path, &file_stat)) &&
+            S_ISSOCK(file_stat.st_mode)) {
+            unlink(socket_path);
+        }
+        *fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if ((*fd < 0) ||
+            (0 != bind(*fd, (struct sockaddr *) &address, sizeof(address))) ||
+            (0 != listen(*fd, SERVER_BACKLOG))) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    if ((EXIT_FAILURE == status) && (*fd >= 0)) {
+        close(*fd);
+        *fd = -1;
+    }
+
+    return status;
+}
+
+static int MapSharedMemory(struct Server_Mapping *mapping, int fd) {
+    struct stat file_stat;
+    void *data = MAP_FAILED;
+    int seals = fcntl(fd, F_GET_SEALS);
+    int status = EXIT_SUCCESS;
+
+    if ((seals < 0) || (0 == (seals & F_SEAL_SHRINK)) ||
+        (0 != fstat(fd, &file_stat)) || (file_stat.st_size <= 0) ||
+        ((uintmax_t) file_stat.st_size > SIZE_MAX)) {
+        UnmapSharedMemory(mapping);
+        status = EXIT_FAILURE;
+    }
+    else if ((NULL == mapping->data) ||
+             (mapping->device != file_stat.st_dev) ||
+             (mapping->inode != file_stat.st_ino) ||
+             (mapping->size != (size_t) file_stat.st_size)) {
+        UnmapSharedMemory(mapping);
+        data = mmap(NULL, file_stat.st_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+        if (MAP_FAILED == data) {
+            status = EXIT_FAILURE;
+        }
+        else {
+            mapping->data = data;
+            mapping->size = file_stat.st_size;
+            mapping->device = file_stat.st_dev;
+            mapping->inode = file_stat.st_ino;
+        }
+    }
+    close(fd);
+
+    return status;
+}
+
+static void UnmapSharedMemory(struct Server_Mapping *mapping) {
+    if (NULL != mapping->data) {
+        munmap(mapping->data, mapping->size);
+    }
+    memset(mapping, 0, sizeof(*mapping));
+}
+
+static int ReceiveRequest(struct Server_Client *client, bool *complete) {
+    union {
+        struct cmsghdr header;
+        uint8_t buffer[CMSG_SPACE(SERVER_MAX_FDS * sizeof(int))];
+    } control;
+    struct msghdr message;
+    struct iovec iov;
+    struct cmsghdr *cmsg = NULL;
+    ssize_t length = 0;
+    size_t i = 0;
+    int fd = -1;
+    int status = EXIT_SUCCESS;
+
+    memset(&message, 0, sizeof(message));
+    iov.iov_base = (uint8_t *) &(client->request) + client->received;
+    iov.iov_len = sizeof(client->request) - client->received;
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    do {
+        length = recvmsg(client->fd, &message, 0);
+    } while ((length < 0) && (EINTR == errno));
+
+    /* The descriptors are taken over even if the request is rejected. */
+    for (cmsg = CMSG_FIRSTHDR(&message); (length > 0) && (NULL != cmsg);
+         cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        for (i = 0; (SOL_SOCKET == cmsg->cmsg_level) &&
+                    (SCM_RIGHTS == cmsg->cmsg_type) &&
+                    (CMSG_LEN((i + 1U) * sizeof(int)) <= cmsg->cmsg_len);
+             i++) {
+            memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            if (client->fd_count < SERVER_MAX_FDS) {
+                client->fds[client->fd_count++] = fd;
+            }
+            else {
+                close(fd);
+            }
+        }
+    }
+
+    if ((length < 0) && ((EAGAIN == errno) || (EWOULDBLOCK == errno))) {
+        /* Nothing more has come in yet. */
+        length = 0;
+    }
+    else if ((length <= 0) ||
+             (0 != (message.msg_flags & (MSG_CTRUNC | MSG_TRUNC)))) {
+        status = EXIT_FAILURE;
+    }
+    client->received += length;
+    *complete = (EXIT_SUCCESS == status) &&
+                (sizeof(client->request) == client->received);
+    if (*complete && (SERVER_MAGIC != client->request.magic)) {
+        status = EXIT_FAILURE;
+    }
+
+    for (i = 0; (*complete || (EXIT_FAILURE == status)) &&
+                (i < client->fd_count); i++) {
+        if (EXIT_FAILURE == status) {
+            close(client->fds[i]);
+        }
+        else {
+            status = MapSharedMemory((0 == i) ? &(client->frame) :
+                                                &(client->preview),
+                                     client->fds[i]);
+        }
+    }
+    if (*complete || (EXIT_FAILURE == status)) {
+        client->received = 0;
+        client->fd_count = 0;
+    }
+
+    return status;
+}
+
+static void ProcessRequest(struct Delite_Context *context,
+                           const struct Server_Client *client,
+                           const struct Server_Request *request,
+                           struct Server_Response *response,
+                           struct Stats *stats) {
+    const struct Server_Mapping *frame = &(client->frame);
+    const struct Server_Mapping *preview = &(client->preview);
+    uint16_t *data = NULL;
+    size_t preview_size = 0;
+    int status = EXIT_SUCCESS;
+
+    memset(response, 0, sizeof(*response));
+    response->magic = SERVER_MAGIC;
+
+    /* The requested frame and preview must lie within their memory. */
+    if ((0 == request->flags) ||
+        (0 != (request->flags & ~(SERVER_FLAG_ADJUST |
+                                  SERVER_FLAG_PREVIEW))) ||
+        (NULL == frame->data) || (0 != request->frame_offset % 2U) ||
+        (0 == request->frame_size) ||
+        (request->frame_offset > frame->size) ||
+        (request->frame_size > (frame->size - request->frame_offset) /
+                               sizeof(uint16_t))) {
+        status = EXIT_FAILURE;
+    }
+    else if ((0 != (request->flags & SERVER_FLAG_PREVIEW)) &&
+             ((NULL == preview->data) ||
+              (request->preview_offset > preview->size))) {
+        status = EXIT_FAILURE;
+    }
+    else {
+        data = (uint16_t *) (frame->data + request->frame_offset);
+        StatsInit(context->stats);
+    }
+
+    if ((EXIT_SUCCESS == status) &&
+        (0 != (request->flags & SERVER_FLAG_ADJUST))) {
+        status = DeliteAdjust(context, data, request->frame_size);
+    }
+    if ((EXIT_SUCCESS == status) &&
+        (0 != (request->flags & SERVER_FLAG_PREVIEW))) {
+        status = DeliteRenderPreview(context, data, request->frame_size,
+                                     preview->data + request->preview_offset,
+                                     preview->size - request->preview_offset,
+                                     &preview_size);
+    }
+
+    if (NULL != data) {
+        response->adjusted = context->stats->counters[STATS_PIXELS_ADJUSTED];
+        if (NULL != stats) {
+            StatsMerge(stats, context->stats);
+        }
+    }
+    if (EXIT_SUCCESS == status) {
+        response->preview_size = preview_size;
+    }
+    response->status = status;
+}
+
+static int ServeClient(struct Delite_Context *context,
+                       struct Server_Client *client,
+                       struct Stats *stats) {
+    struct Server_Response response;
+    ssize_t length = 0;
+    bool complete = false;
+    int status = EXIT_SUCCESS;
+
+    status = ReceiveRequest(client, &complete);
+    if ((EXIT_SUCCESS == status) && complete) {
+        ProcessRequest(context, client, &(client->request), &response,
+                       stats);
+        /* A client gone before its reply mustn't stop the server. */
+        do {
+            length = send(client->fd, &response, sizeof(response),
+                          MSG_NOSIGNAL);
+        } while ((length < 0) && (EINTR == errno));
+        if (length != (ssize_t) sizeof(response)) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    return status;
+}
+
+static void CloseClient(struct Server_Client *client) {
+    size_t i = 0;
+
+    for (i = 0; i < client->fd_count; i++) {
+        close(client->fds[i]);
+    }
+    client->fd_count = 0;
+    UnmapSharedMemory(&(client->frame));
+    UnmapSharedMemory(&(client->preview));
+    close(client->fd);
+    client->fd = -1;
+}
@@ -0,0 +1,136 @@
+/**
+ *  @brief Run statistics implementation file.
+ *
+ */
+
+#include "stats.h"
+
+#include "kernels.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+/****************************************************************************
+ * LOCAL DECLARATIONS
+ ****************************************************************************/
+/* JSON keys of the stages and counters, in enum order. */
+static const char *const stage_names[STATS_STAGE_COUNT] = {
+    "read", "detect", "adjust", "preview", "fused", "write"
+};
+static const char *const counter_names[STATS_COUNTER_COUNT] = {
+    "frames", "bytes_read", "bytes_written", "pixels_scanned",
+    "pixels_adjusted"
+};
+
+/**
+ *  @brief Log a JSON string value.
+ *
+ *  @param log    Log to write to
+ *  @param value  String to log (NULL for null)
+ *
+ *  @return none
+ */
+static void LogString(struct Log *log, const char *value);
+
+/****************************************************************************/
+
+void StatsInit(struct Stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->started = StatsGetTime();
+}
+
+double StatsGetTime(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void StatsBegin(struct Stats *stats, enum Stats_Stage stage) {
+    if (NULL != stats) {
+        stats->starts[stage] = StatsGetTime();
+    }
+}
+
+void StatsEnd(struct Stats *stats, enum Stats_Stage stage) {
+    if (NULL != stats) {
+        stats->seconds[stage] += StatsGetTime() - stats->starts[stage];
+    }
+}
+
+void StatsAdd(struct Stats *stats, enum Stats_Counter counter,
+              uint64_t value) {
+    if (NULL != stats) {
+        stats->counters[counter] += value;
+    }
+}
+
+void StatsSetEngine(struct Stats *stats, const char *engine) {
+    if (NULL != stats) {
+        stats->engine = engine;
+    }
+}
+
+void StatsSetIoBackend(struct Stats *stats, const char *io_backend) {
+    if (NULL != stats) {
+        stats->io_backend = io_backend;
+    }
+}
+
+void StatsMerge(struct Stats *stats, const struct Stats *other) {
+    size_t i = 0;
+
+    for (i = 0; i < STATS_STAGE_COUNT; i++) {
+        stats->seconds[i] += other->seconds[i];
+    }
+    for (i = 0; i < STATS_COUNTER_COUNT; i++) {
+        stats->counters[i] += other->counters[i];
+    }
+    if (NULL != other->engine) {
+        stats->engine = other->engine;
+    }
+    if (NULL != other->io_backend) {
+        stats->io_backend = other->io_backend;
+    }
+}
+
+void StatsWrite(const struct Stats *stats, struct Log *log) {
+    struct rusage usage;
+    size_t i = 0;
+
+    /* The maximum resident set size is given in KiB. */
+    memset(&usage, 0, sizeof(usage));
+    getrusage(RUSAGE_SELF, &usage);
+
+    LogPrintf(log, "{\"engine\":");
+    LogString(log, stats->engine);
+    LogPrintf(log, ",\"kernels\":");
+    LogString(log, KernelsGetName());
+    LogPrintf(log, ",\"io_backend\":");
+    LogString(log, stats->io_backend);
+    LogPrintf(log, ",\"threads\":%zu,\"seconds\":{\"total\":%.6f",
+              stats->thread_count, StatsGetTime() - stats->started);
+    for (i = 0; i < STATS_STAGE_COUNT; i++) {
+        LogPrintf(log, ",\"%s\":%.6f", stage_names[i], stats->seconds[i]);
+    }
+    LogPrintf(log, "}");
+    for (i = 0; i < STATS_COUNTER_COUNT; i++) {
+        LogPrintf(log, ",\"%s\":%" PRIu64, counter_names[i],
+                  stats->counters[i]);
+    }
+    LogPrintf(log, ",\"peak_rss_bytes\":%" PRIu64 "}\n",
+              (uint64_t) usage.ru_maxrss * 1024U);
+}
+
+static void LogString(struct Log *log, const char *value) {
+    if (NULL == value) {
+        LogPrintf(log, "null");
+    }
+    else {
+        LogPrintf(log, "\"%s\"", value);
+    }
+}
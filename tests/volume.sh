@@ -0,0 +1,58 @@
+#!/bin/sh
+# Checks of the --depth volume mode, run by make check.
+#
+# A volume that doesn't split exactly into its slices must be rejected
+# before any output is written, while a valid one must be adjusted the
+# same as that data taken as a single frame.
+
+DELITE=${DELITE:-bin/delite}
+BENCH=${BENCH:-bin/bench}
+DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+failed=0
+
+# Print a failed check and remember it.
+fail() {
+    echo "FAIL: $1"
+    failed=1
+}
+
+# Check that a volume geometry is rejected without any output.
+expect_rejected() {
+    rm -rf "$DIR/out" && mkdir "$DIR/out" || exit 1
+    if "$DELITE" -f "$DIR/volume.bin" -p 500 "$@" -o "$DIR/out/s.%i" \
+           --altered "$DIR/out/altered.bin" > "$DIR/log" 2>&1; then
+        fail "$* was accepted"
+    elif [ -n "$(ls -A "$DIR/out")" ]; then
+        fail "$* left output files behind"
+    fi
+}
+
+# 16 slices of 160x120 pixels.
+"$BENCH" -g "$DIR/volume.bin" -d hot -w 160 -h 1920 > /dev/null ||
+    exit 1
+
+expect_rejected --width 160 --height 120 --depth 17
+expect_rejected --width 160 --height 120 --depth 15
+expect_rejected --depth 7
+expect_rejected --width 170 --depth 16
+
+rm -rf "$DIR/out" && mkdir "$DIR/out" || exit 1
+if ! "$DELITE" -f "$DIR/volume.bin" -p 500 --width 160 --height 120 \
+         --depth 16 -o "$DIR/out/s.%i" --altered "$DIR/out/volume.bin" \
+         > "$DIR/log" 2>&1; then
+    fail "a valid --depth was rejected"
+elif ! "$DELITE" -f "$DIR/volume.bin" -p 500 --width 160 \
+           -o "$DIR/out/frame" --altered "$DIR/out/frame.bin" \
+           > "$DIR/log" 2>&1; then
+    fail "the volume was rejected as a single frame"
+elif ! cmp -s "$DIR/out/volume.bin" "$DIR/out/frame.bin"; then
+    fail "--depth changed the adjusted data"
+elif [ ! -f "$DIR/out/s.15" ]; then
+    fail "the last slice preview is missing"
+fi
+
+if [ 0 -eq "$failed" ]; then
+    echo "volume: OK"
+fi
+exit $failed